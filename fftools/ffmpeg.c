@@ -160,6 +160,7 @@ static int restore_tty;
 
 #if HAVE_THREADS
 static void free_input_threads(void);
+static void free_encoder_thread(OutputStream *ost);
 #endif
 
 /* sub2video hack:
@@ -222,6 +223,7 @@ static void sub2video_push_ref(InputStream *ist, int64_t pts)
     av_assert1(frame->data[0]);
     ist->sub2video.last_pts = frame->pts = pts;
     for (i = 0; i < ist->nb_filters; i++) {
+        filtergraph_wait(ist->filters[i]->graph);
         ret = av_buffersrc_add_frame_flags(ist->filters[i]->filter, frame,
                                            AV_BUFFERSRC_FLAG_KEEP_REF |
                                            AV_BUFFERSRC_FLAG_PUSH);
@@ -288,8 +290,10 @@ static void sub2video_heartbeat(InputStream *ist, int64_t pts)
         if (pts2 >= ist2->sub2video.end_pts ||
             (!ist2->sub2video.frame->data[0] && ist2->sub2video.end_pts < INT64_MAX))
             sub2video_update(ist2, NULL);
-        for (j = 0, nb_reqs = 0; j < ist2->nb_filters; j++)
+        for (j = 0, nb_reqs = 0; j < ist2->nb_filters; j++) {
+            filtergraph_wait(ist2->filters[j]->graph);
             nb_reqs += av_buffersrc_get_nb_failed_requests(ist2->filters[j]->filter);
+        }
         if (nb_reqs)
             sub2video_push_ref(ist2, pts2);
     }
@@ -303,6 +307,7 @@ static void sub2video_flush(InputStream *ist)
     if (ist->sub2video.end_pts < INT64_MAX)
         sub2video_update(ist, NULL);
     for (i = 0; i < ist->nb_filters; i++) {
+        filtergraph_wait(ist->filters[i]->graph);
         ret = av_buffersrc_add_frame(ist->filters[i]->filter, NULL);
         if (ret != AVERROR_EOF && ret < 0)
             av_log(NULL, AV_LOG_WARNING, "Flush the frame error.\n");
@@ -485,6 +490,7 @@ static void ffmpeg_cleanup(int ret)
 
     for (i = 0; i < nb_filtergraphs; i++) {
         FilterGraph *fg = filtergraphs[i];
+        filtergraph_free_thread(fg);
         avfilter_graph_free(&fg->graph);
         for (j = 0; j < fg->nb_inputs; j++) {
             while (av_fifo_size(fg->inputs[j]->frame_queue)) {
@@ -562,6 +568,9 @@ static void ffmpeg_cleanup(int ret)
 
         av_dict_free(&ost->sws_dict);
 
+#if HAVE_THREADS
+        free_encoder_thread(ost);
+#endif
         avcodec_free_context_ijk(&ost->enc_ctx);
         avcodec_parameters_free_ijk(&ost->ref_par);
 
@@ -884,6 +893,194 @@ finish:
     }
 }
 
+#if HAVE_THREADS
+typedef struct EncoderFrame {
+    AVFrame *frame;         /* NULL requests the encoder to be drained */
+    int64_t  sync_opts;     /* ost->sync_opts when the frame was submitted */
+} EncoderFrame;
+
+typedef struct EncoderPacket {
+    AVPacket pkt;
+    int ret;                /* 0 for a packet, 1 after the last packet of a frame,
+                               AVERROR_EOF once drained, other errors are fatal */
+} EncoderPacket;
+
+static void encoder_frame_free(void *msg)
+{
+    EncoderFrame *in = msg;
+    av_frame_free_xij(&in->frame);
+}
+
+static void encoder_packet_free(void *msg)
+{
+    EncoderPacket *out = msg;
+    av_packet_unref_ijk(&out->pkt);
+}
+
+static void *encoder_thread(void *arg)
+{
+    OutputStream   *ost = arg;
+    AVCodecContext *enc = ost->enc_ctx;
+    EncoderFrame     in;
+    EncoderPacket   out;
+    int ret;
+
+    while (av_thread_message_queue_recv(ost->enc_in_queue, &in, 0) >= 0) {
+        int flush = !in.frame;
+
+        ret = avcodec_send_frame(enc, in.frame);
+        av_frame_free_xij(&in.frame);
+
+        while (ret >= 0) {
+            av_init_packet_ijk(&out.pkt);
+            out.pkt.data = NULL;
+            out.pkt.size = 0;
+            out.ret      = 0;
+
+            ret = avcodec_receive_packet(enc, &out.pkt);
+            if (ret < 0)
+                break;
+
+            if (!flush && enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+                out.pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                out.pkt.pts = in.sync_opts;
+
+            ret = av_thread_message_queue_send(ost->enc_out_queue, &out, 0);
+            if (ret < 0) {
+                av_packet_unref_ijk(&out.pkt);
+                return NULL;
+            }
+        }
+
+        av_init_packet_ijk(&out.pkt);
+        out.pkt.data = NULL;
+        out.pkt.size = 0;
+        out.ret      = ret == AVERROR(EAGAIN) ? 1 : ret;
+        if (av_thread_message_queue_send(ost->enc_out_queue, &out, 0) < 0 || out.ret < 0)
+            break;
+    }
+
+    return NULL;
+}
+
+static int init_encoder_thread(OutputStream *ost)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    int ret;
+
+    /* two-pass logs, vstats and PSNR reporting read encoder state per packet */
+    if (!threaded_encoding || ost->logfile || vstats_filename ||
+        (enc->flags & AV_CODEC_FLAG_PSNR) ||
+        (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO))
+        return 0;
+
+    ret = av_thread_message_queue_alloc(&ost->enc_in_queue, 2, sizeof(EncoderFrame));
+    if (ret < 0)
+        return ret;
+    ret = av_thread_message_queue_alloc(&ost->enc_out_queue, 16, sizeof(EncoderPacket));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(ost->enc_in_queue, encoder_frame_free);
+    av_thread_message_queue_set_free_func(ost->enc_out_queue, encoder_packet_free);
+
+    if ((ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    return 0;
+fail:
+    av_thread_message_queue_free(&ost->enc_in_queue);
+    av_thread_message_queue_free(&ost->enc_out_queue);
+    return ret;
+}
+
+static void free_encoder_thread(OutputStream *ost)
+{
+    if (!ost->enc_in_queue)
+        return;
+
+    av_thread_message_flush(ost->enc_in_queue);
+    av_thread_message_queue_set_err_recv(ost->enc_in_queue, AVERROR_EOF);
+    av_thread_message_queue_set_err_send(ost->enc_out_queue, AVERROR_EOF);
+    pthread_join(ost->enc_thread, NULL);
+
+    av_thread_message_queue_free(&ost->enc_in_queue);
+    av_thread_message_queue_free(&ost->enc_out_queue);
+    ost->enc_frames_pending = 0;
+}
+
+/* mux the packets the encoder thread produced for the oldest pending frame */
+static void encoder_thread_collect(OutputFile *of, OutputStream *ost)
+{
+    AVCodecContext *enc = ost->enc_ctx;
+    const char *desc = enc->codec_type == AVMEDIA_TYPE_VIDEO ? "video" : "audio";
+    EncoderPacket out;
+    int ret;
+
+    while ((ret = av_thread_message_queue_recv(ost->enc_out_queue, &out, 0)) >= 0) {
+        if (out.ret == 1)
+            break;
+        if (out.ret == AVERROR_EOF) {
+            output_packet(of, &out.pkt, ost, 1);
+            break;
+        }
+        if (out.ret < 0) {
+            ret = out.ret;
+            break;
+        }
+        if (ost->finished & MUXER_FINISHED) {
+            av_packet_unref_ijk(&out.pkt);
+            continue;
+        }
+
+        if (debug_ts) {
+            av_log(NULL, AV_LOG_INFO, "encoder -> type:%s "
+                   "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n", desc,
+                   av_ts2str(out.pkt.pts), av_ts2timestr(out.pkt.pts, &enc->time_base),
+                   av_ts2str(out.pkt.dts), av_ts2timestr(out.pkt.dts, &enc->time_base));
+        }
+
+        av_packet_rescale_ts_xij(&out.pkt, enc->time_base, ost->mux_timebase);
+        output_packet(of, &out.pkt, ost, 0);
+    }
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_FATAL, "%s encoding failed: %s\n", desc, av_err2str(ret));
+        exit_program(1);
+    }
+    ost->enc_frames_pending--;
+}
+
+/*
+ * Hand a frame (or NULL to drain) to the encoder thread. One frame is kept in
+ * flight per stream: the packets of the previous frame are muxed here, so the
+ * output does not depend on thread scheduling.
+ */
+static void encoder_thread_submit(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+    EncoderFrame in = { NULL, ost->sync_opts };
+    int ret;
+
+    if (frame && !(in.frame = av_frame_clone_xij(frame))) {
+        av_log(NULL, AV_LOG_FATAL, "Could not queue frame for encoding\n");
+        exit_program(1);
+    }
+
+    ret = av_thread_message_queue_send(ost->enc_in_queue, &in, 0);
+    if (ret < 0) {
+        av_frame_free_xij(&in.frame);
+        av_log(NULL, AV_LOG_FATAL, "Could not queue frame for encoding: %s\n",
+               av_err2str(ret));
+        exit_program(1);
+    }
+    ost->enc_frames_pending++;
+
+    while (ost->enc_frames_pending > !!frame)
+        encoder_thread_collect(of, ost);
+}
+#endif
+
 static int check_recording_time(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
@@ -926,6 +1123,13 @@ static void do_audio_out(OutputFile *of, OutputStream *ost,
                enc->time_base.num, enc->time_base.den);
     }
 
+#if HAVE_THREADS
+    if (ost->enc_in_queue) {
+        encoder_thread_submit(of, ost, frame);
+        return;
+    }
+#endif
+
     ret = avcodec_send_frame(enc, frame);
     if (ret < 0)
         goto error;
@@ -1275,43 +1479,50 @@ static void do_video_out(OutputFile *of,
 
         ost->frames_encoded++;
 
-        ret = avcodec_send_frame(enc, in_picture);
-        if (ret < 0)
-            goto error;
-
-        while (1) {
-            ret = avcodec_receive_packet(enc, &pkt);
-            update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
-            if (ret == AVERROR(EAGAIN))
-                break;
+#if HAVE_THREADS
+        if (ost->enc_in_queue) {
+            encoder_thread_submit(of, ost, in_picture);
+        } else
+#endif
+        {
+            ret = avcodec_send_frame(enc, in_picture);
             if (ret < 0)
                 goto error;
 
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                       "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                       av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
-                       av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
-            }
+            while (1) {
+                ret = avcodec_receive_packet(enc, &pkt);
+                update_benchmark("encode_video %d.%d", ost->file_index, ost->index);
+                if (ret == AVERROR(EAGAIN))
+                    break;
+                if (ret < 0)
+                    goto error;
 
-            if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
-                pkt.pts = ost->sync_opts;
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                           "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                           av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &enc->time_base),
+                           av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &enc->time_base));
+                }
 
-            av_packet_rescale_ts_xij(&pkt, enc->time_base, ost->mux_timebase);
+                if (pkt.pts == AV_NOPTS_VALUE && !(enc->codec->capabilities & AV_CODEC_CAP_DELAY))
+                    pkt.pts = ost->sync_opts;
 
-            if (debug_ts) {
-                av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
-                    "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
-                    av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
-                    av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
-            }
+                av_packet_rescale_ts_xij(&pkt, enc->time_base, ost->mux_timebase);
 
-            frame_size = pkt.size;
-            output_packet(of, &pkt, ost, 0);
+                if (debug_ts) {
+                    av_log(NULL, AV_LOG_INFO, "encoder -> type:video "
+                        "pkt_pts:%s pkt_pts_time:%s pkt_dts:%s pkt_dts_time:%s\n",
+                        av_ts2str(pkt.pts), av_ts2timestr(pkt.pts, &ost->mux_timebase),
+                        av_ts2str(pkt.dts), av_ts2timestr(pkt.dts, &ost->mux_timebase));
+                }
+
+                frame_size = pkt.size;
+                output_packet(of, &pkt, ost, 0);
 
-            /* if two pass, output log */
-            if (ost->logfile && enc->stats_out) {
-                fprintf(ost->logfile, "%s", enc->stats_out);
+                /* if two pass, output log */
+                if (ost->logfile && enc->stats_out) {
+                    fprintf(ost->logfile, "%s", enc->stats_out);
+                }
             }
         }
     }
@@ -1425,6 +1636,7 @@ static int reap_filters(int flush)
 
         if (!ost->filter || !ost->filter->graph->graph)
             continue;
+        filtergraph_wait(ost->filter->graph);
         filter = ost->filter->filter;
 
         if (!ost->initialized) {
@@ -1893,12 +2105,24 @@ static void flush_encoders(void)
             }
         }
 
+#if HAVE_THREADS
+        while (ost->enc_frames_pending)
+            encoder_thread_collect(of, ost);
+#endif
+
         if (enc->codec_type == AVMEDIA_TYPE_AUDIO && enc->frame_size <= 1)
             continue;
 
         if (enc->codec_type != AVMEDIA_TYPE_VIDEO && enc->codec_type != AVMEDIA_TYPE_AUDIO)
             continue;
 
+#if HAVE_THREADS
+        if (ost->enc_in_queue) {
+            encoder_thread_submit(of, ost, NULL);
+            continue;
+        }
+#endif
+
         for (;;) {
             const char *desc = NULL;
             AVPacket pkt;
@@ -2177,7 +2401,7 @@ static int ifilter_send_frame(InputFilter *ifilter, AVFrame *frame)
         }
     }
 
-    ret = av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
+    ret = filtergraph_send_frame(ifilter, frame);
     if (ret < 0) {
         if (ret != AVERROR_EOF)
             av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
@@ -2194,6 +2418,7 @@ static int ifilter_send_eof(InputFilter *ifilter, int64_t pts)
     ifilter->eof = 1;
 
     if (ifilter->filter) {
+        filtergraph_wait(ifilter->graph);
         ret = av_buffersrc_close(ifilter->filter, pts, AV_BUFFERSRC_FLAG_PUSH);
         if (ret < 0)
             return ret;
@@ -3541,6 +3766,15 @@ static int init_output_stream(OutputStream *ost, char *error, int error_len)
             ost->st->duration = av_rescale_q(ist->st->duration, ist->st->time_base, ost->st->time_base);
 
         ost->st->codec->codec= ost->enc_ctx->codec;
+
+#if HAVE_THREADS
+        ret = init_encoder_thread(ost);
+        if (ret < 0) {
+            snprintf(error, error_len, "Could not start the encoder thread "
+                     "for output stream #%d:%d", ost->file_index, ost->index);
+            return ret;
+        }
+#endif
     } else if (ost->stream_copy) {
         ret = init_output_stream_streamcopy(ost);
         if (ret < 0)
@@ -3898,6 +4132,7 @@ static int check_keyboard_interaction(int64_t cur_time)
             for (i = 0; i < nb_filtergraphs; i++) {
                 FilterGraph *fg = filtergraphs[i];
                 if (fg->graph) {
+                    filtergraph_wait(fg);
                     if (time < 0) {
                         ret = avfilter_graph_send_command(fg->graph, target, command, arg, buf, sizeof(buf),
                                                           key == 'c' ? AVFILTER_CMD_FLAG_ONE : 0);
@@ -4461,6 +4696,7 @@ static int transcode_from_filter(FilterGraph *graph, InputStream **best_ist)
     InputStream *ist;
 
     *best_ist = NULL;
+    filtergraph_wait(graph);
     ret = avfilter_graph_request_oldest(graph->graph);
     if (ret >= 0)
         return reap_filters(0);
@@ -290,6 +290,13 @@ typedef struct FilterGraph {
     int          nb_inputs;
     OutputFilter **outputs;
     int         nb_outputs;
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *in_queue;   /* frames waiting for the filtergraph thread */
+    AVThreadMessageQueue *out_queue;  /* results of the frames it pushed */
+    pthread_t thread;                 /* thread pushing frames into this graph */
+    int frames_pending;               /* frames submitted but not yet pushed */
+#endif
 } FilterGraph;
 
 typedef struct InputStream {
@@ -548,6 +555,13 @@ typedef struct OutputStream {
 
     /* frame encode sum of squared error values */
     int64_t error[4];
+
+#if HAVE_THREADS
+    AVThreadMessageQueue *enc_in_queue;  /* frames waiting for the encoder thread */
+    AVThreadMessageQueue *enc_out_queue; /* packets returned by the encoder thread */
+    pthread_t enc_thread;                /* thread running this stream's encoder */
+    int enc_frames_pending;              /* frames submitted but not yet muxed */
+#endif
 } OutputStream;
 
 typedef struct OutputFile {
@@ -608,6 +622,9 @@ extern char *videotoolbox_pixfmt;
 
 extern int filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int threaded_encoding;
+extern int threaded_filtering;
+extern int filter_frame_threads;
 extern int vstats_version;
 
 extern const AVIOInterruptCB int_cb;
@@ -642,6 +659,9 @@ int configure_output_filter(FilterGraph *fg, OutputFilter *ofilter, AVFilterInOu
 void check_filter_outputs(void);
 int ist_in_filtergraph(FilterGraph *fg, InputStream *ist);
 int filtergraph_is_simple(FilterGraph *fg);
+int filtergraph_send_frame(InputFilter *ifilter, AVFrame *frame);
+void filtergraph_wait(FilterGraph *fg);
+void filtergraph_free_thread(FilterGraph *fg);
 int init_simple_filtergraph(InputStream *ist, OutputStream *ost);
 int init_complex_filtergraph(FilterGraph *fg);
 
@@ -986,6 +986,7 @@ static int configure_input_filter(FilterGraph *fg, InputFilter *ifilter,
 static void cleanup_filtergraph(FilterGraph *fg)
 {
     int i;
+    filtergraph_wait(fg);
     for (i = 0; i < fg->nb_outputs; i++)
         fg->outputs[i]->filter = (AVFilterContext *)NULL;
     for (i = 0; i < fg->nb_inputs; i++)
@@ -1003,6 +1004,8 @@ int configure_filtergraph(FilterGraph *fg)
     cleanup_filtergraph(fg);
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
+    if (filter_frame_threads)
+        fg->graph->thread_type |= AVFILTER_THREAD_FRAME;
 
     if (simple) {
         OutputStream *ost = fg->outputs[0]->ost;
@@ -1209,3 +1212,137 @@ int filtergraph_is_simple(FilterGraph *fg)
 {
     return !fg->graph_desc;
 }
+
+#if HAVE_THREADS
+#define FILTERGRAPH_QUEUE_SIZE 4
+
+typedef struct FilterFrame {
+    InputFilter *ifilter;
+    AVFrame     *frame;
+} FilterFrame;
+
+static void filter_frame_free(void *msg)
+{
+    FilterFrame *in = msg;
+    av_frame_free_xij(&in->frame);
+}
+
+static void *filtergraph_thread(void *arg)
+{
+    FilterGraph *fg = arg;
+    FilterFrame  in;
+    int ret;
+
+    while (av_thread_message_queue_recv(fg->in_queue, &in, 0) >= 0) {
+        ret = av_buffersrc_add_frame_flags(in.ifilter->filter, in.frame,
+                                           AV_BUFFERSRC_FLAG_PUSH);
+        av_frame_free_xij(&in.frame);
+        if (av_thread_message_queue_send(fg->out_queue, &ret, 0) < 0)
+            break;
+    }
+
+    return NULL;
+}
+
+static int init_filtergraph_thread(FilterGraph *fg)
+{
+    int ret;
+
+    ret = av_thread_message_queue_alloc(&fg->in_queue, FILTERGRAPH_QUEUE_SIZE, sizeof(FilterFrame));
+    if (ret < 0)
+        return ret;
+    ret = av_thread_message_queue_alloc(&fg->out_queue, FILTERGRAPH_QUEUE_SIZE, sizeof(int));
+    if (ret < 0)
+        goto fail;
+    av_thread_message_queue_set_free_func(fg->in_queue, filter_frame_free);
+
+    if ((ret = pthread_create(&fg->thread, NULL, filtergraph_thread, fg))) {
+        av_log(NULL, AV_LOG_ERROR, "pthread_create failed: %s. Try to increase `ulimit -v` or decrease `ulimit -s`.\n", strerror(ret));
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    return 0;
+fail:
+    av_thread_message_queue_free(&fg->in_queue);
+    av_thread_message_queue_free(&fg->out_queue);
+    return ret;
+}
+
+/* wait until the oldest frame handed to the filtergraph thread was pushed */
+static void filtergraph_collect(FilterGraph *fg)
+{
+    int ret, err;
+
+    err = av_thread_message_queue_recv(fg->out_queue, &ret, 0);
+    fg->frames_pending--;
+    if (err < 0)
+        ret = err;
+    /* a failed push is fatal, exactly as when it is done on the main thread */
+    if (ret < 0 && ret != AVERROR_EOF) {
+        av_log(NULL, AV_LOG_ERROR, "Error while filtering: %s\n", av_err2str(ret));
+        exit_program(1);
+    }
+}
+#endif
+
+int filtergraph_send_frame(InputFilter *ifilter, AVFrame *frame)
+{
+#if HAVE_THREADS
+    FilterGraph *fg = ifilter->graph;
+    FilterFrame  in;
+    int ret;
+
+    /* a single graph has nothing to run in parallel with */
+    if (threaded_filtering && nb_filtergraphs > 1 && !fg->in_queue) {
+        ret = init_filtergraph_thread(fg);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (fg->in_queue) {
+        if (fg->frames_pending == FILTERGRAPH_QUEUE_SIZE)
+            filtergraph_collect(fg);
+
+        in.ifilter = ifilter;
+        in.frame   = av_frame_alloc_ijk();
+        if (!in.frame)
+            return AVERROR(ENOMEM);
+        av_frame_move_ref_xij(in.frame, frame);
+
+        ret = av_thread_message_queue_send(fg->in_queue, &in, 0);
+        if (ret < 0) {
+            av_frame_free_xij(&in.frame);
+            return ret;
+        }
+        fg->frames_pending++;
+        return 0;
+    }
+#endif
+
+    return av_buffersrc_add_frame_flags(ifilter->filter, frame, AV_BUFFERSRC_FLAG_PUSH);
+}
+
+void filtergraph_wait(FilterGraph *fg)
+{
+#if HAVE_THREADS
+    while (fg->frames_pending)
+        filtergraph_collect(fg);
+#endif
+}
+
+void filtergraph_free_thread(FilterGraph *fg)
+{
+#if HAVE_THREADS
+    if (!fg->in_queue)
+        return;
+
+    av_thread_message_flush(fg->in_queue);
+    av_thread_message_queue_set_err_recv(fg->in_queue, AVERROR_EOF);
+    av_thread_message_queue_set_err_send(fg->out_queue, AVERROR_EOF);
+    pthread_join(fg->thread, NULL);
+
+    av_thread_message_queue_free(&fg->in_queue);
+    av_thread_message_queue_free(&fg->out_queue);
+    fg->frames_pending = 0;
+#endif
+}
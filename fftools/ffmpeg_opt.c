@@ -109,6 +109,9 @@ int frame_bits_per_raw_sample = 0;
 float max_error_rate  = 2.0/3;
 int filter_nbthreads = 0;
 int filter_complex_nbthreads = 0;
+int threaded_encoding = 1;
+int threaded_filtering = 1;
+int filter_frame_threads = 0;
 int vstats_version = 2;
 
 
@@ -3441,6 +3444,12 @@ const OptionDef options[] = {
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "threaded_encoding", OPT_BOOL | OPT_EXPERT,                    { &threaded_encoding },
+        "run each audio/video encoder in its own thread" },
+    { "threaded_filtering", OPT_BOOL | OPT_EXPERT,                   { &threaded_filtering },
+        "run each filtergraph in its own thread" },
+    { "filter_frame_threads", OPT_BOOL | OPT_EXPERT,                 { &filter_frame_threads },
+        "process successive frames in different filters concurrently" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
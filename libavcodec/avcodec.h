@@ -3320,6 +3320,45 @@ typedef struct AVCodecContext {
      * used as reference pictures).
      */
     int extra_hw_frames;
+
+    /**
+     * Number of frame threads to use when frame and slice threading are
+     * combined. Each frame thread then decodes its slices or WPP rows with
+     * thread_count / frame_thread_count threads, so that the total number
+     * of threads stays within thread_count. Fewer frame threads mean less
+     * decoding delay.
+     * Only used if thread_type has both FF_THREAD_FRAME and FF_THREAD_SLICE
+     * set and the decoder supports combining them (H.264 and HEVC).
+     * - 0: do not combine frame and slice threading
+     * - -1: pick a balance between frame and slice threads automatically
+     * - decoding: Set by user.
+     * - encoding: unused
+     */
+    int frame_thread_count;
+
+    /**
+     * Frame buffer pool used by avcodec_default_get_buffer2_xij() for video.
+     * A reference to a pool created with avcodec_frame_pool_alloc_xij(), which
+     * may be shared with other decoders. If NULL, a private pool with a budget
+     * of frame_pool_max_size is used.
+     *
+     * libavcodec takes its own reference; the user's reference is unreffed
+     * in avcodec_close_xij().
+     *
+     * - decoding: Set by user.
+     * - encoding: unused
+     */
+    AVBufferRef *frame_pool;
+
+    /**
+     * Memory in bytes the private frame buffer pool may keep for buffers of
+     * picture sizes not in use anymore. Buffers of the current size are
+     * never counted against it. When switching back to an earlier picture
+     * size, its buffers are then reused without new allocations.
+     * - decoding: Set by user.
+     * - encoding: unused
+     */
+    int64_t frame_pool_max_size;
 } AVCodecContext;
 
 #if FF_API_CODEC_GET_SET
@@ -6151,6 +6190,20 @@ const AVCodecDescriptor *avcodec_descriptor_next(const AVCodecDescriptor *prev);
  */
 const AVCodecDescriptor *avcodec_descriptor_get_by_name(const char *name);
 
+/**
+ * Allocate a frame buffer pool that can be shared between decoders through
+ * AVCodecContext.frame_pool.
+ *
+ * Buffers are pooled per size, so decoders switching between picture sizes
+ * (e.g. between the variants of an adaptive stream) reuse the buffers of
+ * sizes used before. Buffers of sizes no decoder currently uses are freed,
+ * least recently used first, once they take more than max_size bytes.
+ *
+ * @param max_size memory budget in bytes for buffers of unused sizes
+ * @return a reference to the pool or NULL on failure
+ */
+AVBufferRef *avcodec_frame_pool_alloc_xij(int64_t max_size);
+
 /**
  * Allocate a CPB properties structure and initialize its fields to default
  * values.
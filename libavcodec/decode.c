@@ -40,6 +40,7 @@
 #include "avcodec.h"
 #include "bytestream.h"
 #include "decode.h"
+#include "framepool.h"
 #include "hwaccel.h"
 #include "internal.h"
 #include "thread.h"
@@ -1506,6 +1507,28 @@ int ff_get_format_xij(AVCodecContext *avctx, const enum AVPixelFormat *fmt)
     return ret;
 }
 
+static void release_plane_pools(FramePool *pool)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (pool->pool_size[i]) {
+            ff_shared_pool_release(pool->shared, pool->pool_size[i]);
+            pool->pool_size[i] = 0;
+            pool->pools[i]     = NULL;
+        } else
+            av_buffer_pool_uninit_xij(&pool->pools[i]);
+    }
+}
+
+void ff_decode_frame_pool_uninit(AVCodecContext *avctx)
+{
+    FramePool *pool = avctx->internal->pool;
+
+    release_plane_pools(pool);
+    av_buffer_unref_xij(&pool->shared);
+}
+
 static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
 {
     FramePool *pool = avctx->internal->pool;
@@ -1513,9 +1536,11 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
 
     switch (avctx->codec_type) {
     case AVMEDIA_TYPE_VIDEO: {
+        AVBufferPool *pools[4];
         uint8_t *data[4];
         int linesize[4];
         int size[4] = { 0 };
+        int pool_size[4];
         int w = frame->width;
         int h = frame->height;
         int tmpsize, unaligned;
@@ -1549,20 +1574,36 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
             size[i] = data[i + 1] - data[i];
         size[i] = tmpsize - (data[i] - data[0]);
 
+        if (!pool->shared) {
+            pool->shared = avctx->frame_pool ?
+                           av_buffer_ref_ijk(avctx->frame_pool) :
+                           avcodec_frame_pool_alloc_xij(avctx->frame_pool_max_size);
+            if (!pool->shared)
+                return AVERROR(ENOMEM);
+        }
+
+        /* acquire the new sizes before releasing the old ones, so that
+         * sizes used by both keep their buffers */
         for (i = 0; i < 4; i++) {
-            av_buffer_pool_uninit_xij(&pool->pools[i]);
-            pool->linesize[i] = linesize[i];
-            if (size[i]) {
-                pool->pools[i] = av_buffer_pool_init_xij(size[i] + 16 + STRIDE_ALIGN - 1,
-                                                     CONFIG_MEMORY_POISONING ?
-                                                        NULL :
-                                                        av_buffer_allocz_xij);
-                if (!pool->pools[i]) {
+            pool_size[i] = size[i] ? size[i] + 16 + STRIDE_ALIGN - 1 : 0;
+            pools[i]     = NULL;
+            if (pool_size[i]) {
+                pools[i] = ff_shared_pool_acquire(pool->shared, pool_size[i]);
+                if (!pools[i]) {
+                    while (i--)
+                        if (pool_size[i])
+                            ff_shared_pool_release(pool->shared, pool_size[i]);
                     ret = AVERROR(ENOMEM);
                     goto fail;
                 }
             }
         }
+        release_plane_pools(pool);
+        for (i = 0; i < 4; i++) {
+            pool->pools[i]     = pools[i];
+            pool->pool_size[i] = pool_size[i];
+            pool->linesize[i]  = linesize[i];
+        }
         pool->format = frame->format;
         pool->width  = frame->width;
         pool->height = frame->height;
@@ -1600,8 +1641,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
     }
     return 0;
 fail:
-    for (i = 0; i < 4; i++)
-        av_buffer_pool_uninit_xij(&pool->pools[i]);
+    release_plane_pools(pool);
     pool->format = -1;
     pool->planes = pool->channels = pool->samples = 0;
     pool->width  = pool->height = 0;
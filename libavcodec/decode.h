@@ -66,6 +66,11 @@ int ff_decode_get_packet_xij(AVCodecContext *avctx, AVPacket *pkt);
 
 void ff_decode_bsfs_uninit_xij(AVCodecContext *avctx);
 
+/**
+ * Free the buffer pools used by avcodec_default_get_buffer2_xij().
+ */
+void ff_decode_frame_pool_uninit(AVCodecContext *avctx);
+
 /**
  * Make sure avctx.hw_frames_ctx is set. If it's not set, the function will
  * try to allocate it from hw_device_ctx. If that is not possible, an error
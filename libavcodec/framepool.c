@@ -0,0 +1,221 @@
+/*
+ * Frame buffer pool shared between decoders
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Size-class frame buffer pool.
+ *
+ * Plane buffers are pooled by size. A decoder acquires the size classes of
+ * its current geometry and releases them when the geometry changes, but the
+ * buffers of released classes are kept until the memory budget is exceeded,
+ * least recently used classes being freed first. Switching back to a
+ * geometry used before therefore reuses its buffers.
+ */
+
+#include <stdatomic.h>
+
+#include "config.h"
+
+#include "libavutil/buffer.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avcodec.h"
+#include "framepool.h"
+
+typedef struct PoolClass {
+    AVBufferPool *pool;
+    int size;
+    int users;             ///< number of acquire calls not released yet
+    uint64_t last_used;
+    atomic_int nb_buffers; ///< buffers allocated by the pool and not freed yet
+} PoolClass;
+
+typedef struct SharedFramePool {
+    AVMutex mutex;
+    PoolClass **classes;
+    int nb_classes;
+    int64_t max_size;
+    uint64_t clock;
+} SharedFramePool;
+
+static void pool_buffer_free(void *opaque, uint8_t *data)
+{
+    PoolClass *cls = opaque;
+
+    atomic_fetch_sub_explicit(&cls->nb_buffers, 1, memory_order_relaxed);
+    av_free(data);
+}
+
+static AVBufferRef *pool_alloc(void *opaque, int size)
+{
+    PoolClass *cls = opaque;
+    AVBufferRef *buf;
+    uint8_t *data = CONFIG_MEMORY_POISONING ? av_malloc(size) : av_mallocz(size);
+
+    if (!data)
+        return NULL;
+    buf = av_buffer_create_ijk(data, size, pool_buffer_free, cls, 0);
+    if (!buf) {
+        av_free(data);
+        return NULL;
+    }
+    atomic_fetch_add_explicit(&cls->nb_buffers, 1, memory_order_relaxed);
+    return buf;
+}
+
+/* called once an uninitialized pool got all its buffers back and freed them */
+static void pool_free(void *opaque)
+{
+    av_free(opaque);
+}
+
+static void remove_class(SharedFramePool *fp, int idx)
+{
+    AVBufferPool *pool = fp->classes[idx]->pool;
+
+    fp->classes[idx] = fp->classes[--fp->nb_classes];
+    av_buffer_pool_uninit_xij(&pool);
+}
+
+/* free unused size classes, least recently used first, while the unused
+ * ones take more than the budget; classes in use are never counted */
+static void enforce_budget(SharedFramePool *fp)
+{
+    for (;;) {
+        int64_t total = 0;
+        int i, victim = -1;
+
+        for (i = 0; i < fp->nb_classes; i++) {
+            PoolClass *cls = fp->classes[i];
+            if (cls->users)
+                continue;
+            total += (int64_t)atomic_load_explicit(&cls->nb_buffers,
+                                                   memory_order_relaxed) * cls->size;
+            if (victim < 0 || cls->last_used < fp->classes[victim]->last_used)
+                victim = i;
+        }
+        if (total <= fp->max_size || victim < 0)
+            return;
+        remove_class(fp, victim);
+    }
+}
+
+static PoolClass *find_class(SharedFramePool *fp, int size)
+{
+    int i;
+
+    for (i = 0; i < fp->nb_classes; i++)
+        if (fp->classes[i]->size == size)
+            return fp->classes[i];
+    return NULL;
+}
+
+static PoolClass *add_class(SharedFramePool *fp, int size)
+{
+    PoolClass **classes, *cls;
+
+    classes = av_realloc_array(fp->classes, fp->nb_classes + 1, sizeof(*classes));
+    if (!classes)
+        return NULL;
+    fp->classes = classes;
+
+    cls = av_mallocz(sizeof(*cls));
+    if (!cls)
+        return NULL;
+    cls->size = size;
+    atomic_init(&cls->nb_buffers, 0);
+    cls->pool = av_buffer_pool_init2_xij(size, cls, pool_alloc, pool_free);
+    if (!cls->pool) {
+        av_free(cls);
+        return NULL;
+    }
+
+    fp->classes[fp->nb_classes++] = cls;
+    return cls;
+}
+
+AVBufferPool *ff_shared_pool_acquire(AVBufferRef *frame_pool, int size)
+{
+    SharedFramePool *fp = (SharedFramePool *)frame_pool->data;
+    AVBufferPool *pool = NULL;
+    PoolClass *cls;
+
+    ff_mutex_lock(&fp->mutex);
+    cls = find_class(fp, size);
+    if (!cls)
+        cls = add_class(fp, size);
+    if (cls) {
+        cls->users++;
+        cls->last_used = ++fp->clock;
+        pool = cls->pool;
+        enforce_budget(fp);
+    }
+    ff_mutex_unlock(&fp->mutex);
+
+    return pool;
+}
+
+void ff_shared_pool_release(AVBufferRef *frame_pool, int size)
+{
+    SharedFramePool *fp = (SharedFramePool *)frame_pool->data;
+    PoolClass *cls;
+
+    ff_mutex_lock(&fp->mutex);
+    cls = find_class(fp, size);
+    if (cls && cls->users > 0) {
+        cls->users--;
+        cls->last_used = ++fp->clock;
+        enforce_budget(fp);
+    }
+    ff_mutex_unlock(&fp->mutex);
+}
+
+static void frame_pool_free(void *opaque, uint8_t *data)
+{
+    SharedFramePool *fp = (SharedFramePool *)data;
+
+    while (fp->nb_classes)
+        remove_class(fp, fp->nb_classes - 1);
+    av_freep(&fp->classes);
+    ff_mutex_destroy(&fp->mutex);
+    av_free(fp);
+}
+
+AVBufferRef *avcodec_frame_pool_alloc_xij(int64_t max_size)
+{
+    SharedFramePool *fp = av_mallocz(sizeof(*fp));
+    AVBufferRef *ref;
+
+    if (!fp)
+        return NULL;
+    if (ff_mutex_init(&fp->mutex, NULL)) {
+        av_free(fp);
+        return NULL;
+    }
+    fp->max_size = FFMAX(max_size, 0);
+
+    ref = av_buffer_create_ijk((uint8_t *)fp, sizeof(*fp), frame_pool_free, NULL, 0);
+    if (!ref) {
+        ff_mutex_destroy(&fp->mutex);
+        av_free(fp);
+    }
+    return ref;
+}
@@ -0,0 +1,44 @@
+/*
+ * Frame buffer pool shared between decoders
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_FRAMEPOOL_H
+#define AVCODEC_FRAMEPOOL_H
+
+#include "libavutil/buffer.h"
+
+/**
+ * Get the buffer pool for buffers of the given size from a pool created with
+ * avcodec_frame_pool_alloc_xij(), creating it if needed.
+ *
+ * The returned pool stays valid until the matching ff_shared_pool_release()
+ * call. Buffers may be taken from it with av_buffer_pool_get_xij() without
+ * further locking.
+ *
+ * @return the buffer pool or NULL on allocation failure
+ */
+AVBufferPool *ff_shared_pool_acquire(AVBufferRef *frame_pool, int size);
+
+/**
+ * Release a pool acquired with ff_shared_pool_acquire(). Its buffers are kept
+ * for later use as long as the memory budget of the shared pool allows.
+ */
+void ff_shared_pool_release(AVBufferRef *frame_pool, int size);
+
+#endif /* AVCODEC_FRAMEPOOL_H */
@@ -1122,6 +1122,23 @@ static int h264_init_ps(H264Context *h, const H264SliceContext *sl, int first_sl
     return 0;
 }
 
+static int h264_export_stream_params(H264Context *h, const H264SliceContext *sl)
+{
+    const SPS *sps;
+    int ret;
+
+    ret = h264_init_ps(h, sl, 1);
+    if (ret < 0)
+        return ret;
+
+    sps = h->ps.sps;
+    if (sps->bitstream_restriction_flag ||
+        h->avctx->strict_std_compliance >= FF_COMPLIANCE_STRICT)
+        h->avctx->has_b_frames = FFMAX(h->avctx->has_b_frames, sps->num_reorder_frames);
+
+    return 0;
+}
+
 static int h264_export_frame_props(H264Context *h)
 {
     const SPS *sps = h->ps.sps;
@@ -2094,10 +2111,14 @@ int ff_h264_queue_decode_slice(H264Context *h, const H2645NAL *nal)
             (h->avctx->skip_frame >= AVDISCARD_NONREF && !h->nal_ref_idc) ||
             (h->avctx->skip_frame >= AVDISCARD_BIDIR  && sl->slice_type_nos == AV_PICTURE_TYPE_B) ||
             (h->avctx->skip_frame >= AVDISCARD_NONINTRA && sl->slice_type_nos != AV_PICTURE_TYPE_I) ||
-            (h->avctx->skip_frame >= AVDISCARD_NONKEY && h->nal_unit_type != H264_NAL_IDR_SLICE && h->sei.recovery_point.recovery_frame_cnt < 0) ||
-            h->avctx->skip_frame >= AVDISCARD_ALL) {
+            (h->avctx->skip_frame >= AVDISCARD_NONKEY && h->nal_unit_type != H264_NAL_IDR_SLICE && h->sei.recovery_point.recovery_frame_cnt < 0)) {
             return 0;
         }
+        if (h->avctx->skip_frame >= AVDISCARD_ALL) {
+            /* still activate the parameter sets, so that the stream
+             * parameters get exported without decoding anything */
+            return first_slice ? h264_export_stream_params(h, sl) : 0;
+        }
     }
 
     if (!first_slice) {
@@ -2495,13 +2516,29 @@ static void decode_finish_row(const H264Context *h, H264SliceContext *sl)
 
     ff_h264_draw_horiz_band(h, sl, top, height);
 
-    if (h->droppable || sl->h264->slice_ctx[0].er.error_occurred)
+    if (h->droppable || h->defer_progress || sl->h264->slice_ctx[0].er.error_occurred)
         return;
 
     ff_thread_report_progress(&h->cur_pic_ptr->tf, top + height - 1,
                               h->picture_structure == PICT_BOTTOM_FIELD);
 }
 
+/**
+ * Report the rows above macroblock row mb_y as decoded, keeping clear of
+ * the area the deblocking of row mb_y may still modify.
+ */
+static void report_decoded_rows(const H264Context *h, int mb_y)
+{
+    int pic_height = 16 * h->mb_height >> FIELD_PICTURE(h);
+    int bottom     = 16 * (mb_y >> FIELD_PICTURE(h)) - ((16 + 4) << FRAME_MBAFF(h));
+
+    if (bottom <= 0 || h->droppable || h->slice_ctx[0].er.error_occurred)
+        return;
+
+    ff_thread_report_progress(&h->cur_pic_ptr->tf, FFMIN(bottom, pic_height) - 1,
+                              h->picture_structure == PICT_BOTTOM_FIELD);
+}
+
 static void er_add_slice(H264SliceContext *sl,
                          int startx, int starty,
                          int endx, int endy, int status)
@@ -2778,6 +2815,8 @@ int ff_h264_execute_decode_slices(H264Context *h)
             sl->next_slice_idx = next_slice_idx;
         }
 
+        h->defer_progress = !!(avctx->active_thread_type & FF_THREAD_FRAME);
+
         avctx->execute(avctx, decode_slice, h->slice_ctx,
                        NULL, context_count, sizeof(h->slice_ctx[0]));
 
@@ -2806,6 +2845,11 @@ int ff_h264_execute_decode_slices(H264Context *h)
                 }
             }
         }
+
+        if (h->defer_progress) {
+            h->defer_progress = 0;
+            report_decoded_rows(h, h->mb_y);
+        }
     }
 
 finish:
@@ -372,6 +372,12 @@ typedef struct H264Context {
      */
     int postpone_filter;
 
+    /* Set when several slices are decoded in parallel by a frame thread.
+     * Rows then complete out of order, so frame progress is only reported
+     * once all queued slices are done.
+     */
+    int defer_progress;
+
     /*
      * Set to 1 when the current picture is IDR, 0 otherwise.
      */
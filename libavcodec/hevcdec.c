@@ -2601,6 +2601,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 
     }
     s->data = data;
+    s->wpp_defer_progress = !!(s->threads_type & FF_THREAD_FRAME);
 
     for (i = 1; i < s->threads_number; i++) {
         s->sList[i]->HEVClc->first_qp_group = 1;
@@ -2620,6 +2621,13 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     if (s->ps.pps->entropy_coding_sync_enabled_flag)
         s->avctx->execute2(s->avctx, hls_decode_entry_wpp, arg, ret, s->sh.num_entry_point_offsets + 1);
 
+    if (s->wpp_defer_progress) {
+        int last_row = s->sh.slice_ctb_addr_rs / s->ps.sps->ctb_width + s->sh.num_entry_point_offsets;
+
+        s->wpp_defer_progress = 0;
+        ff_thread_report_progress(&s->ref->tf, last_row << s->ps.sps->log2_ctb_size, 0);
+    }
+
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
 error:
@@ -2916,7 +2924,7 @@ static int decode_nal_unit(HEVCContext *s, const H2645NAL *nal)
         if (ret < 0)
             return ret;
 
-        if (
+        if (s->avctx->skip_frame >= AVDISCARD_ALL ||
             (s->avctx->skip_frame >= AVDISCARD_BIDIR && s->sh.slice_type == HEVC_SLICE_B) ||
             (s->avctx->skip_frame >= AVDISCARD_NONINTRA && s->sh.slice_type != HEVC_SLICE_I) ||
             (s->avctx->skip_frame >= AVDISCARD_NONKEY && !IS_IDR(s))) {
@@ -3012,6 +3020,42 @@ fail:
     return 0;
 }
 
+/**
+ * Check whether a NAL unit is needed to export the stream parameters, i.e.
+ * it is a parameter set or the first slice segment of a picture, whose
+ * header activates the SPS.
+ */
+static int is_stream_header_nal(const H2645NAL *nal)
+{
+    GetBitContext gb = nal->gb;
+
+    switch (nal->type) {
+    case HEVC_NAL_VPS:
+    case HEVC_NAL_SPS:
+    case HEVC_NAL_PPS:
+        return 1;
+    case HEVC_NAL_TRAIL_R:
+    case HEVC_NAL_TRAIL_N:
+    case HEVC_NAL_TSA_N:
+    case HEVC_NAL_TSA_R:
+    case HEVC_NAL_STSA_N:
+    case HEVC_NAL_STSA_R:
+    case HEVC_NAL_BLA_W_LP:
+    case HEVC_NAL_BLA_W_RADL:
+    case HEVC_NAL_BLA_N_LP:
+    case HEVC_NAL_IDR_W_RADL:
+    case HEVC_NAL_IDR_N_LP:
+    case HEVC_NAL_CRA_NUT:
+    case HEVC_NAL_RADL_N:
+    case HEVC_NAL_RADL_R:
+    case HEVC_NAL_RASL_N:
+    case HEVC_NAL_RASL_R:
+        // first_slice_segment_in_pic_flag
+        return show_bits1(&gb);
+    }
+    return 0;
+}
+
 static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
 {
     int i, ret = 0;
@@ -3048,7 +3092,7 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
     for (i = 0; i < s->pkt.nb_nals; i++) {
         H2645NAL *nal = &s->pkt.nals[i];
 
-        if (s->avctx->skip_frame >= AVDISCARD_ALL ||
+        if ((s->avctx->skip_frame >= AVDISCARD_ALL && !is_stream_header_nal(nal)) ||
             (s->avctx->skip_frame >= AVDISCARD_NONREF
             && ff_hevc_nal_is_nonref(nal->type)))
             continue;
@@ -3533,7 +3577,8 @@ AVCodec ff_hevc_decoder = {
     .init_thread_copy      = hevc_init_thread_copy,
     .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                              AV_CODEC_CAP_SLICE_THREADS | AV_CODEC_CAP_FRAME_THREADS,
-    .caps_internal         = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_EXPORTS_CROPPING,
+    .caps_internal         = FF_CODEC_CAP_INIT_THREADSAFE | FF_CODEC_CAP_EXPORTS_CROPPING |
+                             FF_CODEC_CAP_HYBRID_THREADS | FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM,
     .profiles              = NULL_IF_CONFIG_SMALL(ff_hevc_profiles),
     .hw_configs            = (const AVCodecHWConfigInternal*[]) {
 #if CONFIG_HEVC_DXVA2_HWACCEL
@@ -391,6 +391,12 @@ typedef struct HEVCContext {
 
     uint8_t             threads_type;
     uint8_t             threads_number;
+    /**
+     * Set while the rows of a WPP slice are decoded in parallel by a frame
+     * thread. Rows then complete out of order, so frame progress is only
+     * reported once the whole slice is done.
+     */
+    uint8_t             wpp_defer_progress;
 
     int                 width;
     int                 height;
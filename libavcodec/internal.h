@@ -68,6 +68,12 @@
  * Codec initializes slice-based threading with a main function
  */
 #define FF_CODEC_CAP_SLICE_THREAD_HAS_MF    (1 << 5)
+/**
+ * The decoder supports slice threading inside each of its frame threads.
+ * It must only report frame progress for rows that no concurrently running
+ * slice job can still modify.
+ */
+#define FF_CODEC_CAP_HYBRID_THREADS         (1 << 6)
 
 #ifdef TRACE
 #   define ff_tlog(ctx, ...) av_log(ctx, AV_LOG_TRACE, __VA_ARGS__)
@@ -104,6 +110,13 @@ typedef struct FramePool {
      */
     AVBufferPool *pools[4];
 
+    /**
+     * Size-class pool the video plane pools are taken from, pools[] are
+     * then owned by it. Audio pools are owned by this struct.
+     */
+    AVBufferRef *shared;
+    int pool_size[4];
+
     /*
      * Pool parameters
      */
@@ -162,6 +175,12 @@ typedef struct AVCodecInternal {
 
     void *thread_ctx;
 
+    /**
+     * Slice thread context of a frame thread, when frame and slice
+     * threading are combined. thread_ctx then holds the frame thread context.
+     */
+    void *slice_thread_ctx;
+
     DecodeSimpleContext ds;
     DecodeFilterContext filter;
 
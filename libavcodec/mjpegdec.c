@@ -1325,12 +1325,13 @@ static void shift_output(MJpegDecodeContext *s, uint8_t *ptr, int linesize)
     }
 }
 
-static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
-                             int Al, const uint8_t *mb_bitmask,
-                             int mb_bitmask_size,
-                             const AVFrame *reference)
+/* decode the MCUs mcu_start to mcu_end - 1 of a scan */
+static int mjpeg_decode_scan_mcus(MJpegDecodeContext *s, int nb_components,
+                                  int Ah, int Al, const uint8_t *mb_bitmask,
+                                  const AVFrame *reference,
+                                  int mcu_start, int mcu_end)
 {
-    int i, mb_x, mb_y, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
+    int i, mcu, chroma_h_shift, chroma_v_shift, chroma_width, chroma_height;
     uint8_t *data[MAX_COMPONENTS];
     const uint8_t *reference_data[MAX_COMPONENTS];
     int linesize[MAX_COMPONENTS];
@@ -1338,15 +1339,10 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
     int bytes_per_pixel = 1 + (s->bits > 8);
 
     if (mb_bitmask) {
-        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
-            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
-            return AVERROR_INVALIDDATA;
-        }
         init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width * s->mb_height);
+        skip_bits_long(&mb_bitmask_gb, mcu_start);
     }
 
-    s->restart_count = 0;
-
     av_pix_fmt_get_chroma_sub_sample(s->avctx->pix_fmt, &chroma_h_shift,
                                      &chroma_v_shift);
     chroma_width  = AV_CEIL_RSHIFT(s->width,  chroma_h_shift);
@@ -1357,95 +1353,221 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
         data[c] = s->picture_ptr->data[c];
         reference_data[c] = reference ? reference->data[c] : NULL;
         linesize[c] = s->linesize[c];
-        s->coefs_finished[c] |= 1;
     }
 
-    for (mb_y = 0; mb_y < s->mb_height; mb_y++) {
-        for (mb_x = 0; mb_x < s->mb_width; mb_x++) {
-            const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
+    for (mcu = mcu_start; mcu < mcu_end; mcu++) {
+        const int mb_x = mcu % s->mb_width;
+        const int mb_y = mcu / s->mb_width;
+        const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
 
-            if (s->restart_interval && !s->restart_count)
-                s->restart_count = s->restart_interval;
+        if (s->restart_interval && !s->restart_count)
+            s->restart_count = s->restart_interval;
+
+        if (get_bits_left(&s->gb) < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
+                   -get_bits_left(&s->gb));
+            return AVERROR_INVALIDDATA;
+        }
+        for (i = 0; i < nb_components; i++) {
+            uint8_t *ptr;
+            int n, h, v, x, y, c, j;
+            int block_offset;
+            n = s->nb_blocks[i];
+            c = s->comp_index[i];
+            h = s->h_scount[i];
+            v = s->v_scount[i];
+            x = 0;
+            y = 0;
+            for (j = 0; j < n; j++) {
+                block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
+                                 (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
+
+                if (s->interlaced && s->bottom_field)
+                    block_offset += linesize[c] >> 1;
+                if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
+                    && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
+                    ptr = data[c] + block_offset;
+                } else
+                    ptr = NULL;
+                if (!s->progressive) {
+                    if (copy_mb) {
+                        if (ptr)
+                            mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
+                                            linesize[c], s->avctx->lowres);
 
-            if (get_bits_left(&s->gb) < 0) {
-                av_log(s->avctx, AV_LOG_ERROR, "overread %d\n",
-                       -get_bits_left(&s->gb));
-                return AVERROR_INVALIDDATA;
-            }
-            for (i = 0; i < nb_components; i++) {
-                uint8_t *ptr;
-                int n, h, v, x, y, c, j;
-                int block_offset;
-                n = s->nb_blocks[i];
-                c = s->comp_index[i];
-                h = s->h_scount[i];
-                v = s->v_scount[i];
-                x = 0;
-                y = 0;
-                for (j = 0; j < n; j++) {
-                    block_offset = (((linesize[c] * (v * mb_y + y) * 8) +
-                                     (h * mb_x + x) * 8 * bytes_per_pixel) >> s->avctx->lowres);
-
-                    if (s->interlaced && s->bottom_field)
-                        block_offset += linesize[c] >> 1;
-                    if (   8*(h * mb_x + x) < ((c == 1) || (c == 2) ? chroma_width  : s->width)
-                        && 8*(v * mb_y + y) < ((c == 1) || (c == 2) ? chroma_height : s->height)) {
-                        ptr = data[c] + block_offset;
-                    } else
-                        ptr = NULL;
-                    if (!s->progressive) {
-                        if (copy_mb) {
-                            if (ptr)
-                                mjpeg_copy_block(s, ptr, reference_data[c] + block_offset,
-                                                linesize[c], s->avctx->lowres);
-
-                        } else {
-                            s->bdsp.clear_block(s->block);
-                            if (decode_block(s, s->block, i,
-                                             s->dc_index[i], s->ac_index[i],
-                                             s->quant_matrixes[s->quant_sindex[i]]) < 0) {
-                                av_log(s->avctx, AV_LOG_ERROR,
-                                       "error y=%d x=%d\n", mb_y, mb_x);
-                                return AVERROR_INVALIDDATA;
-                            }
-                            if (ptr) {
-                                s->idsp.idct_put(ptr, linesize[c], s->block);
-                                if (s->bits & 7)
-                                    shift_output(s, ptr, linesize[c]);
-                            }
-                        }
                     } else {
-                        int block_idx  = s->block_stride[c] * (v * mb_y + y) +
-                                         (h * mb_x + x);
-                        int16_t *block = s->blocks[c][block_idx];
-                        if (Ah)
-                            block[0] += get_bits1(&s->gb) *
-                                        s->quant_matrixes[s->quant_sindex[i]][0] << Al;
-                        else if (decode_dc_progressive(s, block, i, s->dc_index[i],
-                                                       s->quant_matrixes[s->quant_sindex[i]],
-                                                       Al) < 0) {
+                        s->bdsp.clear_block(s->block);
+                        if (decode_block(s, s->block, i,
+                                         s->dc_index[i], s->ac_index[i],
+                                         s->quant_matrixes[s->quant_sindex[i]]) < 0) {
                             av_log(s->avctx, AV_LOG_ERROR,
                                    "error y=%d x=%d\n", mb_y, mb_x);
                             return AVERROR_INVALIDDATA;
                         }
+                        if (ptr) {
+                            s->idsp.idct_put(ptr, linesize[c], s->block);
+                            if (s->bits & 7)
+                                shift_output(s, ptr, linesize[c]);
+                        }
                     }
-                    ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
-                    ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
-                            mb_x, mb_y, x, y, c, s->bottom_field,
-                            (v * mb_y + y) * 8, (h * mb_x + x) * 8);
-                    if (++x == h) {
-                        x = 0;
-                        y++;
+                } else {
+                    int block_idx  = s->block_stride[c] * (v * mb_y + y) +
+                                     (h * mb_x + x);
+                    int16_t *block = s->blocks[c][block_idx];
+                    if (Ah)
+                        block[0] += get_bits1(&s->gb) *
+                                    s->quant_matrixes[s->quant_sindex[i]][0] << Al;
+                    else if (decode_dc_progressive(s, block, i, s->dc_index[i],
+                                                   s->quant_matrixes[s->quant_sindex[i]],
+                                                   Al) < 0) {
+                        av_log(s->avctx, AV_LOG_ERROR,
+                               "error y=%d x=%d\n", mb_y, mb_x);
+                        return AVERROR_INVALIDDATA;
                     }
                 }
+                ff_dlog(s->avctx, "mb: %d %d processed\n", mb_y, mb_x);
+                ff_dlog(s->avctx, "%d %d %d %d %d %d %d %d \n",
+                        mb_x, mb_y, x, y, c, s->bottom_field,
+                        (v * mb_y + y) * 8, (h * mb_x + x) * 8);
+                if (++x == h) {
+                    x = 0;
+                    y++;
+                }
             }
-
-            handle_rstn(s, nb_components);
         }
+
+        handle_rstn(s, nb_components);
     }
     return 0;
 }
 
+typedef struct MJpegScanThreadData {
+    int nb_components, Ah, Al;
+    const uint8_t *mb_bitmask;
+    const AVFrame *reference;
+    const uint8_t *buf;
+    int buf_size;
+    int scan_start;         ///< byte offset of the first restart interval in buf
+    const int *restart_pos; ///< offsets of the RSTn markers ending each interval
+    int nb_intervals;
+} MJpegScanThreadData;
+
+static int decode_restart_interval(AVCodecContext *avctx, void *arg,
+                                   int jobnr, int threadnr)
+{
+    MJpegDecodeContext *s        = avctx->priv_data;
+    MJpegDecodeContext *sc       = &s->slice_ctx[threadnr];
+    const MJpegScanThreadData *td = arg;
+    int start = jobnr ? td->restart_pos[jobnr - 1] + 2 : td->scan_start;
+    int mcu_start = jobnr * s->restart_interval;
+    int mcu_end   = FFMIN(mcu_start + s->restart_interval,
+                          s->mb_width * s->mb_height);
+    int i, ret;
+
+    ret = init_get_bits8(&sc->gb, td->buf + start, td->buf_size - start);
+    if (ret < 0)
+        return ret;
+    for (i = 0; i < td->nb_components; i++)
+        sc->last_dc[i] = (4 << s->bits);
+    sc->restart_count = 0;
+
+    ret = mjpeg_decode_scan_mcus(sc, td->nb_components, td->Ah, td->Al,
+                                 td->mb_bitmask, td->reference,
+                                 mcu_start, mcu_end);
+
+    /* the caller continues parsing after the last interval */
+    if (jobnr == td->nb_intervals - 1)
+        s->gb = sc->gb;
+    return ret;
+}
+
+/**
+ * Decode the restart intervals of a scan in parallel.
+ * @return 1 if the scan was decoded, 0 if it has to be decoded serially
+ */
+static int mjpeg_decode_scan_threaded(MJpegDecodeContext *s, int nb_components,
+                                      int Ah, int Al, const uint8_t *mb_bitmask,
+                                      const AVFrame *reference)
+{
+    AVCodecContext *avctx = s->avctx;
+    MJpegScanThreadData td;
+    int i, first;
+    int nb_threads = avctx->thread_count;
+
+    if (!(avctx->active_thread_type & FF_THREAD_SLICE) || nb_threads < 2 ||
+        !s->restart_interval || s->progressive ||
+        avctx->codec_id == AV_CODEC_ID_THP ||
+        s->gb.buffer != s->buffer || get_bits_count(&s->gb) & 7)
+        return 0;
+
+    td.nb_intervals = (s->mb_width * s->mb_height + s->restart_interval - 1) /
+                      s->restart_interval;
+    if (td.nb_intervals < 2)
+        return 0;
+
+    /* only the RSTn markers following the scan header belong to it */
+    td.scan_start = get_bits_count(&s->gb) >> 3;
+    for (first = 0; first < s->nb_restart_pos; first++)
+        if (s->restart_pos[first] >= td.scan_start)
+            break;
+    if (s->nb_restart_pos - first < td.nb_intervals - 1)
+        return 0;
+
+    nb_threads = FFMIN(nb_threads, td.nb_intervals);
+    av_fast_malloc(&s->slice_ctx, &s->slice_ctx_size,
+                   nb_threads * sizeof(*s->slice_ctx));
+    av_fast_malloc(&s->slice_ret, &s->slice_ret_size,
+                   td.nb_intervals * sizeof(*s->slice_ret));
+    if (!s->slice_ctx || !s->slice_ret)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < nb_threads; i++)
+        s->slice_ctx[i] = *s;
+
+    td.nb_components = nb_components;
+    td.Ah            = Ah;
+    td.Al            = Al;
+    td.mb_bitmask    = mb_bitmask;
+    td.reference     = reference;
+    td.buf           = s->gb.buffer;
+    td.buf_size      = s->gb.size_in_bits >> 3;
+    td.restart_pos   = s->restart_pos + first;
+
+    avctx->execute2(avctx, decode_restart_interval, &td, s->slice_ret,
+                    td.nb_intervals);
+    for (i = 0; i < td.nb_intervals; i++)
+        if (s->slice_ret[i] < 0)
+            return s->slice_ret[i];
+    return 1;
+}
+
+static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah,
+                             int Al, const uint8_t *mb_bitmask,
+                             int mb_bitmask_size,
+                             const AVFrame *reference)
+{
+    int i, ret;
+
+    if (mb_bitmask) {
+        if (mb_bitmask_size != (s->mb_width * s->mb_height + 7)>>3) {
+            av_log(s->avctx, AV_LOG_ERROR, "mb_bitmask_size mismatches\n");
+            return AVERROR_INVALIDDATA;
+        }
+    }
+
+    s->restart_count = 0;
+
+    for (i = 0; i < nb_components; i++)
+        s->coefs_finished[s->comp_index[i]] |= 1;
+
+    ret = mjpeg_decode_scan_threaded(s, nb_components, Ah, Al,
+                                     mb_bitmask, reference);
+    if (ret)
+        return FFMIN(ret, 0);
+
+    return mjpeg_decode_scan_mcus(s, nb_components, Ah, Al, mb_bitmask,
+                                  reference, 0, s->mb_width * s->mb_height);
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss,
                                             int se, int Ah, int Al)
 {
@@ -2099,6 +2221,21 @@ found:
     return val;
 }
 
+static int add_restart_pos(MJpegDecodeContext *s, int pos)
+{
+    int *restart_pos;
+
+    if (s->nb_restart_pos >= INT_MAX / sizeof(*restart_pos))
+        return AVERROR(ENOMEM);
+    restart_pos = av_fast_realloc(s->restart_pos, &s->restart_pos_size,
+                                  (s->nb_restart_pos + 1) * sizeof(*restart_pos));
+    if (!restart_pos)
+        return AVERROR(ENOMEM);
+    s->restart_pos = restart_pos;
+    s->restart_pos[s->nb_restart_pos++] = pos;
+    return 0;
+}
+
 int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                          const uint8_t **buf_ptr, const uint8_t *buf_end,
                          const uint8_t **unescaped_buf_ptr,
@@ -2107,6 +2244,8 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
     int start_code;
     start_code = find_marker(buf_ptr, buf_end);
 
+    s->nb_restart_pos = 0;
+
     av_fast_padded_malloc_xij(&s->buffer, &s->buffer_size, buf_end - *buf_ptr);
     if (!s->buffer)
         return AVERROR(ENOMEM);
@@ -2154,6 +2293,13 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                         copy_data_segment(1);
                         if (x)
                             break;
+                    } else if (s->avctx->active_thread_type & FF_THREAD_SLICE) {
+                        /* RSTn is kept in the output, remember where it ends
+                         * up so that restart intervals can be decoded in
+                         * parallel */
+                        int ret = add_restart_pos(s, (dst - s->buffer) + (ptr - 2 - src));
+                        if (ret < 0)
+                            return ret;
                     }
                 }
             }
@@ -2728,6 +2874,9 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
         av_frame_unref_xij(s->picture_ptr);
 
     av_freep(&s->buffer);
+    av_freep(&s->restart_pos);
+    av_freep(&s->slice_ctx);
+    av_freep(&s->slice_ret);
     av_freep(&s->stereo3d);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size = 0;
@@ -2781,7 +2930,7 @@ AVCodec ff_mjpeg_decoder = {
     .close          = ff_mjpeg_decode_end,
     .decode         = ff_mjpeg_decode_frame,
     .flush          = decode_flush,
-    .capabilities   = AV_CODEC_CAP_DR1,
+    .capabilities   = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_SLICE_THREADS,
     .max_lowres     = 3,
     .priv_class     = &mjpegdec_class,
     .caps_internal  = FF_CODEC_CAP_INIT_THREADSAFE |
@@ -114,6 +114,14 @@ typedef struct MJpegDecodeContext {
     int restart_interval;
     int restart_count;
 
+    int *restart_pos;                ///< offsets of the RSTn markers in buffer
+    unsigned int restart_pos_size;
+    int nb_restart_pos;
+    struct MJpegDecodeContext *slice_ctx; ///< per-thread copies used to decode restart intervals
+    unsigned int slice_ctx_size;
+    int *slice_ret;
+    unsigned int slice_ret_size;
+
     int buggy_avid;
     int cs_itu601;
     int interlace_polarity;
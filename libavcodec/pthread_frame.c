@@ -299,7 +299,7 @@ static int update_context_from_thread(AVCodecContext *dst, AVCodecContext *src,
     }
 
     if (for_user) {
-        dst->delay       = src->thread_count - 1;
+        dst->delay       = dst->thread_count - 1;
 #if FF_API_CODED_FRAME
 FF_DISABLE_DEPRECATION_WARNINGS
         dst->coded_frame = src->coded_frame;
@@ -679,6 +679,9 @@ void ff_frame_thread_free(AVCodecContext *avctx, int thread_count)
         if (codec->close && p->avctx)
             codec->close(p->avctx);
 
+        if (p->avctx && p->avctx->internal && p->avctx->internal->slice_thread_ctx)
+            ff_slice_thread_free(p->avctx);
+
         release_delayed_buffers(p);
         av_frame_free_xij(&p->frame);
     }
@@ -726,6 +729,7 @@ int ff_frame_thread_init(AVCodecContext *avctx)
     const AVCodec *codec = avctx->codec;
     AVCodecContext *src = avctx;
     FrameThreadContext *fctx;
+    int slice_count = 0;
     int i, err = 0;
 
     if (!thread_count) {
@@ -741,6 +745,28 @@ int ff_frame_thread_init(AVCodecContext *avctx)
             thread_count = avctx->thread_count = 1;
     }
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE) {
+        int frame_count = avctx->frame_thread_count;
+
+        // by default split the threads about evenly between both levels
+        if (frame_count < 0)
+            frame_count = FFMAX(lrint(sqrt(thread_count)), 2);
+        frame_count = FFMIN(frame_count, thread_count);
+
+        if (frame_count == 1) {
+            avctx->active_thread_type = FF_THREAD_SLICE;
+            return ff_slice_thread_init(avctx);
+        }
+
+        slice_count = thread_count / frame_count;
+        if (slice_count > 1) {
+            thread_count = avctx->thread_count = frame_count;
+        } else {
+            avctx->active_thread_type = FF_THREAD_FRAME;
+            slice_count = 0;
+        }
+    }
+
     if (thread_count <= 1) {
         avctx->active_thread_type = 0;
         return 0;
@@ -799,7 +825,10 @@ int ff_frame_thread_init(AVCodecContext *avctx)
         }
         *copy->internal = *src->internal;
         copy->internal->thread_ctx = p;
+        copy->internal->slice_thread_ctx = NULL;
         copy->internal->last_pkt_props = &p->avpkt;
+        if (slice_count)
+            copy->thread_count = slice_count;
 
         if (!i) {
             src = copy;
@@ -823,6 +852,12 @@ int ff_frame_thread_init(AVCodecContext *avctx)
 
         if (err) goto error;
 
+        if (slice_count) {
+            err = ff_slice_thread_init(copy);
+            if (err < 0)
+                goto error;
+        }
+
         atomic_init(&p->debug_threads, (copy->debug & FF_DEBUG_THREADS) != 0);
 
         err = AVERROR(pthread_create(&p->thread, NULL, frame_worker_thread, p));
@@ -0,0 +1,122 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavcodec/framepool.c"
+
+#include "libavutil/log.h"
+
+/* luma and chroma plane sizes of two geometries */
+static const int sizes[2][2] = { { 1000, 250 }, { 2000, 500 } };
+
+/* the idle buffers of the first geometry fit, those of the second do not */
+#define BUDGET   2500
+#define NB_BUFS  2
+
+static int nb_buffers(SharedFramePool *fp, int size)
+{
+    PoolClass *cls = find_class(fp, size);
+    return cls ? atomic_load(&cls->nb_buffers) : -1;
+}
+
+/* get NB_BUFS buffers at once from each plane pool and return them, the way
+ * a decoder goes through its frames */
+static int use_pools(AVBufferPool *pools[2])
+{
+    AVBufferRef *bufs[2][NB_BUFS];
+    int i, p, ret = 0;
+
+    for (p = 0; p < 2; p++)
+        for (i = 0; i < NB_BUFS; i++)
+            if (!pools[p] || !(bufs[p][i] = av_buffer_pool_get_xij(pools[p])))
+                ret = 1;
+    for (p = 0; p < 2; p++)
+        for (i = 0; i < NB_BUFS; i++)
+            av_buffer_unref_xij(&bufs[p][i]);
+    return ret;
+}
+
+/* acquire the pools of a geometry, then release those of the previous one,
+ * in the same order as update_frame_pool() */
+static void switch_geometry(AVBufferRef *ref, AVBufferPool *pools[2], int from, int to)
+{
+    int p;
+
+    for (p = 0; p < 2; p++)
+        pools[p] = ff_shared_pool_acquire(ref, sizes[to][p]);
+    if (from >= 0)
+        for (p = 0; p < 2; p++)
+            ff_shared_pool_release(ref, sizes[from][p]);
+}
+
+#define CHECK(cond) do {                                                \
+        if (!(cond)) {                                                  \
+            av_log(NULL, AV_LOG_ERROR, "%s failed\n", #cond);           \
+            ret = 1;                                                    \
+        }                                                               \
+    } while (0)
+
+int main(void)
+{
+    AVBufferRef *ref = avcodec_frame_pool_alloc_xij(BUDGET);
+    AVBufferPool *pools[2];
+    SharedFramePool *fp;
+    int p, ret = 0;
+
+    if (!ref)
+        return 1;
+    fp = (SharedFramePool *)ref->data;
+
+    switch_geometry(ref, pools, -1, 0);
+    CHECK(!use_pools(pools));
+
+    /* the buffers of the second geometry alone exceed the budget, but only
+     * idle buffers count, so those of the first one are kept */
+    switch_geometry(ref, pools, 0, 1);
+    CHECK(!use_pools(pools));
+    for (p = 0; p < 2; p++) {
+        CHECK(nb_buffers(fp, sizes[0][p]) == NB_BUFS);
+        CHECK(nb_buffers(fp, sizes[1][p]) == NB_BUFS);
+    }
+
+    /* switching back finds all the buffers of the first geometry; the idle
+     * luma buffers of the second exceed the budget and are freed, its
+     * chroma buffers still fit */
+    switch_geometry(ref, pools, 1, 0);
+    for (p = 0; p < 2; p++)
+        CHECK(nb_buffers(fp, sizes[0][p]) == NB_BUFS);
+    CHECK(nb_buffers(fp, sizes[1][0]) == -1);
+    CHECK(nb_buffers(fp, sizes[1][1]) == NB_BUFS);
+    CHECK(!use_pools(pools));
+    for (p = 0; p < 2; p++)
+        CHECK(nb_buffers(fp, sizes[0][p]) == NB_BUFS);
+
+    /* the second switch to the second geometry finds its chroma buffers */
+    switch_geometry(ref, pools, 0, 1);
+    CHECK(nb_buffers(fp, sizes[1][0]) == 0);
+    CHECK(nb_buffers(fp, sizes[1][1]) == NB_BUFS);
+    CHECK(!use_pools(pools));
+    for (p = 0; p < 2; p++) {
+        CHECK(nb_buffers(fp, sizes[0][p]) == NB_BUFS);
+        CHECK(nb_buffers(fp, sizes[1][p]) == NB_BUFS);
+    }
+
+    for (p = 0; p < 2; p++)
+        ff_shared_pool_release(ref, sizes[1][p]);
+    av_buffer_unref_xij(&ref);
+    return ret;
+}
@@ -1032,6 +1032,8 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
         av_packet_free_xij(&avctx->internal->ds.in_pkt);
 
+        if (avctx->internal->pool)
+            ff_decode_frame_pool_uninit(avctx);
         av_freep(&avctx->internal->pool);
     }
     av_freep(&avctx->internal);
@@ -1066,7 +1068,6 @@ av_cold int avcodec_close_xij(AVCodecContext *avctx)
         return 0;
 
     if (avcodec_is_open_xij(avctx)) {
-        FramePool *pool = avctx->internal->pool;
         if (CONFIG_FRAME_THREAD_ENCODER &&
             avctx->internal->frame_thread_encoder && avctx->thread_count > 1) {
             ff_frame_thread_encoder_free(avctx);
@@ -1085,8 +1086,7 @@ av_cold int avcodec_close_xij(AVCodecContext *avctx)
 
         av_packet_free_xij(&avctx->internal->ds.in_pkt);
 
-        for (i = 0; i < FF_ARRAY_ELEMS(pool->pools); i++)
-            av_buffer_pool_uninit_xij(&pool->pools[i]);
+        ff_decode_frame_pool_uninit(avctx);
         av_freep(&avctx->internal->pool);
 
         if (avctx->hwaccel && avctx->hwaccel->uninit)
@@ -1105,6 +1105,7 @@ av_cold int avcodec_close_xij(AVCodecContext *avctx)
 
     av_buffer_unref_xij(&avctx->hw_frames_ctx);
     av_buffer_unref_xij(&avctx->hw_device_ctx);
+    av_buffer_unref_xij(&avctx->frame_pool);
 
     if (avctx->priv_data && avctx->codec && avctx->codec->priv_class)
         av_opt_free(avctx->priv_data);
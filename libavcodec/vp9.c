@@ -1474,6 +1474,9 @@ static int vp9_decode_frame(AVCodecContext *avctx, void *frame,
 
     if ((ret = decode_frame_header(avctx, data, size, &ref)) < 0) {
         return ret;
+    } else if (avctx->skip_frame >= AVDISCARD_ALL) {
+        // the frame header already exported the stream parameters
+        return pkt->size;
     } else if (ret == 0) {
         if (!s->s.refs[ref].f->buf[0]) {
             av_log(avctx, AV_LOG_ERROR, "Requested reference %d not available\n", ref);
@@ -1792,7 +1795,8 @@ AVCodec ff_vp9_decoder = {
     .close                 = vp9_decode_free,
     .decode                = vp9_decode_frame,
     .capabilities          = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS | AV_CODEC_CAP_SLICE_THREADS,
-    .caps_internal         = FF_CODEC_CAP_SLICE_THREAD_HAS_MF,
+    .caps_internal         = FF_CODEC_CAP_SLICE_THREAD_HAS_MF |
+                             FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM,
     .flush                 = vp9_decode_flush,
     .init_thread_copy      = ONLY_IF_THREADS_ENABLED(vp9_decode_init_thread_copy),
     .update_thread_context = ONLY_IF_THREADS_ENABLED(vp9_decode_update_thread_context),
@@ -0,0 +1,637 @@
+;******************************************************************************
+;* SIMD optimized intra prediction functions for HEVC decoding
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pw_planar_inc: dw  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16
+               dw 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32
+
+cextern pw_1
+cextern pw_1024
+
+SECTION .text
+
+%if ARCH_X86_64
+
+; %1 = dst gpr, %2 = address, %3 = bit depth
+%macro LOAD_PIXEL 3
+%if %3 == 8
+    movzx             %1, byte %2
+%else
+    movzx             %1, word %2
+%endif
+%endmacro
+
+; load mmsize / 2 pixels as words
+; %1 = dst, %2 = address, %3 = bit depth
+%macro LOAD_WORDS 3
+%if %3 == 8
+    pmovzxbw          %1, %2
+%else
+    movu              %1, %2
+%endif
+%endmacro
+
+; %1 = address, %2 = src, %3 = number of bytes
+%macro STORE_BYTES 3
+%if %3 == 4
+    movd              %1, xm%2
+%elif %3 == 8
+    movq              %1, xm%2
+%elif %3 == 16
+    movu              %1, xm%2
+%else
+    movu              %1, m%2
+%endif
+%endmacro
+
+;------------------------------------------------------------------------------
+; void ff_hevc_pred_planar_<size>_<depth>(uint8_t *src, const uint8_t *top,
+;                                         const uint8_t *left, ptrdiff_t stride)
+;------------------------------------------------------------------------------
+
+; The block is processed in strips of up to two registers of words per row.
+; For every column, acc = (x + 1) * top[size] + (size - 1 - y) * top[x] +
+; (y + 1) * left[size] + size is updated from one row to the next, so that
+; each row only has to add (size - 1 - x) * left[y].
+; At 10 bits the 32x32 sums overflow 16 bits: the (x + 1) * top[size] part is
+; then kept aside and both halves are averaged before the final shift.
+
+; %1 = size - 1 - x, %2 = acc, %3 = top[x] - left[size], %4 = (x + 1) * top[size],
+; %5 = offset of the register in pixels, %6 = log2(size), %7 = bit depth, %8 = split
+%macro PLANAR_INIT 8
+%assign %%ps (%7 + 7) / 8
+    LOAD_WORDS        %3, [topq + xq * %%ps + %5 * %%ps], %7
+    psllw             m9, %3, %6
+    psubw             m9, %3                           ; (size - 1) * top[x]
+    pmullw            %2, m6, [incq + xq * 2 + %5 * 2] ; (x + 1) * top[size]
+%if %8
+    mova              %4, %2
+    paddw             %2, m8, m9
+%else
+    paddw             %2, m8
+    paddw             %2, m9
+%endif
+    psubw             %3, m7
+    psubw             %1, m10, [incq + xq * 2 + %5 * 2]
+%endmacro
+
+; %1 = dst, %2 = size - 1 - x, %3 = acc, %4 = top[x] - left[size],
+; %5 = (x + 1) * top[size], %6 = log2(size), %7 = split
+%macro PLANAR_ROW 7
+    pmullw            %1, %2, m6
+%if %7
+    paddw             %1, %5
+    pxor              m9, %1, %3
+    pand              m9, [pw_1]
+    pavgw             %1, %3
+    psubw             %1, m9
+    psrlw             %1, %6
+%else
+    paddw             %1, %3
+    psrlw             %1, %6 + 1
+%endif
+    psubw             %3, %4
+%endmacro
+
+; %1 = size, %2 = log2(size), %3 = bit depth
+%macro PRED_PLANAR 3
+%assign %%ps (%3 + 7) / 8
+%assign %%w mmsize / 2
+%if %1 > %%w
+%assign %%n 2
+%else
+%assign %%n 1
+%endif
+%assign %%strips %1 / (%%n * %%w)
+%if %%strips < 1
+%assign %%strips 1
+%endif
+%if %3 > 8 && %1 == 32
+%assign %%split 1
+%else
+%assign %%split 0
+%endif
+%assign %%nxmm 11 + 2 * %%split
+cglobal hevc_pred_planar_%1_%3, 4, 9, %%nxmm, src, top, left, stride, x, y, tmp, dst, inc
+%if %3 > 8
+    add          strideq, strideq
+%endif
+    lea             incq, [pw_planar_inc]
+    mov             tmpd, %1
+    movd            xm10, tmpd
+    SPLATW           m10, xm10                         ; size
+    xor               xd, xd
+.strip:
+    LOAD_PIXEL      tmpd, [topq + %1 * %%ps], %3
+    movd             xm6, tmpd
+    SPLATW            m6, xm6                          ; top[size]
+    LOAD_PIXEL      tmpd, [leftq + %1 * %%ps], %3
+    movd             xm7, tmpd
+    SPLATW            m7, xm7                          ; left[size]
+    paddw             m8, m7, m10
+    PLANAR_INIT       m0, m2, m4, m11, 0, %2, %3, %%split
+%if %%n == 2
+    PLANAR_INIT       m1, m3, m5, m12, %%w, %2, %3, %%split
+%endif
+
+    lea             dstq, [srcq + xq * %%ps]
+    xor               yd, yd
+.row:
+    LOAD_PIXEL      tmpd, [leftq + yq * %%ps], %3
+    movd             xm6, tmpd
+    SPLATW            m6, xm6                          ; left[y]
+    PLANAR_ROW        m7, m0, m2, m4, m11, %2, %%split
+%if %%n == 2
+    PLANAR_ROW        m8, m1, m3, m5, m12, %2, %%split
+%endif
+%if %3 == 8
+%if %%n == 2
+    packuswb          m7, m8
+%if cpuflag(avx2)
+    vpermq            m7, m7, q3120
+%endif
+    movu          [dstq], m7
+%elif mmsize == 32
+    vextracti128     xm8, m7, 1
+    packuswb         xm7, xm8
+    movu          [dstq], xm7
+%else
+    packuswb          m7, m7
+    STORE_BYTES   [dstq], 7, %1
+%endif
+%else
+%if %%n == 2
+    movu          [dstq], m7
+    movu [dstq + mmsize], m8
+%else
+    STORE_BYTES   [dstq], 7, %1 * 2
+%endif
+%endif
+    add             dstq, strideq
+    inc               yd
+    cmp               yd, %1
+    jl .row
+
+%if %%strips > 1
+    add               xd, %%n * %%w
+    cmp               xd, %1
+    jl .strip
+%endif
+    RET
+%endmacro
+
+;------------------------------------------------------------------------------
+; void ff_hevc_pred_dc_<size>_<depth>(uint8_t *src, const uint8_t *top,
+;                                     const uint8_t *left, ptrdiff_t stride,
+;                                     int c_idx)
+;------------------------------------------------------------------------------
+
+; %1 = size, %2 = log2(size), %3 = bit depth
+%macro PRED_DC 3
+%assign %%ps (%3 + 7) / 8
+cglobal hevc_pred_dc_%1_%3, 5, 8, 6, src, top, left, stride, c_idx, dc, tmp, dst
+%if %3 == 8
+    pxor              m5, m5
+%if %1 == 4
+    movd              m0, [topq]
+    movd              m1, [leftq]
+    punpckldq         m0, m1
+    psadbw            m0, m5
+%elif %1 == 8
+    movq              m0, [topq]
+    movhps            m0, [leftq]
+    psadbw            m0, m5
+%else
+    movu              m0, [topq]
+    movu              m1, [leftq]
+    psadbw            m0, m5
+    psadbw            m1, m5
+    paddw             m0, m1
+%if %1 == 32
+    movu              m1, [topq + 16]
+    movu              m2, [leftq + 16]
+    psadbw            m1, m5
+    psadbw            m2, m5
+    paddw             m0, m1
+    paddw             m0, m2
+%endif
+%endif
+%if %1 > 4
+    movhlps           m1, m0
+    paddw             m0, m1
+%endif
+%else ; %3 > 8
+    add          strideq, strideq
+%if %1 == 4
+    movq              m0, [topq]
+    movq              m1, [leftq]
+    paddw             m0, m1
+%else
+    movu              m0, [topq]
+    movu              m1, [leftq]
+    paddw             m0, m1
+%assign %%i 16
+%rep %1 / 8 - 1
+    movu              m1, [topq + %%i]
+    paddw             m0, m1
+    movu              m1, [leftq + %%i]
+    paddw             m0, m1
+%assign %%i %%i + 16
+%endrep
+%endif
+    pmaddwd           m0, [pw_1]
+    movhlps           m1, m0
+    paddd             m0, m1
+    pshuflw           m1, m0, q0032
+    paddd             m0, m1
+%endif
+    movd             dcd, m0
+    add              dcd, %1
+    shr              dcd, %2 + 1
+
+    movd              m0, dcd
+%if %3 == 8
+    pshufb            m0, m5
+%else
+    SPLATW            m0, m0
+%endif
+    mov             dstq, srcq
+    mov             tmpd, %1
+.fill:
+%if %1 * %%ps <= 16
+    STORE_BYTES   [dstq], 0, %1 * %%ps
+%else
+%assign %%i 0
+%rep %1 * %%ps / 16
+    movu   [dstq + %%i], m0
+%assign %%i %%i + 16
+%endrep
+%endif
+    add             dstq, strideq
+    dec             tmpd
+    jg .fill
+
+%if %1 < 32
+    ; luma edge filter
+    test          c_idxd, c_idxd
+    jnz .end
+    lea             tmpd, [dcq * 3 + 2]
+    movd              m1, tmpd
+    SPLATW            m1, m1                           ; 3 * dc + 2
+
+    LOAD_WORDS        m2, [topq], %3
+    paddw             m2, m1
+    psrlw             m2, 2
+%if %1 == 16
+    LOAD_WORDS        m3, [topq + 8 * %%ps], %3
+    paddw             m3, m1
+    psrlw             m3, 2
+%endif
+%if %3 == 8
+%if %1 == 16
+    packuswb          m2, m3
+%else
+    packuswb          m2, m2
+%endif
+    STORE_BYTES   [srcq], 2, %1
+%elif %1 == 16
+    movu          [srcq], m2
+    movu     [srcq + 16], m3
+%else
+    STORE_BYTES   [srcq], 2, %1 * 2
+%endif
+
+    LOAD_WORDS        m2, [leftq], %3
+    paddw             m2, m1
+    psrlw             m2, 2
+%if %1 == 16
+    LOAD_WORDS        m3, [leftq + 8 * %%ps], %3
+    paddw             m3, m1
+    psrlw             m3, 2
+%endif
+    mov             dstq, srcq
+%if %3 == 8
+%if %1 == 16
+    packuswb          m2, m3
+%else
+    packuswb          m2, m2
+%endif
+%assign %%y 1
+%rep %1 - 1
+    add             dstq, strideq
+    pextrb        [dstq], m2, %%y
+%assign %%y %%y + 1
+%endrep
+%else
+%assign %%y 1
+%rep %1 - 1
+    add             dstq, strideq
+%if %%y < 8
+    pextrw        [dstq], m2, %%y
+%else
+    pextrw        [dstq], m3, %%y - 8
+%endif
+%assign %%y %%y + 1
+%endrep
+%endif
+
+    LOAD_PIXEL      tmpd, [topq], %3
+    lea              dcd, [dcq * 2 + tmpq + 2]
+    LOAD_PIXEL      tmpd, [leftq], %3
+    add              dcd, tmpd
+    shr              dcd, 2
+%if %3 == 8
+    mov           [srcq], dcb
+%else
+    mov           [srcq], dcw
+%endif
+.end:
+%endif
+    RET
+%endmacro
+
+;------------------------------------------------------------------------------
+; void ff_hevc_pred_angular_<size>_<depth>(uint8_t *dst, ptrdiff_t stride,
+;                                          const uint8_t *ref, int angle)
+;------------------------------------------------------------------------------
+
+; Vertical angular prediction from a reference row ref[0..2 * size + 1], where
+; ref[0] is the top-left sample. Row y interpolates between ref[x + idx + 1]
+; and ref[x + idx + 2] with idx = ((y + 1) * angle) >> 5. Horizontal modes use
+; the same function on the left samples followed by a transposition.
+
+; %1 = offset in bytes, %2 = number of bytes, %3 = bit depth
+%macro ANGULAR_INTERP 3
+%if %3 == 8
+%if %2 == 4
+    movd              m0, [refq + idxq + 1 + %1]
+    movd              m1, [refq + idxq + 2 + %1]
+%elif %2 == 8
+    movq              m0, [refq + idxq + 1 + %1]
+    movq              m1, [refq + idxq + 2 + %1]
+%else
+    movu              m0, [refq + idxq + 1 + %1]
+    movu              m1, [refq + idxq + 2 + %1]
+%endif
+%if %2 < 16
+    punpcklbw         m0, m1
+    pmaddubsw         m0, m5
+    pmulhrsw          m0, m6
+    packuswb          m0, m0
+%else
+    punpckhbw         m2, m0, m1
+    punpcklbw         m0, m1
+    pmaddubsw         m0, m5
+    pmaddubsw         m2, m5
+    pmulhrsw          m0, m6
+    pmulhrsw          m2, m6
+    packuswb          m0, m2
+%endif
+%else
+%if %2 == 8
+    movq              m0, [refq + idxq * 2 + 2 + %1]
+    movq              m1, [refq + idxq * 2 + 4 + %1]
+%else
+    movu              m0, [refq + idxq * 2 + 2 + %1]
+    movu              m1, [refq + idxq * 2 + 4 + %1]
+%endif
+    pmullw            m0, m4
+    pmullw            m1, m5
+    paddw             m0, m1
+    pmulhrsw          m0, m6
+%endif
+    STORE_BYTES [dstq + %1], 0, %2
+%endmacro
+
+; %1 = size, %2 = bit depth
+%macro PRED_ANGULAR 2
+%assign %%bytes %1 * ((%2 + 7) / 8)
+cglobal hevc_pred_angular_%1_%2, 4, 8, 7, dst, stride, ref, angle, y, pos, idx, fact
+%if %2 > 8
+    add          strideq, strideq
+%endif
+    movsxd        angleq, angled
+    xor             posd, posd
+    mova              m6, [pw_1024]
+    mov               yd, %1
+.loop:
+    add             posq, angleq
+    mov             idxq, posq
+    sar             idxq, 5
+    mov            factd, posd
+    and            factd, 31
+%if %2 == 8
+    imul           factd, 255
+    add            factd, 32                           ; (fact << 8) | (32 - fact)
+    movd             xm5, factd
+    SPLATW            m5, xm5
+%else
+    movd             xm5, factd
+    SPLATW            m5, xm5                          ; fact
+    neg            factd
+    add            factd, 32
+    movd             xm4, factd
+    SPLATW            m4, xm4                          ; 32 - fact
+%endif
+%if %%bytes <= mmsize
+    ANGULAR_INTERP     0, %%bytes, %2
+%else
+%assign %%i 0
+%rep %%bytes / mmsize
+    ANGULAR_INTERP %%i, mmsize, %2
+%assign %%i %%i + mmsize
+%endrep
+%endif
+    add             dstq, strideq
+    dec               yd
+    jg .loop
+    RET
+%endmacro
+
+;------------------------------------------------------------------------------
+; void ff_hevc_transpose_<size>_<depth>(uint8_t *dst, ptrdiff_t stride,
+;                                       const uint8_t *src)
+;------------------------------------------------------------------------------
+
+; src is a contiguous size x size block.
+
+; 4x4 block of bytes, %1 = src, %2 = dst, %3 = src stride
+%macro TRANSPOSE_4x4B 3
+    movd              m0, [%1]
+    movd              m1, [%1 + %3]
+    movd              m2, [%1 + %3 * 2]
+    movd              m3, [%1 + %3 * 3]
+    punpcklbw         m0, m1
+    punpcklbw         m2, m3
+    punpcklwd         m0, m2
+    movd            [%2], m0
+    pextrd [%2 + strideq], m0, 1
+    pextrd [%2 + strideq * 2], m0, 2
+    pextrd [%2 + stride3q], m0, 3
+%endmacro
+
+; 8x8 block of bytes, %1 = src, %2 = dst, %3 = src stride
+%macro TRANSPOSE_8x8B 3
+    movq              m0, [%1]
+    movq              m1, [%1 + %3]
+    movq              m2, [%1 + %3 * 2]
+    movq              m3, [%1 + %3 * 3]
+    movq              m4, [%1 + %3 * 4]
+    movq              m5, [%1 + %3 * 5]
+    movq              m6, [%1 + %3 * 6]
+    movq              m7, [%1 + %3 * 7]
+    punpcklbw         m0, m1
+    punpcklbw         m2, m3
+    punpcklbw         m4, m5
+    punpcklbw         m6, m7
+    punpckhwd         m1, m0, m2
+    punpcklwd         m0, m2
+    punpckhwd         m3, m4, m6
+    punpcklwd         m4, m6
+    punpckhdq         m2, m0, m4
+    punpckldq         m0, m4
+    punpckhdq         m5, m1, m3
+    punpckldq         m1, m3
+    movq            [%2], m0
+    movhps [%2 + strideq], m0
+    movq [%2 + strideq * 2], m2
+    movhps [%2 + stride3q], m2
+    lea             tmpq, [%2 + strideq * 4]
+    movq          [tmpq], m1
+    movhps [tmpq + strideq], m1
+    movq [tmpq + strideq * 2], m5
+    movhps [tmpq + stride3q], m5
+%endmacro
+
+; 4x4 block of words, %1 = src, %2 = dst, %3 = src stride
+%macro TRANSPOSE_4x4W 3
+    movq              m0, [%1]
+    movq              m1, [%1 + %3]
+    movq              m2, [%1 + %3 * 2]
+    movq              m3, [%1 + %3 * 3]
+    punpcklwd         m0, m1
+    punpcklwd         m2, m3
+    punpckhdq         m1, m0, m2
+    punpckldq         m0, m2
+    movq            [%2], m0
+    movhps [%2 + strideq], m0
+    movq [%2 + strideq * 2], m1
+    movhps [%2 + stride3q], m1
+%endmacro
+
+; %1 = block size, %2 = bit depth, %3 = src, %4 = dst, %5 = src stride
+%macro TRANSPOSE_BLOCK 5
+%if %2 > 8
+    TRANSPOSE_4x4W    %3, %4, %5
+%elif %1 == 8
+    TRANSPOSE_8x8B    %3, %4, %5
+%else
+    TRANSPOSE_4x4B    %3, %4, %5
+%endif
+%endmacro
+
+; %1 = size, %2 = bit depth
+%macro TRANSPOSE 2
+%if %2 == 8 && %1 > 4
+%assign %%b 8
+%else
+%assign %%b 4
+%endif
+%assign %%ps (%2 + 7) / 8
+cglobal hevc_transpose_%1_%2, 3, 9, 8, dst, stride, src, stride3, row, col, srcb, dstb, tmp
+%if %2 > 8
+    add          strideq, strideq
+%endif
+    lea         stride3q, [strideq * 3]
+%if %1 == %%b
+    TRANSPOSE_BLOCK %%b, %2, srcq, dstq, %1 * %%ps
+%else
+    mov             rowd, %1 / %%b
+.row:
+    mov            srcbq, srcq
+    mov            dstbq, dstq
+    mov             cold, %1 / %%b
+.col:
+    TRANSPOSE_BLOCK %%b, %2, srcbq, dstbq, %1 * %%ps
+    add            srcbq, %%b * %%ps
+    lea            dstbq, [dstbq + strideq * %%b]
+    dec             cold
+    jg .col
+    add             srcq, %1 * %%b * %%ps
+    add             dstq, %%b * %%ps
+    dec             rowd
+    jg .row
+%endif
+    RET
+%endmacro
+
+INIT_XMM sse4
+PRED_PLANAR   4, 2,  8
+PRED_PLANAR   8, 3,  8
+PRED_PLANAR  16, 4,  8
+PRED_PLANAR  32, 5,  8
+PRED_PLANAR   4, 2, 10
+PRED_PLANAR   8, 3, 10
+PRED_PLANAR  16, 4, 10
+PRED_PLANAR  32, 5, 10
+
+PRED_DC       4, 2,  8
+PRED_DC       8, 3,  8
+PRED_DC      16, 4,  8
+PRED_DC      32, 5,  8
+PRED_DC       4, 2, 10
+PRED_DC       8, 3, 10
+PRED_DC      16, 4, 10
+PRED_DC      32, 5, 10
+
+PRED_ANGULAR  4,  8
+PRED_ANGULAR  8,  8
+PRED_ANGULAR 16,  8
+PRED_ANGULAR 32,  8
+PRED_ANGULAR  4, 10
+PRED_ANGULAR  8, 10
+PRED_ANGULAR 16, 10
+PRED_ANGULAR 32, 10
+
+TRANSPOSE     4,  8
+TRANSPOSE     8,  8
+TRANSPOSE    16,  8
+TRANSPOSE    32,  8
+TRANSPOSE     4, 10
+TRANSPOSE     8, 10
+TRANSPOSE    16, 10
+TRANSPOSE    32, 10
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+PRED_PLANAR  16, 4,  8
+PRED_PLANAR  32, 5,  8
+PRED_PLANAR  16, 4, 10
+PRED_PLANAR  32, 5, 10
+
+PRED_ANGULAR 32,  8
+PRED_ANGULAR 16, 10
+PRED_ANGULAR 32, 10
+%endif
+
+%endif ; ARCH_X86_64
@@ -0,0 +1,232 @@
+/*
+ * HEVC intra prediction, x86 init
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "libavutil/attributes.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/internal.h"
+#include "libavutil/x86/cpu.h"
+#include "libavcodec/hevcpred.h"
+
+#define PLANAR_FUNCS(depth, opt)                                                   \
+void ff_hevc_pred_planar_4_  ## depth ## _ ## opt(uint8_t *src, const uint8_t *top, \
+                                                  const uint8_t *left, ptrdiff_t stride); \
+void ff_hevc_pred_planar_8_  ## depth ## _ ## opt(uint8_t *src, const uint8_t *top, \
+                                                  const uint8_t *left, ptrdiff_t stride); \
+void ff_hevc_pred_planar_16_ ## depth ## _ ## opt(uint8_t *src, const uint8_t *top, \
+                                                  const uint8_t *left, ptrdiff_t stride); \
+void ff_hevc_pred_planar_32_ ## depth ## _ ## opt(uint8_t *src, const uint8_t *top, \
+                                                  const uint8_t *left, ptrdiff_t stride);
+
+#define DC_FUNC(size, depth, opt)                                                  \
+void ff_hevc_pred_dc_ ## size ## _ ## depth ## _ ## opt(uint8_t *src, const uint8_t *top, \
+                                                        const uint8_t *left,        \
+                                                        ptrdiff_t stride, int c_idx);
+
+#define ANGULAR_FUNC(size, depth, opt)                                             \
+void ff_hevc_pred_angular_ ## size ## _ ## depth ## _ ## opt(uint8_t *dst, ptrdiff_t stride, \
+                                                             const uint8_t *ref, int angle);
+
+#define TRANSPOSE_FUNC(size, depth, opt)                                           \
+void ff_hevc_transpose_ ## size ## _ ## depth ## _ ## opt(uint8_t *dst, ptrdiff_t stride, \
+                                                          const uint8_t *src);
+
+#define PRED_FUNCS(size, depth, opt) \
+    DC_FUNC(size, depth, opt)        \
+    ANGULAR_FUNC(size, depth, opt)   \
+    TRANSPOSE_FUNC(size, depth, opt)
+
+PLANAR_FUNCS(8,  sse4)
+PLANAR_FUNCS(10, sse4)
+PRED_FUNCS( 4,  8, sse4)
+PRED_FUNCS( 8,  8, sse4)
+PRED_FUNCS(16,  8, sse4)
+PRED_FUNCS(32,  8, sse4)
+PRED_FUNCS( 4, 10, sse4)
+PRED_FUNCS( 8, 10, sse4)
+PRED_FUNCS(16, 10, sse4)
+PRED_FUNCS(32, 10, sse4)
+
+PLANAR_FUNCS(8,  avx2)
+PLANAR_FUNCS(10, avx2)
+ANGULAR_FUNC(32,  8, avx2)
+ANGULAR_FUNC(16, 10, avx2)
+ANGULAR_FUNC(32, 10, avx2)
+
+typedef void (*angular_func)(uint8_t *dst, ptrdiff_t stride,
+                             const uint8_t *ref, int angle);
+typedef void (*transpose_func)(uint8_t *dst, ptrdiff_t stride,
+                               const uint8_t *src);
+
+static const int8_t intra_pred_angle[] = {
+     32,  26,  21,  17, 13,  9,  5, 2, 0, -2, -5, -9, -13, -17, -21, -26, -32,
+    -26, -21, -17, -13, -9, -5, -2, 0, 2,  5,  9, 13,  17,  21,  26,  32
+};
+
+static const int16_t inv_angle[] = {
+    -4096, -1638, -910, -630, -482, -390, -315, -256, -315, -390, -482,
+    -630, -910, -1638, -4096
+};
+
+#define RP(p, i)    (depth > 8 ? ((const uint16_t *)(p))[i] : ((const uint8_t *)(p))[i])
+#define WP(p, i, v) do {                        \
+        if (depth > 8)                          \
+            ((uint16_t *)(p))[i] = v;           \
+        else                                    \
+            ((uint8_t *)(p))[i] = v;            \
+    } while (0)
+
+/**
+ * Build the reference row of an angular mode and run the SIMD interpolation.
+ * The kernels always predict vertically; horizontal modes are predicted
+ * into a temporary block from the left samples and transposed.
+ */
+static av_always_inline void pred_angular(uint8_t *src, const uint8_t *top,
+                                          const uint8_t *left, ptrdiff_t stride,
+                                          int c_idx, int mode, int size, int depth,
+                                          angular_func angular,
+                                          transpose_func transpose)
+{
+    LOCAL_ALIGNED_16(uint8_t, ref_array, [(3 * 32 + 2) * 2]);
+    LOCAL_ALIGNED_16(uint8_t, tmp, [32 * 32 * 2]);
+    const int ps        = depth > 8 ? 2 : 1;
+    const int angle     = intra_pred_angle[mode - 2];
+    const int last      = (size * angle) >> 5;
+    const uint8_t *main = mode >= 18 ? top  : left;
+    const uint8_t *side = mode >= 18 ? left : top;
+    uint8_t *ref        = ref_array + size * ps;
+    int i;
+
+    /* ref[0] is the top-left sample; the kernels may read one sample past
+     * the end of the row when the fractional weight is 0. */
+    memcpy(ref, main - ps, (2 * size + 1) * ps);
+    WP(ref, 2 * size + 1, RP(ref, 2 * size));
+    if (angle < 0 && last < -1) {
+        for (i = last; i <= -1; i++)
+            WP(ref, i, RP(side, -1 + ((i * inv_angle[mode - 11] + 128) >> 8)));
+    }
+
+    if (mode >= 18) {
+        angular(src, stride, ref, angle);
+        if (mode == 26 && c_idx == 0 && size < 32) {
+            for (i = 0; i < size; i++)
+                WP(src, i * stride,
+                   av_clip_uintp2(RP(top, 0) + ((RP(left, i) - RP(left, -1)) >> 1), depth));
+        }
+    } else {
+        angular(tmp, size, ref, angle);
+        transpose(src, stride, tmp);
+        if (mode == 10 && c_idx == 0 && size < 32) {
+            for (i = 0; i < size; i++)
+                WP(src, i,
+                   av_clip_uintp2(RP(left, 0) + ((RP(top, i) - RP(top, -1)) >> 1), depth));
+        }
+    }
+}
+
+#define PRED_ANGULAR(size, depth, opt, topt)                                       \
+static void pred_angular_ ## size ## _ ## depth ## _ ## opt(uint8_t *src,          \
+                                                            const uint8_t *top,    \
+                                                            const uint8_t *left,   \
+                                                            ptrdiff_t stride,      \
+                                                            int c_idx, int mode)   \
+{                                                                                  \
+    pred_angular(src, top, left, stride, c_idx, mode, size, depth,                 \
+                 ff_hevc_pred_angular_ ## size ## _ ## depth ## _ ## opt,          \
+                 ff_hevc_transpose_ ## size ## _ ## depth ## _ ## topt);           \
+}
+
+#define PRED_DC(depth, opt)                                                        \
+static void pred_dc_ ## depth ## _ ## opt(uint8_t *src, const uint8_t *top,        \
+                                          const uint8_t *left, ptrdiff_t stride,   \
+                                          int log2_size, int c_idx)                \
+{                                                                                  \
+    switch (log2_size) {                                                           \
+    case 2: ff_hevc_pred_dc_4_  ## depth ## _ ## opt(src, top, left, stride, c_idx); break; \
+    case 3: ff_hevc_pred_dc_8_  ## depth ## _ ## opt(src, top, left, stride, c_idx); break; \
+    case 4: ff_hevc_pred_dc_16_ ## depth ## _ ## opt(src, top, left, stride, c_idx); break; \
+    case 5: ff_hevc_pred_dc_32_ ## depth ## _ ## opt(src, top, left, stride, c_idx); break; \
+    }                                                                              \
+}
+
+#if ARCH_X86_64
+PRED_ANGULAR( 4,  8, sse4, sse4)
+PRED_ANGULAR( 8,  8, sse4, sse4)
+PRED_ANGULAR(16,  8, sse4, sse4)
+PRED_ANGULAR(32,  8, sse4, sse4)
+PRED_ANGULAR( 4, 10, sse4, sse4)
+PRED_ANGULAR( 8, 10, sse4, sse4)
+PRED_ANGULAR(16, 10, sse4, sse4)
+PRED_ANGULAR(32, 10, sse4, sse4)
+PRED_ANGULAR(32,  8, avx2, sse4)
+PRED_ANGULAR(16, 10, avx2, sse4)
+PRED_ANGULAR(32, 10, avx2, sse4)
+
+PRED_DC( 8, sse4)
+PRED_DC(10, sse4)
+#endif
+
+av_cold void ff_hevc_pred_init_x86(HEVCPredContext *hpc, int bit_depth)
+{
+#if ARCH_X86_64
+    int cpu_flags = av_get_cpu_flags();
+
+    if (bit_depth == 8) {
+        if (EXTERNAL_SSE4(cpu_flags)) {
+            hpc->pred_planar[0]  = ff_hevc_pred_planar_4_8_sse4;
+            hpc->pred_planar[1]  = ff_hevc_pred_planar_8_8_sse4;
+            hpc->pred_planar[2]  = ff_hevc_pred_planar_16_8_sse4;
+            hpc->pred_planar[3]  = ff_hevc_pred_planar_32_8_sse4;
+            hpc->pred_dc         = pred_dc_8_sse4;
+            hpc->pred_angular[0] = pred_angular_4_8_sse4;
+            hpc->pred_angular[1] = pred_angular_8_8_sse4;
+            hpc->pred_angular[2] = pred_angular_16_8_sse4;
+            hpc->pred_angular[3] = pred_angular_32_8_sse4;
+        }
+        if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+            hpc->pred_planar[2]  = ff_hevc_pred_planar_16_8_avx2;
+            hpc->pred_planar[3]  = ff_hevc_pred_planar_32_8_avx2;
+            hpc->pred_angular[3] = pred_angular_32_8_avx2;
+        }
+    } else if (bit_depth == 10) {
+        if (EXTERNAL_SSE4(cpu_flags)) {
+            hpc->pred_planar[0]  = ff_hevc_pred_planar_4_10_sse4;
+            hpc->pred_planar[1]  = ff_hevc_pred_planar_8_10_sse4;
+            hpc->pred_planar[2]  = ff_hevc_pred_planar_16_10_sse4;
+            hpc->pred_planar[3]  = ff_hevc_pred_planar_32_10_sse4;
+            hpc->pred_dc         = pred_dc_10_sse4;
+            hpc->pred_angular[0] = pred_angular_4_10_sse4;
+            hpc->pred_angular[1] = pred_angular_8_10_sse4;
+            hpc->pred_angular[2] = pred_angular_16_10_sse4;
+            hpc->pred_angular[3] = pred_angular_32_10_sse4;
+        }
+        if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+            hpc->pred_planar[2]  = ff_hevc_pred_planar_16_10_avx2;
+            hpc->pred_planar[3]  = ff_hevc_pred_planar_32_10_avx2;
+            hpc->pred_angular[2] = pred_angular_16_10_avx2;
+            hpc->pred_angular[3] = pred_angular_32_10_avx2;
+        }
+    }
+#endif /* ARCH_X86_64 */
+}
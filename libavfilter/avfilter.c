@@ -409,6 +409,9 @@ int ff_request_frame(AVFilterLink *link)
     FF_TPRINTF_START(NULL, request_frame); ff_tlog_link(NULL, link, 1);
 
     av_assert1(!link->dst->filter->activate);
+    if (link->dst->internal->frame_thread &&
+        ff_filter_frame_thread_queue_request(link))
+        return 0;
     if (link->status_out)
         return link->status_out;
     if (link->status_in) {
@@ -556,6 +559,9 @@ void ff_update_link_current_pts(AVFilterLink *link, int64_t pts)
 
 int avfilter_process_command(AVFilterContext *filter, const char *cmd, const char *arg, char *res, int res_len, int flags)
 {
+    if (filter->internal->frame_thread)
+        ff_filter_frame_thread_wait(filter);
+
     if(!strcmp(cmd, "ping")){
         char local_res[256] = {0};
 
@@ -627,8 +633,9 @@ static const AVClass *filter_child_class_next(const AVClass *prev)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM
 static const AVOption avfilter_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
-        { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, FLAGS, "thread_type" },
+        { .i64 = AVFILTER_THREAD_SLICE | AVFILTER_THREAD_FRAME }, 0, INT_MAX, FLAGS, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .unit = "thread_type" },
     { "enable", "set enable expression", OFFSET(enable_str), AV_OPT_TYPE_STRING, {.str=NULL}, .flags = FLAGS },
     { "threads", "Allowed number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, FLAGS },
@@ -764,6 +771,8 @@ void avfilter_free(AVFilterContext *filter)
     if (!filter)
         return;
 
+    ff_filter_frame_thread_free(filter);
+
     if (filter->graph)
         ff_filter_graph_remove_filter(filter->graph, filter);
 
@@ -886,6 +895,7 @@ static int process_options(AVFilterContext *ctx, AVDictionary **options,
 
 int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
 {
+    int thread_type;
     int ret = 0;
 
     ret = av_opt_set_dict(ctx, options);
@@ -894,14 +904,19 @@ int avfilter_init_dict(AVFilterContext *ctx, AVDictionary **options)
         return ret;
     }
 
+    thread_type = ctx->thread_type & ctx->graph->thread_type;
     if (ctx->filter->flags & AVFILTER_FLAG_SLICE_THREADS &&
-        ctx->thread_type & ctx->graph->thread_type & AVFILTER_THREAD_SLICE &&
+        thread_type & AVFILTER_THREAD_SLICE &&
         ctx->graph->internal->thread_execute) {
         ctx->thread_type       = AVFILTER_THREAD_SLICE;
         ctx->internal->execute = ctx->graph->internal->thread_execute;
     } else {
         ctx->thread_type = 0;
     }
+    /* The frame thread is started, or the flag cleared, by
+       avfilter_graph_config() once the links are known. */
+    if (thread_type & AVFILTER_THREAD_FRAME && !ctx->filter->activate)
+        ctx->thread_type |= AVFILTER_THREAD_FRAME;
 
     if (ctx->filter->priv_class) {
         ret = av_opt_set_dict2(ctx->priv, options, AV_OPT_SEARCH_CHILDREN);
@@ -1068,6 +1083,10 @@ static int ff_filter_frame_framed(AVFilterLink *link, AVFrame *frame)
     if (dstctx->is_disabled &&
         (dstctx->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC))
         filter_frame = default_filter_frame;
+    if (dstctx->internal->frame_thread) {
+        ff_filter_frame_thread_submit(link, frame, filter_frame);
+        return 0;
+    }
     ret = filter_frame(link, frame);
     link->frame_count_out++;
     return ret;
@@ -1082,6 +1101,12 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
     int ret;
     FF_TPRINTF_START(NULL, filter_frame); ff_tlog_link(NULL, link, 1); ff_tlog(NULL, " "); ff_tlog_ref(NULL, frame, 1);
 
+    if (link->src->internal->frame_thread) {
+        ret = ff_filter_frame_thread_queue_frame(link, frame);
+        if (ret)
+            return FFMIN(ret, 0);
+    }
+
     /* Consistency checks */
     if (link->type == AVMEDIA_TYPE_VIDEO) {
         if (strcmp(link->dst->filter->name, "buffersink") &&
@@ -332,6 +332,14 @@ typedef struct AVFilter {
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Process successive frames in different filters concurrently: filters with
+ * a single input and a single output run their filter_frame() callback in
+ * their own thread while the rest of the graph keeps being scheduled.
+ * It must be enabled explicitly in AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_FRAME (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
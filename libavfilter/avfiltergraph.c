@@ -50,6 +50,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "frame", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_FRAME }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads),
         AV_OPT_TYPE_INT,   { .i64 = 0 }, 0, INT_MAX, F|V|A },
     {"scale_sws_opts"       , "default scale filter options"        , OFFSET(scale_sws_opts)        ,
@@ -78,6 +79,39 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_frame_thread_init(AVFilterGraph *graph)
+{
+    return 0;
+}
+
+int ff_graph_frame_thread_run_once(AVFilterGraph *graph)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_filter_frame_thread_submit(AVFilterLink *link, AVFrame *frame,
+                                   int (*filter_frame)(AVFilterLink *, AVFrame *))
+{
+}
+
+void ff_filter_frame_thread_wait(AVFilterContext *ctx)
+{
+}
+
+void ff_filter_frame_thread_free(AVFilterContext *ctx)
+{
+}
+
+int ff_filter_frame_thread_queue_frame(AVFilterLink *link, AVFrame *frame)
+{
+    return 0;
+}
+
+int ff_filter_frame_thread_queue_request(AVFilterLink *link)
+{
+    return 0;
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -119,9 +153,15 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
 
 void avfilter_graph_free(AVFilterGraph **graph)
 {
+    unsigned i;
+
     if (!*graph)
         return;
 
+    /* Stop all frame threads before any link goes away. */
+    for (i = 0; i < (*graph)->nb_filters; i++)
+        ff_filter_frame_thread_free((*graph)->filters[i]);
+
     while ((*graph)->nb_filters)
         avfilter_free((*graph)->filters[0]);
 
@@ -1279,6 +1319,8 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = ff_graph_frame_thread_init(graphctx)) < 0)
+        return ret;
 
     return 0;
 }
@@ -1444,6 +1486,8 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
     unsigned i;
 
     av_assert0(graph->nb_filters);
+    if (graph->internal->frame_thread)
+        return ff_graph_frame_thread_run_once(graph);
     filter = graph->filters[0];
     for (i = 1; i < graph->nb_filters; i++)
         if (graph->filters[i]->ready > filter->ready)
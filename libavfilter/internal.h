@@ -148,11 +148,13 @@ struct AVFilterPad {
 struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
+    void *frame_thread;
     FFFrameQueueGlobal frame_queues;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+    void *frame_thread;
 };
 
 /**
@@ -384,6 +386,12 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter acts on other filters of the graph from its filter_frame()
+ * callback and must never run it in a frame thread.
+ */
+#define FF_FILTER_FLAG_NO_FRAME_THREADS (1 << 1)
+
 /**
  * Run one round of processing on a filter graph.
  */
@@ -0,0 +1,51 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_LUT_H
+#define AVFILTER_LUT_H
+
+#include <stdint.h>
+
+#include "libavutil/mem.h"
+
+typedef struct LUTTable8 {
+    uint8_t val[256];                       ///< output value of each input value
+    /**
+     * val split in rows of 16 values, each row XORed with the row above
+     * except rows 0 and 8, filled by ff_lut_init_table8(). The XOR of rows
+     * 8 * (i / 8) to i is row i of val, which allows looking values up
+     * with byte shuffles of one row at a time.
+     */
+    DECLARE_ALIGNED(16, uint8_t, shuf)[256];
+} LUTTable8;
+
+typedef struct LUTDSPContext {
+    /**
+     * Map w 8-bit samples through a table.
+     *
+     * @return the number of samples processed, the caller processes the rest
+     */
+    int (*lut_row8)(uint8_t *dst, const uint8_t *src, const LUTTable8 *tab, int w);
+} LUTDSPContext;
+
+void ff_lut_init_table8(LUTTable8 *tab);
+
+void ff_lut_init(LUTDSPContext *dsp);
+void ff_lut_init_x86(LUTDSPContext *dsp);
+
+#endif /* AVFILTER_LUT_H */
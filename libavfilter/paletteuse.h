@@ -0,0 +1,51 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_PALETTEUSE_H
+#define AVFILTER_PALETTEUSE_H
+
+#include <stdint.h>
+
+/**
+ * The palette searched by nearest_color() is padded to a multiple of
+ * PALETTEUSE_PAL_ALIGN entries with PALETTEUSE_PAL_PAD in every component,
+ * which is farther from any 8-bit color than all the 8-bit colors are.
+ */
+#define PALETTEUSE_PAL_ALIGN 8
+#define PALETTEUSE_PAL_PAD   0x400
+
+typedef struct PaletteUseDSPContext {
+    /**
+     * Find the palette entry nearest to a color, in squared RGB distance.
+     *
+     * @param pal_rg red | green << 16 of each palette entry
+     * @param pal_b  blue of each palette entry
+     * @param nb     number of entries, a multiple of PALETTEUSE_PAL_ALIGN
+     *               and at most 256
+     * @param rg     red | green << 16 of the color
+     * @param b      blue of the color
+     * @return the index of the first entry with the smallest distance
+     */
+    int (*nearest_color)(const uint32_t *pal_rg, const uint32_t *pal_b,
+                         int nb, uint32_t rg, uint32_t b);
+} PaletteUseDSPContext;
+
+void ff_paletteuse_init(PaletteUseDSPContext *dsp);
+void ff_paletteuse_init_x86(PaletteUseDSPContext *dsp);
+
+#endif /* AVFILTER_PALETTEUSE_H */
@@ -23,19 +23,31 @@
 
 #include "config.h"
 
+#include "libavutil/avassert.h"
 #include "libavutil/common.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 #include "libavutil/slicethread.h"
 
+#define FF_INTERNAL_FIELDS 1
+#include "framequeue.h"
+
 #include "avfilter.h"
+#include "filters.h"
 #include "internal.h"
 #include "thread.h"
 
+/**
+ * Number of frames queued on the input of a frame thread above which the
+ * graph waits for the thread instead of asking for more input.
+ */
+#define FRAME_THREAD_MAX_QUEUED 4
+
 typedef struct ThreadContext {
     AVFilterGraph *graph;
     AVSliceThread *thread;
+    pthread_mutex_t execute_lock;   ///< serializes the filters calling execute() from several threads
     avfilter_action_func *func;
 
     /* per-execute parameters */
@@ -55,6 +67,7 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    pthread_mutex_destroy(&c->execute_lock);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -64,23 +77,369 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+    pthread_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    pthread_mutex_unlock(&c->execute_lock);
     return 0;
 }
 
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
     nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
-    if (nb_threads <= 1)
+    if (nb_threads <= 1) {
         avpriv_slicethread_free(&c->thread);
+    } else if (pthread_mutex_init(&c->execute_lock, NULL)) {
+        avpriv_slicethread_free(&c->thread);
+        return AVERROR(ENOMEM);
+    }
     return FFMAX(nb_threads, 1);
 }
 
+typedef struct FrameThreadGraph {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;           ///< signalled when a frame thread finishes a frame
+    int nb_threads;
+} FrameThreadGraph;
+
+/**
+ * A filter running its filter_frame() callback in a thread of its own.
+ *
+ * The main thread submits one frame at a time and does not touch the filter,
+ * nor its links, until it has forwarded the output of that frame. The frame
+ * thread only queues the frames and requests of the filter, so that all link
+ * state keeps being updated by the main thread.
+ */
+typedef struct FrameThreadContext {
+    AVFilterContext  *ctx;
+    FrameThreadGraph *graph;
+    pthread_t thread;
+    pthread_cond_t cond;            ///< signalled when a frame is submitted or on exit
+
+    /* protected by graph->mutex */
+    int busy;
+    int exit;
+
+    /* owned by the frame thread while busy, by the main thread otherwise */
+    int pending;                    ///< a frame was submitted and its output not forwarded yet
+    AVFilterLink *link;
+    AVFrame *frame;
+    int (*filter_frame)(AVFilterLink *, AVFrame *);
+    int ret;
+    int request;
+    FFFrameQueue out;
+} FrameThreadContext;
+
+static void *frame_thread_worker(void *arg)
+{
+    FrameThreadContext *ft = arg;
+    FrameThreadGraph    *g = ft->graph;
+
+    pthread_mutex_lock(&g->mutex);
+    while (1) {
+        while (!ft->busy && !ft->exit)
+            pthread_cond_wait(&ft->cond, &g->mutex);
+        if (ft->exit)
+            break;
+        pthread_mutex_unlock(&g->mutex);
+
+        ft->ret   = ft->filter_frame(ft->link, ft->frame);
+        ft->frame = NULL;
+        ft->link->frame_count_out++;
+
+        pthread_mutex_lock(&g->mutex);
+        ft->busy = 0;
+        pthread_cond_broadcast(&g->cond);
+    }
+    pthread_mutex_unlock(&g->mutex);
+    return NULL;
+}
+
+static int frame_thread_usable(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink, *outlink;
+
+    if (ctx->filter->activate || ctx->nb_inputs != 1 || ctx->nb_outputs != 1 ||
+        ctx->filter->flags_internal & FF_FILTER_FLAG_NO_FRAME_THREADS)
+        return 0;
+    inlink  = ctx->inputs[0];
+    outlink = ctx->outputs[0];
+    /* Neither the filter nor its neighbours may call into each other
+       while the filter is processing a frame. */
+    return inlink->dstpad->filter_frame &&
+           !inlink->dstpad->get_video_buffer  && !inlink->dstpad->get_audio_buffer &&
+           !outlink->dstpad->get_video_buffer && !outlink->dstpad->get_audio_buffer;
+}
+
+static int frame_thread_init(AVFilterContext *ctx)
+{
+    FrameThreadGraph *g = ctx->graph->internal->frame_thread;
+    FrameThreadContext *ft;
+    int ret;
+
+    ft = av_mallocz(sizeof(*ft));
+    if (!ft)
+        return AVERROR(ENOMEM);
+    ft->ctx   = ctx;
+    ft->graph = g;
+    ff_framequeue_init(&ft->out, &ctx->graph->internal->frame_queues);
+
+    if ((ret = pthread_cond_init(&ft->cond, NULL))) {
+        av_free(ft);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_create(&ft->thread, NULL, frame_thread_worker, ft))) {
+        pthread_cond_destroy(&ft->cond);
+        av_free(ft);
+        return AVERROR(ret);
+    }
+    ctx->internal->frame_thread = ft;
+    g->nb_threads++;
+    return 0;
+}
+
+void ff_filter_frame_thread_free(AVFilterContext *ctx)
+{
+    FrameThreadContext *ft = ctx->internal->frame_thread;
+    FrameThreadGraph *g;
+
+    if (!ft)
+        return;
+    g = ft->graph;
+
+    pthread_mutex_lock(&g->mutex);
+    while (ft->busy)
+        pthread_cond_wait(&g->cond, &g->mutex);
+    ft->exit = 1;
+    pthread_cond_signal(&ft->cond);
+    pthread_mutex_unlock(&g->mutex);
+    pthread_join(ft->thread, NULL);
+
+    pthread_cond_destroy(&ft->cond);
+    ff_framequeue_free(&ft->out);
+    g->nb_threads--;
+    av_freep(&ctx->internal->frame_thread);
+}
+
+void ff_filter_frame_thread_submit(AVFilterLink *link, AVFrame *frame,
+                                   int (*filter_frame)(AVFilterLink *, AVFrame *))
+{
+    FrameThreadContext *ft = link->dst->internal->frame_thread;
+    FrameThreadGraph    *g = ft->graph;
+
+    av_assert1(!ft->pending);
+    ft->pending      = 1;
+    ft->link         = link;
+    ft->frame        = frame;
+    ft->filter_frame = filter_frame;
+
+    pthread_mutex_lock(&g->mutex);
+    ft->busy = 1;
+    pthread_cond_signal(&ft->cond);
+    pthread_mutex_unlock(&g->mutex);
+}
+
+void ff_filter_frame_thread_wait(AVFilterContext *ctx)
+{
+    FrameThreadContext *ft = ctx->internal->frame_thread;
+    FrameThreadGraph    *g = ft->graph;
+
+    pthread_mutex_lock(&g->mutex);
+    while (ft->busy)
+        pthread_cond_wait(&g->cond, &g->mutex);
+    pthread_mutex_unlock(&g->mutex);
+}
+
+int ff_filter_frame_thread_queue_frame(AVFilterLink *link, AVFrame *frame)
+{
+    FrameThreadContext *ft = link->src->internal->frame_thread;
+    int ret;
+
+    if (!ft->pending || !pthread_equal(pthread_self(), ft->thread))
+        return 0;
+    ret = ff_framequeue_add(&ft->out, frame);
+    if (ret < 0) {
+        av_frame_free_xij(&frame);
+        return ret;
+    }
+    return 1;
+}
+
+int ff_filter_frame_thread_queue_request(AVFilterLink *link)
+{
+    FrameThreadContext *ft = link->dst->internal->frame_thread;
+
+    if (!ft->pending || !pthread_equal(pthread_self(), ft->thread))
+        return 0;
+    ft->request = 1;
+    return 1;
+}
+
+static int frame_thread_finish(FrameThreadContext *ft)
+{
+    AVFilterContext *ctx = ft->ctx;
+    AVFilterLink   *link = ft->link;
+    int ret = ft->ret;
+
+    ft->pending = 0;
+    while (ff_framequeue_queued_frames(&ft->out)) {
+        int err = ff_filter_frame(ctx->outputs[0], ff_framequeue_take(&ft->out));
+        if (err < 0 && ret >= 0)
+            ret = err;
+    }
+    if (ft->request) {
+        ft->request = 0;
+        if (ret >= 0)
+            ret = ff_request_frame(link);
+    }
+
+    /* Same as the end of ff_filter_frame_to_filter(). */
+    if (ret < 0 && ret != link->status_out)
+        ff_avfilter_link_set_out_status(link, ret, AV_NOPTS_VALUE);
+    else
+        ff_filter_set_ready(ctx, 300);
+    return ret;
+}
+
+static int frame_threads_finish(AVFilterGraph *graph)
+{
+    FrameThreadGraph *g = graph->internal->frame_thread;
+    int ret = 0;
+    unsigned i;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        FrameThreadContext *ft = graph->filters[i]->internal->frame_thread;
+        int busy, err;
+
+        if (!ft || !ft->pending)
+            continue;
+        pthread_mutex_lock(&g->mutex);
+        busy = ft->busy;
+        pthread_mutex_unlock(&g->mutex);
+        if (busy)
+            continue;
+        err = frame_thread_finish(ft);
+        if (err < 0 && ret >= 0)
+            ret = err;
+    }
+    return ret;
+}
+
+/* Must be called with the graph mutex locked. */
+static int frame_threads_done(AVFilterGraph *graph)
+{
+    unsigned i;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        FrameThreadContext *ft = graph->filters[i]->internal->frame_thread;
+        if (ft && ft->pending && !ft->busy)
+            return 1;
+    }
+    return 0;
+}
+
+static int source_starved(AVFilterContext *ctx)
+{
+    unsigned i;
+
+    if (ctx->nb_inputs)
+        return 0;
+    for (i = 0; i < ctx->nb_outputs; i++) {
+        AVFilterLink *link = ctx->outputs[i];
+        if (link->frame_wanted_out && link->frame_blocked_in && !link->status_in)
+            return 1;
+    }
+    return 0;
+}
+
+int ff_graph_frame_thread_run_once(AVFilterGraph *graph)
+{
+    FrameThreadGraph *g = graph->internal->frame_thread;
+    AVFilterContext *filter = NULL;
+    int pending = 0, starved = 0, lagging = 0;
+    unsigned i;
+    int ret;
+
+    ret = frame_threads_finish(graph);
+    if (ret < 0)
+        return ret;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+        FrameThreadContext *ft = f->internal->frame_thread;
+
+        if (ft && ft->pending) {
+            pending = 1;
+            if (ff_framequeue_queued_frames(&f->inputs[0]->fifo) >= FRAME_THREAD_MAX_QUEUED)
+                lagging = 1;
+            continue;
+        }
+        starved |= source_starved(f);
+        if (!filter || f->ready > filter->ready)
+            filter = f;
+    }
+    if (filter && filter->ready)
+        return ff_filter_activate(filter);
+
+    /* Nothing to do but waiting for the frame threads: let the caller feed
+       a starved source first, unless the threads are already behind. */
+    if (!pending || (starved && !lagging))
+        return AVERROR(EAGAIN);
+
+    pthread_mutex_lock(&g->mutex);
+    while (!frame_threads_done(graph))
+        pthread_cond_wait(&g->cond, &g->mutex);
+    pthread_mutex_unlock(&g->mutex);
+
+    return frame_threads_finish(graph);
+}
+
+int ff_graph_frame_thread_init(AVFilterGraph *graph)
+{
+    FrameThreadGraph *g = graph->internal->frame_thread;
+    unsigned i;
+    int ret;
+
+    for (i = 0; i < graph->nb_filters; i++) {
+        AVFilterContext *f = graph->filters[i];
+
+        if (!(f->thread_type & AVFILTER_THREAD_FRAME) || f->internal->frame_thread)
+            continue;
+        if (!g || g->nb_threads >= graph->nb_threads || !frame_thread_usable(f)) {
+            f->thread_type &= ~AVFILTER_THREAD_FRAME;
+            continue;
+        }
+        if ((ret = frame_thread_init(f)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int frame_thread_graph_init(AVFilterGraph *graph)
+{
+    FrameThreadGraph *g;
+    int ret;
+
+    g = av_mallocz(sizeof(*g));
+    if (!g)
+        return AVERROR(ENOMEM);
+    if ((ret = pthread_mutex_init(&g->mutex, NULL))) {
+        av_free(g);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&g->cond, NULL))) {
+        pthread_mutex_destroy(&g->mutex);
+        av_free(g);
+        return AVERROR(ret);
+    }
+    graph->internal->frame_thread = g;
+    return 0;
+}
+
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
     int ret;
@@ -105,12 +464,23 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_FRAME)
+        return frame_thread_graph_init(graph);
+
     return 0;
 }
 
 void ff_graph_thread_free(AVFilterGraph *graph)
 {
+    FrameThreadGraph *g = graph->internal->frame_thread;
+
     if (graph->internal->thread)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
+
+    if (g) {
+        pthread_cond_destroy(&g->cond);
+        pthread_mutex_destroy(&g->mutex);
+        av_freep(&graph->internal->frame_thread);
+    }
 }
@@ -25,4 +25,45 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Start the frame threads of the filters of a configured graph that allow
+ * AVFILTER_THREAD_FRAME and are able to use it; clear that flag from the
+ * thread_type of the others.
+ */
+int ff_graph_frame_thread_init(AVFilterGraph *graph);
+
+/**
+ * Run one round of processing on a graph with frame threads: forward the
+ * output of the frames the threads have finished, then activate the ready
+ * filter with the highest priority that is not processing a frame.
+ *
+ * If no filter is ready, wait for a frame thread to finish unless a source
+ * is starved and no frame thread is lagging behind its input.
+ */
+int ff_graph_frame_thread_run_once(AVFilterGraph *graph);
+
+/**
+ * Hand a frame over to the frame thread of link->dst, which will call
+ * filter_frame() on it. The output of the filter is forwarded to its
+ * output link once the thread has finished.
+ */
+void ff_filter_frame_thread_submit(AVFilterLink *link, AVFrame *frame,
+                                   int (*filter_frame)(AVFilterLink *, AVFrame *));
+
+/**
+ * Wait until the frame thread of a filter is not processing any frame.
+ */
+void ff_filter_frame_thread_wait(AVFilterContext *ctx);
+
+void ff_filter_frame_thread_free(AVFilterContext *ctx);
+
+/**
+ * Called by ff_filter_frame() and ff_request_frame(): when running in the
+ * frame thread of link->src (respectively link->dst), queue the frame
+ * (respectively the request) for the main thread and return 1.
+ * Return 0 otherwise, or a negative error code.
+ */
+int ff_filter_frame_thread_queue_frame(AVFilterLink *link, AVFrame *frame);
+int ff_filter_frame_thread_queue_request(AVFilterLink *link);
+
 #endif /* AVFILTER_THREAD_H */
@@ -0,0 +1,59 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_TONEMAP_H
+#define AVFILTER_TONEMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The tone curve is sampled as gain = curve(sig) / sig at
+ * t = sig / (sig + peak) * TONEMAP_LUT_SIZE, which maps the whole positive
+ * range to [0, TONEMAP_LUT_SIZE] and samples dark values most densely.
+ * The LUT holds TONEMAP_LUT_SIZE + 2 entries so that t == TONEMAP_LUT_SIZE
+ * can still be interpolated. x86/vf_tonemap.asm has the size hardcoded.
+ */
+#define TONEMAP_LUT_SIZE 4096
+
+typedef struct TonemapRowParams {
+    float coeffs[3];    ///< luma coefficients of the first, second and third plane
+    float desat;        ///< desaturation strength, 0 disables desaturation
+    float peak;         ///< signal peak the LUT was built for
+} TonemapRowParams;
+
+typedef struct TonemapDSPContext {
+    /**
+     * Desaturate and tone map one row of planar float RGB.
+     *
+     * @param dst    output planes, in the order of coeffs
+     * @param src    input planes, in the order of coeffs
+     * @param lut    TONEMAP_LUT_SIZE + 2 gains, 32-byte aligned
+     * @param params constants of the conversion
+     * @param w      number of pixels
+     * @return the number of pixels processed, the caller processes the rest
+     */
+    int (*tonemap_row)(float *const dst[3], const float *const src[3],
+                       const float *lut, const TonemapRowParams *params,
+                       int w);
+} TonemapDSPContext;
+
+void ff_tonemap_init(TonemapDSPContext *dsp);
+void ff_tonemap_init_x86(TonemapDSPContext *dsp);
+
+#endif /* AVFILTER_TONEMAP_H */
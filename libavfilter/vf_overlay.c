@@ -39,6 +39,7 @@
 #include "drawutils.h"
 #include "framesync.h"
 #include "video.h"
+#include "vf_overlay.h"
 
 static const char *const var_names[] = {
     "main_w",    "W", ///< width  of the main    video
@@ -55,21 +56,6 @@ static const char *const var_names[] = {
     NULL
 };
 
-enum var_name {
-    VAR_MAIN_W,    VAR_MW,
-    VAR_MAIN_H,    VAR_MH,
-    VAR_OVERLAY_W, VAR_OW,
-    VAR_OVERLAY_H, VAR_OH,
-    VAR_HSUB,
-    VAR_VSUB,
-    VAR_X,
-    VAR_Y,
-    VAR_N,
-    VAR_POS,
-    VAR_T,
-    VAR_VARS_NB
-};
-
 #define MAIN    0
 #define OVERLAY 1
 
@@ -82,51 +68,6 @@ enum var_name {
 #define U 1
 #define V 2
 
-enum EvalMode {
-    EVAL_MODE_INIT,
-    EVAL_MODE_FRAME,
-    EVAL_MODE_NB
-};
-
-enum OverlayFormat {
-    OVERLAY_FORMAT_YUV420,
-    OVERLAY_FORMAT_YUV422,
-    OVERLAY_FORMAT_YUV444,
-    OVERLAY_FORMAT_RGB,
-    OVERLAY_FORMAT_GBRP,
-    OVERLAY_FORMAT_AUTO,
-    OVERLAY_FORMAT_NB
-};
-
-typedef struct OverlayContext {
-    const AVClass *class;
-    int x, y;                   ///< position of overlaid picture
-
-    uint8_t main_is_packed_rgb;
-    uint8_t main_rgba_map[4];
-    uint8_t main_has_alpha;
-    uint8_t overlay_is_packed_rgb;
-    uint8_t overlay_rgba_map[4];
-    uint8_t overlay_has_alpha;
-    int format;                 ///< OverlayFormat
-    int alpha_format;
-    int eval_mode;              ///< EvalMode
-
-    FFFrameSync fs;
-
-    int main_pix_step[4];       ///< steps per pixel for each plane of the main output
-    int overlay_pix_step[4];    ///< steps per pixel for each plane of the overlay
-    int hsub, vsub;             ///< chroma subsampling values
-    const AVPixFmtDescriptor *main_desc; ///< format descriptor for main input
-
-    double var_values[VAR_VARS_NB];
-    char *x_expr, *y_expr;
-
-    AVExpr *x_pexpr, *y_pexpr;
-
-    void (*blend_image)(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y);
-} OverlayContext;
-
 static av_cold void uninit(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
@@ -406,10 +347,11 @@ static int config_output(AVFilterLink *outlink)
 static av_always_inline void blend_image_packed_rgb(AVFilterContext *ctx,
                                    AVFrame *dst, const AVFrame *src,
                                    int main_has_alpha, int x, int y,
-                                   int is_straight)
+                                   int is_straight, int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     int i, imax, j, jmax;
+    int slice_start, slice_end;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
@@ -428,10 +370,16 @@ static av_always_inline void blend_image_packed_rgb(AVFilterContext *ctx,
     uint8_t *S, *sp, *d, *dp;
 
     i = FFMAX(-y, 0);
-    sp = src->data[0] + i     * src->linesize[0];
-    dp = dst->data[0] + (y+i) * dst->linesize[0];
+    imax = FFMIN(-y + dst_h, src_h);
+    if (imax <= i)
+        return;
+    slice_start = i + (imax - i) *  jobnr      / nb_jobs;
+    slice_end   = i + (imax - i) * (jobnr + 1) / nb_jobs;
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    sp = src->data[0] + slice_start     * src->linesize[0];
+    dp = dst->data[0] + (y+slice_start) * dst->linesize[0];
+
+    for (i = slice_start; i < slice_end; i++) {
         j = FFMAX(-x, 0);
         S = sp + j     * sstep;
         d = dp + (x+j) * dstep;
@@ -495,7 +443,11 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
                                          int dst_offset,
                                          int dst_step,
                                          int straight,
-                                         int yuv)
+                                         int yuv,
+                                         int (*blend_row)(uint8_t *d, const uint8_t *s,
+                                                          const uint8_t *a, int w,
+                                                          ptrdiff_t alinesize),
+                                         int jobnr, int nb_jobs)
 {
     int src_wp = AV_CEIL_RSHIFT(src_w, hsub);
     int src_hp = AV_CEIL_RSHIFT(src_h, vsub);
@@ -505,23 +457,48 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
     int xp = x>>hsub;
     uint8_t *s, *sp, *d, *dp, *dap, *a, *da, *ap;
     int jmax, j, k, kmax;
+    int slice_start, slice_end;
 
     j = FFMAX(-yp, 0);
-    sp = src->data[i] + j         * src->linesize[i];
+    jmax = FFMIN(-yp + dst_hp, src_hp);
+    if (jmax <= j)
+        return;
+    slice_start = j + (jmax - j) *  jobnr      / nb_jobs;
+    slice_end   = j + (jmax - j) * (jobnr + 1) / nb_jobs;
+
+    sp = src->data[i] + slice_start         * src->linesize[i];
     dp = dst->data[dst_plane]
-                      + (yp+j)    * dst->linesize[dst_plane]
+                      + (yp+slice_start)    * dst->linesize[dst_plane]
                       + dst_offset;
-    ap = src->data[3] + (j<<vsub) * src->linesize[3];
-    dap = dst->data[3] + ((yp+j) << vsub) * dst->linesize[3];
+    ap = src->data[3] + (slice_start<<vsub) * src->linesize[3];
+    dap = dst->data[3] + ((yp+slice_start) << vsub) * dst->linesize[3];
 
-    for (jmax = FFMIN(-yp + dst_hp, src_hp); j < jmax; j++) {
+    for (j = slice_start; j < slice_end; j++) {
         k = FFMAX(-xp, 0);
+        kmax = FFMIN(-xp + dst_wp, src_wp);
         d = dp + (xp+k) * dst_step;
         s = sp + k;
         a = ap + (k<<hsub);
         da = dap + ((xp+k) << hsub);
 
-        for (kmax = FFMIN(-xp + dst_wp, src_wp); k < kmax; k++) {
+        // the last overlay row and column average fewer alpha values,
+        // leave them to the generic code below
+        if (blend_row && !main_has_alpha && dst_step == 1 &&
+            (!vsub || j + 1 < src_hp)) {
+            int w = FFMIN(kmax, hsub ? src_wp - 1 : src_wp) - k;
+
+            if (w > 0) {
+                int n = blend_row(d, s, a, w, src->linesize[3]);
+
+                k += n;
+                d += n;
+                s += n;
+                a += n << hsub;
+                da += n << hsub;
+            }
+        }
+
+        for (; k < kmax; k++) {
             int alpha_v, alpha_h, alpha;
 
             // average alpha for color components, improve quality
@@ -574,20 +551,72 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
     }
 }
 
+static av_always_inline int blend_row_c(uint8_t *d, const uint8_t *s,
+                                        const uint8_t *a, int w,
+                                        ptrdiff_t alinesize, int hsub, int vsub,
+                                        int straight, int chroma)
+{
+    int k;
+
+    for (k = 0; k < w; k++) {
+        int alpha;
+
+        if (hsub && vsub)
+            alpha = (a[0] + a[alinesize] + a[1] + a[alinesize + 1]) >> 2;
+        else if (hsub)
+            alpha = (a[0] + ((a[0] + a[1]) >> 1)) >> 1;
+        else
+            alpha = a[0];
+
+        if (straight)
+            d[k] = FAST_DIV255(d[k] * (255 - alpha) + s[k] * alpha);
+        else if (chroma)
+            d[k] = av_clip(FAST_DIV255((d[k] - 128) * (255 - alpha)) + s[k] - 128, -128, 128) + 128;
+        else
+            d[k] = FFMIN(FAST_DIV255(d[k] * (255 - alpha)) + s[k], 255);
+        a += 1 << hsub;
+    }
+    return w;
+}
+
+#define DEFINE_BLEND_ROW(name, hsub, vsub, straight, chroma)                \
+static int blend_row_ ## name ## _c(uint8_t *d, const uint8_t *s,           \
+                                    const uint8_t *a, int w,                \
+                                    ptrdiff_t alinesize)                    \
+{                                                                           \
+    return blend_row_c(d, s, a, w, alinesize, hsub, vsub, straight, chroma); \
+}
+
+DEFINE_BLEND_ROW(44,       0, 0, 1, 0)
+DEFINE_BLEND_ROW(22,       1, 0, 1, 0)
+DEFINE_BLEND_ROW(20,       1, 1, 1, 0)
+DEFINE_BLEND_ROW(44_pm,    0, 0, 0, 0)
+DEFINE_BLEND_ROW(44_pm_uv, 0, 0, 0, 1)
+DEFINE_BLEND_ROW(22_pm_uv, 1, 0, 0, 1)
+DEFINE_BLEND_ROW(20_pm_uv, 1, 1, 0, 1)
+
 static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
                                    int src_w, int src_h,
                                    int dst_w, int dst_h,
-                                   int x, int y)
+                                   int x, int y,
+                                   int jobnr, int nb_jobs)
 {
     uint8_t alpha;          ///< the amount of overlay to blend on to main
     uint8_t *s, *sa, *d, *da;
     int i, imax, j, jmax;
+    int slice_start, slice_end;
 
     i = FFMAX(-y, 0);
-    sa = src->data[3] + i     * src->linesize[3];
-    da = dst->data[3] + (y+i) * dst->linesize[3];
+    imax = FFMIN(-y + dst_h, src_h);
+    if (imax <= i)
+        return;
+    slice_start = i + (imax - i) *  jobnr      / nb_jobs;
+    slice_end   = i + (imax - i) * (jobnr + 1) / nb_jobs;
+
+    sa = src->data[3] + slice_start     * src->linesize[3];
+    da = dst->data[3] + (y+slice_start) * dst->linesize[3];
 
-    for (imax = FFMIN(-y + dst_h, src_h); i < imax; i++) {
+    for (i = slice_start; i < slice_end; i++) {
         j = FFMAX(-x, 0);
         s = sa + j;
         d = da + x+j;
@@ -621,7 +650,8 @@ static av_always_inline void blend_image_yuv(AVFilterContext *ctx,
                                              int hsub, int vsub,
                                              int main_has_alpha,
                                              int x, int y,
-                                             int is_straight)
+                                             int is_straight,
+                                             int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
@@ -630,14 +660,14 @@ static av_always_inline void blend_image_yuv(AVFilterContext *ctx,
     const int dst_h = dst->height;
 
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
-                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step, is_straight, 1);
+                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step, is_straight, 1,
+                s->blend_row[0], jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step, is_straight, 1);
+                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step, is_straight, 1,
+                s->blend_row[1], jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step, is_straight, 1);
-
-    if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step, is_straight, 1,
+                s->blend_row[2], jobnr, nb_jobs);
 }
 
 static av_always_inline void blend_image_planar_rgb(AVFilterContext *ctx,
@@ -645,7 +675,8 @@ static av_always_inline void blend_image_planar_rgb(AVFilterContext *ctx,
                                                     int hsub, int vsub,
                                                     int main_has_alpha,
                                                     int x, int y,
-                                                    int is_straight)
+                                                    int is_straight,
+                                                    int jobnr, int nb_jobs)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
@@ -654,114 +685,160 @@ static av_always_inline void blend_image_planar_rgb(AVFilterContext *ctx,
     const int dst_h = dst->height;
 
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
-                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step, is_straight, 0);
+                s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step, is_straight, 0,
+                s->blend_row[0], jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step, is_straight, 0);
+                s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step, is_straight, 0,
+                s->blend_row[1], jobnr, nb_jobs);
     blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
-                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step, is_straight, 0);
+                s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step, is_straight, 0,
+                s->blend_row[2], jobnr, nb_jobs);
+}
 
-    if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y);
+static void blend_image_yuv420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                               int jobnr, int nb_jobs)
+{
+    blend_image_yuv(ctx, dst, src, 1, 1, 0, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 1, 0, x, y, 1);
+    blend_image_yuv(ctx, dst, src, 1, 1, 1, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuv422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                               int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 1, 1, x, y, 1);
+    blend_image_yuv(ctx, dst, src, 1, 0, 0, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 0, 0, x, y, 1);
+    blend_image_yuv(ctx, dst, src, 1, 0, 1, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuv444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                               int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 0, 1, x, y, 1);
+    blend_image_yuv(ctx, dst, src, 0, 0, 0, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 0, 0, 0, x, y, 1);
+    blend_image_yuv(ctx, dst, src, 0, 0, 1, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_gbrp(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                             int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 0, 0, 1, x, y, 1);
+    blend_image_planar_rgb(ctx, dst, src, 0, 0, 0, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_gbrp(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_gbrap(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                              int jobnr, int nb_jobs)
 {
-    blend_image_planar_rgb(ctx, dst, src, 0, 0, 0, x, y, 1);
+    blend_image_planar_rgb(ctx, dst, src, 0, 0, 1, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_gbrap(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuv420_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                  int jobnr, int nb_jobs)
 {
-    blend_image_planar_rgb(ctx, dst, src, 0, 0, 1, x, y, 1);
+    blend_image_yuv(ctx, dst, src, 1, 1, 0, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv420_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva420_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                   int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 1, 0, x, y, 0);
+    blend_image_yuv(ctx, dst, src, 1, 1, 1, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva420_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuv422_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                  int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 1, 1, x, y, 0);
+    blend_image_yuv(ctx, dst, src, 1, 0, 0, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv422_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva422_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                   int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 0, 0, x, y, 0);
+    blend_image_yuv(ctx, dst, src, 1, 0, 1, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva422_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuv444_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                  int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 1, 0, 1, x, y, 0);
+    blend_image_yuv(ctx, dst, src, 0, 0, 0, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_yuv444_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_yuva444_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                   int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 0, 0, 0, x, y, 0);
+    blend_image_yuv(ctx, dst, src, 0, 0, 1, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_yuva444_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_gbrp_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                int jobnr, int nb_jobs)
 {
-    blend_image_yuv(ctx, dst, src, 0, 0, 1, x, y, 0);
+    blend_image_planar_rgb(ctx, dst, src, 0, 0, 0, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_gbrp_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_gbrap_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                 int jobnr, int nb_jobs)
 {
-    blend_image_planar_rgb(ctx, dst, src, 0, 0, 0, x, y, 0);
+    blend_image_planar_rgb(ctx, dst, src, 0, 0, 1, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_gbrap_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_rgb(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                            int jobnr, int nb_jobs)
 {
-    blend_image_planar_rgb(ctx, dst, src, 0, 0, 1, x, y, 0);
+    blend_image_packed_rgb(ctx, dst, src, 0, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_rgb(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_rgba(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                             int jobnr, int nb_jobs)
 {
-    blend_image_packed_rgb(ctx, dst, src, 0, x, y, 1);
+    blend_image_packed_rgb(ctx, dst, src, 1, x, y, 1, jobnr, nb_jobs);
 }
 
-static void blend_image_rgba(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_rgb_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                               int jobnr, int nb_jobs)
 {
-    blend_image_packed_rgb(ctx, dst, src, 1, x, y, 1);
+    blend_image_packed_rgb(ctx, dst, src, 0, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_rgb_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+static void blend_image_rgba_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y,
+                                int jobnr, int nb_jobs)
 {
-    blend_image_packed_rgb(ctx, dst, src, 0, x, y, 0);
+    blend_image_packed_rgb(ctx, dst, src, 1, x, y, 0, jobnr, nb_jobs);
 }
 
-static void blend_image_rgba_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src, int x, int y)
+av_cold void ff_overlay_init(OverlayContext *s)
 {
-    blend_image_packed_rgb(ctx, dst, src, 1, x, y, 0);
+    const int yuv = !(s->main_desc->flags & AV_PIX_FMT_FLAG_RGB);
+    int straight = !s->alpha_format;
+
+    memset(s->blend_row, 0, sizeof(s->blend_row));
+    if (s->main_is_packed_rgb || s->main_has_alpha)
+        return;
+
+    s->blend_row[0] = straight ? blend_row_44_c : blend_row_44_pm_c;
+    if (!yuv) {
+        s->blend_row[1] = s->blend_row[2] = s->blend_row[0];
+    } else if (!s->hsub && !s->vsub) {
+        s->blend_row[1] = s->blend_row[2] = straight ? blend_row_44_c : blend_row_44_pm_uv_c;
+    } else if (s->hsub == 1 && !s->vsub) {
+        s->blend_row[1] = s->blend_row[2] = straight ? blend_row_22_c : blend_row_22_pm_uv_c;
+    } else if (s->hsub == 1 && s->vsub == 1) {
+        s->blend_row[1] = s->blend_row[2] = straight ? blend_row_20_c : blend_row_20_pm_uv_c;
+    } else {
+        s->blend_row[1] = s->blend_row[2] = NULL;
+    }
+
+    if (ARCH_X86)
+        ff_overlay_init_x86(s, yuv);
 }
 
 static int config_input_main(AVFilterLink *inlink)
@@ -823,7 +900,7 @@ static int config_input_main(AVFilterLink *inlink)
     }
 
     if (!s->alpha_format)
-        return 0;
+        goto end;
 
     switch (s->format) {
     case OVERLAY_FORMAT_YUV420:
@@ -867,6 +944,32 @@ static int config_input_main(AVFilterLink *inlink)
         }
         break;
     }
+
+end:
+    ff_overlay_init(s);
+    return 0;
+}
+
+typedef struct ThreadData {
+    AVFrame *dst, *src;
+} ThreadData;
+
+static int blend_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+
+    s->blend_image(ctx, td->dst, td->src, s->x, s->y, jobnr, nb_jobs);
+    return 0;
+}
+
+static int alpha_composite_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+
+    alpha_composite(td->src, td->dst, td->src->width, td->src->height,
+                    td->dst->width, td->dst->height, s->x, s->y, jobnr, nb_jobs);
     return 0;
 }
 
@@ -905,8 +1008,16 @@ static int do_blend(FFFrameSync *fs)
     }
 
     if (s->x < mainpic->width  && s->x + second->width  >= 0 ||
-        s->y < mainpic->height && s->y + second->height >= 0)
-        s->blend_image(ctx, mainpic, second, s->x, s->y);
+        s->y < mainpic->height && s->y + second->height >= 0) {
+        ThreadData td = { .dst = mainpic, .src = second };
+        int nb_jobs = av_clip(second->height, 1, ff_filter_get_nb_threads(ctx));
+
+        ctx->internal->execute(ctx, blend_slice, &td, NULL, nb_jobs);
+        /* the planes are blended with the main alpha from before compositing,
+         * so only update it once all of them are done */
+        if (s->main_has_alpha && !s->main_is_packed_rgb)
+            ctx->internal->execute(ctx, alpha_composite_slice, &td, NULL, nb_jobs);
+    }
     return ff_filter_frame(ctx->outputs[0], mainpic);
 }
 
@@ -992,5 +1103,6 @@ AVFilter ff_vf_overlay = {
     .process_command = process_command,
     .inputs        = avfilter_vf_overlay_inputs,
     .outputs       = avfilter_vf_overlay_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
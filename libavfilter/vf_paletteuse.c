@@ -23,14 +23,20 @@
  * Use a palette to downsample an input video stream.
  */
 
+#include <stdatomic.h>
+
+#include "config.h"
 #include "libavutil/bprint.h"
 #include "libavutil/internal.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/qsort.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "filters.h"
 #include "framesync.h"
 #include "internal.h"
+#include "paletteuse.h"
 
 enum dithering_mode {
     DITHERING_NONE,
@@ -78,14 +84,28 @@ struct cache_node {
 struct PaletteUseContext;
 
 typedef int (*set_frame_func)(struct PaletteUseContext *s, AVFrame *out, AVFrame *in,
-                              int x_start, int y_start, int width, int height);
+                              int x_start, int y_start, int width, int height,
+                              int jobnr, int nb_jobs);
+
+/* Interval in pixels at which the error diffusion rows report their progress
+ * to the row below. */
+#define PROGRESS_STEP 32
 
 typedef struct PaletteUseContext {
     const AVClass *class;
     FFFrameSync fs;
-    struct cache_node cache[CACHE_SIZE];    /* lookup cache */
+    struct cache_node *cache;               /* lookup caches, CACHE_SIZE nodes for each job */
+    int nb_caches;
     struct color_node map[AVPALETTE_COUNT]; /* 3D-Tree (KD-Tree with K=3) for reverse colormap */
     uint32_t palette[AVPALETTE_COUNT];
+    /* opaque unique palette colors for the brute-force search, padded to
+     * PALETTEUSE_PAL_ALIGN entries */
+    DECLARE_ALIGNED(32, uint32_t, pal_rg)[AVPALETTE_COUNT];
+    DECLARE_ALIGNED(32, uint32_t, pal_b)[AVPALETTE_COUNT];
+    uint8_t pal_ids[AVPALETTE_COUNT];       /* palette index of each of them */
+    int nb_pal_colors;                      /* number of opaque colors */
+    int nb_pal_entries;                     /* padded number of entries */
+    PaletteUseDSPContext dsp;
     int transparency_index; /* index in the palette of transparency. -1 if there is no transparency in the palette. */
     int trans_thresh;
     int palette_loaded;
@@ -98,6 +118,15 @@ typedef struct PaletteUseContext {
     AVFrame *last_in;
     AVFrame *last_out;
 
+    int nb_jobs;
+    int *job_rets;
+    int pipeline;       /* error diffusion rows are dithered concurrently */
+#if HAVE_THREADS
+    atomic_int *row_progress; /* number of pixels dithered in each row, as an end x */
+    pthread_mutex_t *progress_mutex;
+    pthread_cond_t *progress_cond;
+#endif
+
     /* debug options */
     char *dot_filename;
     int color_search_method;
@@ -327,10 +356,49 @@ end:
     return root[best_node_id].palette_id;
 }
 
-#define COLORMAP_NEAREST(search, palette, root, target, trans_thresh)                                    \
-    search == COLOR_SEARCH_NNS_ITERATIVE ? colormap_nearest_iterative(root, target, trans_thresh) :      \
-    search == COLOR_SEARCH_NNS_RECURSIVE ? colormap_nearest_recursive(root, target, trans_thresh) :      \
-                                           colormap_nearest_bruteforce(palette, target, trans_thresh)
+static int nearest_color_c(const uint32_t *pal_rg, const uint32_t *pal_b,
+                           int nb, uint32_t rg, uint32_t b)
+{
+    int i, pal_id = 0, min_dist = INT_MAX;
+
+    for (i = 0; i < nb; i++) {
+        const int dr = (int)(pal_rg[i] & 0xffff) - (int)(rg & 0xffff);
+        const int dg = (int)(pal_rg[i] >> 16)    - (int)(rg >> 16);
+        const int db = (int) pal_b[i]            - (int)b;
+        const int d = dr*dr + dg*dg + db*db;
+
+        if (d < min_dist) {
+            pal_id = i;
+            min_dist = d;
+        }
+    }
+    return pal_id;
+}
+
+av_cold void ff_paletteuse_init(PaletteUseDSPContext *dsp)
+{
+    dsp->nearest_color = nearest_color_c;
+
+    if (ARCH_X86)
+        ff_paletteuse_init_x86(dsp);
+}
+
+/* Same result as colormap_nearest_bruteforce(), searching only the opaque
+ * unique colors of the palette. */
+static av_always_inline uint8_t colormap_nearest_dsp(const PaletteUseContext *s, const uint8_t *argb)
+{
+    if (!s->nb_pal_colors)
+        return colormap_nearest_bruteforce(s->palette, argb, s->trans_thresh);
+    if (argb[0] < s->trans_thresh) // all the opaque colors are equally far
+        return s->pal_ids[0];
+    return s->pal_ids[s->dsp.nearest_color(s->pal_rg, s->pal_b, s->nb_pal_entries,
+                                           argb[1] | argb[2] << 16, argb[3])];
+}
+
+#define COLORMAP_NEAREST(s, search, target)                                                                     \
+    search == COLOR_SEARCH_NNS_ITERATIVE ? colormap_nearest_iterative((s)->map, target, (s)->trans_thresh) :     \
+    search == COLOR_SEARCH_NNS_RECURSIVE ? colormap_nearest_recursive((s)->map, target, (s)->trans_thresh) :     \
+                                           colormap_nearest_dsp(s, target)
 
 /**
  * Check if the requested color is in the cache already. If not, find it in the
@@ -338,7 +406,8 @@ end:
  * Note: a, r, g, and b are the components of color, but are passed as well to avoid
  * recomputing them (they are generally computed by the caller for other uses).
  */
-static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
+static av_always_inline int color_get(PaletteUseContext *s, struct cache_node *cache,
+                                      uint32_t color,
                                       uint8_t a, uint8_t r, uint8_t g, uint8_t b,
                                       const enum color_search_method search_method)
 {
@@ -348,7 +417,7 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
     const uint8_t ghash = g & ((1<<NBITS)-1);
     const uint8_t bhash = b & ((1<<NBITS)-1);
     const unsigned hash = rhash<<(NBITS*2) | ghash<<NBITS | bhash;
-    struct cache_node *node = &s->cache[hash];
+    struct cache_node *node = &cache[hash];
     struct cached_color *e;
 
     // first, check for transparency
@@ -367,12 +436,12 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
     if (!e)
         return AVERROR(ENOMEM);
     e->color = color;
-    e->pal_entry = COLORMAP_NEAREST(search_method, s->palette, s->map, argb_elts, s->trans_thresh);
+    e->pal_entry = COLORMAP_NEAREST(s, search_method, argb_elts);
 
     return e->pal_entry;
 }
 
-static av_always_inline int get_dst_color_err(PaletteUseContext *s,
+static av_always_inline int get_dst_color_err(PaletteUseContext *s, struct cache_node *cache,
                                               uint32_t c, int *er, int *eg, int *eb,
                                               const enum color_search_method search_method)
 {
@@ -381,7 +450,7 @@ static av_always_inline int get_dst_color_err(PaletteUseContext *s,
     const uint8_t g = c >>  8 & 0xff;
     const uint8_t b = c       & 0xff;
     uint32_t dstc;
-    const int dstx = color_get(s, c, a, r, g, b, search_method);
+    const int dstx = color_get(s, cache, c, a, r, g, b, search_method);
     if (dstx < 0)
         return dstx;
     dstc = s->palette[dstx];
@@ -391,24 +460,89 @@ static av_always_inline int get_dst_color_err(PaletteUseContext *s,
     return dstx;
 }
 
+#if HAVE_THREADS
+static void report_progress(PaletteUseContext *s, int jobnr, int y, int x)
+{
+    pthread_mutex_lock(&s->progress_mutex[jobnr]);
+    atomic_store_explicit(&s->row_progress[y], x, memory_order_release);
+    pthread_cond_broadcast(&s->progress_cond[jobnr]);
+    pthread_mutex_unlock(&s->progress_mutex[jobnr]);
+}
+
+/**
+ * Wait until row y, dithered by job jobnr, is dithered up to x, and return
+ * how far it actually is.
+ */
+static int await_progress(PaletteUseContext *s, int jobnr, int y, int x)
+{
+    int progress = atomic_load_explicit(&s->row_progress[y], memory_order_acquire);
+
+    if (progress >= x)
+        return progress;
+    pthread_mutex_lock(&s->progress_mutex[jobnr]);
+    while ((progress = atomic_load_explicit(&s->row_progress[y], memory_order_acquire)) < x)
+        pthread_cond_wait(&s->progress_cond[jobnr], &s->progress_mutex[jobnr]);
+    pthread_mutex_unlock(&s->progress_mutex[jobnr]);
+    return progress;
+}
+#else
+static void report_progress(PaletteUseContext *s, int jobnr, int y, int x) {}
+static int await_progress(PaletteUseContext *s, int jobnr, int y, int x) { return INT_MAX; }
+#endif
+
+/**
+ * Map the pixels of one job to the palette.
+ *
+ * Without error diffusion, each job dithers a band of rows. With error
+ * diffusion, job jobnr dithers the rows y_start + jobnr + k * nb_jobs, and
+ * every pixel waits until the row above, which diffuses its error into the
+ * pixel's neighbourhood, has moved far enough ahead of it. All the error
+ * updates then happen in the same order as when dithering the whole window in
+ * one go, so the output does not depend on the number of jobs.
+ */
 static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFrame *in,
                                       int x_start, int y_start, int w, int h,
+                                      int jobnr, int nb_jobs,
                                       enum dithering_mode dither,
                                       const enum color_search_method search_method)
 {
-    int x, y;
+    int x, y, y_first, y_step, ret = 0;
     const int src_linesize = in ->linesize[0] >> 2;
     const int dst_linesize = out->linesize[0];
-    uint32_t *src = ((uint32_t *)in ->data[0]) + y_start*src_linesize;
-    uint8_t  *dst =              out->data[0]  + y_start*dst_linesize;
+    struct cache_node *cache = s->cache + jobnr * CACHE_SIZE;
+    const int diffusion = dither != DITHERING_NONE && dither != DITHERING_BAYER;
+    /* farthest column of the next row an error is diffused into */
+    const int reach = dither == DITHERING_SIERRA2 ? 2 : 1;
+    const int sync = diffusion && nb_jobs > 1;
+    const int prev_job = jobnr ? jobnr - 1 : nb_jobs - 1;
 
     w += x_start;
     h += y_start;
 
-    for (y = y_start; y < h; y++) {
+    if (diffusion) {
+        y_first = y_start + jobnr;
+        y_step  = nb_jobs;
+    } else {
+        const int slice_h = h - y_start;
+        y_first = y_start + (slice_h *  jobnr     ) / nb_jobs;
+        h       = y_start + (slice_h * (jobnr + 1)) / nb_jobs;
+        y_step  = 1;
+    }
+
+    for (y = y_first; y < h; y += y_step) {
+        uint32_t *src = ((uint32_t *)in ->data[0]) + y*src_linesize;
+        uint8_t  *dst =              out->data[0]  + y*dst_linesize;
+        const int wait = sync && y > y_start;
+        int ready = wait ? x_start : w;
+
         for (x = x_start; x < w; x++) {
             int er, eg, eb;
 
+            /* the pixels up to x + reach of this row, and therefore the
+             * errors they diffuse, must be final before dithering x */
+            if (x >= ready)
+                ready = await_progress(s, prev_job, y - 1, FFMIN(x + 2*reach + 1, w)) - 2*reach;
+
             if (dither == DITHERING_BAYER) {
                 const int d = s->ordered_dither[(y & 7)<<3 | (x & 7)];
                 const uint8_t a8 = src[x] >> 24 & 0xff;
@@ -418,7 +552,8 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
                 const uint8_t r = av_clip_uint8(r8 + d);
                 const uint8_t g = av_clip_uint8(g8 + d);
                 const uint8_t b = av_clip_uint8(b8 + d);
-                const int color = color_get(s, src[x], a8, r, g, b, search_method);
+                const uint32_t c = (uint32_t)a8 << 24 | r << 16 | g << 8 | b;
+                const int color = color_get(s, cache, c, a8, r, g, b, search_method);
 
                 if (color < 0)
                     return color;
@@ -426,10 +561,12 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_HECKBERT) {
                 const int right = x < w - 1, down = y < h - 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
-                if (color < 0)
-                    return color;
+                if (color < 0) {
+                    ret = color;
+                    goto fail;
+                }
                 dst[x] = color;
 
                 if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 3, 3);
@@ -438,10 +575,12 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_FLOYD_STEINBERG) {
                 const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
-                if (color < 0)
-                    return color;
+                if (color < 0) {
+                    ret = color;
+                    goto fail;
+                }
                 dst[x] = color;
 
                 if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 7, 4);
@@ -452,10 +591,12 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
             } else if (dither == DITHERING_SIERRA2) {
                 const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
                 const int right2 = x < w - 2,                    left2 = x > x_start + 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
-                if (color < 0)
-                    return color;
+                if (color < 0) {
+                    ret = color;
+                    goto fail;
+                }
                 dst[x] = color;
 
                 if (right)          src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 4, 4);
@@ -471,10 +612,12 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_SIERRA2_4A) {
                 const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
-                if (color < 0)
-                    return color;
+                if (color < 0) {
+                    ret = color;
+                    goto fail;
+                }
                 dst[x] = color;
 
                 if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 2, 2);
@@ -486,19 +629,65 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
                 const uint8_t r = src[x] >> 16 & 0xff;
                 const uint8_t g = src[x] >>  8 & 0xff;
                 const uint8_t b = src[x]       & 0xff;
-                const int color = color_get(s, src[x], a, r, g, b, search_method);
+                const int color = color_get(s, cache, src[x], a, r, g, b, search_method);
 
                 if (color < 0)
                     return color;
                 dst[x] = color;
             }
+
+            if (sync && !((x + 1 - x_start) % PROGRESS_STEP))
+                report_progress(s, jobnr, y, x + 1);
         }
-        src += src_linesize;
-        dst += dst_linesize;
+        if (sync)
+            report_progress(s, jobnr, y, w);
     }
     return 0;
+
+fail:
+    /* do not leave the jobs below waiting for rows which will not come */
+    if (sync)
+        for (; y < h; y += y_step)
+            report_progress(s, jobnr, y, INT_MAX);
+    return ret;
+}
+
+#define DEFINE_SET_FRAME(color_search, name, value)                             \
+static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,    \
+                            int x_start, int y_start, int w, int h,             \
+                            int jobnr, int nb_jobs)                             \
+{                                                                               \
+    return set_frame(s, out, in, x_start, y_start, w, h, jobnr, nb_jobs,        \
+                     value, color_search);                                      \
 }
 
+#define DEFINE_SET_FRAME_COLOR_SEARCH(color_search, color_search_macro)                                 \
+    DEFINE_SET_FRAME(color_search_macro, color_search##_##none,            DITHERING_NONE)              \
+    DEFINE_SET_FRAME(color_search_macro, color_search##_##bayer,           DITHERING_BAYER)             \
+    DEFINE_SET_FRAME(color_search_macro, color_search##_##heckbert,        DITHERING_HECKBERT)          \
+    DEFINE_SET_FRAME(color_search_macro, color_search##_##floyd_steinberg, DITHERING_FLOYD_STEINBERG)   \
+    DEFINE_SET_FRAME(color_search_macro, color_search##_##sierra2,         DITHERING_SIERRA2)           \
+    DEFINE_SET_FRAME(color_search_macro, color_search##_##sierra2_4a,      DITHERING_SIERRA2_4A)        \
+
+DEFINE_SET_FRAME_COLOR_SEARCH(nns_iterative, COLOR_SEARCH_NNS_ITERATIVE)
+DEFINE_SET_FRAME_COLOR_SEARCH(nns_recursive, COLOR_SEARCH_NNS_RECURSIVE)
+DEFINE_SET_FRAME_COLOR_SEARCH(bruteforce,    COLOR_SEARCH_BRUTEFORCE)
+
+#define DITHERING_ENTRIES(color_search) {       \
+    set_frame_##color_search##_none,            \
+    set_frame_##color_search##_bayer,           \
+    set_frame_##color_search##_heckbert,        \
+    set_frame_##color_search##_floyd_steinberg, \
+    set_frame_##color_search##_sierra2,         \
+    set_frame_##color_search##_sierra2_4a,      \
+}
+
+static const set_frame_func set_frame_lut[NB_COLOR_SEARCHES][NB_DITHERING] = {
+    DITHERING_ENTRIES(nns_iterative),
+    DITHERING_ENTRIES(nns_recursive),
+    DITHERING_ENTRIES(bruteforce),
+};
+
 #define INDENT 4
 static void disp_node(AVBPrint *buf,
                       const struct color_node *map,
@@ -554,16 +743,17 @@ static int disp_tree(const struct color_node *node, const char *fname)
     return 0;
 }
 
-static int debug_accuracy(const struct color_node *node, const uint32_t *palette, const int trans_thresh,
-                          const enum color_search_method search_method)
+static int debug_accuracy(const PaletteUseContext *s, const enum color_search_method search_method)
 {
     int r, g, b, ret = 0;
+    const uint32_t *palette = s->palette;
+    const int trans_thresh = s->trans_thresh;
 
     for (r = 0; r < 256; r++) {
         for (g = 0; g < 256; g++) {
             for (b = 0; b < 256; b++) {
                 const uint8_t argb[] = {0xff, r, g, b};
-                const int r1 = COLORMAP_NEAREST(search_method, palette, node, argb, trans_thresh);
+                const int r1 = COLORMAP_NEAREST(s, search_method, argb);
                 const int r2 = colormap_nearest_bruteforce(palette, argb, trans_thresh);
                 if (r1 != r2) {
                     const uint32_t c1 = palette[r1];
@@ -748,6 +938,7 @@ static void load_colormap(PaletteUseContext *s)
         }
     }
 
+    s->nb_pal_colors = 0;
     for (i = 0; i < AVPALETTE_COUNT; i++) {
         const uint32_t c = s->palette[i];
         if (i != 0 && c == last_color) {
@@ -759,6 +950,15 @@ static void load_colormap(PaletteUseContext *s)
             color_used[i] = 1; // ignore transparent color(s)
             continue;
         }
+        s->pal_rg[s->nb_pal_colors]  = (c >> 16 & 0xff) | (c & 0xff00) << 8;
+        s->pal_b[s->nb_pal_colors]   =  c       & 0xff;
+        s->pal_ids[s->nb_pal_colors] = i;
+        s->nb_pal_colors++;
+    }
+    s->nb_pal_entries = FFALIGN(s->nb_pal_colors, PALETTEUSE_PAL_ALIGN);
+    for (i = s->nb_pal_colors; i < s->nb_pal_entries; i++) {
+        s->pal_rg[i] = PALETTEUSE_PAL_PAD | PALETTEUSE_PAL_PAD << 16;
+        s->pal_b[i]  = PALETTEUSE_PAL_PAD;
     }
 
     box.min[0] = box.min[1] = box.min[2] = 0x00;
@@ -770,7 +970,7 @@ static void load_colormap(PaletteUseContext *s)
         disp_tree(s->map, s->dot_filename);
 
     if (s->debug_accuracy) {
-        if (!debug_accuracy(s->map, s->palette, s->trans_thresh, s->color_search_method))
+        if (!debug_accuracy(s, s->color_search_method))
             av_log(NULL, AV_LOG_INFO, "Accuracy check passed\n");
     }
 }
@@ -894,9 +1094,24 @@ static void set_processing_window(enum diff_mode diff_mode,
     *hp = height;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int x, y, w, h;
+} ThreadData;
+
+static int set_frame_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+    ThreadData *td = arg;
+
+    return s->set_frame(s, td->out, td->in, td->x, td->y, td->w, td->h,
+                        jobnr, nb_jobs);
+}
+
 static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
 {
-    int x, y, w, h, ret;
+    int i, x, y, w, h, nb_jobs, ret = 0;
+    ThreadData td;
     AVFilterContext *ctx = inlink->dst;
     PaletteUseContext *s = ctx->priv;
     AVFilterLink *outlink = inlink->dst->outputs[0];
@@ -926,7 +1141,27 @@ static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
     ff_dlog(ctx, "%dx%d rect: (%d;%d) -> (%d,%d) [area:%dx%d]\n",
             w, h, x, y, x+w, y+h, in->width, in->height);
 
-    ret = s->set_frame(s, out, in, x, y, w, h);
+    nb_jobs = FFMIN(s->nb_jobs, h);
+    if (s->dither != DITHERING_NONE && s->dither != DITHERING_BAYER) {
+        if (!s->pipeline)
+            nb_jobs = 1;
+#if HAVE_THREADS
+        else
+            for (i = y; i < y + h; i++)
+                atomic_init(&s->row_progress[i], 0);
+#endif
+    }
+
+    td.in  = in;
+    td.out = out;
+    td.x   = x;
+    td.y   = y;
+    td.w   = w;
+    td.h   = h;
+    ctx->internal->execute(ctx, set_frame_slice, &td, s->job_rets, nb_jobs);
+    for (i = 0; i < nb_jobs; i++)
+        if (s->job_rets[i] < 0)
+            ret = s->job_rets[i];
     if (ret < 0) {
         av_frame_free_xij(&out);
         *outf = NULL;
@@ -940,9 +1175,76 @@ static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
     return 0;
 }
 
+static void free_caches(PaletteUseContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_caches * CACHE_SIZE; i++) {
+        av_freep(&s->cache[i].entries);
+        s->cache[i].nb_entries = 0;
+    }
+}
+
+static void free_jobs(PaletteUseContext *s)
+{
+    free_caches(s);
+    av_freep(&s->cache);
+    s->nb_caches = 0;
+    av_freep(&s->job_rets);
+#if HAVE_THREADS
+    if (s->pipeline) {
+        int i;
+
+        for (i = 0; i < s->nb_jobs; i++) {
+            pthread_mutex_destroy(&s->progress_mutex[i]);
+            pthread_cond_destroy(&s->progress_cond[i]);
+        }
+    }
+    av_freep(&s->progress_mutex);
+    av_freep(&s->progress_cond);
+    av_freep(&s->row_progress);
+#endif
+    s->pipeline = 0;
+}
+
+static int alloc_jobs(AVFilterContext *ctx, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+
+    free_jobs(s);
+    s->nb_jobs = nb_jobs;
+
+    s->cache    = av_calloc(nb_jobs * CACHE_SIZE, sizeof(*s->cache));
+    s->job_rets = av_calloc(nb_jobs, sizeof(*s->job_rets));
+    if (!s->cache || !s->job_rets)
+        return AVERROR(ENOMEM);
+    s->nb_caches = nb_jobs;
+
+#if HAVE_THREADS
+    /* The error diffusion rows wait for each other, so their jobs must all
+     * run at the same time, which only the graph's own slice threads, with at
+     * most one job per thread, guarantee. */
+    if (nb_jobs > 1 && !ctx->graph->execute) {
+        int i;
+
+        s->row_progress   = av_calloc(ctx->outputs[0]->h, sizeof(*s->row_progress));
+        s->progress_mutex = av_calloc(nb_jobs, sizeof(*s->progress_mutex));
+        s->progress_cond  = av_calloc(nb_jobs, sizeof(*s->progress_cond));
+        if (!s->row_progress || !s->progress_mutex || !s->progress_cond)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < nb_jobs; i++) {
+            pthread_mutex_init(&s->progress_mutex[i], NULL);
+            pthread_cond_init(&s->progress_cond[i], NULL);
+        }
+        s->pipeline = 1;
+    }
+#endif
+    return 0;
+}
+
 static int config_output(AVFilterLink *outlink)
 {
-    int ret;
+    int ret, nb_jobs;
     AVFilterContext *ctx = outlink->src;
     PaletteUseContext *s = ctx->priv;
 
@@ -959,7 +1261,13 @@ static int config_output(AVFilterLink *outlink)
     outlink->time_base = ctx->inputs[0]->time_base;
     if ((ret = ff_framesync_configure(&s->fs)) < 0)
         return ret;
-    return 0;
+
+    /* Each job has a color cache of its own. Without slice threads the jobs
+     * would run one after the other, so use a single one. */
+    nb_jobs = 1;
+    if (ctx->thread_type & AVFILTER_THREAD_SLICE)
+        nb_jobs = FFMAX(FFMIN(ff_filter_get_nb_threads(ctx), outlink->h), 1);
+    return alloc_jobs(ctx, nb_jobs);
 }
 
 static int config_input_palette(AVFilterLink *inlink)
@@ -988,9 +1296,7 @@ static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
     if (s->new) {
         memset(s->palette, 0, sizeof(s->palette));
         memset(s->map, 0, sizeof(s->map));
-        for (i = 0; i < CACHE_SIZE; i++)
-            av_freep(&s->cache[i].entries);
-        memset(s->cache, 0, sizeof(s->cache));
+        free_caches(s);
     }
 
     i = 0;
@@ -1040,40 +1346,6 @@ error:
     return ret;
 }
 
-#define DEFINE_SET_FRAME(color_search, name, value)                             \
-static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,    \
-                            int x_start, int y_start, int w, int h)             \
-{                                                                               \
-    return set_frame(s, out, in, x_start, y_start, w, h, value, color_search);  \
-}
-
-#define DEFINE_SET_FRAME_COLOR_SEARCH(color_search, color_search_macro)                                 \
-    DEFINE_SET_FRAME(color_search_macro, color_search##_##none,            DITHERING_NONE)              \
-    DEFINE_SET_FRAME(color_search_macro, color_search##_##bayer,           DITHERING_BAYER)             \
-    DEFINE_SET_FRAME(color_search_macro, color_search##_##heckbert,        DITHERING_HECKBERT)          \
-    DEFINE_SET_FRAME(color_search_macro, color_search##_##floyd_steinberg, DITHERING_FLOYD_STEINBERG)   \
-    DEFINE_SET_FRAME(color_search_macro, color_search##_##sierra2,         DITHERING_SIERRA2)           \
-    DEFINE_SET_FRAME(color_search_macro, color_search##_##sierra2_4a,      DITHERING_SIERRA2_4A)        \
-
-DEFINE_SET_FRAME_COLOR_SEARCH(nns_iterative, COLOR_SEARCH_NNS_ITERATIVE)
-DEFINE_SET_FRAME_COLOR_SEARCH(nns_recursive, COLOR_SEARCH_NNS_RECURSIVE)
-DEFINE_SET_FRAME_COLOR_SEARCH(bruteforce,    COLOR_SEARCH_BRUTEFORCE)
-
-#define DITHERING_ENTRIES(color_search) {       \
-    set_frame_##color_search##_none,            \
-    set_frame_##color_search##_bayer,           \
-    set_frame_##color_search##_heckbert,        \
-    set_frame_##color_search##_floyd_steinberg, \
-    set_frame_##color_search##_sierra2,         \
-    set_frame_##color_search##_sierra2_4a,      \
-}
-
-static const set_frame_func set_frame_lut[NB_COLOR_SEARCHES][NB_DITHERING] = {
-    DITHERING_ENTRIES(nns_iterative),
-    DITHERING_ENTRIES(nns_recursive),
-    DITHERING_ENTRIES(bruteforce),
-};
-
 static int dither_value(int p)
 {
     const int q = p ^ (p >> 3);
@@ -1087,6 +1359,7 @@ static av_cold int init(AVFilterContext *ctx)
     PaletteUseContext *s = ctx->priv;
 
     s->set_frame = set_frame_lut[s->color_search_method][s->dither];
+    ff_paletteuse_init(&s->dsp);
 
     if (s->dither == DITHERING_BAYER) {
         int i;
@@ -1107,12 +1380,10 @@ static int activate(AVFilterContext *ctx)
 
 static av_cold void uninit(AVFilterContext *ctx)
 {
-    int i;
     PaletteUseContext *s = ctx->priv;
 
     ff_framesync_uninit(&s->fs);
-    for (i = 0; i < CACHE_SIZE; i++)
-        av_freep(&s->cache[i].entries);
+    free_jobs(s);
     av_frame_free_xij(&s->last_in);
     av_frame_free_xij(&s->last_out);
 }
@@ -1149,4 +1420,5 @@ AVFilter ff_vf_paletteuse = {
     .inputs        = paletteuse_inputs,
     .outputs       = paletteuse_outputs,
     .priv_class    = &paletteuse_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -54,6 +54,7 @@ typedef struct PSNRContext {
     int planewidth[4];
     int planeheight[4];
     double planeweight[4];
+    uint64_t (*score)[4];       ///< sum of squared errors of each plane, per job
     PSNRDSPContext dsp;
 } PSNRContext;
 
@@ -104,29 +105,37 @@ static uint64_t sse_line_16bit(const uint8_t *_main_line, const uint8_t *_ref_li
     return m2;
 }
 
-static inline
-void compute_images_mse(PSNRContext *s,
-                        const uint8_t *main_data[4], const int main_linesizes[4],
-                        const uint8_t *ref_data[4], const int ref_linesizes[4],
-                        int w, int h, double mse[4])
+typedef struct ThreadData {
+    AVFrame *master, *ref;
+} ThreadData;
+
+/* The sums are integers, so adding up the slices gives the same mse as a
+ * single pass over the frame. */
+static int compute_images_sse(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    PSNRContext *s = ctx->priv;
+    ThreadData *td = arg;
     int i, c;
 
     for (c = 0; c < s->nb_components; c++) {
         const int outw = s->planewidth[c];
         const int outh = s->planeheight[c];
-        const uint8_t *main_line = main_data[c];
-        const uint8_t *ref_line = ref_data[c];
-        const int ref_linesize = ref_linesizes[c];
-        const int main_linesize = main_linesizes[c];
+        const int slice_start = (outh *  jobnr     ) / nb_jobs;
+        const int slice_end   = (outh * (jobnr + 1)) / nb_jobs;
+        const int ref_linesize = td->ref->linesize[c];
+        const int main_linesize = td->master->linesize[c];
+        const uint8_t *main_line = td->master->data[c] + slice_start * main_linesize;
+        const uint8_t *ref_line = td->ref->data[c] + slice_start * ref_linesize;
         uint64_t m = 0;
-        for (i = 0; i < outh; i++) {
+        for (i = slice_start; i < slice_end; i++) {
             m += s->dsp.sse_line(main_line, ref_line, outw);
             ref_line += ref_linesize;
             main_line += main_linesize;
         }
-        mse[c] = m / (double)(outw * outh);
+        s->score[jobnr][c] = m;
     }
+
+    return 0;
 }
 
 static void set_meta(AVDictionary **metadata, const char *key, char comp, float d)
@@ -147,8 +156,9 @@ static int do_psnr(FFFrameSync *fs)
     AVFilterContext *ctx = fs->parent;
     PSNRContext *s = ctx->priv;
     AVFrame *master, *ref;
+    ThreadData td;
     double comp_mse[4], mse = 0;
-    int ret, j, c;
+    int ret, j, c, nb_jobs;
     AVDictionary **metadata;
 
     ret = ff_framesync_dualinput_get(fs, &master, &ref);
@@ -158,9 +168,17 @@ static int do_psnr(FFFrameSync *fs)
         return ff_filter_frame(ctx->outputs[0], master);
     metadata = &master->metadata;
 
-    compute_images_mse(s, (const uint8_t **)master->data, master->linesize,
-                          (const uint8_t **)ref->data, ref->linesize,
-                          master->width, master->height, comp_mse);
+    td.master = master;
+    td.ref    = ref;
+    nb_jobs = FFMIN(s->planeheight[1], ff_filter_get_nb_threads(ctx));
+    ctx->internal->execute(ctx, compute_images_sse, &td, NULL, nb_jobs);
+
+    for (c = 0; c < s->nb_components; c++) {
+        uint64_t m = 0;
+        for (j = 0; j < nb_jobs; j++)
+            m += s->score[j][c];
+        comp_mse[c] = m / (double)(s->planewidth[c] * s->planeheight[c]);
+    }
 
     for (j = 0; j < s->nb_components; j++)
         mse += comp_mse[j] * s->planeweight[j];
@@ -325,6 +343,11 @@ static int config_input_ref(AVFilterLink *inlink)
     }
     s->average_max = lrint(average_max);
 
+    av_freep(&s->score);
+    s->score = av_calloc(ff_filter_get_nb_threads(ctx), sizeof(*s->score));
+    if (!s->score)
+        return AVERROR(ENOMEM);
+
     s->dsp.sse_line = desc->comp[0].depth > 8 ? sse_line_16bit : sse_line_8bit;
     if (ARCH_X86)
         ff_psnr_init_x86(&s->dsp, desc->comp[0].depth);
@@ -381,6 +404,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     }
 
     ff_framesync_uninit(&s->fs);
+    av_freep(&s->score);
 
     if (s->stats_file && s->stats_file != stdout)
         fclose(s->stats_file);
@@ -419,4 +443,5 @@ AVFilter ff_vf_psnr = {
     .priv_class    = &psnr_class,
     .inputs        = psnr_inputs,
     .outputs       = psnr_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
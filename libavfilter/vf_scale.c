@@ -217,6 +217,26 @@ static const int *parse_yuv_type(const char *s, enum AVColorSpace colorspace)
     return sws_getCoefficients(colorspace);
 }
 
+typedef struct SwsJob {
+    int (*func)(void *arg, int jobnr, int nb_jobs);
+    void *arg;
+} SwsJob;
+
+static int sws_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SwsJob *job = arg;
+    return job->func(job->arg, jobnr, nb_jobs);
+}
+
+static int sws_execute(void *opaque, int (*func)(void *arg, int jobnr, int nb_jobs),
+                       void *arg, int nb_jobs)
+{
+    AVFilterContext *ctx = opaque;
+    SwsJob job = { func, arg };
+
+    return ctx->internal->execute(ctx, sws_job, &job, NULL, nb_jobs);
+}
+
 static int config_props(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -299,6 +319,13 @@ static int config_props(AVFilterLink *outlink)
             av_opt_set_int(*s, "sws_flags", scale->flags, 0);
             av_opt_set_int(*s, "param0", scale->param[0], 0);
             av_opt_set_int(*s, "param1", scale->param[1], 0);
+            /* libswscale splits the frame into bands itself, with the
+             * source lines each band's filters need, and runs them on the
+             * threads of the graph; the fields already run in parallel */
+            if (!i) {
+                av_opt_set_int(*s, "threads", ff_filter_get_nb_threads(ctx), 0);
+                sws_set_execute_xij(*s, sws_execute, ctx);
+            }
             if (scale->in_range != AVCOL_RANGE_UNSPECIFIED)
                 av_opt_set_int(*s, "src_range",
                                scale->in_range == AVCOL_RANGE_JPEG, 0);
@@ -400,6 +427,20 @@ static int scale_slice(AVFilterLink *link, AVFrame *out_buf, AVFrame *cur_pic, s
                          out,out_stride);
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int scale_field(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ScaleContext *scale = ctx->priv;
+    AVFilterLink *link = ctx->inputs[0];
+    ThreadData *td = arg;
+
+    return scale_slice(link, td->out, td->in, scale->isws[jobnr], 0,
+                       (link->h + !jobnr) / 2, 2, jobnr);
+}
+
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     ScaleContext *scale = link->dst->priv;
@@ -505,8 +546,8 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
               INT_MAX);
 
     if(scale->interlaced>0 || (scale->interlaced<0 && in->interlaced_frame)){
-        scale_slice(link, out, in, scale->isws[0], 0, (link->h+1)/2, 2, 0);
-        scale_slice(link, out, in, scale->isws[1], 0,  link->h   /2, 2, 1);
+        ThreadData td = { .in = in, .out = out };
+        link->dst->internal->execute(link->dst, scale_field, &td, NULL, 2);
     }else if (scale->nb_slices) {
         int i, slice_h, slice_start, slice_end = 0;
         const int nb_slices = FFMIN(scale->nb_slices, link->h);
@@ -639,6 +680,7 @@ AVFilter ff_vf_scale = {
     .inputs          = avfilter_vf_scale_inputs,
     .outputs         = avfilter_vf_scale_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
 
 static const AVClass scale2ref_class = {
@@ -691,4 +733,5 @@ AVFilter ff_vf_scale2ref = {
     .inputs          = avfilter_vf_scale2ref_inputs,
     .outputs         = avfilter_vf_scale2ref_outputs,
     .process_command = process_command,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
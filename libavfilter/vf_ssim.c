@@ -59,13 +59,15 @@ typedef struct SSIMContext {
     uint8_t rgba_map[4];
     int planewidth[4];
     int planeheight[4];
-    int *temp;
+    uint8_t *temp;              ///< block sums of two rows, temp_size bytes per job
+    int temp_size;
+    float *row_ssim[4];         ///< ssim of each row of 4x4 blocks of each plane
     int is_rgb;
-    float (*ssim_plane)(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max);
+    void (*ssim_plane)(SSIMDSPContext *dsp,
+                       uint8_t *main, int main_stride,
+                       uint8_t *ref, int ref_stride,
+                       int width, void *temp, int max,
+                       float *row_ssim, int row_start, int row_end);
     SSIMDSPContext dsp;
 } SSIMContext;
 
@@ -221,21 +223,19 @@ static float ssim_endn_8bit(const int (*sum0)[4], const int (*sum1)[4], int widt
 
 #define SUM_LEN(w) (((w) >> 2) + 3)
 
-static float ssim_plane_16bit(SSIMDSPContext *dsp,
-                              uint8_t *main, int main_stride,
-                              uint8_t *ref, int ref_stride,
-                              int width, int height, void *temp,
-                              int max)
+static void ssim_plane_16bit(SSIMDSPContext *dsp,
+                             uint8_t *main, int main_stride,
+                             uint8_t *ref, int ref_stride,
+                             int width, void *temp, int max,
+                             float *row_ssim, int row_start, int row_end)
 {
-    int z = 0, y;
-    float ssim = 0.0;
+    int z = row_start - 1, y;
     int64_t (*sum0)[4] = temp;
     int64_t (*sum1)[4] = sum0 + SUM_LEN(width);
 
     width >>= 2;
-    height >>= 2;
 
-    for (y = 1; y < height; y++) {
+    for (y = row_start; y < row_end; y++) {
         for (; z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
             ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
@@ -243,27 +243,23 @@ static float ssim_plane_16bit(SSIMDSPContext *dsp,
                              sum0, width);
         }
 
-        ssim += ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
+        row_ssim[y] = ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
     }
-
-    return ssim / ((height - 1) * (width - 1));
 }
 
-static float ssim_plane(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max)
+static void ssim_plane(SSIMDSPContext *dsp,
+                       uint8_t *main, int main_stride,
+                       uint8_t *ref, int ref_stride,
+                       int width, void *temp, int max,
+                       float *row_ssim, int row_start, int row_end)
 {
-    int z = 0, y;
-    float ssim = 0.0;
+    int z = row_start - 1, y;
     int (*sum0)[4] = temp;
     int (*sum1)[4] = sum0 + SUM_LEN(width);
 
     width >>= 2;
-    height >>= 2;
 
-    for (y = 1; y < height; y++) {
+    for (y = row_start; y < row_end; y++) {
         for (; z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
             dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
@@ -271,10 +267,38 @@ static float ssim_plane(SSIMDSPContext *dsp,
                                sum0, width);
         }
 
-        ssim += dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+        row_ssim[y] = dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+    }
+}
+
+typedef struct ThreadData {
+    AVFrame *master, *ref;
+} ThreadData;
+
+/* Row y of 4x4 blocks is scored from the block sums of rows y - 1 and y, so
+ * every slice recomputes the sums of the row above it. The scores of the
+ * rows are added up in order by the caller, which keeps the float sum the
+ * same as with a single job. */
+static int ssim_plane_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SSIMContext *s = ctx->priv;
+    ThreadData *td = arg;
+    void *temp = s->temp + jobnr * s->temp_size;
+    int i;
+
+    for (i = 0; i < s->nb_components; i++) {
+        const int nb_rows = FFMAX((s->planeheight[i] >> 2) - 1, 0);
+        const int slice_start = 1 + (nb_rows *  jobnr     ) / nb_jobs;
+        const int slice_end   = 1 + (nb_rows * (jobnr + 1)) / nb_jobs;
+
+        if (slice_start < slice_end)
+            s->ssim_plane(&s->dsp, td->master->data[i], td->master->linesize[i],
+                          td->ref->data[i], td->ref->linesize[i],
+                          s->planewidth[i], temp, s->max,
+                          s->row_ssim[i], slice_start, slice_end);
     }
 
-    return ssim / ((height - 1) * (width - 1));
+    return 0;
 }
 
 static double ssim_db(double ssim, double weight)
@@ -288,8 +312,9 @@ static int do_ssim(FFFrameSync *fs)
     SSIMContext *s = ctx->priv;
     AVFrame *master, *ref;
     AVDictionary **metadata;
+    ThreadData td;
     float c[4], ssimv = 0.0;
-    int ret, i;
+    int ret, i, y;
 
     ret = ff_framesync_dualinput_get(fs, &master, &ref);
     if (ret < 0)
@@ -300,11 +325,19 @@ static int do_ssim(FFFrameSync *fs)
 
     s->nb_frames++;
 
+    td.master = master;
+    td.ref    = ref;
+    ctx->internal->execute(ctx, ssim_plane_slice, &td, NULL,
+                           FFMIN(s->planeheight[1], ff_filter_get_nb_threads(ctx)));
+
     for (i = 0; i < s->nb_components; i++) {
-        c[i] = s->ssim_plane(&s->dsp, master->data[i], master->linesize[i],
-                             ref->data[i], ref->linesize[i],
-                             s->planewidth[i], s->planeheight[i], s->temp,
-                             s->max);
+        const int width  = s->planewidth[i]  >> 2;
+        const int height = s->planeheight[i] >> 2;
+        float ssim = 0.0;
+
+        for (y = 1; y < height; y++)
+            ssim += s->row_ssim[i][y];
+        c[i] = ssim / ((height - 1) * (width - 1));
         ssimv += s->coefs[i] * c[i];
         s->ssim[i] += c[i];
     }
@@ -410,9 +443,17 @@ static int config_input_ref(AVFilterLink *inlink)
     for (i = 0; i < s->nb_components; i++)
         s->coefs[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
 
-    s->temp = av_mallocz_array(2 * SUM_LEN(inlink->w), (desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    av_freep(&s->temp);
+    s->temp_size = 2 * SUM_LEN(inlink->w) * ((desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    s->temp = av_mallocz_array(ff_filter_get_nb_threads(ctx), s->temp_size);
     if (!s->temp)
         return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_components; i++) {
+        av_freep(&s->row_ssim[i]);
+        s->row_ssim[i] = av_malloc_array((s->planeheight[i] >> 2) + 1, sizeof(*s->row_ssim[i]));
+        if (!s->row_ssim[i])
+            return AVERROR(ENOMEM);
+    }
     s->max = (1 << desc->comp[0].depth) - 1;
 
     s->ssim_plane = desc->comp[0].depth > 8 ? ssim_plane_16bit : ssim_plane;
@@ -455,10 +496,10 @@ static int activate(AVFilterContext *ctx)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     SSIMContext *s = ctx->priv;
+    int i;
 
     if (s->nb_frames > 0) {
         char buf[256];
-        int i;
         buf[0] = 0;
         for (i = 0; i < s->nb_components; i++) {
             int c = s->is_rgb ? s->rgba_map[i] : i;
@@ -475,6 +516,8 @@ static av_cold void uninit(AVFilterContext *ctx)
         fclose(s->stats_file);
 
     av_freep(&s->temp);
+    for (i = 0; i < 4; i++)
+        av_freep(&s->row_ssim[i]);
 }
 
 static const AVFilterPad ssim_inputs[] = {
@@ -510,4 +553,5 @@ AVFilter ff_vf_ssim = {
     .priv_class    = &ssim_class,
     .inputs        = ssim_inputs,
     .outputs       = ssim_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -31,12 +31,14 @@
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mastering_display_metadata.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 
 #include "avfilter.h"
 #include "formats.h"
 #include "internal.h"
+#include "tonemap.h"
 #include "video.h"
 
 #define REFERENCE_WHITE 100.0f
@@ -76,6 +78,11 @@ typedef struct TonemapContext {
     double peak;
 
     const LumaCoefficients *coeffs;
+
+    TonemapDSPContext dsp;
+    TonemapRowParams row_params;
+    double lut_peak;            ///< peak the LUT was built for, 0 if not built
+    DECLARE_ALIGNED(32, float, lut)[TONEMAP_LUT_SIZE + 2];
 } TonemapContext;
 
 static const enum AVPixelFormat pix_fmts[] = {
@@ -111,6 +118,8 @@ static av_cold int init(AVFilterContext *ctx)
     if (isnan(s->param))
         s->param = 1.0f;
 
+    ff_tonemap_init(&s->dsp);
+
     return 0;
 }
 
@@ -158,38 +167,8 @@ static float mobius(float in, float j, double peak)
     return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
 }
 
-#define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
-static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
-                    const AVPixFmtDescriptor *desc, int x, int y, double peak)
+static float tonemap_curve(TonemapContext *s, float sig, double peak)
 {
-    const float *r_in = (const float *)(in->data[0] + x * desc->comp[0].step + y * in->linesize[0]);
-    const float *b_in = (const float *)(in->data[1] + x * desc->comp[1].step + y * in->linesize[1]);
-    const float *g_in = (const float *)(in->data[2] + x * desc->comp[2].step + y * in->linesize[2]);
-    float *r_out = (float *)(out->data[0] + x * desc->comp[0].step + y * out->linesize[0]);
-    float *b_out = (float *)(out->data[1] + x * desc->comp[1].step + y * out->linesize[1]);
-    float *g_out = (float *)(out->data[2] + x * desc->comp[2].step + y * out->linesize[2]);
-    float sig, sig_orig;
-
-    /* load values */
-    *r_out = *r_in;
-    *b_out = *b_in;
-    *g_out = *g_in;
-
-    /* desaturate to prevent unnatural colors */
-    if (s->desat > 0) {
-        float luma = s->coeffs->cr * *r_in + s->coeffs->cg * *g_in + s->coeffs->cb * *b_in;
-        float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
-        *r_out = MIX(*r_in, luma, overbright);
-        *g_out = MIX(*g_in, luma, overbright);
-        *b_out = MIX(*b_in, luma, overbright);
-    }
-
-    /* pick the brightest component, reducing the value range as necessary
-     * to keep the entire signal in range and preventing discoloration due to
-     * out-of-bounds clipping */
-    sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
-    sig_orig = sig;
-
     switch(s->tonemap) {
     default:
     case TONEMAP_NONE:
@@ -216,17 +195,115 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
         break;
     }
 
-    /* apply the computed scale factor to the color,
-     * linearly to prevent discoloration */
-    *r_out *= sig / sig_orig;
-    *g_out *= sig / sig_orig;
-    *b_out *= sig / sig_orig;
+    return sig;
+}
+
+/* sample the gain curve(sig) / sig at sig = peak * t / (1 - t), the last
+ * two entries stand for signals far above the peak */
+static void build_lut(TonemapContext *s, double peak)
+{
+    int i;
+
+    for (i = 0; i < TONEMAP_LUT_SIZE + 2; i++) {
+        double t = FFMIN(i, TONEMAP_LUT_SIZE - 1.0 / 64) / TONEMAP_LUT_SIZE;
+        float sig = FFMAX(peak * t / (1 - t), 1e-6);
+
+        s->lut[i] = tonemap_curve(s, sig, peak) / sig;
+    }
+    s->lut_peak = peak;
+}
+
+static int tonemap_row_c(float *const dst[3], const float *const src[3],
+                         const float *lut, const TonemapRowParams *p, int w)
+{
+    int x;
+
+    for (x = 0; x < w; x++) {
+        float v0 = src[0][x], v1 = src[1][x], v2 = src[2][x];
+        float sig, t, gain;
+        int i;
+
+        /* desaturate to prevent unnatural colors */
+        if (p->desat > 0) {
+            float luma = p->coeffs[0] * v0 + p->coeffs[1] * v1 + p->coeffs[2] * v2;
+            float overbright = FFMAX(luma - p->desat, 1e-6f) / FFMAX(luma, 1e-6f);
+            v0 += (luma - v0) * overbright;
+            v1 += (luma - v1) * overbright;
+            v2 += (luma - v2) * overbright;
+        }
+
+        /* pick the brightest component, reducing the value range as necessary
+         * to keep the entire signal in range and preventing discoloration due to
+         * out-of-bounds clipping */
+        sig = FFMAX(FFMAX3(v0, v1, v2), 1e-6f);
+
+        /* interpolate the gain, NaN and infinite signals end up at the top */
+        t = sig / (sig + p->peak) * TONEMAP_LUT_SIZE;
+        t = t < TONEMAP_LUT_SIZE ? t : TONEMAP_LUT_SIZE;
+        i = t;
+        gain = lut[i] + (lut[i + 1] - lut[i]) * (t - i);
+
+        /* apply the computed scale factor to the color,
+         * linearly to prevent discoloration */
+        dst[0][x] = v0 * gain;
+        dst[1][x] = v1 * gain;
+        dst[2][x] = v2 * gain;
+    }
+
+    return w;
+}
+
+av_cold void ff_tonemap_init(TonemapDSPContext *dsp)
+{
+    dsp->tonemap_row = tonemap_row_c;
+
+    if (ARCH_X86)
+        ff_tonemap_init_x86(dsp);
+}
+
+typedef struct ThreadData {
+    AVFrame *in, *out;
+} ThreadData;
+
+static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    TonemapContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const AVFrame *in = td->in;
+    AVFrame *out = td->out;
+    const int slice_start = (out->height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (out->height * (jobnr + 1)) / nb_jobs;
+    int y, p;
+
+    for (y = slice_start; y < slice_end; y++) {
+        float *dst[3];
+        const float *src[3];
+        int n;
+
+        for (p = 0; p < 3; p++) {
+            dst[p] = (float *)(out->data[p] + y * out->linesize[p]);
+            src[p] = (const float *)(in->data[p] + y * in->linesize[p]);
+        }
+
+        n = s->dsp.tonemap_row(dst, src, s->lut, &s->row_params, out->width);
+        if (n < out->width) {
+            for (p = 0; p < 3; p++) {
+                dst[p] += n;
+                src[p] += n;
+            }
+            tonemap_row_c(dst, src, s->lut, &s->row_params, out->width - n);
+        }
+    }
+
+    return 0;
 }
 
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
-    TonemapContext *s = link->dst->priv;
-    AVFilterLink *outlink = link->dst->outputs[0];
+    AVFilterContext *ctx = link->dst;
+    TonemapContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    ThreadData td;
     AVFrame *out;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     const AVPixFmtDescriptor *odesc = av_pix_fmt_desc_get(outlink->format);
@@ -264,6 +341,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         av_log(s, AV_LOG_DEBUG, "Computed signal peak: %f\n", peak);
     }
 
+    /* the tone curve only depends on the peak once the filter is set up */
+    if (peak != s->lut_peak)
+        build_lut(s, peak);
+
     /* load original color space even if pixel format is RGB to compute overbrights */
     s->coeffs = &luma_coefficients[in->colorspace];
     if (s->desat > 0 && (in->colorspace == AVCOL_SPC_UNSPECIFIED || !s->coeffs)) {
@@ -276,10 +357,17 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         s->desat = 0;
     }
 
+    s->row_params.coeffs[0] = s->coeffs->cr;
+    s->row_params.coeffs[1] = s->coeffs->cb;
+    s->row_params.coeffs[2] = s->coeffs->cg;
+    s->row_params.desat     = s->desat;
+    s->row_params.peak      = peak;
+
     /* do the tone map */
-    for (y = 0; y < out->height; y++)
-        for (x = 0; x < out->width; x++)
-            tonemap(s, out, in, desc, x, y, peak);
+    td.in  = in;
+    td.out = out;
+    ctx->internal->execute(ctx, tonemap_slice, &td, NULL,
+                           FFMIN(out->height, ff_filter_get_nb_threads(ctx)));
 
     /* copy/generate alpha if needed */
     if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
@@ -351,4 +439,5 @@ AVFilter ff_vf_tonemap = {
     .priv_class      = &tonemap_class,
     .inputs          = tonemap_inputs,
     .outputs         = tonemap_outputs,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
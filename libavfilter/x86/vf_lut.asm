@@ -0,0 +1,86 @@
+;*****************************************************************************
+;* x86-optimized functions for lut filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;*****************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pb_16: times 32 db 16
+pb_80: times 32 db 0x80
+
+SECTION .text
+
+; Look up the values of one half of the table, the one of the samples whose
+; index in %1 is below 128, and XOR them into m2. The index goes down by 16
+; for each row, with signed saturation so that it stays negative, and the
+; shuffle gives 0, once it is below the row.
+; %1 index, %2 first row of the half
+%macro LOOKUP_HALF 2
+%assign %%i 0
+%rep 8
+%if cpuflag(avx2)
+    vbroadcasti128  m4, [tabq + 256 + (%2 + %%i) * 16]
+%else
+    mova            m4, [tabq + 256 + (%2 + %%i) * 16]
+%endif
+    pshufb          m4, %1
+    pxor            m2, m4
+%if %%i < 7
+    psubsb          %1, m3
+%endif
+%assign %%i %%i+1
+%endrep
+%endmacro
+
+;------------------------------------------------------------------------------
+; int ff_lut_row8(uint8_t *dst, const uint8_t *src, const LUTTable8 *tab, int w)
+;------------------------------------------------------------------------------
+
+%macro LUT_ROW8 0
+cglobal lut_row8, 4, 5, 6, dst, src, tab, w, x
+    mova            m3, [pb_16]
+    mova            m5, [pb_80]
+    and             wd, ~(mmsize - 1)
+    jz .end
+    xor             xd, xd
+
+.loop:
+    movu            m0, [srcq + xq]
+    pxor            m1, m0, m5          ; samples from 128 as the index of the upper half
+    pxor            m2, m2
+    LOOKUP_HALF     m0, 0
+    LOOKUP_HALF     m1, 8
+    movu   [dstq + xq], m2
+    add             xd, mmsize
+    cmp             xd, wd
+    jl .loop
+
+.end:
+    mov            eax, wd
+    RET
+%endmacro
+
+INIT_XMM ssse3
+LUT_ROW8
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+LUT_ROW8
+%endif
@@ -0,0 +1,139 @@
+;*****************************************************************************
+;* x86-optimized functions for overlay filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;*****************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pw_128:  times 16 dw 128
+pw_255:  times 16 dw 255
+pw_257:  times 16 dw 257
+pw_m128: times 16 dw -128
+
+SECTION .text
+
+;------------------------------------------------------------------------------
+; int ff_overlay_row_<alpha>[_pm[_uv]](uint8_t *d, const uint8_t *s,
+;                                      const uint8_t *a, int w,
+;                                      ptrdiff_t alinesize)
+;
+; Blend mmsize/2 pixels per iteration, the remaining w % (mmsize/2) pixels are
+; left to the caller. All arithmetic is done on words and matches the C code,
+; FAST_DIV255(x) = ((x + 128) * 257) >> 16 being a pmulh by 257.
+;------------------------------------------------------------------------------
+
+; %1 alpha: 44 one alpha per pixel, 22 average of 2x1, 20 average of 2x2
+; %2 blend: 0 straight, 1 premultiplied, 2 premultiplied chroma (around 128)
+; %3 function name suffix
+%macro OVERLAY_ROW 2-3
+cglobal overlay_row_%1%3, 5, 6, 8, d, s, a, w, alinesize, x
+    and            wd, -mmsize/2
+    jz .end
+%if %1 == 20
+    add    alinesizeq, aq
+%endif
+    mova           m5, [pw_255]
+    mova           m6, [pw_128]
+    mova           m7, [pw_257]
+    xor            xq, xq
+
+.loop:
+%if %1 == 44
+    pmovzxbw       m2, [aq+xq]
+%else
+    movu           m2, [aq+xq*2]
+    psrlw          m3, m2, 8
+    pand           m2, m5
+%if %1 == 20
+    paddw          m2, m3
+    movu           m3, [alinesizeq+xq*2]
+    psrlw          m4, m3, 8
+    pand           m3, m5
+    paddw          m2, m3
+    paddw          m2, m4
+    psrlw          m2, 2                ; (a[0] + a[1] + a[ls] + a[ls + 1]) >> 2
+%else
+    paddw          m3, m2
+    psrlw          m3, 1
+    paddw          m2, m3
+    psrlw          m2, 1                ; (a[0] + ((a[0] + a[1]) >> 1)) >> 1
+%endif
+%endif
+    pmovzxbw       m0, [dq+xq]
+    pmovzxbw       m1, [sq+xq]
+%if %2 == 0
+    pmullw         m1, m2
+    pxor           m2, m5               ; 255 - alpha
+    pmullw         m0, m2
+    paddw          m0, m1
+    paddw          m0, m6
+    pmulhuw        m0, m7
+%elif %2 == 1
+    pxor           m2, m5
+    pmullw         m0, m2
+    paddw          m0, m6
+    pmulhuw        m0, m7
+    paddw          m0, m1               ; saturated to 255 by packuswb
+%else
+    pxor           m2, m5
+    psubw          m0, m6
+    pmullw         m0, m2
+    paddw          m0, m6
+    pmulhw         m0, m7
+    paddw          m0, m1
+    psubw          m0, m6
+    pmaxsw         m0, [pw_m128]
+    pminsw         m0, m6
+    paddw          m0, m6
+    pand           m0, m5               ; 256 wraps to 0 like the C code
+%endif
+    packuswb       m0, m0
+%if mmsize == 32
+    vpermq         m0, m0, q3120
+    movu      [dq+xq], xm0
+%else
+    movq      [dq+xq], m0
+%endif
+    add            xq, mmsize/2
+    cmp            xq, wq
+    jl .loop
+
+.end:
+    mov           eax, wd
+    RET
+%endmacro
+
+%macro OVERLAY_ROWS 0
+OVERLAY_ROW 44, 0
+OVERLAY_ROW 22, 0
+OVERLAY_ROW 20, 0
+OVERLAY_ROW 44, 1, _pm
+OVERLAY_ROW 44, 2, _pm_uv
+OVERLAY_ROW 22, 2, _pm_uv
+OVERLAY_ROW 20, 2, _pm_uv
+%endmacro
+
+INIT_XMM sse4
+OVERLAY_ROWS
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+OVERLAY_ROWS
+%endif
@@ -0,0 +1,71 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/vf_overlay.h"
+
+#define OVERLAY_ROW_FUNC(name, opt)                                          \
+int ff_overlay_row_ ## name ## _ ## opt(uint8_t *d, const uint8_t *s,        \
+                                        const uint8_t *a, int w,             \
+                                        ptrdiff_t alinesize);
+
+#define OVERLAY_ROW_FUNCS(opt)          \
+    OVERLAY_ROW_FUNC(44,       opt)     \
+    OVERLAY_ROW_FUNC(22,       opt)     \
+    OVERLAY_ROW_FUNC(20,       opt)     \
+    OVERLAY_ROW_FUNC(44_pm,    opt)     \
+    OVERLAY_ROW_FUNC(44_pm_uv, opt)     \
+    OVERLAY_ROW_FUNC(22_pm_uv, opt)     \
+    OVERLAY_ROW_FUNC(20_pm_uv, opt)
+
+OVERLAY_ROW_FUNCS(sse4)
+OVERLAY_ROW_FUNCS(avx2)
+
+#define ASSIGN_OVERLAY_ROW_FUNCS(opt)                                               \
+do {                                                                                \
+    s->blend_row[0] = straight ? ff_overlay_row_44_ ## opt                          \
+                               : ff_overlay_row_44_pm_ ## opt;                      \
+    if (!yuv)                                                                       \
+        chroma = s->blend_row[0];                                                   \
+    else if (!s->hsub && !s->vsub)                                                  \
+        chroma = straight ? ff_overlay_row_44_ ## opt : ff_overlay_row_44_pm_uv_ ## opt; \
+    else if (s->hsub == 1 && !s->vsub)                                              \
+        chroma = straight ? ff_overlay_row_22_ ## opt : ff_overlay_row_22_pm_uv_ ## opt; \
+    else if (s->hsub == 1 && s->vsub == 1)                                          \
+        chroma = straight ? ff_overlay_row_20_ ## opt : ff_overlay_row_20_pm_uv_ ## opt; \
+    if (chroma)                                                                     \
+        s->blend_row[1] = s->blend_row[2] = chroma;                                 \
+} while (0)
+
+av_cold void ff_overlay_init_x86(OverlayContext *s, int yuv)
+{
+    int cpu_flags = av_get_cpu_flags();
+    int straight = !s->alpha_format;
+    int (*chroma)(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                  int w, ptrdiff_t alinesize) = NULL;
+
+    if (!s->blend_row[0])
+        return;
+
+    if (EXTERNAL_SSE4(cpu_flags))
+        ASSIGN_OVERLAY_ROW_FUNCS(sse4);
+    if (EXTERNAL_AVX2_FAST(cpu_flags))
+        ASSIGN_OVERLAY_ROW_FUNCS(avx2);
+}
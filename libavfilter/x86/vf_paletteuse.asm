@@ -0,0 +1,94 @@
+;*****************************************************************************
+;* x86-optimized functions for paletteuse filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;*****************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pd_0to7: dd 0, 1, 2, 3, 4, 5, 6, 7
+pd_8:    times 8 dd 8
+pd_4:    times 4 dd 4
+
+SECTION .text
+
+;------------------------------------------------------------------------------
+; int ff_nearest_color(const uint32_t *pal_rg, const uint32_t *pal_b, int nb,
+;                      uint32_t rg, uint32_t b)
+;------------------------------------------------------------------------------
+
+; Each lane keeps the smallest distance << 8 | index of the entries it sees,
+; the index making the first of the nearest entries win. The distances of the
+; PALETTEUSE_PAL_PAD entries stay below 1 << 22.
+%macro NEAREST_COLOR 0
+cglobal nearest_color, 5, 5, 7, pal_rg, pal_b, nb, rg, b
+    movd           xm0, rgd
+    movd           xm1, bd
+%if cpuflag(avx2)
+    vpbroadcastd    m0, xm0
+    vpbroadcastd    m1, xm1
+    mova            m6, [pd_8]
+%else
+    SPLATD          m0
+    SPLATD          m1
+    mova            m6, [pd_4]
+%endif
+    mova            m2, [pd_0to7]           ; index of each lane
+    pcmpeqd         m3, m3
+    psrld           m3, 1                   ; best key of each lane
+    shl            nbd, 2
+    add         pal_rgq, nbq
+    add          pal_bq, nbq
+    neg             nbq
+
+.loop:
+    movu            m4, [pal_rgq + nbq]
+    movu            m5, [pal_bq + nbq]
+    psubw           m4, m0
+    psubw           m5, m1
+    pmaddwd         m4, m4                  ; dr * dr + dg * dg
+    pmaddwd         m5, m5                  ; db * db
+    paddd           m4, m5
+    pslld           m4, 8
+    por             m4, m2
+    pminsd          m3, m4
+    paddd           m2, m6
+    add            nbq, mmsize
+    jl .loop
+
+%if mmsize == 32
+    vextracti128   xm4, m3, 1
+    pminsd         xm3, xm4
+%endif
+    pshufd         xm4, xm3, q1032
+    pminsd         xm3, xm4
+    pshufd         xm4, xm3, q2301
+    pminsd         xm3, xm4
+    movd           eax, xm3
+    and            eax, 0xff
+    RET
+%endmacro
+
+INIT_XMM sse4
+NEAREST_COLOR
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+NEAREST_COLOR
+%endif
@@ -0,0 +1,155 @@
+;*****************************************************************************
+;* x86-optimized functions for tonemap filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;*****************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+%if ARCH_X86_64
+
+SECTION_RODATA 32
+
+ps_eps:      times 8 dd 0x358637bd  ; 1e-6
+ps_lut_size: times 8 dd 0x45800000  ; 4096.0, TONEMAP_LUT_SIZE
+
+SECTION .text
+
+; m0-m2 samples, m3 frac, m4 index, m5 gain
+%macro LOAD_GAIN 0
+%if cpuflag(avx2)
+    pcmpeqd        m7, m7
+    vgatherdps     m5, [lutq+m4*4], m7
+    pcmpeqd        m7, m7
+    vgatherdps     m6, [lutq+m4*4+4], m7
+%else
+    movd          i0d, m4
+    pextrd        i1d, m4, 1
+    movss          m5, [lutq+i0q*4]
+    movss          m6, [lutq+i0q*4+4]
+    insertps       m5, [lutq+i1q*4], 0x10
+    insertps       m6, [lutq+i1q*4+4], 0x10
+    pextrd        i0d, m4, 2
+    pextrd        i1d, m4, 3
+    insertps       m5, [lutq+i0q*4], 0x20
+    insertps       m6, [lutq+i0q*4+4], 0x20
+    insertps       m5, [lutq+i1q*4], 0x30
+    insertps       m6, [lutq+i1q*4+4], 0x30
+%endif
+    subps          m6, m5
+    mulps          m6, m3
+    addps          m5, m6               ; lut[i] + (lut[i + 1] - lut[i]) * (t - i)
+%endmacro
+
+; %1 desaturate
+%macro TONEMAP_LOOP 1
+.loop%1:
+    movu           m0, [s0q+xq*4]
+    movu           m1, [s1q+xq*4]
+    movu           m2, [s2q+xq*4]
+%if %1
+    mulps          m3, m0, m8
+    mulps          m4, m1, m9
+    addps          m3, m4
+    mulps          m4, m2, m10
+    addps          m3, m4               ; luma
+    subps          m4, m3, m11
+    maxps          m4, m13
+    maxps          m5, m3, m13
+    divps          m4, m5               ; overbright
+%assign %%i 0
+%rep 3
+    subps          m5, m3, m %+ %%i
+    mulps          m5, m4
+    addps    m %+ %%i, m5
+%assign %%i %%i+1
+%endrep
+%endif
+    maxps          m3, m0, m1
+    maxps          m3, m2
+    maxps          m3, m13              ; sig
+    addps          m4, m3, m12
+    divps          m3, m4
+    mulps          m3, m14
+    minps          m3, m14              ; t, NaN ends up at TONEMAP_LUT_SIZE
+    cvttps2dq      m4, m3
+    cvtdq2ps       m5, m4
+    subps          m3, m5
+    LOAD_GAIN
+    mulps          m0, m5
+    mulps          m1, m5
+    mulps          m2, m5
+    movu [d0q+xq*4], m0
+    movu [d1q+xq*4], m1
+    movu [d2q+xq*4], m2
+    add            xq, mmsize/4
+    cmp            xq, wq
+    jl .loop%1
+%endmacro
+
+;------------------------------------------------------------------------------
+; int ff_tonemap_row(float *const dst[3], const float *const src[3],
+;                    const float *lut, const TonemapRowParams *params, int w)
+;------------------------------------------------------------------------------
+
+%macro TONEMAP_ROW 0
+cglobal tonemap_row, 5, 12, 15, dst, src, lut, params, w, d0, d1, d2, s0, s1, s2, x
+%define i0q dstq
+%define i0d dstd
+%define i1q srcq
+%define i1d srcd
+    movsxdifnidn   wq, wd
+    and            wq, -mmsize/4
+    jz .end
+    mov           d0q, [dstq]
+    mov           d1q, [dstq+gprsize]
+    mov           d2q, [dstq+2*gprsize]
+    mov           s0q, [srcq]
+    mov           s1q, [srcq+gprsize]
+    mov           s2q, [srcq+2*gprsize]
+    VBROADCASTSS   m8, [paramsq]
+    VBROADCASTSS   m9, [paramsq+4]
+    VBROADCASTSS  m10, [paramsq+8]
+    VBROADCASTSS  m11, [paramsq+12]     ; desat
+    VBROADCASTSS  m12, [paramsq+16]     ; peak
+    mova          m13, [ps_eps]
+    mova          m14, [ps_lut_size]
+    xor            xq, xq
+    xorps         xm0, xm0
+    comiss       xm11, xm0
+    ja .desat
+
+    TONEMAP_LOOP 0
+    jmp .end
+
+.desat:
+    TONEMAP_LOOP 1
+
+.end:
+    mov           eax, wd
+    RET
+%endmacro
+
+INIT_XMM sse4
+TONEMAP_ROW
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+TONEMAP_ROW
+%endif
+
+%endif ; ARCH_X86_64
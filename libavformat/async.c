@@ -30,11 +30,12 @@
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/error.h"
-#include "libavutil/fifo.h"
 #include "libavutil/log.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
+#include "libavutil/time.h"
 #include "url.h"
+#include <stdatomic.h>
 #include <stdint.h>
 
 #if HAVE_UNISTD_H
@@ -43,107 +44,222 @@
 
 #define BUFFER_CAPACITY         (4 * 1024 * 1024)
 #define READ_BACK_CAPACITY      (4 * 1024 * 1024)
+#define MIN_BUFFER_CAPACITY     (256 * 1024)
 #define SHORT_SEEK_THRESHOLD    (256 * 1024)
 
+#define RING_BLOCK_SIZE         (64 * 1024)
+#define RING_NB_BLOCKS          ((BUFFER_CAPACITY + READ_BACK_CAPACITY) / RING_BLOCK_SIZE)
+/* only wake up a sleeping producer once it can write a reasonable amount */
+#define RING_WAKEUP_SPACE       RING_BLOCK_SIZE
+
+#define BITRATE_WINDOW          1000000
+
+/*
+ * Single-producer/single-consumer ring. Positions are monotonic byte
+ * counters: the background thread only advances write_pos, the reader only
+ * advances read_pos and back_pos, so neither side needs a lock to move data.
+ * Storage is split into blocks which are allocated when first written and
+ * released again when the capacity shrinks.
+ */
 typedef struct RingBuffer
 {
-    AVFifoBuffer *fifo;
-    int           read_back_capacity;
+    uint8_t            *blocks[RING_NB_BLOCKS];
+    int                 nb_allocated;
+
+    atomic_int_fast64_t write_pos;
+    atomic_int_fast64_t read_pos;
+    atomic_int_fast64_t back_pos;   // oldest byte still available for seeking back
 
-    int           read_pos;
+    atomic_int          capacity;
+    atomic_int          read_back_capacity;
 } RingBuffer;
 
 typedef struct Context {
     AVClass        *class;
     URLContext     *inner;
 
-    int             seek_request;
+    atomic_int      seek_request;
     int64_t         seek_pos;
     int             seek_whence;
     int             seek_completed;
     int64_t         seek_ret;
 
-    int             inner_io_error;
     int             io_error;
-    int             io_eof_reached;
+    atomic_int      io_eof_reached;
 
     int64_t         logical_pos;
     int64_t         logical_size;
     RingBuffer      ring;
 
+    atomic_int_fast64_t consumed_bytes;
+    int64_t         rate_consumed;
+    int64_t         rate_time;
+    int64_t         byte_rate;
+
+    atomic_int      main_waiting;
+    atomic_int      background_waiting;
     pthread_cond_t  cond_wakeup_main;
     pthread_cond_t  cond_wakeup_background;
     pthread_mutex_t mutex;
     pthread_t       async_buffer_thread;
 
-    int             abort_request;
+    atomic_int      abort_request;
     AVIOInterruptCB interrupt_callback;
+
+    /* options */
+    int             buffer_duration;
 } Context;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
 {
     memset(ring, 0, sizeof(RingBuffer));
-    ring->fifo = av_fifo_alloc(capacity + read_back_capacity);
-    if (!ring->fifo)
-        return AVERROR(ENOMEM);
-
-    ring->read_back_capacity = read_back_capacity;
+    atomic_init(&ring->write_pos, 0);
+    atomic_init(&ring->read_pos, 0);
+    atomic_init(&ring->back_pos, 0);
+    atomic_init(&ring->capacity, capacity);
+    atomic_init(&ring->read_back_capacity, read_back_capacity);
     return 0;
 }
 
 static void ring_destroy(RingBuffer *ring)
 {
-    av_fifo_freep(&ring->fifo);
+    int i;
+
+    for (i = 0; i < RING_NB_BLOCKS; i++)
+        av_freep(&ring->blocks[i]);
+    ring->nb_allocated = 0;
 }
 
+/* only called while the reader is blocked waiting for a seek to complete */
 static void ring_reset(RingBuffer *ring)
 {
-    av_fifo_reset(ring->fifo);
-    ring->read_pos = 0;
+    atomic_store(&ring->write_pos, 0);
+    atomic_store(&ring->read_pos, 0);
+    atomic_store(&ring->back_pos, 0);
 }
 
+/* reader side: bytes available for reading */
 static int ring_size(RingBuffer *ring)
 {
-    return av_fifo_size(ring->fifo) - ring->read_pos;
+    return (int)(atomic_load(&ring->write_pos) - atomic_load(&ring->read_pos));
 }
 
+/* writer side: bytes that can be written without exceeding the capacity or overwriting read-back data */
 static int ring_space(RingBuffer *ring)
 {
-    return av_fifo_space(ring->fifo);
+    int64_t write_pos = atomic_load(&ring->write_pos);
+    int64_t limit     = FFMIN(atomic_load(&ring->read_pos) + atomic_load(&ring->capacity),
+                              atomic_load(&ring->back_pos) + (int64_t)RING_NB_BLOCKS * RING_BLOCK_SIZE);
+
+    return (int)av_clip64(limit - write_pos, 0, INT_MAX);
+}
+
+static int ring_size_of_read_back(RingBuffer *ring)
+{
+    return (int)(atomic_load(&ring->read_pos) - atomic_load(&ring->back_pos));
+}
+
+/*
+ * Reader side: return a pointer to the contiguous readable data at the read
+ * position without copying it. The data stays valid until ring_consume().
+ */
+static int ring_peek(RingBuffer *ring, const uint8_t **data)
+{
+    int64_t read_pos = atomic_load(&ring->read_pos);
+    int     offset   = read_pos % RING_BLOCK_SIZE;
+    int     size     = FFMIN(ring_size(ring), RING_BLOCK_SIZE - offset);
+
+    if (size <= 0)
+        return 0;
+
+    *data = ring->blocks[(read_pos / RING_BLOCK_SIZE) % RING_NB_BLOCKS] + offset;
+    return size;
 }
 
-static int ring_generic_read(RingBuffer *ring, void *dest, int buf_size, void (*func)(void*, void*, int))
+static void ring_consume(RingBuffer *ring, int size)
 {
-    int ret;
+    int64_t read_pos = atomic_load(&ring->read_pos) + size;
+    int64_t back_pos = read_pos - atomic_load(&ring->read_back_capacity);
+
+    av_assert2(size <= ring_size(ring));
+    atomic_store(&ring->read_pos, read_pos);
+    if (back_pos > atomic_load(&ring->back_pos))
+        atomic_store(&ring->back_pos, back_pos);
+}
+
+static int ring_read(RingBuffer *ring, void *dest, int buf_size)
+{
+    const uint8_t *data;
+    int            size;
 
     av_assert2(buf_size <= ring_size(ring));
-    ret = av_fifo_generic_peek_at(ring->fifo, dest, ring->read_pos, buf_size, func);
-    ring->read_pos += buf_size;
+    while (buf_size > 0) {
+        size = FFMIN(ring_peek(ring, &data), buf_size);
+        if (dest) {
+            memcpy(dest, data, size);
+            dest = (uint8_t *)dest + size;
+        }
+        ring_consume(ring, size);
+        buf_size -= size;
+    }
 
-    if (ring->read_pos > ring->read_back_capacity) {
-        av_fifo_drain(ring->fifo, ring->read_pos - ring->read_back_capacity);
-        ring->read_pos = ring->read_back_capacity;
+    return 0;
+}
+
+/*
+ * Writer side: return the contiguous writable area at the write position,
+ * allocating its block if needed. Publish it with ring_commit().
+ */
+static int ring_write_span(RingBuffer *ring, uint8_t **data, int max_size)
+{
+    int64_t  write_pos = atomic_load(&ring->write_pos);
+    int      offset    = write_pos % RING_BLOCK_SIZE;
+    uint8_t **block    = &ring->blocks[(write_pos / RING_BLOCK_SIZE) % RING_NB_BLOCKS];
+
+    if (!*block) {
+        *block = av_malloc(RING_BLOCK_SIZE);
+        if (!*block)
+            return AVERROR(ENOMEM);
+        ring->nb_allocated++;
     }
 
-    return ret;
+    *data = *block + offset;
+    return FFMIN(max_size, RING_BLOCK_SIZE - offset);
 }
 
-static int ring_generic_write(RingBuffer *ring, void *src, int size, int (*func)(void*, void*, int))
+static void ring_commit(RingBuffer *ring, int size)
 {
-    av_assert2(size <= ring_space(ring));
-    return av_fifo_generic_write(ring->fifo, src, size, func);
+    atomic_store(&ring->write_pos, atomic_load(&ring->write_pos) + size);
 }
 
-static int ring_size_of_read_back(RingBuffer *ring)
+/* writer side: release blocks the reader can no longer access once the capacity shrank */
+static void ring_shrink(RingBuffer *ring)
 {
-    return ring->read_pos;
+    uint8_t live[RING_NB_BLOCKS] = { 0 };
+    int64_t write_pos = atomic_load(&ring->write_pos);
+    int64_t back_pos  = atomic_load(&ring->back_pos);
+    int     needed    = (atomic_load(&ring->capacity) + atomic_load(&ring->read_back_capacity)) / RING_BLOCK_SIZE + 2;
+    int64_t i;
+
+    if (ring->nb_allocated <= needed)
+        return;
+
+    for (i = back_pos / RING_BLOCK_SIZE; i * RING_BLOCK_SIZE < write_pos; i++)
+        live[i % RING_NB_BLOCKS] = 1;
+
+    for (i = 0; i < RING_NB_BLOCKS && ring->nb_allocated > needed; i++) {
+        if (ring->blocks[i] && !live[i]) {
+            av_freep(&ring->blocks[i]);
+            ring->nb_allocated--;
+        }
+    }
 }
 
 static int ring_drain(RingBuffer *ring, int offset)
 {
     av_assert2(offset >= -ring_size_of_read_back(ring));
     av_assert2(offset <= -ring_size(ring));
-    ring->read_pos += offset;
+    atomic_store(&ring->read_pos, atomic_load(&ring->read_pos) + offset);
     return 0;
 }
 
@@ -152,25 +268,65 @@ static int async_check_interrupt(void *arg)
     URLContext *h   = arg;
     Context    *c   = h->priv_data;
 
-    if (c->abort_request)
+    if (atomic_load(&c->abort_request))
         return 1;
 
     if (ff_check_interrupt(&c->interrupt_callback))
-        c->abort_request = 1;
+        atomic_store(&c->abort_request, 1);
 
-    return c->abort_request;
+    return atomic_load(&c->abort_request);
 }
 
-static int wrapped_url_read(void *src, void *dst, int size)
+/*
+ * Each side announces it is about to sleep in *_waiting before re-checking
+ * its condition under the mutex, so the other side only has to take the
+ * mutex and signal when somebody is actually waiting.
+ */
+static void async_wakeup_main(Context *c)
 {
-    URLContext *h   = src;
-    Context    *c   = h->priv_data;
-    int         ret;
+    if (atomic_load(&c->main_waiting)) {
+        pthread_mutex_lock(&c->mutex);
+        pthread_cond_signal(&c->cond_wakeup_main);
+        pthread_mutex_unlock(&c->mutex);
+    }
+}
 
-    ret = ffurl_read(c->inner, dst, size);
-    c->inner_io_error = ret < 0 ? ret : 0;
+static void async_wakeup_background(Context *c)
+{
+    if (atomic_load(&c->background_waiting) &&
+        !atomic_load(&c->io_eof_reached) &&
+        ring_space(&c->ring) >= RING_WAKEUP_SPACE) {
+        pthread_mutex_lock(&c->mutex);
+        pthread_cond_signal(&c->cond_wakeup_background);
+        pthread_mutex_unlock(&c->mutex);
+    }
+}
 
-    return ret;
+/* adapt the buffer capacity to the rate the reader consumes data at */
+static void async_update_capacity(Context *c)
+{
+    RingBuffer *ring = &c->ring;
+    int64_t     now  = av_gettime_relative();
+    int64_t     consumed, rate, capacity;
+
+    if (c->buffer_duration <= 0 || now - c->rate_time < BITRATE_WINDOW)
+        return;
+
+    consumed = atomic_load(&c->consumed_bytes);
+    rate     = (consumed - c->rate_consumed) * 1000000 / (now - c->rate_time);
+    c->rate_consumed = consumed;
+    c->rate_time     = now;
+
+    /* the reader is paused, keep what we have */
+    if (rate <= 0)
+        return;
+
+    c->byte_rate = c->byte_rate ? (3 * c->byte_rate + rate) / 4 : rate;
+    capacity     = av_clip64(c->byte_rate * c->buffer_duration, MIN_BUFFER_CAPACITY, BUFFER_CAPACITY);
+
+    atomic_store(&ring->capacity, (int)capacity);
+    atomic_store(&ring->read_back_capacity, (int)FFMIN(capacity, READ_BACK_CAPACITY));
+    ring_shrink(ring);
 }
 
 static void *async_buffer_task(void *arg)
@@ -183,55 +339,66 @@ static void *async_buffer_task(void *arg)
 
     while (1) {
         int fifo_space, to_copy;
+        uint8_t *data;
 
-        pthread_mutex_lock(&c->mutex);
         if (async_check_interrupt(h)) {
-            c->io_eof_reached = 1;
-            c->io_error       = AVERROR_EXIT;
+            pthread_mutex_lock(&c->mutex);
+            c->io_error = AVERROR_EXIT;
+            atomic_store(&c->io_eof_reached, 1);
             pthread_cond_signal(&c->cond_wakeup_main);
             pthread_mutex_unlock(&c->mutex);
             break;
         }
 
-        if (c->seek_request) {
+        if (atomic_load(&c->seek_request)) {
+            pthread_mutex_lock(&c->mutex);
             seek_ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
             if (seek_ret >= 0) {
-                c->io_eof_reached = 0;
-                c->io_error       = 0;
+                atomic_store(&c->io_eof_reached, 0);
+                c->io_error = 0;
                 ring_reset(ring);
             }
 
             c->seek_completed = 1;
             c->seek_ret       = seek_ret;
-            c->seek_request   = 0;
-
+            atomic_store(&c->seek_request, 0);
 
             pthread_cond_signal(&c->cond_wakeup_main);
             pthread_mutex_unlock(&c->mutex);
             continue;
         }
 
+        async_update_capacity(c);
+
         fifo_space = ring_space(ring);
-        if (c->io_eof_reached || fifo_space <= 0) {
-            pthread_cond_signal(&c->cond_wakeup_main);
-            pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
+        if (atomic_load(&c->io_eof_reached) || fifo_space <= 0) {
+            pthread_mutex_lock(&c->mutex);
+            atomic_store(&c->background_waiting, 1);
+            if (!atomic_load(&c->seek_request) && !atomic_load(&c->abort_request) &&
+                (atomic_load(&c->io_eof_reached) || ring_space(ring) < RING_WAKEUP_SPACE))
+                pthread_cond_wait(&c->cond_wakeup_background, &c->mutex);
+            atomic_store(&c->background_waiting, 0);
             pthread_mutex_unlock(&c->mutex);
             continue;
         }
-        pthread_mutex_unlock(&c->mutex);
 
-        to_copy = FFMIN(4096, fifo_space);
-        ret = ring_generic_write(ring, (void *)h, to_copy, wrapped_url_read);
+        to_copy = ring_write_span(ring, &data, fifo_space);
+        if (to_copy < 0)
+            ret = to_copy;
+        else
+            ret = ffurl_read(c->inner, data, to_copy);
 
-        pthread_mutex_lock(&c->mutex);
-        if (ret <= 0) {
-            c->io_eof_reached = 1;
-            if (c->inner_io_error < 0)
-                c->io_error = c->inner_io_error;
+        if (ret > 0) {
+            ring_commit(ring, ret);
+            async_wakeup_main(c);
+        } else {
+            pthread_mutex_lock(&c->mutex);
+            if (ret < 0)
+                c->io_error = ret;
+            atomic_store(&c->io_eof_reached, 1);
+            pthread_cond_signal(&c->cond_wakeup_main);
+            pthread_mutex_unlock(&c->mutex);
         }
-
-        pthread_cond_signal(&c->cond_wakeup_main);
-        pthread_mutex_unlock(&c->mutex);
     }
 
     return NULL;
@@ -248,6 +415,7 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
     ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
     if (ret < 0)
         goto fifo_fail;
+    c->rate_time = av_gettime_relative();
 
     /* wrap interrupt callback */
     c->interrupt_callback = h->interrupt_callback;
@@ -306,7 +474,7 @@ static int async_close(URLContext *h)
     int      ret;
 
     pthread_mutex_lock(&c->mutex);
-    c->abort_request = 1;
+    atomic_store(&c->abort_request, 1);
     pthread_cond_signal(&c->cond_wakeup_background);
     pthread_mutex_unlock(&c->mutex);
 
@@ -323,60 +491,65 @@ static int async_close(URLContext *h)
     return 0;
 }
 
-static int async_read_internal(URLContext *h, void *dest, int size, int read_complete,
-                               void (*func)(void*, void*, int))
+/* dest may be NULL to skip data */
+static int async_read_internal(URLContext *h, void *dest, int size, int read_complete)
 {
     Context      *c       = h->priv_data;
     RingBuffer   *ring    = &c->ring;
     int           to_read = size;
     int           ret     = 0;
 
-    pthread_mutex_lock(&c->mutex);
-
     while (to_read > 0) {
-        int fifo_size, to_copy;
+        int fifo_size, to_copy, eof;
         if (async_check_interrupt(h)) {
             ret = AVERROR_EXIT;
             break;
         }
+        /* check eof before the size, the writer publishes data before eof */
+        eof       = atomic_load(&c->io_eof_reached);
         fifo_size = ring_size(ring);
         to_copy   = FFMIN(to_read, fifo_size);
         if (to_copy > 0) {
-            ring_generic_read(ring, dest, to_copy, func);
-            if (!func)
+            ring_read(ring, dest, to_copy);
+            if (dest)
                 dest = (uint8_t *)dest + to_copy;
             c->logical_pos += to_copy;
             to_read        -= to_copy;
             ret             = size - to_read;
+            atomic_fetch_add(&c->consumed_bytes, to_copy);
+            async_wakeup_background(c);
 
             if (to_read <= 0 || !read_complete)
                 break;
-        } else if (c->io_eof_reached) {
+            continue;
+        } else if (eof) {
             if (ret <= 0) {
+                pthread_mutex_lock(&c->mutex);
                 if (c->io_error)
                     ret = c->io_error;
                 else
                     ret = AVERROR_EOF;
+                pthread_mutex_unlock(&c->mutex);
             }
             break;
         }
-        pthread_cond_signal(&c->cond_wakeup_background);
-        pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
-    }
 
-    pthread_cond_signal(&c->cond_wakeup_background);
-    pthread_mutex_unlock(&c->mutex);
+        pthread_mutex_lock(&c->mutex);
+        atomic_store(&c->main_waiting, 1);
+        if (!atomic_load(&c->abort_request) && !atomic_load(&c->io_eof_reached) && ring_size(ring) <= 0) {
+            pthread_cond_signal(&c->cond_wakeup_background);
+            pthread_cond_wait(&c->cond_wakeup_main, &c->mutex);
+        }
+        atomic_store(&c->main_waiting, 0);
+        pthread_mutex_unlock(&c->mutex);
+    }
 
     return ret;
 }
 
 static int async_read(URLContext *h, unsigned char *buf, int size)
 {
-    return async_read_internal(h, buf, size, 0, NULL);
-}
-
-static void fifo_do_not_copy_func(void* dest, void* src, int size) {
-    // do not copy
+    return async_read_internal(h, buf, size, 0);
 }
 
 static int64_t async_seek(URLContext *h, int64_t pos, int whence)
@@ -418,7 +591,7 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 
         if (pos_delta > 0) {
             // fast seek forwards
-            async_read_internal(h, NULL, pos_delta, 1, fifo_do_not_copy_func);
+            async_read_internal(h, NULL, pos_delta, 1);
         } else {
             // fast seek backwards
             ring_drain(ring, pos_delta);
@@ -436,11 +609,11 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 
     pthread_mutex_lock(&c->mutex);
 
-    c->seek_request   = 1;
     c->seek_pos       = new_logical_pos;
     c->seek_whence    = SEEK_SET;
     c->seek_completed = 0;
     c->seek_ret       = 0;
+    atomic_store(&c->seek_request, 1);
 
     while (1) {
         if (async_check_interrupt(h)) {
@@ -466,6 +639,8 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 #define D AV_OPT_FLAG_DECODING_PARAM
 
 static const AVOption options[] = {
+    { "buffer_duration", "seconds of data to buffer at the measured bitrate, 0 to always use the maximum buffer size",
+        OFFSET(buffer_duration), AV_OPT_TYPE_INT, { .i64 = 10 }, 0, INT_MAX, .flags = D },
     {NULL},
 };
 
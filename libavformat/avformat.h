@@ -1953,6 +1953,15 @@ typedef struct AVFormatContext {
 #define IJK_DEMUXER_STATUS_DASH_VID_MISMATCH -3
     int demuxer_status_code;
 
+    /**
+     * Number of threads avformat_find_stream_info_ijk() uses to decode
+     * packets of different streams concurrently. 0 or 1 decodes them on the
+     * calling thread. The results do not depend on this value.
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    int probe_threads;
+
 } AVFormatContext;
 
 #if FF_API_FORMAT_GET_SET
@@ -23,28 +23,44 @@
 
 /**
  * @TODO
- *      support keeping files
  *      support filling with a background thread
  */
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/md5.h"
 #include "libavutil/opt.h"
 #include "libavutil/tree.h"
 #include "avformat.h"
+#include "internal.h"
 #include <fcntl.h>
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#endif
 #if HAVE_IO_H
 #include <io.h>
 #endif
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_FLOCK
+#include <sys/file.h>
+#endif
 #include <sys/stat.h>
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
 
+#define INDEX_MAGIC     MKTAG('F', 'F', 'C', 'I')
+#define INDEX_VERSION   1
+#define INDEX_MAX_SIZE  (64 << 20)
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
 typedef struct CacheEntry {
     int64_t logical_pos;
     int64_t physical_pos;
@@ -63,6 +79,19 @@ typedef struct Context {
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+
+    /* persistent mode */
+    char *cache_dir;
+    int64_t cache_max_size;
+    char *inner_url;
+    int inner_flags;
+    AVDictionary *inner_options;
+    char *data_path;
+    char *index_path;
+    char *etag;
+    char *last_modified;
+    int read_only;
+    int served;         ///< cached data was returned before the resource was validated
 } Context;
 
 static int cmp(const void *key, const void *node)
@@ -70,6 +99,485 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
+static int insert_entry(Context *c, int64_t logical_pos, int64_t physical_pos, int size)
+{
+    CacheEntry *entry, *entry_ret;
+    struct AVTreeNode *node;
+
+    entry = av_malloc(sizeof(*entry));
+    node  = av_tree_node_alloc();
+    if (!entry || !node) {
+        av_free(entry);
+        av_free(node);
+        return AVERROR(ENOMEM);
+    }
+    entry->logical_pos  = logical_pos;
+    entry->physical_pos = physical_pos;
+    entry->size         = size;
+
+    entry_ret = av_tree_insert(&c->root, entry, cmp, &node);
+    if (entry_ret && entry_ret != entry) {
+        av_free(entry);
+        av_free(node);
+        return AVERROR_INVALIDDATA;
+    }
+    return 0;
+}
+
+static int enu_free(void *opaque, void *elem)
+{
+    av_free(elem);
+    return 0;
+}
+
+static void free_entries(Context *c)
+{
+    av_tree_enumerate(c->root, NULL, NULL, enu_free);
+    av_tree_destroy(c->root);
+    c->root = NULL;
+}
+
+/* Only one writer may append to a persistent cache file, others read what
+ * is already there and fetch the rest from the network. The lock belongs
+ * to the open file, so two contexts of the same process exclude each other
+ * too; plain fcntl() locks are per process and only a last resort. */
+static int lock_data_file(int fd)
+{
+#if HAVE_FLOCK
+    return flock(fd, LOCK_EX | LOCK_NB) != -1;
+#elif HAVE_FCNTL && (defined(F_OFD_SETLK) || defined(F_SETLK))
+    struct flock lock = { 0 };
+
+    lock.l_type   = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+#ifdef F_OFD_SETLK
+    return fcntl(fd, F_OFD_SETLK, &lock) != -1;
+#else
+    return fcntl(fd, F_SETLK, &lock) != -1;
+#endif
+#else
+    return 1;
+#endif
+}
+
+static int open_data_file(URLContext *h)
+{
+    Context *c = h->priv_data;
+
+    c->fd = avpriv_open(c->data_path, O_RDWR | O_CREAT | O_BINARY, 0666);
+    if (c->fd < 0) {
+        int ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Failed to open cache file %s\n", c->data_path);
+        return ret;
+    }
+    c->cache_pos = 0;
+    c->read_only = !lock_data_file(c->fd);
+    if (c->read_only)
+        av_log(h, AV_LOG_VERBOSE, "Cache file %s is being written by another reader, using it read-only\n",
+               c->data_path);
+    return 0;
+}
+
+static int read_index_string(const uint8_t **p, const uint8_t *end, char **str)
+{
+    unsigned len;
+
+    if (end - *p < 4)
+        return AVERROR_INVALIDDATA;
+    len = AV_RL32(*p);
+    *p += 4;
+    if (end - *p < len)
+        return AVERROR_INVALIDDATA;
+    if (len) {
+        *str = av_strndup(*p, len);
+        if (!*str)
+            return AVERROR(ENOMEM);
+    }
+    *p += len;
+    return 0;
+}
+
+static int load_index(URLContext *h)
+{
+    Context *c = h->priv_data;
+    struct stat st;
+    uint8_t *buf = NULL;
+    const uint8_t *p, *end;
+    char *url = NULL;
+    int64_t data_size;
+    int fd, ret;
+
+    if (fstat(c->fd, &st) < 0)
+        return AVERROR(errno);
+    data_size = st.st_size;
+
+    fd = avpriv_open(c->index_path, O_RDONLY | O_BINARY);
+    if (fd < 0)
+        return AVERROR(errno);
+    if (fstat(fd, &st) < 0 || st.st_size < 28 || st.st_size > INDEX_MAX_SIZE) {
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+    buf = av_malloc(st.st_size);
+    if (!buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if (read(fd, buf, st.st_size) != st.st_size) {
+        ret = AVERROR(EIO);
+        goto fail;
+    }
+
+    p   = buf;
+    end = buf + st.st_size;
+    if (AV_RL32(p) != INDEX_MAGIC || AV_RL32(p + 4) != INDEX_VERSION) {
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+    p += 8;
+
+    if ((ret = read_index_string(&p, end, &url)) < 0 ||
+        (ret = read_index_string(&p, end, &c->etag)) < 0 ||
+        (ret = read_index_string(&p, end, &c->last_modified)) < 0)
+        goto fail;
+    /* file names are hashes, make sure this really is our resource */
+    if (!url || strcmp(url, c->inner_url) || end - p < 12) {
+        ret = AVERROR_INVALIDDATA;
+        goto fail;
+    }
+    c->end         = AV_RL64(p);
+    c->is_true_eof = AV_RL32(p + 8);
+    p += 12;
+
+    for (; end - p >= 20; p += 20) {
+        int64_t logical_pos  = AV_RL64(p);
+        int64_t physical_pos = AV_RL64(p + 8);
+        int     size         = AV_RL32(p + 16);
+
+        /* the data file may have been replaced or truncated behind our back */
+        if (logical_pos < 0 || physical_pos < 0 || size <= 0 ||
+            physical_pos + size > data_size || logical_pos + size > c->end) {
+            ret = AVERROR_INVALIDDATA;
+            goto fail;
+        }
+        if ((ret = insert_entry(c, logical_pos, physical_pos, size)) < 0)
+            goto fail;
+    }
+    ret = 0;
+
+fail:
+    if (ret < 0) {
+        free_entries(c);
+        av_freep(&c->etag);
+        av_freep(&c->last_modified);
+        c->end         = 0;
+        c->is_true_eof = 0;
+    }
+    av_free(url);
+    av_free(buf);
+    close(fd);
+    return ret;
+}
+
+static void write_index_string(AVIOContext *pb, const char *str)
+{
+    int len = str ? strlen(str) : 0;
+
+    avio_wl32_xij(pb, len);
+    avio_write_xij(pb, str, len);
+}
+
+static int enu_write(void *opaque, void *elem)
+{
+    AVIOContext *pb   = opaque;
+    CacheEntry *entry = elem;
+
+    avio_wl64_xij(pb, entry->logical_pos);
+    avio_wl64_xij(pb, entry->physical_pos);
+    avio_wl32_xij(pb, entry->size);
+    return 0;
+}
+
+static int save_index(URLContext *h)
+{
+    Context *c = h->priv_data;
+    AVIOContext *pb;
+    uint8_t *buf = NULL;
+    char *tmp_path;
+    int size, fd, ret;
+
+    tmp_path = av_asprintf("%s.tmp", c->index_path);
+    if (!tmp_path)
+        return AVERROR(ENOMEM);
+
+    if ((ret = avio_open_dyn_buf_xij(&pb)) < 0)
+        goto end;
+    avio_wl32_xij(pb, INDEX_MAGIC);
+    avio_wl32_xij(pb, INDEX_VERSION);
+    write_index_string(pb, c->inner_url);
+    write_index_string(pb, c->etag);
+    write_index_string(pb, c->last_modified);
+    avio_wl64_xij(pb, c->end);
+    avio_wl32_xij(pb, c->is_true_eof);
+    av_tree_enumerate(c->root, pb, NULL, enu_write);
+    size = avio_close_dyn_buf_xij(pb, &buf);
+
+    /* write a new index and rename it over the old one, so readers never see a partial index */
+    fd = avpriv_open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (fd < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Failed to create cache index %s\n", tmp_path);
+        goto end;
+    }
+    ret = write(fd, buf, size);
+    close(fd);
+    if (ret != size) {
+        ret = ret < 0 ? AVERROR(errno) : AVERROR(EIO);
+        unlink(tmp_path);
+        goto end;
+    }
+    ret = ff_rename(tmp_path, c->index_path, h);
+
+end:
+    av_free(buf);
+    av_free(tmp_path);
+    return ret;
+}
+
+#if HAVE_DIRENT_H
+typedef struct CacheFile {
+    char *name;
+    time_t mtime;
+    int64_t size;
+} CacheFile;
+
+static int cmp_cache_file(const void *a, const void *b)
+{
+    return FFDIFFSIGN(((const CacheFile *)a)->mtime, ((const CacheFile *)b)->mtime);
+}
+
+/* drop the least recently used files of the whole cache directory until it fits the budget */
+static void evict_files(URLContext *h)
+{
+    Context *c = h->priv_data;
+    CacheFile *files = NULL;
+    int nb_files = 0, i;
+    int64_t total = 0;
+    struct dirent *d;
+    DIR *dir;
+
+    if (c->cache_max_size <= 0)
+        return;
+
+    dir = opendir(c->cache_dir);
+    if (!dir)
+        return;
+
+    while ((d = readdir(dir))) {
+        const char *ext = strrchr(d->d_name, '.');
+        char *data_path, *index_path;
+        struct stat st;
+        CacheFile *file;
+
+        if (!ext || strcmp(ext, ".data"))
+            continue;
+
+        data_path  = av_asprintf("%s/%s", c->cache_dir, d->d_name);
+        index_path = av_asprintf("%s/%.*s.idx", c->cache_dir, (int)(ext - d->d_name), d->d_name);
+        if (data_path && index_path && !stat(data_path, &st) &&
+            av_reallocp_array(&files, nb_files + 1, sizeof(*files)) >= 0) {
+            file        = &files[nb_files++];
+            file->name  = av_strndup(d->d_name, ext - d->d_name);
+            file->size  = st.st_size;
+            file->mtime = st.st_mtime;
+            if (!stat(index_path, &st))
+                file->mtime = FFMAX(file->mtime, st.st_mtime);
+            total += file->size;
+        }
+        av_free(data_path);
+        av_free(index_path);
+        if (!files)
+            break;
+    }
+    closedir(dir);
+
+    qsort(files, nb_files, sizeof(*files), cmp_cache_file);
+
+    for (i = 0; i < nb_files && total > c->cache_max_size; i++) {
+        char *data_path, *index_path;
+
+        if (!files[i].name)
+            continue;
+        data_path  = av_asprintf("%s/%s.data", c->cache_dir, files[i].name);
+        index_path = av_asprintf("%s/%s.idx",  c->cache_dir, files[i].name);
+        if (data_path && index_path && strcmp(data_path, c->data_path)) {
+            av_log(h, AV_LOG_DEBUG, "Evicting %s from cache\n", data_path);
+            unlink(index_path);
+            if (!unlink(data_path))
+                total -= files[i].size;
+        }
+        av_free(data_path);
+        av_free(index_path);
+    }
+
+    for (i = 0; i < nb_files; i++)
+        av_free(files[i].name);
+    av_free(files);
+}
+#endif
+
+static char *get_inner_string(URLContext *inner, const char *name)
+{
+    uint8_t *value = NULL;
+
+    if (av_opt_get(inner, name, AV_OPT_SEARCH_CHILDREN, &value) < 0)
+        return NULL;
+    if (value && !value[0])
+        av_freep(&value);
+    return (char *)value;
+}
+
+/* drop cached data if the resource changed since it was stored */
+static int check_validators(URLContext *h)
+{
+    Context *c = h->priv_data;
+    char *etag          = get_inner_string(c->inner, "etag");
+    char *last_modified = get_inner_string(c->inner, "last_modified");
+    int64_t size        = ffurl_size(c->inner);
+    int changed = 0;
+
+    if (c->root) {
+        if ((etag || c->etag) && (!etag || !c->etag || strcmp(etag, c->etag)))
+            changed = 1;
+        if ((last_modified || c->last_modified) &&
+            (!last_modified || !c->last_modified || strcmp(last_modified, c->last_modified)))
+            changed = 1;
+        if (size > 0 && c->is_true_eof && size != c->end)
+            changed = 1;
+    }
+
+    if (changed && c->served) {
+        /* the caller already has bytes of the old version, it must not get
+         * the rest from the new one */
+        av_log(h, AV_LOG_ERROR, "%s changed since it was cached and cached data "
+               "was already returned\n", c->inner_url);
+        av_free(etag);
+        av_free(last_modified);
+        if (!c->read_only) {
+            unlink(c->data_path);
+            unlink(c->index_path);
+            c->read_only = 1;
+        }
+        return AVERROR(EIO);
+    }
+
+    av_free(c->etag);
+    av_free(c->last_modified);
+    c->etag          = etag;
+    c->last_modified = last_modified;
+
+    if (!changed)
+        return 0;
+
+    av_log(h, AV_LOG_INFO, "%s changed since it was cached, dropping cached data\n", c->inner_url);
+    free_entries(c);
+    c->end         = 0;
+    c->is_true_eof = 0;
+    if (c->read_only)
+        return 0;
+
+    /* start over in a new file, readers keep the old one open */
+    close(c->fd);
+    unlink(c->data_path);
+    unlink(c->index_path);
+    return open_data_file(h);
+}
+
+static int cache_open_inner(URLContext *h, const char *url, int flags, AVDictionary **options)
+{
+    Context *c= h->priv_data;
+    int ret;
+
+    ret = ffurl_open_whitelist(&c->inner, url, flags, &h->interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0 || !c->data_path)
+        return ret;
+
+    return check_validators(h);
+}
+
+/* open the inner protocol on first use if we started from persistent data */
+static int cache_connect(URLContext *h)
+{
+    Context *c= h->priv_data;
+    int ret;
+
+    if (c->inner)
+        return 0;
+
+    ret = cache_open_inner(h, c->inner_url, c->inner_flags, &c->inner_options);
+    av_dict_free(&c->inner_options);
+    if (ret < 0)
+        ffurl_closep(&c->inner);
+    return ret;
+}
+
+static void cache_free(Context *c)
+{
+    if (c->fd >= 0)
+        close(c->fd);
+    c->fd = -1;
+    free_entries(c);
+
+    av_dict_free(&c->inner_options);
+    av_freep(&c->inner_url);
+    av_freep(&c->data_path);
+    av_freep(&c->index_path);
+    av_freep(&c->etag);
+    av_freep(&c->last_modified);
+}
+
+static int cache_open_persistent(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    Context *c= h->priv_data;
+    uint8_t md5[16];
+    char name[33];
+    int i, ret;
+
+    av_md5_sum(md5, arg, strlen(arg));
+    for (i = 0; i < 16; i++)
+        snprintf(name + 2 * i, 3, "%02x", md5[i]);
+
+    c->inner_url  = av_strdup(arg);
+    c->data_path  = av_asprintf("%s/%s.data", c->cache_dir, name);
+    c->index_path = av_asprintf("%s/%s.idx",  c->cache_dir, name);
+    c->fd         = -1;
+    if (!c->inner_url || !c->data_path || !c->index_path) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = open_data_file(h)) < 0)
+        goto fail;
+
+    if (load_index(h) >= 0 && c->root) {
+        av_log(h, AV_LOG_VERBOSE, "Using cached data of %s from %s\n", arg, c->data_path);
+        c->inner_flags = flags;
+        if (options)
+            av_dict_copy(&c->inner_options, *options, 0);
+        return 0;
+    }
+
+    ret = cache_open_inner(h, arg, flags, options);
+    if (ret >= 0)
+        return ret;
+
+fail:
+    ffurl_closep(&c->inner);
+    cache_free(c);
+    return ret;
+}
+
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     char *buffername;
@@ -77,6 +585,9 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "cache:", &arg);
 
+    if (c->cache_dir && c->cache_dir[0])
+        return cache_open_persistent(h, arg, flags, options);
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
@@ -86,8 +597,7 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
     unlink(buffername);
     av_freep(&buffername);
 
-    return ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
-                                options, h->protocol_whitelist, h->protocol_blacklist, h);
+    return cache_open_inner(h, arg, flags, options);
 }
 
 static int add_entry(URLContext *h, const unsigned char *buf, int size)
@@ -99,6 +609,9 @@ static int add_entry(URLContext *h, const unsigned char *buf, int size)
     CacheEntry *entry_ret;
     struct AVTreeNode *node = NULL;
 
+    if (c->read_only)
+        return 0;
+
     //FIXME avoid lseek
     pos = lseek(c->fd, 0, SEEK_END);
     if (pos < 0) {
@@ -184,6 +697,8 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
                 c->cache_pos += r;
                 c->logical_pos += r;
                 c->cache_hit ++;
+                if (!c->inner)
+                    c->served = 1;
                 return r;
             }
         }
@@ -191,6 +706,9 @@ static int cache_read(URLContext *h, unsigned char *buf, int size)
 
     // Cache miss or some kind of fault with the cache
 
+    if ((r = cache_connect(h)) < 0)
+        return r;
+
     if (c->logical_pos != c->inner_pos) {
         r = ffurl_seek(c->inner, c->logical_pos, SEEK_SET);
         if (r<0) {
@@ -224,6 +742,12 @@ static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
     int64_t ret;
 
     if (whence == AVSEEK_SIZE) {
+        if (!c->inner && c->is_true_eof) {
+            c->served = 1;
+            return c->end;
+        }
+        if ((ret = cache_connect(h)) < 0)
+            return ret;
         pos= ffurl_seek(c->inner, pos, whence);
         if(pos <= 0){
             pos= ffurl_seek(c->inner, -1, SEEK_END);
@@ -252,6 +776,8 @@ resolve_eof:
     }
 
     //cache miss
+    if ((ret = cache_connect(h)) < 0)
+        return ret;
     ret= ffurl_seek(c->inner, pos, whence);
     if ((whence == SEEK_SET && pos >= c->logical_pos ||
          whence == SEEK_END && pos <= 0) && ret < 0) {
@@ -283,12 +809,6 @@ resolve_eof:
     return ret;
 }
 
-static int enu_free(void *opaque, void *elem)
-{
-    av_free(elem);
-    return 0;
-}
-
 static int cache_close(URLContext *h)
 {
     Context *c= h->priv_data;
@@ -296,10 +816,16 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
-    close(c->fd);
+    if (c->data_path && c->fd >= 0 && !c->read_only) {
+        if (save_index(h) < 0)
+            av_log(h, AV_LOG_WARNING, "Failed to save cache index %s\n", c->index_path);
+#if HAVE_DIRENT_H
+        evict_files(h);
+#endif
+    }
+
     ffurl_close(c->inner);
-    av_tree_enumerate(c->root, NULL, NULL, enu_free);
-    av_tree_destroy(c->root);
+    cache_free(c);
 
     return 0;
 }
@@ -309,6 +835,8 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_dir", "Directory to keep cached data in across sessions, empty for a temporary file", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "cache_max_size", "Maximum size in bytes of all files in cache_dir, 0 for unlimited", OFFSET(cache_max_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
     {NULL},
 };
 
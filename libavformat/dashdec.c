@@ -23,6 +23,7 @@
 #include "libavutil/application.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
 #include "internal.h"
@@ -30,6 +31,7 @@
 #include "dash.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define PREFETCH_CHUNK_SIZE 65536
 
 struct fragment {
     int64_t url_offset;
@@ -39,6 +41,35 @@ struct fragment {
     AVApplicationContext *app_ctx;
     int64_t         app_ctx_intptr;
     struct representation * pls;
+    int prefetch;   /* requested by the prefetch thread of its representation */
+};
+
+enum PrefetchState {
+    PREFETCH_QUEUED,
+    PREFETCH_RUNNING,
+    PREFETCH_DONE,
+    PREFETCH_FAILED,
+};
+
+/*
+ * A fragment downloaded into memory by the prefetch thread of its
+ * representation. The request is fully prepared by the demuxer thread, the
+ * prefetch thread never touches the manifest or the shared options.
+ */
+struct prefetch_job {
+    char *src_url;              /* fragment url as listed in the manifest, to match the job */
+    int64_t url_offset;
+    struct fragment *seg;       /* hooked copy of the fragment, owns the application context */
+    char *url;
+    AVDictionary *opts;
+    int64_t size;               /* as reported by the protocol once opened, -1 if unknown */
+    uint8_t *data;
+    unsigned int data_size;
+    unsigned int data_len;
+    enum PrefetchState state;
+    int error;
+    int cancelled;              /* freed by the prefetch thread once it stops running */
+    struct prefetch_job *next;
 };
 
 /*
@@ -122,6 +153,24 @@ struct representation {
     uint32_t init_sec_buf_read_offset;
     int64_t cur_timestamp;
     int is_restart_needed;
+
+    /* The fragments following the current one are downloaded by a thread
+     * per representation, so a slow audio fetch does not hold back video.
+     * The job list and the job data are protected by prefetch_mutex. When
+     * the current fragment was prefetched, prefetch_cur points to its job
+     * instead of input. prefetch_buffered is the amount of downloaded data
+     * held by the jobs. */
+#if HAVE_THREADS
+    pthread_t prefetch_thread;
+    pthread_mutex_t prefetch_mutex;
+    pthread_cond_t prefetch_cond;
+#endif
+    int prefetch_started;
+    int prefetch_abort;
+    struct prefetch_job *prefetch_jobs;
+    struct prefetch_job *prefetch_cur;
+    unsigned int prefetch_read_offset;
+    int64_t prefetch_buffered;
 };
 
 typedef struct DASHContext {
@@ -163,15 +212,25 @@ typedef struct DASHContext {
     int disable_video;
     int disable_retry;
     int disable_xml_release;
+    int prefetch_fragments;
+    int64_t prefetch_buffer_size;
     AVAppIOControl  app_io_ctrl;
     AVApplicationContext *app_ctx;
     int64_t         app_ctx_intptr;
     AVAppDashStream info;
+#if HAVE_THREADS
+    /* the prefetch threads report their http events too, this keeps the
+     * application callback from being entered by several threads at once */
+    pthread_mutex_t app_event_lock;
+    int app_event_lock_inited;
+#endif
 } DASHContext;
 
 static int dash_call_inject(AVFormatContext *s);
+static int dash_forward_app_event(DASHContext *c, int event_type, void *obj, size_t size);
 static int func_on_app_event(AVApplicationContext *h, int event_type ,void *obj, size_t size);
 static void dash_hook_segment (AVFormatContext *s, struct representation *pls, struct fragment *seg);
+static void prefetch_stop(struct representation *pls);
 
 
 static int ishttp(char *url)
@@ -357,6 +416,7 @@ static void free_timelines_list(struct representation *pls)
 
 static void free_representation(struct representation *pls)
 {
+    prefetch_stop(pls);
     free_fragment_list(pls);
     free_timelines_list(pls);
     free_fragment(&pls->cur_seg);
@@ -1341,7 +1401,7 @@ cleanup:
         }
     }
     if (c->app_ctx) {
-        c->app_ctx->func_on_app_event(c->app_ctx, AVAPP_CTRL_SET_DASH_VIDEO_STREAM, &c->info, sizeof(c->info));
+        dash_forward_app_event(c, AVAPP_CTRL_SET_DASH_VIDEO_STREAM, &c->info, sizeof(c->info));
     }
     av_free(new_url);
     av_free(buffer);
@@ -1552,6 +1612,21 @@ fail:
     return ret;
 }
 
+static int dash_forward_app_event(DASHContext *c, int event_type, void *obj, size_t size)
+{
+    int ret;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(&c->app_event_lock);
+#endif
+    ret = c->app_ctx->func_on_app_event(c->app_ctx, event_type, obj, size);
+#if HAVE_THREADS
+    pthread_mutex_unlock(&c->app_event_lock);
+#endif
+    return ret;
+}
+
+/* runs on the prefetch thread for prefetched fragments, see dash_forward_app_event() */
 static int func_on_app_event(AVApplicationContext *h, int event_type ,void *obj, size_t size) {
     struct fragment * seg = h->opaque;
     struct representation * pls = seg->pls;
@@ -1579,6 +1654,14 @@ static int func_on_app_event(AVApplicationContext *h, int event_type ,void *obj,
                 break;
             }
 
+            /* retrying may reload the manifest, leave that to the demuxer thread */
+            if (seg->prefetch) {
+                app_io_ctrl->is_url_changed = 0;
+                app_io_ctrl->is_handled = 0;
+                app_io_ctrl->retry_counter = 0;
+                return 0;
+            }
+
             if (c->disable_retry) {
                 app_io_ctrl->is_url_changed = 0;
                 app_io_ctrl->is_handled = 0;
@@ -1642,7 +1725,7 @@ static int func_on_app_event(AVApplicationContext *h, int event_type ,void *obj,
         default:
             break;
     }
-    return c->app_ctx->func_on_app_event(c->app_ctx, event_type, obj, size);
+    return dash_forward_app_event(c, event_type, obj, size);
 }
 
 static void dash_hook_segment (AVFormatContext *s, struct representation *pls, struct fragment *seg) {
@@ -1665,12 +1748,69 @@ static void dash_hook_segment (AVFormatContext *s, struct representation *pls, s
 }
 
 
+static struct fragment *copy_fragment(struct fragment *seg_ptr)
+{
+    struct fragment *seg = av_mallocz(sizeof(struct fragment));
+    if (!seg) {
+        return NULL;
+    }
+    seg->url = av_strdup(seg_ptr->url);
+    if (!seg->url) {
+        av_free(seg);
+        return NULL;
+    }
+    seg->size = seg_ptr->size;
+    seg->url_offset = seg_ptr->url_offset;
+    return seg;
+}
+
+static int fill_template_fragment(struct representation *pls, struct fragment *seg, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+    char *tmpfilename= av_mallocz(c->max_url_size);
+    if (!tmpfilename) {
+        return AVERROR(ENOMEM);
+    }
+    ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq_no, 0, get_segment_start_time_based_on_timeline(pls, seq_no));
+    seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
+    if (!seg->url) {
+        av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
+        seg->url = av_strdup(pls->url_template);
+        if (!seg->url) {
+            av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
+            av_free(tmpfilename);
+            return AVERROR(ENOMEM);
+        }
+    }
+    av_free(tmpfilename);
+    seg->size = -1;
+    return 0;
+}
+
+/* like get_current_fragment() for a later fragment, without reloading the manifest */
+static struct fragment *get_next_fragment(struct representation *pls, int64_t seq_no)
+{
+    DASHContext *c = pls->parent->priv_data;
+    struct fragment *seg;
+
+    if (pls->n_fragments > 0)
+        return seq_no < pls->n_fragments ? copy_fragment(pls->fragments[seq_no]) : NULL;
+
+    if (!pls->url_template || !pls->url_template[0] ||
+        seq_no > (c->is_live ? calc_max_seg_no(pls, c) : pls->last_seq_no))
+        return NULL;
+
+    seg = av_mallocz(sizeof(struct fragment));
+    if (seg && fill_template_fragment(pls, seg, seq_no) < 0)
+        av_freep(&seg);
+    return seg;
+}
+
 static struct fragment *get_current_fragment(struct representation *pls)
 {
     int64_t min_seq_no = 0;
     int64_t max_seq_no = 0;
     struct fragment *seg = NULL;
-    struct fragment *seg_ptr = NULL;
 
     if (!pls->parent) {
         av_log(NULL, AV_LOG_ERROR, "%s: pls->parent == NULL !\n", __func__);
@@ -1680,19 +1820,7 @@ static struct fragment *get_current_fragment(struct representation *pls)
 
     while (( !ff_check_interrupt(c->interrupt_callback)&& pls->n_fragments > 0)) {
         if (pls->cur_seq_no < pls->n_fragments) {
-            seg_ptr = pls->fragments[pls->cur_seq_no];
-            seg = av_mallocz(sizeof(struct fragment));
-            if (!seg) {
-                return NULL;
-            }
-            seg->url = av_strdup(seg_ptr->url);
-            if (!seg->url) {
-                av_free(seg);
-                return NULL;
-            }
-            seg->size = seg_ptr->size;
-            seg->url_offset = seg_ptr->url_offset;
-            return seg;
+            return copy_fragment(pls->fragments[pls->cur_seq_no]);
         } else if (c->is_live) {
             refresh_manifest(pls->parent);
         } else {
@@ -1727,24 +1855,8 @@ static struct fragment *get_current_fragment(struct representation *pls)
             return NULL;
         }
     }
-    if (seg) {
-        char *tmpfilename= av_mallocz(c->max_url_size);
-        if (!tmpfilename) {
-            return NULL;
-        }
-        ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, pls->cur_seq_no, 0, get_segment_start_time_based_on_timeline(pls, pls->cur_seq_no));
-        seg->url = av_strireplace(pls->url_template, pls->url_template, tmpfilename);
-        if (!seg->url) {
-            av_log(pls->parent, AV_LOG_WARNING, "Unable to resolve template url '%s', try to use origin template\n", pls->url_template);
-            seg->url = av_strdup(pls->url_template);
-            if (!seg->url) {
-                av_log(pls->parent, AV_LOG_ERROR, "Cannot resolve template url '%s'\n", pls->url_template);
-                av_free(tmpfilename);
-                return NULL;
-            }
-        }
-        av_free(tmpfilename);
-        seg->size = -1;
+    if (seg && fill_template_fragment(pls, seg, pls->cur_seq_no) < 0) {
+        av_freep(&seg);
     }
 
     return seg;
@@ -1780,6 +1892,17 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
 }
 
 
+static void set_fragment_options(DASHContext *c, struct fragment *seg, AVDictionary **opts)
+{
+    set_httpheader_options(c, opts);
+    if (seg->size >= 0) {
+        /* try to restrict the HTTP request to the part we want
+         * (if this is in fact a HTTP request) */
+        av_dict_set_int(opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(opts, "end_offset", seg->url_offset + seg->size, 0);
+    }
+}
+
 static int open_input(DASHContext *c, struct representation *pls, struct fragment *seg)
 {
     AVDictionary *opts = NULL;
@@ -1791,15 +1914,7 @@ static int open_input(DASHContext *c, struct representation *pls, struct fragmen
         goto cleanup;
     }
 
-
-
-    set_httpheader_options(c, &opts);
-    if (seg->size >= 0) {
-        /* try to restrict the HTTP request to the part we want
-         * (if this is in fact a HTTP request) */
-        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
-        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
-    }
+    set_fragment_options(c, seg, &opts);
 
     dash_hook_segment(pls->parent, pls, seg);
 
@@ -1826,6 +1941,454 @@ cleanup:
     return ret;
 }
 
+#if HAVE_THREADS
+/* all prefetch_* helpers below expect prefetch_mutex to be held unless noted */
+static void prefetch_job_free(struct representation *pls, struct prefetch_job **job)
+{
+    pls->prefetch_buffered -= (*job)->data_len;
+    av_freep(&(*job)->src_url);
+    free_fragment(&(*job)->seg);
+    av_freep(&(*job)->url);
+    av_dict_free(&(*job)->opts);
+    av_freep(&(*job)->data);
+    av_freep(job);
+}
+
+static void prefetch_job_unlink(struct representation *pls, struct prefetch_job *job)
+{
+    struct prefetch_job **p;
+
+    for (p = &pls->prefetch_jobs; *p; p = &(*p)->next) {
+        if (*p == job) {
+            *p = job->next;
+            break;
+        }
+    }
+}
+
+/* drop a job, or let the prefetch thread drop it if it is still downloading */
+static void prefetch_job_drop(struct representation *pls, struct prefetch_job *job)
+{
+    if (job == pls->prefetch_cur)
+        pls->prefetch_cur = NULL;
+    if (job->state == PREFETCH_RUNNING) {
+        job->cancelled = 1;
+    } else {
+        prefetch_job_unlink(pls, job);
+        prefetch_job_free(pls, &job);
+    }
+}
+
+/* the job the demuxer needs first, it is never held back by the memory limit */
+static struct prefetch_job *prefetch_head(struct representation *pls)
+{
+    struct prefetch_job *job = pls->prefetch_jobs;
+
+    while (job && job->cancelled)
+        job = job->next;
+    return job;
+}
+
+static int prefetch_memory_full(DASHContext *c, struct representation *pls, struct prefetch_job *job)
+{
+    return job != prefetch_head(pls) && pls->prefetch_buffered >= c->prefetch_buffer_size;
+}
+
+static void *prefetch_task(void *arg)
+{
+    struct representation *pls = arg;
+    DASHContext *c = pls->parent->priv_data;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    while (!pls->prefetch_abort) {
+        struct prefetch_job *job;
+        AVIOContext *in = NULL;
+        AVDictionary *opts = NULL;
+        int ret;
+
+        for (job = pls->prefetch_jobs; job; job = job->next)
+            if (!job->cancelled && job->state == PREFETCH_QUEUED)
+                break;
+        if (!job || prefetch_memory_full(c, pls, job)) {
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+            continue;
+        }
+
+        job->state = PREFETCH_RUNNING;
+        av_dict_copy(&opts, job->opts, 0);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+
+        ret = avio_open2_xij(&in, job->url, AVIO_FLAG_READ, c->interrupt_callback, &opts);
+        av_dict_free(&opts);
+
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        if (ret >= 0)
+            job->size = avio_size_xij(in);
+        while (ret >= 0) {
+            uint8_t *data;
+
+            while (!job->cancelled && !pls->prefetch_abort && prefetch_memory_full(c, pls, job))
+                pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+            if (job->cancelled || pls->prefetch_abort) {
+                ret = AVERROR_EXIT;
+                break;
+            }
+            data = av_fast_realloc(job->data, &job->data_size, job->data_len + PREFETCH_CHUNK_SIZE);
+            if (!data) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            job->data = data;
+
+            /* the demuxer only reads below data_len, so this part can be filled unlocked */
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+            ret = avio_read_xij(in, job->data + job->data_len, PREFETCH_CHUNK_SIZE);
+            pthread_mutex_lock(&pls->prefetch_mutex);
+
+            if (ret > 0) {
+                job->data_len          += ret;
+                pls->prefetch_buffered += ret;
+                pthread_cond_broadcast(&pls->prefetch_cond);
+            } else if (ret == 0) {
+                ret = AVERROR_EOF;
+            }
+        }
+
+        job->state = ret == AVERROR_EOF ? PREFETCH_DONE : PREFETCH_FAILED;
+        job->error = ret;
+        if (job->state == PREFETCH_FAILED && ret != AVERROR_EXIT)
+            av_log(pls->parent, AV_LOG_WARNING, "Failed to prefetch fragment of playlist %d: %s\n",
+                   pls->rep_idx, av_err2str(ret));
+        if (job->cancelled) {
+            prefetch_job_unlink(pls, job);
+            prefetch_job_free(pls, &job);
+        }
+        pthread_cond_broadcast(&pls->prefetch_cond);
+
+        if (in) {
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+            avio_closep_xij(&in);
+            pthread_mutex_lock(&pls->prefetch_mutex);
+        }
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return NULL;
+}
+
+/* called without the lock held */
+static int prefetch_start(struct representation *pls)
+{
+    int ret;
+
+    if ((ret = pthread_mutex_init(&pls->prefetch_mutex, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&pls->prefetch_cond, NULL))) {
+        pthread_mutex_destroy(&pls->prefetch_mutex);
+        return AVERROR(ret);
+    }
+    pls->prefetch_abort = 0;
+    if ((ret = pthread_create(&pls->prefetch_thread, NULL, prefetch_task, pls))) {
+        pthread_cond_destroy(&pls->prefetch_cond);
+        pthread_mutex_destroy(&pls->prefetch_mutex);
+        return AVERROR(ret);
+    }
+    pls->prefetch_started = 1;
+    return 0;
+}
+
+/* called without the lock held */
+static void prefetch_stop(struct representation *pls)
+{
+    struct prefetch_job *job;
+
+    if (!pls->prefetch_started)
+        return;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    pls->prefetch_abort = 1;
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    pthread_join(pls->prefetch_thread, NULL);
+
+    while ((job = pls->prefetch_jobs)) {
+        pls->prefetch_jobs = job->next;
+        prefetch_job_free(pls, &job);
+    }
+    pls->prefetch_cur = NULL;
+    pthread_cond_destroy(&pls->prefetch_cond);
+    pthread_mutex_destroy(&pls->prefetch_mutex);
+    pls->prefetch_started = 0;
+}
+
+/* called without the lock held, on seek, restart or when the representation is dropped */
+static void prefetch_cancel(struct representation *pls)
+{
+    struct prefetch_job *job, *next;
+
+    if (!pls->prefetch_started)
+        return;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    for (job = pls->prefetch_jobs; job; job = next) {
+        next = job->next;
+        if (!job->cancelled)
+            prefetch_job_drop(pls, job);
+    }
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+}
+
+static int prefetch_queued(struct representation *pls, struct fragment *seg)
+{
+    struct prefetch_job *job;
+
+    for (job = pls->prefetch_jobs; job; job = job->next)
+        if (!job->cancelled && job->url_offset == seg->url_offset && !strcmp(job->src_url, seg->url))
+            return 1;
+    return 0;
+}
+
+/* queue downloads for the fragments following the current one, called without the lock held */
+static void prefetch_schedule(DASHContext *c, struct representation *pls)
+{
+    int64_t seq_no;
+    int ret;
+
+    /* a single fragment is read and seeked in place by the nested demuxer */
+    if (c->prefetch_fragments <= 0 || pls->n_fragments == 1)
+        return;
+
+    if (!pls->prefetch_started && (ret = prefetch_start(pls)) < 0) {
+        av_log(pls->parent, AV_LOG_WARNING, "Failed to start fragment prefetching: %s\n",
+               av_err2str(ret));
+        c->prefetch_fragments = 0;
+        return;
+    }
+
+    for (seq_no = pls->cur_seq_no + 1; seq_no <= pls->cur_seq_no + c->prefetch_fragments; seq_no++) {
+        struct fragment *seg = get_next_fragment(pls, seq_no);
+        struct prefetch_job *job, **tail;
+        int queued;
+
+        if (!seg)
+            break;
+
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        queued = prefetch_queued(pls, seg);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+        if (queued) {
+            free_fragment(&seg);
+            continue;
+        }
+
+        job = av_mallocz(sizeof(*job));
+        if (!job) {
+            free_fragment(&seg);
+            break;
+        }
+        job->src_url    = av_strdup(seg->url);
+        job->url_offset = seg->url_offset;
+        job->url        = av_mallocz(c->max_url_size);
+        job->seg        = seg;
+        job->size       = -1;
+        if (!job->src_url || !job->url) {
+            prefetch_job_free(pls, &job);
+            break;
+        }
+
+        /* mirror open_input(), but keep the application context in the job options */
+        av_dict_copy(&job->opts, c->avio_opts, 0);
+        set_fragment_options(c, seg, &job->opts);
+        seg->prefetch = 1;
+        dash_hook_segment(pls->parent, pls, seg);
+        ff_make_absolute_url(job->url, c->max_url_size, c->base_url, seg->url);
+        if (seg->app_ctx_intptr != 0)
+            av_dict_set_int(&job->opts, "ijkapplication", seg->app_ctx_intptr, 0);
+
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        for (tail = &pls->prefetch_jobs; *tail; tail = &(*tail)->next);
+        *tail = job;
+        pthread_cond_broadcast(&pls->prefetch_cond);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+    }
+}
+
+/* use the prefetched data for the current fragment if there is any */
+static int prefetch_take(struct representation *pls, struct fragment *seg)
+{
+    struct prefetch_job *job, *next, *found = NULL;
+
+    if (!pls->prefetch_started)
+        return 0;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    /* anything queued before the current fragment will not be read anymore */
+    for (job = pls->prefetch_jobs; job && !found; job = next) {
+        next = job->next;
+        if (job->cancelled)
+            continue;
+        if (job->url_offset == seg->url_offset && !strcmp(job->src_url, seg->url))
+            found = job;
+        else
+            prefetch_job_drop(pls, job);
+    }
+    if (!found) {
+        /* the manifest changed under the queued jobs */
+        for (job = pls->prefetch_jobs; job; job = next) {
+            next = job->next;
+            if (!job->cancelled)
+                prefetch_job_drop(pls, job);
+        }
+    }
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    job = found;
+    /* the prefetch thread uses the same interrupt callback, so this wait ends on interrupt too */
+    while (job && !job->data_len &&
+           (job->state == PREFETCH_QUEUED || job->state == PREFETCH_RUNNING))
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+    if (job && !job->data_len && job->state == PREFETCH_FAILED) {
+        /* nothing to gain, open the fragment directly */
+        prefetch_job_drop(pls, job);
+        job = NULL;
+    }
+    pls->prefetch_cur         = job;
+    pls->prefetch_read_offset = 0;
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return !!job;
+}
+
+static int prefetch_read(struct representation *pls, uint8_t *buf, int buf_size)
+{
+    struct prefetch_job *job = pls->prefetch_cur;
+    int ret;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    while (pls->prefetch_read_offset >= job->data_len &&
+           (job->state == PREFETCH_QUEUED || job->state == PREFETCH_RUNNING))
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+
+    if (pls->prefetch_read_offset < job->data_len) {
+        ret = FFMIN(buf_size, job->data_len - pls->prefetch_read_offset);
+        memcpy(buf, job->data + pls->prefetch_read_offset, ret);
+        pls->prefetch_read_offset += ret;
+    } else {
+        ret = job->state == PREFETCH_FAILED ? job->error : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return ret;
+}
+
+static int64_t prefetch_seek(struct representation *pls, int64_t offset, int whence)
+{
+    struct prefetch_job *job = pls->prefetch_cur;
+    int64_t size, ret;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    /* prefetch_take() returned once the fragment was opened, so the size
+     * is known by now if the server sent it */
+    size = job->state == PREFETCH_DONE ? job->data_len : job->size;
+    if (whence == AVSEEK_SIZE) {
+        ret = size >= 0 ? size : AVERROR(ENOSYS);
+        goto end;
+    }
+    if (whence == SEEK_CUR) {
+        offset += pls->prefetch_read_offset;
+    } else if (whence == SEEK_END) {
+        if (size < 0) {
+            ret = AVERROR(ENOSYS);
+            goto end;
+        }
+        offset += size;
+    }
+    while (offset > job->data_len &&
+           (job->state == PREFETCH_QUEUED || job->state == PREFETCH_RUNNING))
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+
+    if (offset < 0 || offset > job->data_len) {
+        ret = AVERROR(EINVAL);
+    } else {
+        pls->prefetch_read_offset = offset;
+        ret = offset;
+    }
+end:
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return ret;
+}
+
+/* pass the application settings on to the downloads in flight, called without the lock held */
+static void prefetch_update_app_ctx(DASHContext *c, struct representation *pls)
+{
+    struct prefetch_job *job;
+
+    if (!pls->prefetch_started || !c->app_ctx)
+        return;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    for (job = pls->prefetch_jobs; job; job = job->next) {
+        AVApplicationContext *app_ctx = job->seg ? job->seg->app_ctx : NULL;
+
+        if (!app_ctx)
+            continue;
+        app_ctx->dash_audio_read_len = c->app_ctx->dash_audio_read_len;
+        app_ctx->dash_audio_recv_buffer_size = c->app_ctx->dash_audio_recv_buffer_size;
+        app_ctx->dash_video_recv_buffer_size = c->app_ctx->dash_video_recv_buffer_size;
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+}
+
+/* the current fragment is finished with, called without the lock held */
+static void prefetch_release(struct representation *pls)
+{
+    if (!pls->prefetch_cur)
+        return;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    prefetch_job_drop(pls, pls->prefetch_cur);
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+}
+#else
+static void prefetch_stop(struct representation *pls)
+{
+}
+
+static void prefetch_cancel(struct representation *pls)
+{
+}
+
+static void prefetch_schedule(DASHContext *c, struct representation *pls)
+{
+}
+
+static int prefetch_take(struct representation *pls, struct fragment *seg)
+{
+    return 0;
+}
+
+static int prefetch_read(struct representation *pls, uint8_t *buf, int buf_size)
+{
+    return AVERROR_BUG;
+}
+
+static int64_t prefetch_seek(struct representation *pls, int64_t offset, int whence)
+{
+    return AVERROR_BUG;
+}
+
+static void prefetch_update_app_ctx(DASHContext *c, struct representation *pls)
+{
+}
+
+static void prefetch_release(struct representation *pls)
+{
+}
+#endif
+
 static int update_init_section(struct representation *pls)
 {
     static const int max_init_section_size = 1024 * 1024;
@@ -1876,6 +2439,8 @@ static int update_init_section(struct representation *pls)
 static int64_t seek_data(void *opaque, int64_t offset, int whence)
 {
     struct representation *v = opaque;
+    if (v->prefetch_cur)
+        return prefetch_seek(v, offset, whence);
     if (v->n_fragments && !v->init_sec_data_len) {
         //avio_size_xij not support AVSEEK_SIZE
         if (whence == AVSEEK_SIZE && v->input && v->input->seek) {
@@ -1903,7 +2468,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     }
 
 restart:
-    if (!v->input) {
+    if (!v->input && !v->prefetch_cur) {
         free_fragment(&v->cur_seg);
         v->cur_seg = get_current_fragment(v);
         if (!v->cur_seg) {
@@ -1916,7 +2481,13 @@ restart:
         if (ret)
             goto end;
 
-        ret = open_input(c, v, v->cur_seg);
+        if (prefetch_take(v, v->cur_seg)) {
+            v->cur_seg_offset = 0;
+            v->cur_seg_size = v->cur_seg->size;
+            ret = 0;
+        } else {
+            ret = open_input(c, v, v->cur_seg);
+        }
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback)) {
                 goto end;
@@ -1930,6 +2501,7 @@ restart:
             }
             goto restart;
         }
+        prefetch_schedule(c, v);
     }
 
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
@@ -1949,12 +2521,17 @@ restart:
         ret = AVERROR_EOF;
         goto end;
     }
-    if (c->app_ctx) {
+    if (c->app_ctx && v->cur_seg->app_ctx) {
         v->cur_seg->app_ctx->dash_audio_read_len = c->app_ctx->dash_audio_read_len;
         v->cur_seg->app_ctx->dash_audio_recv_buffer_size = c->app_ctx->dash_audio_recv_buffer_size;
         v->cur_seg->app_ctx->dash_video_recv_buffer_size = c->app_ctx->dash_video_recv_buffer_size;
     }
-    ret = read_from_url(v, v->cur_seg, buf, buf_size, READ_NORMAL);
+    /* a prefetched fragment was hooked in its job, not in cur_seg */
+    prefetch_update_app_ctx(c, v);
+    if (v->prefetch_cur)
+        ret = prefetch_read(v, buf, buf_size);
+    else
+        ret = read_from_url(v, v->cur_seg, buf, buf_size, READ_NORMAL);
     if (ret > 0)
         goto end;
 
@@ -2160,6 +2737,11 @@ static int dash_read_header(AVFormatContext *s, AVDictionary **options)
         av_log(NULL, AV_LOG_ERROR, "dash c->app_ctx is NULL\n");
         return -1;
     }
+#if HAVE_THREADS
+    if ((ret = pthread_mutex_init(&c->app_event_lock, NULL)))
+        return AVERROR(ret);
+    c->app_event_lock_inited = 1;
+#endif
 
     if (options && *options)
         av_dict_copy(&c->avio_opts, *options, 0);
@@ -2276,6 +2858,7 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
             av_log(s, AV_LOG_INFO, "Now receiving stream_index %d\n", pls->stream_index);
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
+            prefetch_cancel(pls);
             if (pls->input)
                 ff_format_io_close_xij(pls->parent, &pls->input);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
@@ -2328,6 +2911,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
         if (cur->is_restart_needed) {
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
+            prefetch_release(cur);
             if (cur->input)
                 ff_format_io_close_xij(cur->parent, &cur->input);
             ret = reopen_demux_for_component(s, cur);
@@ -2344,6 +2928,13 @@ static int dash_close(AVFormatContext *s)
     DASHContext *c = s->priv_data;
     free_audio_list(c);
     free_video_list(c);
+#if HAVE_THREADS
+    /* read_header may have failed before creating it */
+    if (c->app_event_lock_inited) {
+        pthread_mutex_destroy(&c->app_event_lock);
+        c->app_event_lock_inited = 0;
+    }
+#endif
 
     av_freep(&c->cookies);
     av_freep(&c->user_agent);
@@ -2371,6 +2962,7 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t tim
         ff_read_frame_flush_xij(pls->ctx);
         return av_seek_frame_xij(pls->ctx, -1, timestamp, flags);
     }
+    prefetch_cancel(pls);
     if (pls->input)
         ff_format_io_close_xij(pls->parent, &pls->input);
 
@@ -2529,6 +3121,10 @@ static const AVOption dash_options[] = {
     {"disable_retry", "disable_retry", OFFSET(disable_retry), AV_OPT_TYPE_INT, {.i64 = 0}, INT_MIN, INT_MAX, FLAGS},
     {"disable_video", "disable_video", OFFSET(disable_video), AV_OPT_TYPE_INT, {.i64 = 0}, INT_MIN, INT_MAX, FLAGS},
     {"disable_audio", "disable_audio", OFFSET(disable_audio), AV_OPT_TYPE_INT, {.i64 = 0}, INT_MIN, INT_MAX, FLAGS},
+    {"prefetch_fragments", "Number of fragments each representation downloads ahead in its own thread",
+        OFFSET(prefetch_fragments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_buffer_size", "Maximum amount of prefetched data kept per representation",
+        OFFSET(prefetch_buffer_size), AV_OPT_TYPE_INT64, {.i64 = 16 * 1024 * 1024}, 0, INT64_MAX, FLAGS},
     { "ijkapplication", "AVApplicationContext", OFFSET(app_ctx_intptr), AV_OPT_TYPE_INT64, { .i64 = 0 }, INT64_MIN, INT64_MAX, FLAGS},
     {NULL}
 };
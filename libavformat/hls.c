@@ -34,6 +34,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -41,6 +42,7 @@
 #include "id3v2.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define PREFETCH_CHUNK_SIZE 65536
 
 #define MAX_FIELD_LEN 64
 #define MAX_CHARACTERISTICS_LEN 512
@@ -82,6 +84,32 @@ struct segment {
 
 struct rendition;
 
+enum PrefetchState {
+    PREFETCH_QUEUED,
+    PREFETCH_RUNNING,
+    PREFETCH_DONE,
+    PREFETCH_FAILED,
+};
+
+/*
+ * A media segment downloaded into memory by the prefetch thread of its
+ * playlist. Jobs own copies of everything they need, as the segment list
+ * may be replaced by a playlist reload while they run.
+ */
+struct prefetch_job {
+    int seq_no;
+    char *url;
+    AVDictionary *opts;
+    int64_t size;   /* size of a byte range segment, -1 if it is a whole file */
+    uint8_t *data;
+    unsigned int data_size;
+    unsigned int data_len;
+    enum PrefetchState state;
+    int error;
+    int cancelled;  /* freed by the prefetch thread once it stops running */
+    struct prefetch_job *next;
+};
+
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
     PLS_TYPE_EVENT,
@@ -160,6 +188,22 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Segments N+1..N+prefetch_segments are downloaded by a background
+     * thread while segment N is demuxed. The job list and the data of the
+     * jobs are protected by prefetch_mutex. When the segment being demuxed
+     * was prefetched, prefetch_cur points to its job instead of input. */
+#if HAVE_THREADS
+    pthread_t prefetch_thread;
+    pthread_mutex_t prefetch_mutex;
+    pthread_cond_t prefetch_cond;
+#endif
+    int prefetch_started;
+    int prefetch_abort;
+    struct prefetch_job *prefetch_jobs;
+    struct prefetch_job *prefetch_cur;
+    unsigned int prefetch_read_offset;
+    int64_t prefetch_buffered;
 };
 
 /*
@@ -219,6 +263,8 @@ typedef struct HLSContext {
     AVIOContext *playlist_pb;
     int hls_io_protocol_enable;
     char * hls_io_protocol;
+    int prefetch_segments;
+    int64_t prefetch_buffer_size;
 } HLSContext;
 
 static void free_segment_list(struct playlist *pls)
@@ -244,11 +290,14 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+static void prefetch_stop(struct playlist *pls);
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        prefetch_stop(pls);
         free_segment_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
@@ -1201,29 +1250,34 @@ static void intercept_id3(struct playlist *pls, uint8_t *buf,
         pls->is_id3_timestamped = (pls->id3_mpegts_timestamp != AV_NOPTS_VALUE);
 }
 
-static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
+static void set_segment_options(HLSContext *c, struct segment *seg, AVDictionary **opts)
 {
-    AVDictionary *opts = NULL;
-    int ret;
-    int is_http = 0;
-
     // broker prior HTTP options that should be consistent across requests
-    av_dict_set(&opts, "user_agent", c->user_agent, 0);
-    av_dict_set(&opts, "referer", c->referer, 0);
-    av_dict_set(&opts, "cookies", c->cookies, 0);
-    av_dict_set(&opts, "headers", c->headers, 0);
-    av_dict_set(&opts, "http_proxy", c->http_proxy, 0);
-    av_dict_set(&opts, "seekable", "0", 0);
+    av_dict_set(opts, "user_agent", c->user_agent, 0);
+    av_dict_set(opts, "referer", c->referer, 0);
+    av_dict_set(opts, "cookies", c->cookies, 0);
+    av_dict_set(opts, "headers", c->headers, 0);
+    av_dict_set(opts, "http_proxy", c->http_proxy, 0);
+    av_dict_set(opts, "seekable", "0", 0);
 
     if (c->http_persistent)
-        av_dict_set(&opts, "multiple_requests", "1", 0);
+        av_dict_set(opts, "multiple_requests", "1", 0);
 
     if (seg->size >= 0) {
         /* try to restrict the HTTP request to the part we want
          * (if this is in fact a HTTP request) */
-        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
-        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+        av_dict_set_int(opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(opts, "end_offset", seg->url_offset + seg->size, 0);
     }
+}
+
+static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg, AVIOContext **in)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+    int is_http = 0;
+
+    set_segment_options(c, seg, &opts);
 
     av_log(pls->parent, AV_LOG_VERBOSE, "HLS request for url '%s', offset %"PRId64", playlist %d\n",
            seg->url, seg->url_offset, pls->index);
@@ -1358,6 +1412,378 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     return 0;
 }
 
+#if HAVE_THREADS
+/* all prefetch_* helpers below expect prefetch_mutex to be held unless noted */
+static void prefetch_job_free(struct playlist *pls, struct prefetch_job **job)
+{
+    pls->prefetch_buffered -= (*job)->data_len;
+    av_freep(&(*job)->url);
+    av_dict_free(&(*job)->opts);
+    av_freep(&(*job)->data);
+    av_freep(job);
+}
+
+static void prefetch_job_unlink(struct playlist *pls, struct prefetch_job *job)
+{
+    struct prefetch_job **p;
+
+    for (p = &pls->prefetch_jobs; *p; p = &(*p)->next) {
+        if (*p == job) {
+            *p = job->next;
+            break;
+        }
+    }
+}
+
+/* drop a job, or let the prefetch thread drop it if it is still downloading */
+static void prefetch_job_drop(struct playlist *pls, struct prefetch_job *job)
+{
+    if (job == pls->prefetch_cur)
+        pls->prefetch_cur = NULL;
+    if (job->state == PREFETCH_RUNNING) {
+        job->cancelled = 1;
+    } else {
+        prefetch_job_unlink(pls, job);
+        prefetch_job_free(pls, &job);
+    }
+}
+
+static struct prefetch_job *prefetch_find(struct playlist *pls, int seq_no)
+{
+    struct prefetch_job *job;
+
+    for (job = pls->prefetch_jobs; job; job = job->next)
+        if (!job->cancelled && job->seq_no == seq_no)
+            return job;
+    return NULL;
+}
+
+/* the job the demuxer needs first, it is never held back by the memory limit */
+static struct prefetch_job *prefetch_head(struct playlist *pls)
+{
+    struct prefetch_job *job = pls->prefetch_jobs;
+
+    while (job && job->cancelled)
+        job = job->next;
+    return job;
+}
+
+/* drop jobs for segments the demuxer has moved past */
+static void prefetch_purge(struct playlist *pls)
+{
+    struct prefetch_job *job, *next;
+
+    for (job = pls->prefetch_jobs; job; job = next) {
+        next = job->next;
+        if (!job->cancelled && job != pls->prefetch_cur && job->seq_no < pls->cur_seq_no)
+            prefetch_job_drop(pls, job);
+    }
+}
+
+static int prefetch_memory_full(HLSContext *c, struct playlist *pls, struct prefetch_job *job)
+{
+    return job != prefetch_head(pls) && pls->prefetch_buffered >= c->prefetch_buffer_size;
+}
+
+static void *prefetch_task(void *arg)
+{
+    struct playlist *pls = arg;
+    AVFormatContext *s   = pls->parent;
+    HLSContext *c        = s->priv_data;
+    AVIOContext *in      = NULL;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    while (!pls->prefetch_abort) {
+        struct prefetch_job *job;
+        AVDictionary *opts = NULL;
+        int ret = AVERROR(EINVAL);
+
+        for (job = pls->prefetch_jobs; job; job = job->next)
+            if (!job->cancelled && job->state == PREFETCH_QUEUED)
+                break;
+        if (!job || prefetch_memory_full(c, pls, job)) {
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+            continue;
+        }
+
+        job->state = PREFETCH_RUNNING;
+        av_dict_copy(&opts, job->opts, 0);
+        pthread_mutex_unlock(&pls->prefetch_mutex);
+
+        /* reuse the connection of the previous segment if possible */
+        if (in && c->http_persistent && job->size < 0)
+            ret = open_url_keepalive(s, &in, job->url);
+        if (ret < 0) {
+            if (in)
+                ff_format_io_close_xij(s, &in);
+            ret = s->io_open(s, &in, job->url, AVIO_FLAG_READ, &opts);
+        }
+        av_dict_free(&opts);
+
+        pthread_mutex_lock(&pls->prefetch_mutex);
+        while (ret >= 0) {
+            int to_read = PREFETCH_CHUNK_SIZE;
+            uint8_t *data;
+
+            while (!job->cancelled && !pls->prefetch_abort && prefetch_memory_full(c, pls, job))
+                pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+            if (job->cancelled || pls->prefetch_abort) {
+                ret = AVERROR_EXIT;
+                break;
+            }
+
+            if (job->size >= 0)
+                to_read = FFMIN(to_read, job->size - job->data_len);
+            if (to_read <= 0) {
+                ret = AVERROR_EOF;
+                break;
+            }
+            data = av_fast_realloc(job->data, &job->data_size, job->data_len + to_read);
+            if (!data) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            job->data = data;
+
+            /* the demuxer only reads below data_len, so this part can be filled unlocked */
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+            ret = avio_read_xij(in, job->data + job->data_len, to_read);
+            pthread_mutex_lock(&pls->prefetch_mutex);
+
+            if (ret > 0) {
+                job->data_len           += ret;
+                pls->prefetch_buffered  += ret;
+                pthread_cond_broadcast(&pls->prefetch_cond);
+            } else if (ret == 0) {
+                ret = AVERROR_EOF;
+            }
+        }
+
+        job->state = ret == AVERROR_EOF ? PREFETCH_DONE : PREFETCH_FAILED;
+        job->error = ret;
+        if (job->state == PREFETCH_FAILED && ret != AVERROR_EXIT)
+            av_log(s, AV_LOG_WARNING, "Failed to prefetch segment %d of playlist %d: %s\n",
+                   job->seq_no, pls->index, av_err2str(ret));
+        if (job->cancelled) {
+            prefetch_job_unlink(pls, job);
+            prefetch_job_free(pls, &job);
+        }
+        pthread_cond_broadcast(&pls->prefetch_cond);
+
+        if (in && (ret != AVERROR_EOF || !c->http_persistent)) {
+            pthread_mutex_unlock(&pls->prefetch_mutex);
+            ff_format_io_close_xij(s, &in);
+            pthread_mutex_lock(&pls->prefetch_mutex);
+        }
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    if (in)
+        ff_format_io_close_xij(s, &in);
+
+    return NULL;
+}
+
+/* called without the lock held */
+static int prefetch_start(struct playlist *pls)
+{
+    int ret;
+
+    if ((ret = pthread_mutex_init(&pls->prefetch_mutex, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&pls->prefetch_cond, NULL))) {
+        pthread_mutex_destroy(&pls->prefetch_mutex);
+        return AVERROR(ret);
+    }
+    pls->prefetch_abort = 0;
+    if ((ret = pthread_create(&pls->prefetch_thread, NULL, prefetch_task, pls))) {
+        pthread_cond_destroy(&pls->prefetch_cond);
+        pthread_mutex_destroy(&pls->prefetch_mutex);
+        return AVERROR(ret);
+    }
+    pls->prefetch_started = 1;
+    return 0;
+}
+
+/* called without the lock held */
+static void prefetch_stop(struct playlist *pls)
+{
+    struct prefetch_job *job;
+
+    if (!pls->prefetch_started)
+        return;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    pls->prefetch_abort = 1;
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    pthread_join(pls->prefetch_thread, NULL);
+
+    while ((job = pls->prefetch_jobs)) {
+        pls->prefetch_jobs = job->next;
+        prefetch_job_free(pls, &job);
+    }
+    pls->prefetch_cur = NULL;
+    pthread_cond_destroy(&pls->prefetch_cond);
+    pthread_mutex_destroy(&pls->prefetch_mutex);
+    pls->prefetch_started = 0;
+}
+
+/* called without the lock held, on seek or when the playlist is dropped */
+static void prefetch_cancel(struct playlist *pls)
+{
+    struct prefetch_job *job, *next;
+
+    if (!pls->prefetch_started)
+        return;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    for (job = pls->prefetch_jobs; job; job = next) {
+        next = job->next;
+        if (!job->cancelled)
+            prefetch_job_drop(pls, job);
+    }
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+}
+
+/* queue downloads for the segments following the current one */
+static void prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    int seq_no, ret;
+
+    if (c->prefetch_segments <= 0)
+        return;
+
+    if (!pls->prefetch_started && (ret = prefetch_start(pls)) < 0) {
+        av_log(pls->parent, AV_LOG_WARNING, "Failed to start segment prefetching: %s\n",
+               av_err2str(ret));
+        c->prefetch_segments = 0;
+        return;
+    }
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    prefetch_purge(pls);
+    for (seq_no = pls->cur_seq_no + 1;
+         seq_no <= pls->cur_seq_no + c->prefetch_segments &&
+         seq_no < pls->start_seq_no + pls->n_segments; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        struct prefetch_job *job, **tail;
+
+        if (prefetch_find(pls, seq_no))
+            continue;
+        /* like http_multiple, only plain http segments are fetched ahead */
+        if (seg->key_type != KEY_NONE || !av_strstart(seg->url, "http", NULL))
+            continue;
+
+        job = av_mallocz(sizeof(*job));
+        if (!job)
+            break;
+        job->seq_no = seq_no;
+        job->size   = seg->size;
+        job->url    = av_strdup(seg->url);
+        av_dict_copy(&job->opts, c->avio_opts, 0);
+        set_segment_options(c, seg, &job->opts);
+        av_dict_set(&job->opts, "seekable", "1", 0);
+        if (!job->url) {
+            prefetch_job_free(pls, &job);
+            break;
+        }
+
+        for (tail = &pls->prefetch_jobs; *tail; tail = &(*tail)->next);
+        *tail = job;
+    }
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+}
+
+/* use the prefetched data for the current segment if there is any */
+static int prefetch_take(struct playlist *pls)
+{
+    struct prefetch_job *job;
+
+    if (!pls->prefetch_started)
+        return 0;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    prefetch_purge(pls);
+    job = prefetch_find(pls, pls->cur_seq_no);
+    /* the prefetch thread uses the same interrupt callback, so this wait ends on interrupt too */
+    while (job && !job->data_len && !pls->prefetch_abort &&
+           (job->state == PREFETCH_QUEUED || job->state == PREFETCH_RUNNING))
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+    if (job && !job->data_len && job->state == PREFETCH_FAILED) {
+        /* nothing to gain, open the segment directly */
+        prefetch_job_drop(pls, job);
+        job = NULL;
+    }
+    pls->prefetch_cur         = job;
+    pls->prefetch_read_offset = 0;
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return !!job;
+}
+
+static int prefetch_read(struct playlist *pls, uint8_t *buf, int buf_size)
+{
+    struct prefetch_job *job = pls->prefetch_cur;
+    int ret;
+
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    while (pls->prefetch_read_offset >= job->data_len && !pls->prefetch_abort &&
+           (job->state == PREFETCH_QUEUED || job->state == PREFETCH_RUNNING))
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_mutex);
+
+    if (pls->prefetch_read_offset < job->data_len) {
+        ret = FFMIN(buf_size, job->data_len - pls->prefetch_read_offset);
+        memcpy(buf, job->data + pls->prefetch_read_offset, ret);
+        pls->prefetch_read_offset += ret;
+    } else {
+        ret = job->state == PREFETCH_FAILED ? job->error : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+
+    return ret;
+}
+
+/* the current segment has been read completely */
+static void prefetch_release(struct playlist *pls)
+{
+    pthread_mutex_lock(&pls->prefetch_mutex);
+    if (pls->prefetch_cur)
+        prefetch_job_drop(pls, pls->prefetch_cur);
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_mutex);
+}
+#else
+static void prefetch_stop(struct playlist *pls)
+{
+}
+
+static void prefetch_cancel(struct playlist *pls)
+{
+}
+
+static void prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+}
+
+static int prefetch_take(struct playlist *pls)
+{
+    return 0;
+}
+
+static int prefetch_read(struct playlist *pls, uint8_t *buf, int buf_size)
+{
+    return AVERROR_BUG;
+}
+
+static void prefetch_release(struct playlist *pls)
+{
+}
+#endif
+
 static int64_t default_reload_interval(struct playlist *pls)
 {
     return pls->n_segments > 0 ?
@@ -1424,7 +1850,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->prefetch_cur) || (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1434,6 +1860,7 @@ restart:
         if (!v->needed) {
             av_log(v->parent, AV_LOG_INFO, "No longer receiving playlist %d\n",
                 v->index);
+            prefetch_cancel(v);
             return AVERROR_EOF;
         }
 
@@ -1484,7 +1911,12 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (prefetch_take(v)) {
+            /* a kept-alive connection is of no use for this segment */
+            if (v->input)
+                ff_format_io_close_xij(v->parent, &v->input);
+            ret = 0;
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->input_next_requested = 0;
             ret = 0;
@@ -1507,9 +1939,10 @@ reload:
             goto reload;
         }
         just_opened = 1;
+        prefetch_schedule(c, v);
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1519,7 +1952,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && c->prefetch_segments <= 0 && !v->input_next_requested &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1542,7 +1975,10 @@ reload:
     }
 
     seg = current_segment(v);
-    ret = read_from_url(v, seg, buf, buf_size, READ_NORMAL);
+    if (v->prefetch_cur)
+        ret = prefetch_read(v, buf, buf_size);
+    else
+        ret = read_from_url(v, seg, buf, buf_size, READ_NORMAL);
     if (ret > 0) {
         if (just_opened && v->is_id3_timestamped != 0) {
             /* Intercept ID3 tags here, elementary audio streams are required
@@ -1552,7 +1988,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->prefetch_cur) {
+        prefetch_release(v);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -2053,6 +2491,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
         cur_needed = playlist_needed(c->playlists[i]);
 
         if (cur_needed && !pls->needed) {
+            prefetch_cancel(pls);
             pls->needed = 1;
             changed = 1;
             pls->cur_seq_no = select_cur_seq_no(c, pls);
@@ -2065,6 +2504,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %d\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+            prefetch_cancel(pls);
             if (pls->input)
                 ff_format_io_close_xij(pls->parent, &pls->input);
             pls->input_read_done = 0;
@@ -2350,6 +2790,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
+        prefetch_cancel(pls);
         if (pls->input)
             ff_format_io_close_xij(pls->parent, &pls->input);
         pls->input_read_done = 0;
@@ -2418,6 +2859,10 @@ static const AVOption hls_options[] = {
         OFFSET(hls_io_protocol), AV_OPT_TYPE_STRING, {.str= NULL}, 0, 0, FLAGS},
     {"hls_io_protocol_enable", "enable auto copy segment io protocol from playlist",
         OFFSET(hls_io_protocol_enable), AV_OPT_TYPE_BOOL, {.i64= 0}, 0, 1, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead in the background",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_buffer_size", "Maximum amount of prefetched data kept per playlist",
+        OFFSET(prefetch_buffer_size), AV_OPT_TYPE_INT64, {.i64 = 16 * 1024 * 1024}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -27,10 +27,12 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
 #include "libavutil/application.h"
+#include "libavutil/thread.h"
 
 #include "avformat.h"
 #include "http.h"
@@ -52,6 +54,7 @@
 #define HTTP_MUTLI    2
 #define MAX_EXPIRY    19
 #define WHITESPACES " \n\t\r"
+#define POOL_MAX_CONNS 32
 typedef enum {
     LOWER_PROTO,
     READ_HEADERS,
@@ -59,9 +62,27 @@ typedef enum {
     FINISH
 }HandshakeState;
 
+/* A keep-alive connection that can be handed from one HTTPContext to the
+ * next request for the same server. The lower protocol is opened with an
+ * interrupt callback pointing here, so that it follows whichever context
+ * currently uses the connection. */
+typedef struct HTTPPoolConn {
+    char *key;
+    URLContext *hd;
+    AVIOInterruptCB owner_cb;
+    int64_t expiry;
+    struct HTTPPoolConn *next;
+} HTTPPoolConn;
+
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+static HTTPPoolConn *pool_idle;
+static int pool_nb_idle;
+
 typedef struct HTTPContext {
     const AVClass *class;
     URLContext *hd;
+    /* Set if hd may be returned to the connection pool. */
+    HTTPPoolConn *conn;
     unsigned char buffer[BUFFER_SIZE], *buf_ptr, *buf_end;
     int line_count;
     int http_code;
@@ -75,6 +96,8 @@ typedef struct HTTPContext {
     char *http_proxy;
     char *headers;
     char *mime_type;
+    char *etag;
+    char *last_modified;
     char *http_version;
     char *user_agent;
     char *referer;
@@ -129,6 +152,9 @@ typedef struct HTTPContext {
     char *tcp_hook;
     int64_t app_ctx_intptr;
     AVApplicationContext *app_ctx;
+    int connection_pool;
+    int pool_idle_timeout;
+    int pool_max_per_host;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -150,6 +176,8 @@ static const AVOption options[] = {
     { "multiple_requests", "use persistent connections", OFFSET(multiple_requests), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D | E },
     { "post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D | E },
     { "mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "etag", "export the ETag of the resource", OFFSET(etag), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "last_modified", "export the Last-Modified date of the resource", OFFSET(last_modified), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "http_version", "export the http response version", OFFSET(http_version), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "cookies", "set cookies to be sent in applicable future requests, use newline delimited Set-Cookie HTTP field value syntax", OFFSET(cookies), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     { "icy", "request ICY metadata", OFFSET(icy), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
@@ -173,6 +201,9 @@ static const AVOption options[] = {
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "http-tcp-hook", "hook protocol on tcp", OFFSET(tcp_hook), AV_OPT_TYPE_STRING, { .str = "tcp" }, 0, 0, D | E },
     { "ijkapplication", "AVApplicationContext", OFFSET(app_ctx_intptr), AV_OPT_TYPE_INT64, { .i64 = 0 }, INT64_MIN, INT64_MAX, .flags = D },
+    { "connection_pool", "reuse idle keep-alive connections across contexts", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "pool_idle_timeout", "seconds an idle pooled connection is kept", OFFSET(pool_idle_timeout), AV_OPT_TYPE_INT, { .i64 = 15 }, 0, INT_MAX / 1000000, D },
+    { "pool_max_per_host", "max idle pooled connections per server", OFFSET(pool_max_per_host), AV_OPT_TYPE_INT, { .i64 = 4 }, 0, POOL_MAX_CONNS, D },
     { NULL }
 };
 
@@ -192,6 +223,225 @@ void ff_http_init_auth_state_xij(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+static int pool_interrupt_cb(void *opaque)
+{
+    HTTPPoolConn *conn = opaque;
+    return ff_check_interrupt(&conn->owner_cb);
+}
+
+static void pool_conn_free(HTTPPoolConn **conn)
+{
+    if ((*conn)->hd)
+        ffurl_closep(&(*conn)->hd);
+    av_freep(&(*conn)->key);
+    av_freep(conn);
+}
+
+/* close the connection to the server, whether it is pooled or not */
+static void http_close_hd(HTTPContext *s)
+{
+    if (s->conn) {
+        s->conn->hd = s->hd;
+        s->hd = NULL;
+        pool_conn_free(&s->conn);
+    } else if (s->hd) {
+        ffurl_closep(&s->hd);
+    }
+}
+
+/* a connection is only pooled with options it was opened with */
+static char *pool_make_key(HTTPContext *s, const char *lower_url, AVDictionary *options)
+{
+    static const char * const tls_opts[] = { "ca_file", "cert_file", "key_file", "tls_verify", "verifyhost", NULL };
+    AVBPrint key;
+    char *str;
+    int i;
+
+    av_bprint_init(&key, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&key, "%s|%"PRId64, lower_url, s->app_ctx_intptr);
+    for (i = 0; tls_opts[i]; i++) {
+        AVDictionaryEntry *e = av_dict_get(options, tls_opts[i], NULL, 0);
+        av_bprintf(&key, "|%s", e ? e->value : "");
+    }
+    if (av_bprint_finalize(&key, &str) < 0)
+        return NULL;
+    return str;
+}
+
+/* an idle connection must have nothing to read, anything else means the
+ * server closed it or sent data we cannot attribute to a request */
+static int pool_conn_alive(HTTPPoolConn *conn)
+{
+    struct pollfd p;
+    int fd = ffurl_get_file_handle(conn->hd);
+
+    if (fd < 0)
+        return 1; /* cannot tell, a failed request is retried anyway */
+    p.fd      = fd;
+    p.events  = POLLIN;
+    p.revents = 0;
+    return poll(&p, 1, 0) == 0;
+}
+
+/* called with pool_mutex held */
+static void pool_drop_expired(HTTPPoolConn **expired)
+{
+    HTTPPoolConn **p = &pool_idle;
+    int64_t now = av_gettime_relative();
+
+    while (*p) {
+        HTTPPoolConn *conn = *p;
+        if (conn->expiry <= now) {
+            *p = conn->next;
+            conn->next = *expired;
+            *expired = conn;
+            pool_nb_idle--;
+        } else {
+            p = &conn->next;
+        }
+    }
+}
+
+static void pool_free_list(HTTPPoolConn *list)
+{
+    while (list) {
+        HTTPPoolConn *next = list->next;
+        pool_conn_free(&list);
+        list = next;
+    }
+}
+
+static HTTPPoolConn *pool_checkout(URLContext *h, const char *key)
+{
+    HTTPPoolConn **p, *conn = NULL, *dead = NULL;
+
+    ff_mutex_lock(&pool_mutex);
+    pool_drop_expired(&dead);
+    for (p = &pool_idle; *p; p = &(*p)->next) {
+        if (!strcmp((*p)->key, key)) {
+            conn = *p;
+            *p = conn->next;
+            pool_nb_idle--;
+            break;
+        }
+    }
+    ff_mutex_unlock(&pool_mutex);
+    pool_free_list(dead);
+
+    if (conn) {
+        conn->next     = NULL;
+        conn->owner_cb = h->interrupt_callback;
+        if (!pool_conn_alive(conn)) {
+            av_log(h, AV_LOG_DEBUG, "Pooled connection for %s was closed\n", key);
+            pool_conn_free(&conn);
+        }
+    }
+    return conn;
+}
+
+static int http_conn_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+
+    /* the response body must be known to have been consumed completely */
+    return s->conn && !s->willclose && !(h->flags & AVIO_FLAG_WRITE) &&
+           s->http_code >= 200 && s->http_code < 300 &&
+           s->chunksize == UINT64_MAX && s->filesize != UINT64_MAX &&
+           s->off >= target_end && s->buf_ptr == s->buf_end;
+}
+
+static void pool_checkin(HTTPContext *s)
+{
+    HTTPPoolConn *conn = s->conn, *dead = NULL, **p;
+    int nb_host = 0;
+
+    conn->hd     = s->hd;
+    conn->expiry = av_gettime_relative() + s->pool_idle_timeout * 1000000LL;
+    memset(&conn->owner_cb, 0, sizeof(conn->owner_cb));
+    s->hd   = NULL;
+    s->conn = NULL;
+
+    ff_mutex_lock(&pool_mutex);
+    pool_drop_expired(&dead);
+    for (p = &pool_idle; *p; p = &(*p)->next)
+        nb_host += !strcmp((*p)->key, conn->key);
+    if (nb_host < s->pool_max_per_host && pool_nb_idle < POOL_MAX_CONNS) {
+        conn->next = pool_idle;
+        pool_idle  = conn;
+        pool_nb_idle++;
+        conn = NULL;
+    }
+    ff_mutex_unlock(&pool_mutex);
+
+    pool_free_list(dead);
+    if (conn)
+        pool_conn_free(&conn);
+}
+
+/* report a reused connection like one that connected instantly, so that the
+ * application sees the same tcp open events for every request */
+static int pool_report_reuse(HTTPContext *s, AVDictionary *options)
+{
+    AVAppTcpIOControl control = { 0 };
+    AVDictionaryEntry *e = av_dict_get(options, "dash_audio_tcp", NULL, 0);
+    int ret;
+
+    if ((ret = av_application_on_tcp_will_open(s->app_ctx))) {
+        av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_WILL_TCP_OPEN");
+        return ret;
+    }
+    if ((ret = av_application_on_tcp_did_open(s->app_ctx, 0, ffurl_get_file_handle(s->hd), &control,
+                                              e ? atoi(e->value) : 0, 0))) {
+        av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_DID_TCP_OPEN");
+        return ret;
+    }
+    return 0;
+}
+
+/* open the lower protocol, or take an established connection from the pool */
+static int http_open_lower(URLContext *h, const char *lower_url, AVDictionary **options, int *reused)
+{
+    HTTPContext *s = h->priv_data;
+    AVIOInterruptCB cb;
+    char *key;
+    int err;
+
+    *reused = 0;
+    if (!s->connection_pool || (h->flags & AVIO_FLAG_WRITE) || s->post_data)
+        return ffurl_open_whitelist(&s->hd, lower_url, AVIO_FLAG_READ_WRITE,
+                                    &h->interrupt_callback, options,
+                                    h->protocol_whitelist, h->protocol_blacklist, h);
+
+    if (!(key = pool_make_key(s, lower_url, *options)))
+        return AVERROR(ENOMEM);
+
+    if ((s->conn = pool_checkout(h, key))) {
+        av_free(key);
+        s->hd   = s->conn->hd;
+        s->conn->hd = NULL;
+        *reused = 1;
+        if ((err = pool_report_reuse(s, *options)))
+            http_close_hd(s);
+        return err;
+    }
+
+    if (!(s->conn = av_mallocz(sizeof(*s->conn)))) {
+        av_free(key);
+        return AVERROR(ENOMEM);
+    }
+    s->conn->key      = key;
+    s->conn->owner_cb = h->interrupt_callback;
+    cb.callback = pool_interrupt_cb;
+    cb.opaque   = s->conn;
+    err = ffurl_open_whitelist(&s->hd, lower_url, AVIO_FLAG_READ_WRITE,
+                               &cb, options,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    if (err < 0)
+        http_close_hd(s);
+    return err;
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -202,6 +452,8 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     int port, use_proxy, err, location_changed = 0;
     char prev_location[4096];
     HTTPContext *s = h->priv_data;
+    uint64_t off = s->off, filesize = s->filesize;
+    int reused = 0;
 
     lower_proto = s->tcp_hook;
 
@@ -243,16 +495,27 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     if (!s->hd) {
         av_dict_set_int(options, "ijkapplication", (int64_t)(intptr_t)s->app_ctx, 0);
-        err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
-                                   &h->interrupt_callback, options,
-                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        err = http_open_lower(h, buf, options, &reused);
         if (err < 0)
             return err;
     }
 
     av_strlcpy(prev_location, s->location, sizeof(prev_location));
+    s->line_count = 0;
     err = http_connect(h, path, local_path, hoststr,
                        auth, proxyauth, &location_changed);
+    if (err < 0 && reused && !s->line_count) {
+        /* the server dropped the pooled connection before answering */
+        av_log(h, AV_LOG_DEBUG, "Pooled connection failed, reconnecting\n");
+        http_close_hd(s);
+        s->off      = off;
+        s->filesize = filesize;
+        err = http_open_lower(h, buf, options, &reused);
+        if (err < 0)
+            return err;
+        err = http_connect(h, path, local_path, hoststr,
+                           auth, proxyauth, &location_changed);
+    }
     if (err < 0)
         return err;
 
@@ -279,7 +542,7 @@ redo:
     if (s->http_code == 401) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
             s->auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_hd(s);
             goto redo;
         } else
             goto fail;
@@ -287,7 +550,7 @@ redo:
     if (s->http_code == 407) {
         if ((cur_proxy_auth_type == HTTP_AUTH_NONE || s->proxy_auth_state.stale) &&
             s->proxy_auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_close_hd(s);
             goto redo;
         } else
             goto fail;
@@ -296,7 +559,7 @@ redo:
          s->http_code == 303 || s->http_code == 307) &&
         location_changed == 1) {
         /* url moved, get next */
-        ffurl_closep(&s->hd);
+        http_close_hd(s);
         if (redirects++ >= MAX_REDIRECTS)
             return AVERROR(EIO);
         /* Restart the authentication process with the new target, which
@@ -309,8 +572,7 @@ redo:
     return 0;
 
 fail:
-    if (s->hd)
-        ffurl_closep(&s->hd);
+    http_close_hd(s);
     if (location_changed < 0)
         return location_changed;
     return ff_http_averror_xij(s->http_code, AVERROR(EIO));
@@ -1024,6 +1286,12 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!av_strcasecmp(tag, "Content-Type")) {
             av_free(s->mime_type);
             s->mime_type = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "ETag")) {
+            av_free(s->etag);
+            s->etag = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "Last-Modified")) {
+            av_free(s->last_modified);
+            s->last_modified = av_strdup(p);
         } else if (!av_strcasecmp(tag, "Set-Cookie")) {
             if (parse_cookie(s, p, &s->cookie_dict))
                 av_log(h, AV_LOG_WARNING, "Unable to parse '%s'\n", p);
@@ -1260,7 +1528,7 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
                            "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: ")) {
-        if (s->multiple_requests)
+        if (s->multiple_requests || s->conn)
             len += av_strlcpy(headers + len, "Connection: keep-alive\r\n",
                               sizeof(headers) - len);
         else
@@ -1687,8 +1955,10 @@ static int http_close(URLContext *h)
         /* Close the write direction by sending the end of chunked encoding. */
         ret = http_shutdown(h, h->flags);
 
-    if (s->hd)
-        ffurl_closep(&s->hd);
+    if (s->hd && http_conn_reusable(h))
+        pool_checkin(s);
+    else
+        http_close_hd(s);
     av_dict_free(&s->chained_options);
     return ret;
 }
@@ -1697,6 +1967,7 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
 {
     HTTPContext *s = h->priv_data;
     URLContext *old_hd = s->hd;
+    HTTPPoolConn *old_conn = s->conn;
     uint64_t old_off = s->off;
     uint8_t old_buf[BUFFER_SIZE];
     int old_buf_size, ret;
@@ -1728,7 +1999,8 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     /* we save the old context in case the seek fails */
     old_buf_size = s->buf_end - s->buf_ptr;
     memcpy(old_buf, s->buf_ptr, old_buf_size);
-    s->hd = NULL;
+    s->hd   = NULL;
+    s->conn = NULL;
 
     /* if it fails, continue on old connection */
     start_time = av_gettime();
@@ -1741,13 +2013,19 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
         s->buf_ptr = s->buffer;
         s->buf_end = s->buffer + old_buf_size;
         s->hd      = old_hd;
+        s->conn    = old_conn;
         s->off     = old_off;
         return ret;
     }
     end_time = av_gettime();
     av_application_did_http_seek(s->app_ctx, (void*)h, s->location, off, ret, s->http_code, start_time, end_time);
     av_dict_free(&options);
-    ffurl_close(old_hd);
+    if (old_conn) {
+        old_conn->hd = old_hd;
+        pool_conn_free(&old_conn);
+    } else {
+        ffurl_close(old_hd);
+    }
     return off;
 }
 
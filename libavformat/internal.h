@@ -144,6 +144,12 @@ struct AVFormatInternal {
      * Prefer the codec framerate for avg_frame_rate computation.
      */
     int prefer_codec_framerate;
+
+    /**
+     * Worker threads decoding packets in avformat_find_stream_info_ijk(),
+     * NULL when decoding on the calling thread.
+     */
+    struct ProbeThreadContext *probe_threads;
 };
 
 struct AVStreamInternal {
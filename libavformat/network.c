@@ -23,8 +23,10 @@
 #include "tls.h"
 #include "url.h"
 #include "libavcodec/internal.h"
+#include "libavutil/avstring.h"
 #include "libavutil/avutil.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 
 int ff_tls_init(void)
@@ -293,6 +295,318 @@ int ff_listen_connect(int fd, const struct sockaddr *addr,
     return ret;
 }
 
+/* Connect time and failures of recently used addresses, used to order the
+ * addresses of later connections (RFC 8305 section 4). */
+#define CONNECT_HISTORY_SIZE 64
+/* a failed address is tried last for this long */
+#define CONNECT_FAILURE_PENALTY (10 * 60 * 1000000LL)
+#define MAX_CONNECT_ADDRS 32
+#define MAX_CONNECT_ATTEMPTS 4
+
+typedef struct ConnectHistory {
+    struct sockaddr_storage addr;
+    int64_t rtt;        /* smoothed connect time in microseconds, 0 if unknown */
+    int64_t last_failure;
+    int64_t last_used;
+} ConnectHistory;
+
+static AVMutex connect_history_mutex = AV_MUTEX_INITIALIZER;
+static ConnectHistory connect_history[CONNECT_HISTORY_SIZE];
+
+static int sockaddr_equal(const struct sockaddr *a, const struct sockaddr *b)
+{
+    if (a->sa_family != b->sa_family)
+        return 0;
+    if (a->sa_family == AF_INET) {
+        const struct sockaddr_in *a4 = (const struct sockaddr_in *)a;
+        const struct sockaddr_in *b4 = (const struct sockaddr_in *)b;
+        return a4->sin_port == b4->sin_port &&
+               !memcmp(&a4->sin_addr, &b4->sin_addr, sizeof(a4->sin_addr));
+    }
+#if HAVE_STRUCT_SOCKADDR_IN6
+    if (a->sa_family == AF_INET6) {
+        const struct sockaddr_in6 *a6 = (const struct sockaddr_in6 *)a;
+        const struct sockaddr_in6 *b6 = (const struct sockaddr_in6 *)b;
+        return a6->sin6_port == b6->sin6_port &&
+               !memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(a6->sin6_addr));
+    }
+#endif
+    return 0;
+}
+
+/* called with connect_history_mutex held */
+static ConnectHistory *connect_history_find(const struct addrinfo *ai, int create)
+{
+    ConnectHistory *oldest = &connect_history[0];
+    int i;
+
+    for (i = 0; i < CONNECT_HISTORY_SIZE; i++) {
+        ConnectHistory *e = &connect_history[i];
+        if (e->last_used && sockaddr_equal((struct sockaddr *)&e->addr, ai->ai_addr))
+            return e;
+        if (e->last_used < oldest->last_used)
+            oldest = e;
+    }
+    if (!create || ai->ai_addrlen > sizeof(oldest->addr))
+        return NULL;
+    memset(oldest, 0, sizeof(*oldest));
+    memcpy(&oldest->addr, ai->ai_addr, ai->ai_addrlen);
+    return oldest;
+}
+
+static void connect_history_update(const struct addrinfo *ai, int64_t rtt, int failed)
+{
+    ConnectHistory *e;
+
+    ff_mutex_lock(&connect_history_mutex);
+    if ((e = connect_history_find(ai, 1))) {
+        e->last_used = av_gettime_relative();
+        if (failed) {
+            e->last_failure = e->last_used;
+        } else {
+            e->last_failure = 0;
+            e->rtt = e->rtt ? (7 * e->rtt + rtt) / 8 : rtt;
+        }
+    }
+    ff_mutex_unlock(&connect_history_mutex);
+}
+
+/* lower is better: known fast addresses, then unknown ones, then recent failures */
+static int64_t connect_score(const struct addrinfo *ai, int64_t now)
+{
+    ConnectHistory *e = connect_history_find(ai, 0);
+
+    if (!e)
+        return INT64_MAX / 4;
+    if (e->last_failure && now - e->last_failure < CONNECT_FAILURE_PENALTY)
+        return INT64_MAX / 2;
+    return e->rtt ? e->rtt : INT64_MAX / 4;
+}
+
+/**
+ * Order the addresses by connect history, then interleave the address
+ * families starting with the family of the best address, so that a broken
+ * family only costs one attempt delay. The list itself may be shared with
+ * the DNS cache, so only the array of pointers is reordered.
+ */
+static int order_addresses(struct addrinfo *addrs, struct addrinfo **out)
+{
+    struct addrinfo *sorted[MAX_CONNECT_ADDRS];
+    int64_t score[MAX_CONNECT_ADDRS];
+    int64_t now = av_gettime_relative();
+    int nb = 0, i, j, taken = 0;
+    int family;
+
+    ff_mutex_lock(&connect_history_mutex);
+    for (; addrs && nb < MAX_CONNECT_ADDRS; addrs = addrs->ai_next) {
+        int64_t sc = connect_score(addrs, now);
+        /* stable insertion sort, equal scores keep the resolver order */
+        for (i = nb; i > 0 && score[i - 1] > sc; i--) {
+            sorted[i] = sorted[i - 1];
+            score[i]  = score[i - 1];
+        }
+        sorted[i] = addrs;
+        score[i]  = sc;
+        nb++;
+    }
+    ff_mutex_unlock(&connect_history_mutex);
+
+    if (!nb)
+        return 0;
+    family = sorted[0]->ai_family;
+    for (i = 0; i < nb; i++) {
+        /* take the best remaining address of the wanted family, or any */
+        for (j = 0; j < nb; j++)
+            if (sorted[j] && sorted[j]->ai_family == family)
+                break;
+        if (j == nb)
+            for (j = 0; !sorted[j]; j++);
+        out[taken++] = sorted[j];
+        family = sorted[j]->ai_family == AF_INET ? AF_INET6 : AF_INET;
+        sorted[j] = NULL;
+    }
+    return taken;
+}
+
+static void log_address(URLContext *h, int level, const char *msg,
+                        const struct addrinfo *ai, int err)
+{
+    char hostbuf[100], portbuf[20], errbuf[100] = "";
+
+    if (av_log_get_level() < level)
+        return;
+    if (getnameinfo(ai->ai_addr, ai->ai_addrlen, hostbuf, sizeof(hostbuf),
+                    portbuf, sizeof(portbuf), NI_NUMERICHOST | NI_NUMERICSERV))
+        av_strlcpy(hostbuf, "?", sizeof(hostbuf));
+    if (err)
+        av_strerror(err, errbuf, sizeof(errbuf));
+    av_log(h, level, "%s %s port %s%s%s\n", msg, hostbuf, portbuf,
+           err ? ": " : "", errbuf);
+}
+
+typedef struct ConnectAttempt {
+    int fd;
+    int64_t start;
+    int64_t deadline;
+    struct addrinfo *ai;
+} ConnectAttempt;
+
+/* < 0 on error, 0 if the attempt is in progress, > 0 if it connected already */
+static int start_connect_attempt(ConnectAttempt *attempt, struct addrinfo *ai,
+                                 int timeout, URLContext *h,
+                                 void (*customize_fd)(void *, int), void *customize_ctx)
+{
+    int ret;
+
+    attempt->ai    = ai;
+    attempt->start = av_gettime_relative();
+    attempt->deadline = attempt->start + timeout * 1000LL;
+    attempt->fd = ff_socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (attempt->fd < 0)
+        return ff_neterrno();
+
+    if (ff_socket_nonblock(attempt->fd, 1) < 0)
+        av_log(NULL, AV_LOG_DEBUG, "ff_socket_nonblock failed\n");
+    if (customize_fd)
+        customize_fd(customize_ctx, attempt->fd);
+
+    while ((ret = connect(attempt->fd, ai->ai_addr, ai->ai_addrlen))) {
+        ret = ff_neterrno();
+        switch (ret) {
+        case AVERROR(EINTR):
+            if (ff_check_interrupt(&h->interrupt_callback)) {
+                ret = AVERROR_EXIT;
+                break;
+            }
+            continue;
+        case AVERROR(EINPROGRESS):
+        case AVERROR(EAGAIN):
+            return 0;
+        }
+        closesocket(attempt->fd);
+        attempt->fd = -1;
+        return ret;
+    }
+    return 1;
+}
+
+int ff_connect_parallel(struct addrinfo *addrs, int timeout, int parallel,
+                        int attempt_delay, URLContext *h, int *fd,
+                        void (*customize_fd)(void *, int), void *customize_ctx)
+{
+    struct addrinfo *order[MAX_CONNECT_ADDRS];
+    ConnectAttempt attempts[MAX_CONNECT_ATTEMPTS];
+    struct pollfd pfd[MAX_CONNECT_ATTEMPTS];
+    int nb_addrs, next = 0, nb_attempts = 0, i, j;
+    int64_t next_attempt = 0;
+    int ret = AVERROR(EIO);
+
+    parallel = av_clip(parallel, 1, MAX_CONNECT_ATTEMPTS);
+    nb_addrs = order_addresses(addrs, order);
+
+    while (nb_attempts > 0 || next < nb_addrs) {
+        int64_t now = av_gettime_relative(), wait;
+
+        /* start the next attempt if the previous one is slow or failed */
+        if (next < nb_addrs && nb_attempts < parallel &&
+            (!nb_attempts || now >= next_attempt)) {
+            ConnectAttempt *a = &attempts[nb_attempts];
+            log_address(h, AV_LOG_VERBOSE, "Starting connection attempt to", order[next], 0);
+            ret = start_connect_attempt(a, order[next++], timeout, h,
+                                        customize_fd, customize_ctx);
+            if (ret == AVERROR_EXIT)
+                break;
+            if (ret < 0) {
+                log_address(h, AV_LOG_VERBOSE, "Connection attempt failed to", a->ai, ret);
+                connect_history_update(a->ai, 0, 1);
+                next_attempt = now;
+                continue;
+            }
+            if (ret > 0) {
+                connect_history_update(a->ai, av_gettime_relative() - a->start, 0);
+                for (i = 0; i < nb_attempts; i++)
+                    closesocket(attempts[i].fd);
+                *fd = a->fd;
+                return 0;
+            }
+            pfd[nb_attempts].fd      = a->fd;
+            pfd[nb_attempts].events  = POLLOUT;
+            pfd[nb_attempts].revents = 0;
+            nb_attempts++;
+            next_attempt = now + attempt_delay * 1000LL;
+        }
+
+        /* attempts are sorted oldest first, so the first one expires first */
+        wait = attempts[0].deadline - now;
+        if (next < nb_addrs && nb_attempts < parallel)
+            wait = FFMIN(wait, next_attempt - now);
+        wait = av_clip64(wait / 1000, 0, POLLING_TIME);
+
+        if (ff_check_interrupt(&h->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        ret = poll(pfd, nb_attempts, wait);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret == AVERROR(EINTR))
+                continue;
+            break;
+        }
+
+        now = av_gettime_relative();
+        for (i = 0; i < nb_attempts; i++) {
+            ConnectAttempt *a = &attempts[i];
+            int err = 0;
+
+            if (pfd[i].revents) {
+                socklen_t optlen = sizeof(err);
+                if (getsockopt(a->fd, SOL_SOCKET, SO_ERROR, &err, &optlen))
+                    err = ff_neterrno();
+                else if (err)
+                    err = AVERROR(err);
+                if (!err) {
+                    log_address(h, AV_LOG_VERBOSE, "Successfully connected to", a->ai, 0);
+                    connect_history_update(a->ai, now - a->start, 0);
+                    for (j = 0; j < nb_attempts; j++)
+                        if (j != i)
+                            closesocket(attempts[j].fd);
+                    *fd = a->fd;
+                    return 0;
+                }
+            } else if (now >= a->deadline) {
+                err = AVERROR(ETIMEDOUT);
+            }
+            if (!err)
+                continue;
+
+            log_address(h, next < nb_addrs || nb_attempts > 1 ? AV_LOG_WARNING : AV_LOG_VERBOSE,
+                        "Connection attempt failed to", a->ai, err);
+            connect_history_update(a->ai, 0, 1);
+            closesocket(a->fd);
+            memmove(&attempts[i], &attempts[i + 1], (nb_attempts - i - 1) * sizeof(*attempts));
+            memmove(&pfd[i], &pfd[i + 1], (nb_attempts - i - 1) * sizeof(*pfd));
+            nb_attempts--;
+            i--;
+            /* a failure lets the next address start right away */
+            next_attempt = now;
+            ret = err;
+        }
+    }
+
+    for (i = 0; i < nb_attempts; i++)
+        closesocket(attempts[i].fd);
+    if (ret >= 0)
+        ret = AVERROR(ECONNREFUSED);
+    if (ret != AVERROR_EXIT) {
+        char errbuf[100];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        av_log(h, AV_LOG_ERROR, "Connection to %s failed: %s\n",
+               h->filename, errbuf);
+    }
+    return ret;
+}
+
 int ff_sendto(int fd, const char *msg, int msg_len, int flag,
                       const struct sockaddr *addr,
                       socklen_t addrlen, int timeout, URLContext *h,
@@ -301,6 +301,29 @@ int ff_listen_connect(int fd, const struct sockaddr *addr,
                       socklen_t addrlen, int timeout,
                       URLContext *h, int will_try_next);
 
+/**
+ * Connect to any of the given addresses, racing several of them as
+ * described in RFC 8305 ("Happy Eyeballs"). Addresses are ordered by the
+ * connect time and failures remembered from earlier connections, with the
+ * address families interleaved. A new attempt starts when the previous one
+ * has not completed after attempt_delay or has failed.
+ *
+ * @param addrs         List of addresses to try, not modified.
+ * @param timeout       Timeout in milliseconds for each attempt.
+ * @param parallel      Maximum number of concurrent attempts.
+ * @param attempt_delay Delay in milliseconds before starting the next attempt.
+ * @param h             URLContext providing interrupt check
+ *                      callback and logging context.
+ * @param fd            Set to the connected, non-blocking socket on success.
+ * @param customize_fd  Function called on each new socket before connecting,
+ *                      may be NULL.
+ * @param customize_ctx Context passed to customize_fd.
+ * @return              0 on success, AVERROR on failure.
+ */
+int ff_connect_parallel(struct addrinfo *addrs, int timeout, int parallel,
+                        int attempt_delay, URLContext *h, int *fd,
+                        void (*customize_fd)(void *, int), void *customize_ctx);
+
 int ff_sendto(int fd, const char *msg, int msg_len, int flag,
                       const struct sockaddr *addr,
                       socklen_t addrlen, int timeout, URLContext *h,
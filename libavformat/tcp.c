@@ -61,6 +61,8 @@ typedef struct TCPContext {
     int fastopen_success;
     int dash_audio_tcp;
     int dash_video_tcp;
+    int connect_parallel;
+    int connect_attempt_delay;
 } TCPContext;
 
 #define FAST_OPEN_FLAG 0x20000000
@@ -85,6 +87,8 @@ static const AVOption options[] = {
     { "fastopen", "enable fastopen",          OFFSET(fastopen), AV_OPT_TYPE_INT, { .i64 = 0},       0, INT_MAX, .flags = D|E },
     { "dash_audio_tcp", "dash audio tcp", OFFSET(dash_audio_tcp), AV_OPT_TYPE_INT, { .i64 = 0},       0, 1, .flags = D|E },
     { "dash_video_tcp", "dash video tcp", OFFSET(dash_video_tcp), AV_OPT_TYPE_INT, { .i64 = 0},       0, 1, .flags = D|E },
+    { "connect_parallel", "max number of addresses connected to concurrently", OFFSET(connect_parallel), AV_OPT_TYPE_INT, { .i64 = 2 }, 1, 4, .flags = D|E },
+    { "connect_attempt_delay", "delay (in milliseconds) before trying the next address", OFFSET(connect_attempt_delay), AV_OPT_TYPE_INT, { .i64 = 250 }, 10, INT_MAX, .flags = D|E },
     { NULL }
 };
 
@@ -343,6 +347,22 @@ int ijk_tcp_getaddrinfo_nonblock(const char *hostname, const char *servname,
 }
 #endif
 
+static void customize_fd(void *ctx, int fd)
+{
+    TCPContext *s = ctx;
+    /* Set the socket's send or receive buffer sizes, if specified.
+       If unspecified or setting fails, system default is used. */
+    if (s->recv_buffer_size > 0) {
+        setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &s->recv_buffer_size, sizeof (s->recv_buffer_size));
+    }
+    if (s->send_buffer_size > 0) {
+        setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &s->send_buffer_size, sizeof (s->send_buffer_size));
+    }
+    if (s->tcp_nodelay > 0) {
+        setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &s->tcp_nodelay, sizeof (s->tcp_nodelay));
+    }
+}
+
 /* return non zero if error */
 static int tcp_open(URLContext *h, const char *uri, int flags)
 {
@@ -414,9 +434,9 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     if (s->dns_cache_timeout > 0) {
         if (s->dns_cache_clear) {
             av_log(NULL, AV_LOG_INFO, "will delete dns cache entry, uri = %s\n", uri);
-            remove_dns_cache_entry(uri);
+            remove_dns_cache_entry(hostname, portstr);
         } else {
-            dns_entry = get_dns_cache_reference(uri);
+            dns_entry = get_dns_cache_reference(hostname, portstr);
         }
     }
     av_application_on_dns_will_open(s->app_ctx, hostname);
@@ -454,14 +474,21 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     }
     dns_time = (av_gettime() - dns_time) / 1000;
 
- restart:
 #if HAVE_STRUCT_SOCKADDR_IN6
     // workaround for IOS9 getaddrinfo in IPv6 only network use hardcode IPv4 address can not resolve port number.
+    if (!dns_entry) {
+        for (cur_ai = ai; cur_ai; cur_ai = cur_ai->ai_next) {
+            if (cur_ai->ai_family == AF_INET6) {
+                struct sockaddr_in6 * sockaddr_v6 = (struct sockaddr_in6 *)cur_ai->ai_addr;
+                if (!sockaddr_v6->sin6_port){
+                    sockaddr_v6->sin6_port = htons(port);
+                }
+            }
+        }
+        cur_ai = ai;
+    }
     if (cur_ai->ai_family == AF_INET6){
         struct sockaddr_in6 * sockaddr_v6 = (struct sockaddr_in6 *)cur_ai->ai_addr;
-        if (!sockaddr_v6->sin6_port){
-            sockaddr_v6->sin6_port = htons(port);
-        }
         c_ipaddr = (char *)inet_ntop(AF_INET, &sockaddr_v6->sin6_addr, ipbuf, MAX_IP_LEN);
     }
 #endif
@@ -472,21 +499,13 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     if (dns_entry) {
         av_application_on_dns_did_open(s->app_ctx, hostname, c_ipaddr, DNS_TYPE_DNS_CACHE, dns_time, s->dash_audio_tcp, 0);
     } else {
-        if (strstr(uri, c_ipaddr)) {
+        if (c_ipaddr && strstr(uri, c_ipaddr)) {
             av_application_on_dns_did_open(s->app_ctx, hostname, c_ipaddr, DNS_TYPE_NO_USE, dns_time, s->dash_audio_tcp, 0);
         } else {
             av_application_on_dns_did_open(s->app_ctx, hostname, c_ipaddr, DNS_TYPE_LOCAL_DNS, dns_time, s->dash_audio_tcp, 0);
         }
     }
 
-    fd = ff_socket(cur_ai->ai_family,
-                   cur_ai->ai_socktype,
-                   cur_ai->ai_protocol);
-    if (fd < 0) {
-        ret = ff_neterrno();
-        goto fail;
-    }
-
     if (s->app_ctx) {
         if (s->dash_audio_tcp && s->app_ctx->dash_audio_recv_buffer_size > 0 && s->app_ctx->dash_audio_recv_buffer_size != s->recv_buffer_size) {
             s->recv_buffer_size = s->app_ctx->dash_audio_recv_buffer_size;
@@ -495,65 +514,64 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
         }
     }
 
-    /* Set the socket's send or receive buffer sizes, if specified.
-       If unspecified or setting fails, system default is used. */
-    if (s->recv_buffer_size > 0) {
-        setsockopt (fd, SOL_SOCKET, SO_RCVBUF, &s->recv_buffer_size, sizeof (s->recv_buffer_size));
-    }
-    if (s->send_buffer_size > 0) {
-        setsockopt (fd, SOL_SOCKET, SO_SNDBUF, &s->send_buffer_size, sizeof (s->send_buffer_size));
+    if (!s->listen) {
+        ret = av_application_on_tcp_will_open(s->app_ctx);
+        if (ret) {
+            av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_WILL_TCP_OPEN");
+            goto fail1;
+        }
+        tcp_time = av_gettime();
+        /* race the addresses, the DID_TCP_OPEN event reports the one that won */
+        ret = ff_connect_parallel(cur_ai, s->open_timeout / 1000, s->connect_parallel,
+                                  s->connect_attempt_delay, h, &fd, customize_fd, s);
+        if (ret < 0) {
+            if (ret == AVERROR(ETIMEDOUT)) {
+                ret = AVERROR_TCP_CONNECT_TIMEOUT;
+            }
+            av_application_on_tcp_did_open(s->app_ctx, ret, fd, &control, s->dash_audio_tcp, (av_gettime() - tcp_time) / 1000);
+            goto fail1;
+        }
+        ret = av_application_on_tcp_did_open(s->app_ctx, 0, fd, &control, s->dash_audio_tcp, (av_gettime() - tcp_time) / 1000);
+        if (ret) {
+            av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_DID_TCP_OPEN");
+            goto fail1;
+        } else if (!dns_entry && !strstr(hostname, control.ip) && s->dns_cache_timeout > 0) {
+            add_dns_cache_entry(hostname, portstr, &hints, ai, s->dns_cache_timeout);
+            av_log(NULL, AV_LOG_INFO, "add dns cache uri = %s, ip = %s port = %d\n", uri , control.ip, control.port);
+        }
+        av_log(NULL, AV_LOG_INFO, "tcp did open uri = %s, ip = %s port = %d\n", uri , control.ip, control.port);
+        goto done;
     }
-    if (s->tcp_nodelay > 0) {
-        setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &s->tcp_nodelay, sizeof (s->tcp_nodelay));
+
+ restart:
+    fd = ff_socket(cur_ai->ai_family,
+                   cur_ai->ai_socktype,
+                   cur_ai->ai_protocol);
+    if (fd < 0) {
+        ret = ff_neterrno();
+        goto fail;
     }
+    customize_fd(s, fd);
 
     if (s->listen == 2) {
         // multi-client
         if ((ret = ff_listen(fd, cur_ai->ai_addr, cur_ai->ai_addrlen)) < 0)
             goto fail1;
-    } else if (s->listen == 1) {
+    } else {
         // single client
         if ((ret = ff_listen_bind(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
                                   s->listen_timeout, h)) < 0)
             goto fail1;
         // Socket descriptor already closed here. Safe to overwrite to client one.
         fd = ret;
-    } else {
-        ret = av_application_on_tcp_will_open(s->app_ctx);
-        if (ret) {
-            av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_WILL_TCP_OPEN");
-            goto fail1;
-        }
-        tcp_time = av_gettime();
-        if ((ret = ff_listen_connect(fd, cur_ai->ai_addr, cur_ai->ai_addrlen,
-                                     s->open_timeout / 1000, h, !!cur_ai->ai_next)) < 0) {
-            if (ret == AVERROR(ETIMEDOUT)) {
-                ret = AVERROR_TCP_CONNECT_TIMEOUT;
-            }
-            if (av_application_on_tcp_did_open(s->app_ctx, ret, fd, &control, s->dash_audio_tcp, (av_gettime() - tcp_time) / 1000))
-                goto fail1;
-            if (ret == AVERROR_EXIT)
-                goto fail1;
-            else
-                goto fail;
-        } else {
-            ret = av_application_on_tcp_did_open(s->app_ctx, 0, fd, &control, s->dash_audio_tcp, (av_gettime() - tcp_time) / 1000);
-            if (ret) {
-                av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_DID_TCP_OPEN");
-                goto fail1;
-            } else if (!dns_entry && !strstr(uri, control.ip) && s->dns_cache_timeout > 0) {
-                add_dns_cache_entry(uri, cur_ai, s->dns_cache_timeout);
-                av_log(NULL, AV_LOG_INFO, "add dns cache uri = %s, ip = %s port = %d\n", uri , control.ip, control.port);
-            }
-            av_log(NULL, AV_LOG_INFO, "tcp did open uri = %s, ip = %s port = %d\n", uri , control.ip, control.port);
-        }
     }
 
+ done:
     h->is_streamed = 1;
     s->fd = fd;
 
     if (dns_entry) {
-        release_dns_cache_reference(uri, &dns_entry);
+        release_dns_cache_reference(&dns_entry);
     } else {
         freeaddrinfo(ai);
     }
@@ -574,8 +592,8 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
 
     if (dns_entry) {
         av_log(NULL, AV_LOG_ERROR, "hit dns cache but connect fail uri = %s, ip = %s\n", uri , control.ip);
-        release_dns_cache_reference(uri, &dns_entry);
-        remove_dns_cache_entry(uri);
+        release_dns_cache_reference(&dns_entry);
+        remove_dns_cache_entry(hostname, portstr);
     } else {
         freeaddrinfo(ai);
     }
@@ -637,9 +655,9 @@ static int tcp_fast_open(URLContext *h, const char *http_request, const char *ur
     if (s->dns_cache_timeout > 0) {
         if (s->dns_cache_clear) {
             av_log(NULL, AV_LOG_INFO, "will delete dns cache entry, uri = %s\n", uri);
-            remove_dns_cache_entry(uri);
+            remove_dns_cache_entry(hostname, portstr);
         } else {
-            dns_entry = get_dns_cache_reference(uri);
+            dns_entry = get_dns_cache_reference(hostname, portstr);
         }
     }
 
@@ -730,8 +748,8 @@ static int tcp_fast_open(URLContext *h, const char *http_request, const char *ur
             if (ret) {
                 av_log(NULL, AV_LOG_WARNING, "terminated by application in AVAPP_CTRL_DID_TCP_OPEN");
                 goto fail1;
-            } else if (!dns_entry && !strstr(uri, control.ip) && s->dns_cache_timeout > 0) {
-                add_dns_cache_entry(uri, cur_ai, s->dns_cache_timeout);
+            } else if (!dns_entry && !strstr(hostname, control.ip) && s->dns_cache_timeout > 0) {
+                add_dns_cache_entry(hostname, portstr, &hints, ai, s->dns_cache_timeout);
                 av_log(NULL, AV_LOG_INFO, "add dns cache uri = %s, ip = %s\n", uri , control.ip);
             }
             av_log(NULL, AV_LOG_INFO, "tcp did open uri = %s, ip = %s\n", uri , control.ip);
@@ -742,7 +760,7 @@ static int tcp_fast_open(URLContext *h, const char *http_request, const char *ur
     s->fd = fd;
 
     if (dns_entry) {
-        release_dns_cache_reference(uri, &dns_entry);
+        release_dns_cache_reference(&dns_entry);
     } else {
         freeaddrinfo(ai);
     }
@@ -763,8 +781,8 @@ static int tcp_fast_open(URLContext *h, const char *http_request, const char *ur
 
     if (dns_entry) {
         av_log(NULL, AV_LOG_ERROR, "hit dns cache but connect fail uri = %s, ip = %s\n", uri , control.ip);
-        release_dns_cache_reference(uri, &dns_entry);
-        remove_dns_cache_entry(uri);
+        release_dns_cache_reference(&dns_entry);
+        remove_dns_cache_entry(hostname, portstr);
     } else {
         freeaddrinfo(ai);
     }
@@ -1580,6 +1580,8 @@ static int64_t ts_to_samples(AVStream *st, int64_t ts)
     return av_rescale(ts, st->time_base.num * st->codecpar->sample_rate, st->time_base.den);
 }
 
+static void probe_threads_wait(AVFormatContext *s, AVStream *st);
+
 static int read_frame_internal_ijk(AVFormatContext *s, AVPacket *pkt)
 {
     int ret = 0, i, got_packet = 0;
@@ -1597,6 +1599,7 @@ static int read_frame_internal_ijk(AVFormatContext *s, AVPacket *pkt)
             if (ret == AVERROR(EAGAIN))
                 return ret;
             /* flush the parsers */
+            probe_threads_wait(s, NULL);
             for (i = 0; i < s->nb_streams; i++) {
                 st = s->streams[i];
                 if (st->parser && st->need_parsing)
@@ -1608,6 +1611,7 @@ static int read_frame_internal_ijk(AVFormatContext *s, AVPacket *pkt)
         }
         ret = 0;
         st  = s->streams[cur_pkt.stream_index];
+        probe_threads_wait(s, st);
 
         /* update context if required */
         if (st->internal->need_context_update) {
@@ -3097,7 +3101,10 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
         goto fail;
     }
 
-    if (avpriv_codec_get_cap_skip_frame_fill_param_xij(avctx->codec)) {
+    /* Decoders with this capability fill in the parameters from the headers
+     * alone, so do not reconstruct any picture as long as that is enough. */
+    if (avpriv_codec_get_cap_skip_frame_fill_param_xij(avctx->codec) &&
+        !has_codec_parameters(st, NULL)) {
         do_skip_frame = 1;
         skip_frame = avctx->skip_frame;
         avctx->skip_frame = AVDISCARD_ALL;
@@ -3132,6 +3139,14 @@ static int try_decode_frame(AVFormatContext *s, AVStream *st, AVPacket *avpkt,
                 st->nb_decoded_frames++;
             ret       = got_picture;
         }
+        /* The headers did not tell the decoder delay, find it by decoding
+         * the packet again for real. */
+        if (do_skip_frame && avctx->skip_frame != skip_frame && ret >= 0 &&
+            avpkt->size > 0 && has_codec_parameters(st, NULL) &&
+            !has_decode_delay_been_guessed(st)) {
+            avctx->skip_frame = skip_frame;
+            pkt = *avpkt;
+        }
     }
 
     if (!pkt.data && !got_picture)
@@ -3146,6 +3161,229 @@ fail:
     return ret;
 }
 
+static void decode_probe_packet(AVFormatContext *s, AVStream *st, AVPacket *pkt,
+                                AVDictionary **options)
+{
+    try_decode_frame(s, st, pkt, options);
+    st->codec_info_nb_frames++;
+}
+
+#if HAVE_THREADS
+/*
+ * Packets of different streams are decoded concurrently while probing. At
+ * most one packet per stream is in flight, and the reading thread waits for
+ * it before it touches the stream again, i.e. before parsing or looking at
+ * the next packet of that stream or checking its parameters. Each stream
+ * thus sees the same sequence of operations as when decoding serially.
+ */
+enum ProbeJobState {
+    PROBE_JOB_IDLE,
+    PROBE_JOB_QUEUED,
+    PROBE_JOB_RUNNING,
+};
+
+typedef struct ProbeJob {
+    AVStream *st;
+    AVPacket pkt;
+    AVDictionary **options;
+    enum ProbeJobState state;
+} ProbeJob;
+
+typedef struct ProbeThreadContext {
+    AVFormatContext *ic;
+    pthread_t *workers;
+    int nb_workers;
+    pthread_mutex_t lock;
+    pthread_cond_t job_cond;  ///< signalled when a job is queued or on exit
+    pthread_cond_t done_cond; ///< signalled when a job has been decoded
+    ProbeJob **jobs;          ///< indexed by stream index
+    int nb_jobs;
+    int exit;
+} ProbeThreadContext;
+
+static void *probe_worker(void *arg)
+{
+    ProbeThreadContext *pt = arg;
+
+    pthread_mutex_lock(&pt->lock);
+    for (;;) {
+        ProbeJob *job = NULL;
+        int i;
+
+        for (i = 0; i < pt->nb_jobs && !job; i++)
+            if (pt->jobs[i]->state == PROBE_JOB_QUEUED)
+                job = pt->jobs[i];
+        if (!job) {
+            if (pt->exit)
+                break;
+            pthread_cond_wait(&pt->job_cond, &pt->lock);
+            continue;
+        }
+        job->state = PROBE_JOB_RUNNING;
+        pthread_mutex_unlock(&pt->lock);
+
+        decode_probe_packet(pt->ic, job->st, &job->pkt, job->options);
+        av_packet_unref_ijk(&job->pkt);
+
+        pthread_mutex_lock(&pt->lock);
+        job->state = PROBE_JOB_IDLE;
+        pthread_cond_broadcast(&pt->done_cond);
+    }
+    pthread_mutex_unlock(&pt->lock);
+
+    return NULL;
+}
+
+static void probe_threads_uninit(AVFormatContext *s)
+{
+    ProbeThreadContext *pt = s->internal->probe_threads;
+    int i;
+
+    if (!pt)
+        return;
+
+    /* the workers finish the queued jobs before exiting */
+    pthread_mutex_lock(&pt->lock);
+    pt->exit = 1;
+    pthread_cond_broadcast(&pt->job_cond);
+    pthread_mutex_unlock(&pt->lock);
+    for (i = 0; i < pt->nb_workers; i++)
+        pthread_join(pt->workers[i], NULL);
+
+    for (i = 0; i < pt->nb_jobs; i++)
+        av_freep(&pt->jobs[i]);
+    av_freep(&pt->jobs);
+    av_freep(&pt->workers);
+    pthread_cond_destroy(&pt->done_cond);
+    pthread_cond_destroy(&pt->job_cond);
+    pthread_mutex_destroy(&pt->lock);
+    av_freep(&s->internal->probe_threads);
+}
+
+static int probe_threads_init(AVFormatContext *s, int nb_threads)
+{
+    ProbeThreadContext *pt;
+    int ret;
+
+    pt = av_mallocz(sizeof(*pt));
+    if (!pt)
+        return AVERROR(ENOMEM);
+    pt->ic      = s;
+    pt->workers = av_malloc_array(nb_threads, sizeof(*pt->workers));
+    if (!pt->workers) {
+        av_free(pt);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&pt->lock, NULL);
+    pthread_cond_init(&pt->job_cond, NULL);
+    pthread_cond_init(&pt->done_cond, NULL);
+    s->internal->probe_threads = pt;
+
+    for (; pt->nb_workers < nb_threads; pt->nb_workers++) {
+        ret = pthread_create(&pt->workers[pt->nb_workers], NULL, probe_worker, pt);
+        if (ret) {
+            probe_threads_uninit(s);
+            return AVERROR(ret);
+        }
+    }
+    return 0;
+}
+
+/* wait until the packets of st (or of all streams if NULL) are decoded */
+static void probe_threads_wait(AVFormatContext *s, AVStream *st)
+{
+    ProbeThreadContext *pt = s->internal->probe_threads;
+    int i;
+
+    if (!pt)
+        return;
+
+    pthread_mutex_lock(&pt->lock);
+    for (i = st ? st->index : 0; i < (st ? st->index + 1 : pt->nb_jobs); i++)
+        while (i < pt->nb_jobs && pt->jobs[i]->state != PROBE_JOB_IDLE)
+            pthread_cond_wait(&pt->done_cond, &pt->lock);
+    pthread_mutex_unlock(&pt->lock);
+}
+
+/* whether a packet of st is still queued or being decoded */
+static int probe_threads_busy(AVFormatContext *s, AVStream *st)
+{
+    ProbeThreadContext *pt = s->internal->probe_threads;
+    int busy;
+
+    if (!pt)
+        return 0;
+
+    pthread_mutex_lock(&pt->lock);
+    busy = st->index < pt->nb_jobs && pt->jobs[st->index]->state != PROBE_JOB_IDLE;
+    pthread_mutex_unlock(&pt->lock);
+    return busy;
+}
+
+static void probe_threads_submit(AVFormatContext *s, AVStream *st, AVPacket *pkt,
+                                 AVDictionary **options)
+{
+    ProbeThreadContext *pt = s->internal->probe_threads;
+    ProbeJob *job;
+
+    probe_threads_wait(s, st);
+
+    pthread_mutex_lock(&pt->lock);
+    while (pt->nb_jobs <= st->index) {
+        ProbeJob **jobs = av_realloc_array(pt->jobs, pt->nb_jobs + 1, sizeof(*jobs));
+        if (!jobs)
+            break;
+        pt->jobs = jobs;
+        if (!(jobs[pt->nb_jobs] = av_mallocz(sizeof(**jobs))))
+            break;
+        pt->nb_jobs++;
+    }
+    pthread_mutex_unlock(&pt->lock);
+
+    /* decode on this thread if anything failed */
+    if (pt->nb_jobs <= st->index) {
+        decode_probe_packet(s, st, pkt, options);
+        return;
+    }
+    job = pt->jobs[st->index];
+    if (av_packet_ref_ijk(&job->pkt, pkt) < 0) {
+        decode_probe_packet(s, st, pkt, options);
+        return;
+    }
+    job->st      = st;
+    job->options = options;
+
+    pthread_mutex_lock(&pt->lock);
+    job->state = PROBE_JOB_QUEUED;
+    pthread_cond_signal(&pt->job_cond);
+    pthread_mutex_unlock(&pt->lock);
+}
+#else
+static void probe_threads_uninit(AVFormatContext *s)
+{
+}
+
+static int probe_threads_init(AVFormatContext *s, int nb_threads)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void probe_threads_wait(AVFormatContext *s, AVStream *st)
+{
+}
+
+static int probe_threads_busy(AVFormatContext *s, AVStream *st)
+{
+    return 0;
+}
+
+static void probe_threads_submit(AVFormatContext *s, AVStream *st, AVPacket *pkt,
+                                 AVDictionary **options)
+{
+    decode_probe_packet(s, st, pkt, options);
+}
+#endif
+
 unsigned int ff_codec_get_tag_xij(const AVCodecTag *tags, enum AVCodecID id)
 {
     while (tags->id != AV_CODEC_ID_NONE) {
@@ -3779,21 +4017,33 @@ FF_ENABLE_DEPRECATION_WARNINGS
         ic->streams[i]->info->fps_last_dts  = AV_NOPTS_VALUE;
     }
 
+    if (ic->probe_threads > 1)
+        probe_threads_init(ic, ic->probe_threads);
+
     read_size = 0;
     for (;;) {
         int analyzed_all_streams;
+        int nb_busy;
         if (ff_check_interrupt(&ic->interrupt_callback)) {
             ret = AVERROR_EXIT;
             av_log(ic, AV_LOG_DEBUG, "interrupted\n");
             break;
         }
 
-        /* check if one codec still needs to be handled */
+        /* check if one codec still needs to be handled; streams with a
+         * packet still being decoded are only waited for when all the
+         * other streams are complete, so that reading goes on meanwhile */
+check_streams:
+        nb_busy = 0;
         for (i = 0; i < ic->nb_streams; i++) {
             int fps_analyze_framecount = 20;
             int count;
 
             st = ic->streams[i];
+            if (probe_threads_busy(ic, st)) {
+                nb_busy++;
+                continue;
+            }
             if (!has_codec_parameters(st, NULL))
                 break;
 
@@ -3846,6 +4096,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
                  st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO))
                 break;
         }
+        if (i == ic->nb_streams && nb_busy) {
+            probe_threads_wait(ic, NULL);
+            goto check_streams;
+        }
         analyzed_all_streams = 0;
         if (!missing_streams || !*missing_streams)
         if (i == ic->nb_streams) {
@@ -3899,6 +4153,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
         }
 
         st = ic->streams[pkt->stream_index];
+        probe_threads_wait(ic, st);
         if (!(st->disposition & AV_DISPOSITION_ATTACHED_PIC))
             read_size += pkt->size;
 
@@ -4006,15 +4261,19 @@ FF_ENABLE_DEPRECATION_WARNINGS
          * least one frame of codec data, this makes sure the codec initializes
          * the channel configuration and does not only trust the values from
          * the container. */
-        try_decode_frame(ic, st, pkt,
-                         (options && i < orig_nb_streams) ? &options[i] : NULL);
+        if (ic->internal->probe_threads)
+            probe_threads_submit(ic, st, pkt,
+                                 (options && i < orig_nb_streams) ? &options[i] : NULL);
+        else
+            decode_probe_packet(ic, st, pkt,
+                                (options && i < orig_nb_streams) ? &options[i] : NULL);
 
         if (ic->flags & AVFMT_FLAG_NOBUFFER)
             av_packet_unref_ijk(pkt);
 
-        st->codec_info_nb_frames++;
         count++;
     }
+    probe_threads_uninit(ic);
 
     if (eof_reached) {
         int stream_index;
@@ -4257,6 +4516,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
     }
 
 find_stream_info_err:
+    probe_threads_uninit(ic);
     for (i = 0; i < ic->nb_streams; i++) {
         st = ic->streams[i];
         if (st->info)
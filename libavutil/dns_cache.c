@@ -18,15 +18,58 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "libavutil/dns_cache.h"
+#include "libavutil/avstring.h"
 #include "libavutil/time.h"
 #include "libavformat/network.h"
 #include "libavutil/thread.h"
 
-typedef struct DnsCacheContext DnsCacheContext;
+#define DNS_CACHE_HASH_BITS 6
+#define DNS_CACHE_HASH_SIZE (1 << DNS_CACHE_HASH_BITS)
+/* refresh an entry in the background once less than 1/N of its TTL is left */
+#define DNS_CACHE_REFRESH_DIV 4
+
+#if HAVE_PTHREADS
+#define DnsCacheLock            pthread_rwlock_t
+#define dns_cache_lock_init(l)  pthread_rwlock_init(l, NULL)
+#define dns_cache_rdlock(l)     pthread_rwlock_rdlock(l)
+#define dns_cache_wrlock(l)     pthread_rwlock_wrlock(l)
+#define dns_cache_unlock(l)     pthread_rwlock_unlock(l)
+#else
+/* w32/os2 thread compat layers have no rwlock, fall back to a plain mutex */
+#define DnsCacheLock            pthread_mutex_t
+#define dns_cache_lock_init(l)  pthread_mutex_init(l, NULL)
+#define dns_cache_rdlock(l)     pthread_mutex_lock(l)
+#define dns_cache_wrlock(l)     pthread_mutex_lock(l)
+#define dns_cache_unlock(l)     pthread_mutex_unlock(l)
+#endif
+
+typedef struct DnsCacheNode {
+    DnsCacheEntry entry;            // must be first, handed out to callers
+    struct DnsCacheNode *next;      // hash chain
+    struct DnsCacheNode *refresh_next;
+    uint32_t hash;
+    char *hostname;
+    char *servname;
+    struct addrinfo hints;
+    int64_t timeout;                // TTL in milliseconds
+    int64_t refresh_time;
+    atomic_int ref_count;           // one reference is held by the hash table
+    atomic_int refreshing;
+} DnsCacheNode;
+
 typedef struct DnsCacheContext {
-    AVDictionary *dns_dictionary;
-    pthread_mutex_t dns_dictionary_mutex;
+    DnsCacheNode *buckets[DNS_CACHE_HASH_SIZE];
+    DnsCacheLock lock;
+
+    pthread_mutex_t refresh_mutex;
+    pthread_cond_t refresh_cond;
+    pthread_t refresh_thread;
+    int refresh_thread_started;
+    int refresh_pending;
+
     int initialized;
 } DnsCacheContext;
 
@@ -34,184 +77,357 @@ static DnsCacheContext *context = NULL;
 static pthread_once_t key_once = PTHREAD_ONCE_INIT;
 
 static void inner_init(void) {
-    int ret = 0;
     context = (DnsCacheContext *) av_mallocz(sizeof(DnsCacheContext));
-    if (context) {
-        ret = pthread_mutex_init(&context->dns_dictionary_mutex, NULL);
-        if (!ret) {
-            context->initialized = 1;
-        } else {
-            av_freep(&context);
-        }
+    if (!context)
+        return;
+
+    if (dns_cache_lock_init(&context->lock))
+        goto fail;
+    if (pthread_mutex_init(&context->refresh_mutex, NULL))
+        goto fail;
+    if (pthread_cond_init(&context->refresh_cond, NULL)) {
+        pthread_mutex_destroy(&context->refresh_mutex);
+        goto fail;
     }
+    context->initialized = 1;
+    return;
+
+fail:
+    av_freep(&context);
+}
+
+static uint32_t dns_cache_hash(const char *hostname, const char *servname) {
+    /* FNV-1a over "hostname\0servname" */
+    uint32_t hash = 2166136261U;
+    const uint8_t *p;
+
+    for (p = (const uint8_t *) hostname; *p; p++)
+        hash = (hash ^ av_tolower(*p)) * 16777619U;
+    hash *= 16777619U;
+    for (p = (const uint8_t *) servname; *p; p++)
+        hash = (hash ^ *p) * 16777619U;
+
+    return hash;
 }
 
 static void free_private_addrinfo(struct addrinfo **p_ai) {
     struct addrinfo *ai = *p_ai;
 
-    if (ai) {
-        if (ai->ai_addr) {
-            av_freep(&ai->ai_addr);
-        }
-        av_freep(p_ai);
+    while (ai) {
+        struct addrinfo *next = ai->ai_next;
+        av_freep(&ai->ai_addr);
+        av_free(ai);
+        ai = next;
     }
+    *p_ai = NULL;
 }
 
-static int inner_remove_dns_cache(const char *uri, DnsCacheEntry *dns_cache_entry) {
-    if (context && dns_cache_entry) {
-        if (dns_cache_entry->ref_count == 0) {
-            av_dict_set_int(&context->dns_dictionary, uri, 0, 0);
-            free_private_addrinfo(&dns_cache_entry->res);
-            av_freep(&dns_cache_entry);
-        } else {
-            dns_cache_entry->delete_flag = 1;
+static struct addrinfo *dup_private_addrinfo(const struct addrinfo *src, int port) {
+    struct addrinfo *head = NULL;
+    struct addrinfo **tail = &head;
+
+    for (; src; src = src->ai_next) {
+        struct addrinfo *ai;
+
+        if (!src->ai_addr || src->ai_addrlen <= 0)
+            continue;
+
+        ai = (struct addrinfo *) av_mallocz(sizeof(struct addrinfo));
+        if (!ai)
+            goto fail;
+        memcpy(ai, src, sizeof(struct addrinfo));
+        ai->ai_canonname = NULL;
+        ai->ai_next      = NULL;
+
+        ai->ai_addr = (struct sockaddr *) av_malloc(src->ai_addrlen);
+        if (!ai->ai_addr) {
+            av_free(ai);
+            goto fail;
         }
+        memcpy(ai->ai_addr, src->ai_addr, src->ai_addrlen);
+#if HAVE_STRUCT_SOCKADDR_IN6
+        // the shared copy is read-only, so fix up the port tcp.c would otherwise patch in place
+        if (ai->ai_family == AF_INET6 && port > 0) {
+            struct sockaddr_in6 *sockaddr_v6 = (struct sockaddr_in6 *) ai->ai_addr;
+            if (!sockaddr_v6->sin6_port)
+                sockaddr_v6->sin6_port = htons(port);
+        }
+#endif
+
+        *tail = ai;
+        tail  = &ai->ai_next;
     }
 
-    return 0;
+    return head;
+
+fail:
+    free_private_addrinfo(&head);
+    return NULL;
 }
 
-static DnsCacheEntry *new_dns_cache_entry(const char *uri, struct addrinfo *cur_ai, int64_t timeout) {
-    DnsCacheEntry *new_entry = NULL;
-    int64_t cur_time         = av_gettime_relative();
+static void free_dns_cache_node(DnsCacheNode **p_node) {
+    DnsCacheNode *node = *p_node;
 
-    if (cur_time < 0) {
-        goto fail;
+    if (node) {
+        free_private_addrinfo(&node->entry.res);
+        av_freep(&node->hostname);
+        av_freep(&node->servname);
+        av_freep(p_node);
     }
+}
 
-    new_entry = (DnsCacheEntry *) av_mallocz(sizeof(struct DnsCacheEntry));
-    if (!new_entry) {
-        goto fail;
+static void unref_dns_cache_node(DnsCacheNode *node) {
+    if (atomic_fetch_sub(&node->ref_count, 1) == 1)
+        free_dns_cache_node(&node);
+}
+
+static DnsCacheNode *new_dns_cache_node(const char *hostname, const char *servname,
+                                        const struct addrinfo *hints, struct addrinfo *ai,
+                                        int64_t timeout) {
+    DnsCacheNode *node = NULL;
+    int64_t cur_time   = av_gettime_relative();
+
+    if (cur_time < 0)
+        return NULL;
+
+    node = (DnsCacheNode *) av_mallocz(sizeof(DnsCacheNode));
+    if (!node)
+        return NULL;
+
+    node->hostname  = av_strdup(hostname);
+    node->servname  = av_strdup(servname);
+    node->entry.res = dup_private_addrinfo(ai, strtol(servname, NULL, 10));
+    if (!node->hostname || !node->servname || !node->entry.res) {
+        free_dns_cache_node(&node);
+        return NULL;
     }
 
-    new_entry->res = (struct addrinfo *) av_mallocz(sizeof(struct addrinfo));
-    if (!new_entry->res) {
-        av_freep(&new_entry);
-        goto fail;
+    if (hints) {
+        node->hints.ai_family   = hints->ai_family;
+        node->hints.ai_socktype = hints->ai_socktype;
+        node->hints.ai_protocol = hints->ai_protocol;
+        node->hints.ai_flags    = hints->ai_flags;
     }
+    node->hash               = dns_cache_hash(hostname, servname);
+    node->timeout            = timeout;
+    node->entry.expired_time = cur_time + timeout * 1000;
+    node->refresh_time       = node->entry.expired_time - timeout * 1000 / DNS_CACHE_REFRESH_DIV;
+    atomic_init(&node->ref_count, 1);
+    atomic_init(&node->refreshing, 0);
+
+    return node;
+}
 
-    memcpy(new_entry->res, cur_ai, sizeof(struct addrinfo));
+/* must be called with the lock held */
+static DnsCacheNode **find_dns_cache_node(uint32_t hash, const char *hostname, const char *servname) {
+    DnsCacheNode **p_node = &context->buckets[hash & (DNS_CACHE_HASH_SIZE - 1)];
 
-    new_entry->res->ai_addr = (struct sockaddr *) av_mallocz(sizeof(struct sockaddr));
-    if (!new_entry->res->ai_addr) {
-        av_freep(&new_entry->res);
-        av_freep(&new_entry);
-        goto fail;
+    for (; *p_node; p_node = &(*p_node)->next) {
+        DnsCacheNode *node = *p_node;
+        if (node->hash == hash &&
+            !av_strcasecmp(node->hostname, hostname) &&
+            !strcmp(node->servname, servname))
+            return p_node;
     }
 
-    memcpy(new_entry->res->ai_addr, cur_ai->ai_addr, sizeof(struct sockaddr));
-    new_entry->res->ai_canonname = NULL;
-    new_entry->res->ai_next      = NULL;
-    new_entry->ref_count         = 0;
-    new_entry->delete_flag       = 0;
-    new_entry->expired_time      = cur_time + timeout * 1000;
+    return p_node;
+}
 
-    return new_entry;
+/* must be called with the write lock held */
+static void unlink_dns_cache_node(DnsCacheNode **p_node) {
+    DnsCacheNode *node = *p_node;
+
+    *p_node = node->next;
+    node->next = NULL;
+    unref_dns_cache_node(node);
+}
+
+/* must be called with the write lock held, takes over the table reference of new_node */
+static void replace_dns_cache_node(DnsCacheNode *new_node) {
+    DnsCacheNode **p_node = find_dns_cache_node(new_node->hash, new_node->hostname, new_node->servname);
+
+    if (*p_node)
+        unlink_dns_cache_node(p_node);
+    new_node->next = *p_node;
+    *p_node = new_node;
+}
+
+static void *dns_cache_refresh_thread(void *arg) {
+    DnsCacheNode *list;
+    DnsCacheNode *node;
+    int64_t cur_time;
+    int i;
+
+    while (1) {
+        pthread_mutex_lock(&context->refresh_mutex);
+        while (!context->refresh_pending)
+            pthread_cond_wait(&context->refresh_cond, &context->refresh_mutex);
+        context->refresh_pending = 0;
+        pthread_mutex_unlock(&context->refresh_mutex);
+
+        /* drop expired entries and collect the ones due for a refresh */
+        list     = NULL;
+        cur_time = av_gettime_relative();
+        dns_cache_wrlock(&context->lock);
+        for (i = 0; i < DNS_CACHE_HASH_SIZE; i++) {
+            DnsCacheNode **p_node = &context->buckets[i];
+            while (*p_node) {
+                node = *p_node;
+                if (node->entry.expired_time < cur_time && !atomic_load(&node->refreshing)) {
+                    unlink_dns_cache_node(p_node);
+                    continue;
+                }
+                if (atomic_load(&node->refreshing)) {
+                    atomic_fetch_add(&node->ref_count, 1);
+                    node->refresh_next = list;
+                    list = node;
+                }
+                p_node = &node->next;
+            }
+        }
+        dns_cache_unlock(&context->lock);
+
+        while (list) {
+            struct addrinfo *ai = NULL;
+            DnsCacheNode *new_node = NULL;
+
+            node = list;
+            list = node->refresh_next;
+
+            if (!getaddrinfo(node->hostname[0] ? node->hostname : NULL, node->servname, &node->hints, &ai)) {
+                new_node = new_dns_cache_node(node->hostname, node->servname, &node->hints, ai, node->timeout);
+                freeaddrinfo(ai);
+            }
+
+            dns_cache_wrlock(&context->lock);
+            if (new_node && *find_dns_cache_node(node->hash, node->hostname, node->servname) == node) {
+                replace_dns_cache_node(new_node);
+                new_node = NULL;
+            } else {
+                /* resolve failed or entry was replaced meanwhile, allow another attempt later */
+                atomic_store(&node->refreshing, 0);
+            }
+            dns_cache_unlock(&context->lock);
+
+            if (new_node)
+                free_dns_cache_node(&new_node);
+            unref_dns_cache_node(node);
+        }
+    }
 
-fail:
     return NULL;
 }
 
-DnsCacheEntry *get_dns_cache_reference(const char *uri) {
-    AVDictionaryEntry *elem = NULL;
-    DnsCacheEntry *dns_cache_entry = NULL;
+static void request_dns_cache_refresh(void) {
+    pthread_mutex_lock(&context->refresh_mutex);
+    if (!context->refresh_thread_started) {
+        if (pthread_create(&context->refresh_thread, NULL, dns_cache_refresh_thread, NULL)) {
+            av_log(NULL, AV_LOG_WARNING, "failed to start dns cache refresh thread\n");
+            pthread_mutex_unlock(&context->refresh_mutex);
+            return;
+        }
+        context->refresh_thread_started = 1;
+    }
+    context->refresh_pending = 1;
+    pthread_cond_signal(&context->refresh_cond);
+    pthread_mutex_unlock(&context->refresh_mutex);
+}
+
+DnsCacheEntry *get_dns_cache_reference(const char *hostname, const char *servname) {
+    DnsCacheNode *node = NULL;
+    uint32_t hash;
     int64_t cur_time = av_gettime_relative();
+    int refresh = 0;
 
-    if (cur_time < 0 || !uri || strlen(uri) == 0) {
+    if (cur_time < 0 || !hostname || !servname || strlen(hostname) == 0) {
         return NULL;
     }
     ff_thread_once(&key_once, inner_init);
 
     if (context && context->initialized) {
-        pthread_mutex_lock(&context->dns_dictionary_mutex);
-        elem = av_dict_get(context->dns_dictionary, uri, NULL, AV_DICT_MATCH_CASE);
-        if (elem) {
-            dns_cache_entry = (DnsCacheEntry *) (intptr_t) strtoll(elem->value, NULL, 10);
-            if (dns_cache_entry) {
-                if (dns_cache_entry->expired_time < cur_time) {
-                    inner_remove_dns_cache(uri, dns_cache_entry);
-                    dns_cache_entry = NULL;
-                } else {
-                    dns_cache_entry->ref_count++;
-                }
+        hash = dns_cache_hash(hostname, servname);
+        dns_cache_rdlock(&context->lock);
+        node = *find_dns_cache_node(hash, hostname, servname);
+        if (node) {
+            if (node->entry.expired_time < cur_time) {
+                /* expired entries are replaced by add_dns_cache_entry or pruned by the refresh thread */
+                node = NULL;
+            } else {
+                atomic_fetch_add(&node->ref_count, 1);
+                if (node->refresh_time < cur_time && !atomic_exchange(&node->refreshing, 1))
+                    refresh = 1;
             }
         }
-        pthread_mutex_unlock(&context->dns_dictionary_mutex);
+        dns_cache_unlock(&context->lock);
+
+        if (refresh)
+            request_dns_cache_refresh();
     }
 
-    return dns_cache_entry;
+    return node ? &node->entry : NULL;
 }
 
-int release_dns_cache_reference(const char *uri, DnsCacheEntry **p_entry) {
+int release_dns_cache_reference(DnsCacheEntry **p_entry) {
     DnsCacheEntry *entry = *p_entry;
 
-    if (!uri || strlen(uri) == 0) {
-        return -1;
-    }
-
     if (context && context->initialized && entry) {
-        pthread_mutex_lock(&context->dns_dictionary_mutex);
-        entry->ref_count--;
-        if (entry->delete_flag && entry->ref_count == 0) {
-            inner_remove_dns_cache(uri, entry);
-            entry = NULL;
-        }
-        pthread_mutex_unlock(&context->dns_dictionary_mutex);
+        unref_dns_cache_node((DnsCacheNode *) entry);
+        *p_entry = NULL;
     }
     return 0;
 }
 
-int remove_dns_cache_entry(const char *uri) {
-    AVDictionaryEntry *elem = NULL;
-    DnsCacheEntry *dns_cache_entry = NULL;
+int remove_dns_cache_entry(const char *hostname, const char *servname) {
+    DnsCacheNode **p_node;
+    uint32_t hash;
 
-    if (!uri || strlen(uri) == 0) {
+    if (!hostname || !servname || strlen(hostname) == 0) {
         return -1;
     }
+    ff_thread_once(&key_once, inner_init);
 
     if (context && context->initialized) {
-        pthread_mutex_lock(&context->dns_dictionary_mutex);
-        elem = av_dict_get(context->dns_dictionary, uri, NULL, AV_DICT_MATCH_CASE);
-        if (elem) {
-            dns_cache_entry = (DnsCacheEntry *) (intptr_t) strtoll(elem->value, NULL, 10);
-            if (dns_cache_entry) {
-                inner_remove_dns_cache(uri, dns_cache_entry);
-            }
-        }
-        pthread_mutex_unlock(&context->dns_dictionary_mutex);
+        hash = dns_cache_hash(hostname, servname);
+        dns_cache_wrlock(&context->lock);
+        p_node = find_dns_cache_node(hash, hostname, servname);
+        if (*p_node)
+            unlink_dns_cache_node(p_node);
+        dns_cache_unlock(&context->lock);
     }
 
     return 0;
 }
 
-int add_dns_cache_entry(const char *uri, struct addrinfo *cur_ai, int64_t timeout) {
-    DnsCacheEntry *new_entry = NULL;
-    DnsCacheEntry *old_entry = NULL;
-    AVDictionaryEntry *elem  = NULL;
+int add_dns_cache_entry(const char *hostname, const char *servname,
+                        const struct addrinfo *hints, struct addrinfo *ai, int64_t timeout) {
+    DnsCacheNode *new_entry = NULL;
+    DnsCacheNode *old_entry = NULL;
+    int64_t cur_time = av_gettime_relative();
 
-    if (!uri || strlen(uri) == 0 || timeout <= 0) {
+    if (!hostname || !servname || strlen(hostname) == 0 || timeout <= 0) {
         goto fail;
     }
 
-    if (cur_ai == NULL || cur_ai->ai_addr == NULL) {
+    if (ai == NULL || ai->ai_addr == NULL) {
         goto fail;
     }
+    ff_thread_once(&key_once, inner_init);
 
     if (context && context->initialized) {
-        pthread_mutex_lock(&context->dns_dictionary_mutex);
-        elem = av_dict_get(context->dns_dictionary, uri, NULL, AV_DICT_MATCH_CASE);
-        if (elem) {
-            old_entry = (DnsCacheEntry *) (intptr_t) strtoll(elem->value, NULL, 10);
-            if (old_entry) {
-                pthread_mutex_unlock(&context->dns_dictionary_mutex);
-                goto fail;
-            }
-        }
-        new_entry = new_dns_cache_entry(uri, cur_ai, timeout);
-        if (new_entry) {
-            av_dict_set_int(&context->dns_dictionary, uri, (int64_t) (intptr_t) new_entry, 0);
+        new_entry = new_dns_cache_node(hostname, servname, hints, ai, timeout);
+        if (!new_entry)
+            goto fail;
+
+        dns_cache_wrlock(&context->lock);
+        old_entry = *find_dns_cache_node(new_entry->hash, hostname, servname);
+        if (old_entry && old_entry->entry.expired_time >= cur_time) {
+            /* someone else already cached a valid result */
+            dns_cache_unlock(&context->lock);
+            free_dns_cache_node(&new_entry);
+            return 0;
         }
-        pthread_mutex_unlock(&context->dns_dictionary_mutex);
+        replace_dns_cache_node(new_entry);
+        dns_cache_unlock(&context->lock);
 
         return 0;
     }
@@ -221,23 +437,16 @@ fail:
 }
 
 int remove_all_dns_cache_entry() {
-    AVDictionaryEntry *t = NULL;
-    DnsCacheEntry *dns_cache_entry = NULL;
+    int i;
 
     ff_thread_once(&key_once, inner_init);
     if (context && context->initialized) {
-        pthread_mutex_lock(&context->dns_dictionary_mutex);
-        while((t = av_dict_get(context->dns_dictionary, "", t, AV_DICT_IGNORE_SUFFIX))){
-            dns_cache_entry = (DnsCacheEntry *) (intptr_t) strtoll(t->value, NULL, 10);
-            if (dns_cache_entry){
-                free_private_addrinfo(&dns_cache_entry->res);
-                av_freep(&dns_cache_entry);
-            }
+        dns_cache_wrlock(&context->lock);
+        for (i = 0; i < DNS_CACHE_HASH_SIZE; i++) {
+            while (context->buckets[i])
+                unlink_dns_cache_node(&context->buckets[i]);
         }
-        if (context->dns_dictionary)
-          av_dict_free(&context->dns_dictionary);
-        pthread_mutex_unlock(&context->dns_dictionary_mutex);
+        dns_cache_unlock(&context->lock);
     }
     return 0;
 }
-
@@ -24,16 +24,20 @@
 #include "libavutil/log.h"
 
 typedef struct DnsCacheEntry {
-    volatile int ref_count;
-    volatile int delete_flag;
     int64_t expired_time;
-    struct addrinfo *res;  // construct by private function, not support ai_next and ai_canonname, can only be released using free_private_addrinfo
+    struct addrinfo *res;  // private copy of every resolved address (A and AAAA), shared read-only between users, must not be modified
 } DnsCacheEntry;
 
-DnsCacheEntry *get_dns_cache_reference(const char *uri);
-int release_dns_cache_reference(const char *uri, DnsCacheEntry **p_entry);
-int remove_dns_cache_entry(const char *uri);
-int add_dns_cache_entry(const char *uri, struct addrinfo *cur_ai, int64_t timeout);
+/*
+ * Entries are keyed by hostname and service (port), so every URL on the same
+ * host shares one entry. Entries that are used shortly before they expire are
+ * re-resolved by a background thread, so callers keep hitting the cache.
+ */
+DnsCacheEntry *get_dns_cache_reference(const char *hostname, const char *servname);
+int release_dns_cache_reference(DnsCacheEntry **p_entry);
+int remove_dns_cache_entry(const char *hostname, const char *servname);
+int add_dns_cache_entry(const char *hostname, const char *servname,
+                        const struct addrinfo *hints, struct addrinfo *ai, int64_t timeout);
 int remove_all_dns_cache_entry(void);
 
 
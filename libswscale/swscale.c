@@ -228,9 +228,15 @@ static void lumRangeFromJpeg16_c(int16_t *_dst, int width)
     if (DEBUG_SWSCALE_BUFFERS)                  \
         av_log(c, AV_LOG_DEBUG, __VA_ARGS__)
 
-static int swscale(SwsContext *c, const uint8_t *src[],
-                   int srcStride[], int srcSliceY,
-                   int srcSliceH, uint8_t *dst[], int dstStride[])
+/**
+ * Scale the source lines srcSliceY..srcSliceY+srcSliceH-1 into the
+ * destination lines dstSliceY..dstSliceY+dstSliceH-1. The destination band
+ * is only cut short when the source slice does not reach far enough down.
+ */
+static int scale_band(SwsContext *c, const uint8_t *src[],
+                      int srcStride[], int srcSliceY, int srcSliceH,
+                      uint8_t *dst[], int dstStride[],
+                      int dstSliceY, int dstSliceH)
 {
     /* load a few things into local vars to make the code more readable?
      * and faster */
@@ -337,7 +343,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     if (srcSliceY == 0) {
         lumBufIndex  = -1;
         chrBufIndex  = -1;
-        dstY         = 0;
+        dstY         = dstSliceY;
         lastInLumBuf = -1;
         lastInChrBuf = -1;
     }
@@ -369,7 +375,7 @@ static int swscale(SwsContext *c, const uint8_t *src[],
         hout_slice->width = dstW;
     }
 
-    for (; dstY < dstH; dstY++) {
+    for (; dstY < dstSliceY + dstSliceH; dstY++) {
         const int chrDstY = dstY >> c->chrDstVSubSample;
         int use_mmx_vfilter= c->use_mmx_vfilter;
 
@@ -497,7 +503,32 @@ static int swscale(SwsContext *c, const uint8_t *src[],
                            yuv2packed1, yuv2packed2, yuv2packedX, yuv2anyX, use_mmx_vfilter);
         }
 
-        {
+        if (dstSliceY + dstSliceH < dstH) {
+            /* last line of a band that another thread continues below */
+            uint8_t *band_dst[4] = { NULL };
+            int band_idx[4];
+
+            for (i = 0; i < 4; i++) {
+                SwsPlane *plane = &vout_slice->plane[i];
+                int sub = i == 1 || i == 2 ? c->chrDstVSubSample : 0;
+                if (!c->band_linesize[i] || (dstY & ((1 << sub) - 1)) ||
+                    dstY >> sub != (dstSliceY + dstSliceH - 1) >> sub)
+                    continue;
+                band_idx[i] = (dstY >> sub) - plane->sliceY;
+                band_dst[i] = plane->line[band_idx[i]];
+                plane->line[band_idx[i]] = (uint8_t *)FFALIGN((uintptr_t)c->band_line[i], 64) +
+                                           ((uintptr_t)band_dst[i] & 63);
+            }
+            for (i = vStart; i < vEnd; ++i)
+                desc[i].process(c, &desc[i], dstY, 1);
+            for (i = 0; i < 4; i++) {
+                SwsPlane *plane = &vout_slice->plane[i];
+                if (!band_dst[i])
+                    continue;
+                memcpy(band_dst[i], plane->line[band_idx[i]], c->band_linesize[i]);
+                plane->line[band_idx[i]] = band_dst[i];
+            }
+        } else {
             for (i = vStart; i < vEnd; ++i)
                 desc[i].process(c, &desc[i], dstY, 1);
         }
@@ -531,6 +562,55 @@ static int swscale(SwsContext *c, const uint8_t *src[],
     return dstY - lastDstY;
 }
 
+static int swscale(SwsContext *c, const uint8_t *src[],
+                   int srcStride[], int srcSliceY,
+                   int srcSliceH, uint8_t *dst[], int dstStride[])
+{
+    return scale_band(c, src, srcStride, srcSliceY, srcSliceH,
+                      dst, dstStride, 0, c->dstH);
+}
+
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads)
+{
+    SwsContext *parent = priv;
+    SwsContext *c      = parent->slice_ctx[threadnr];
+    const int align    = 1 << c->chrDstVSubSample;
+    const uint8_t *src[4];
+    uint8_t *dst[4];
+    int srcStride[4], dstStride[4];
+    int dstY0, dstY1;
+
+    /* bands start on chroma line boundaries so that no destination line
+     * is written by two threads */
+    dstY0 = FFMIN(FFALIGN((int64_t)c->dstH *  jobnr      / nb_jobs, align), c->dstH);
+    dstY1 = FFMIN(FFALIGN((int64_t)c->dstH * (jobnr + 1) / nb_jobs, align), c->dstH);
+    if (dstY0 >= dstY1)
+        return;
+
+    memcpy(src,       parent->slice_src,       sizeof(src));
+    memcpy(srcStride, parent->slice_srcStride, sizeof(srcStride));
+    memcpy(dst,       parent->slice_dst,       sizeof(dst));
+    memcpy(dstStride, parent->slice_dstStride, sizeof(dstStride));
+
+    if (usePal(c->srcFormat)) {
+        memcpy(c->pal_yuv, parent->pal_yuv, sizeof(c->pal_yuv));
+        memcpy(c->pal_rgb, parent->pal_rgb, sizeof(c->pal_rgb));
+    }
+
+    /* The whole source frame is available, the vertical filter of the
+     * band reads whichever source lines it needs. */
+    scale_band(c, src, srcStride, 0, c->srcH, dst, dstStride,
+               dstY0, dstY1 - dstY0);
+}
+
+/* one band per job, so every job has a scaler of its own */
+static int slice_job(void *arg, int jobnr, int nb_jobs)
+{
+    ff_sws_slice_worker(arg, jobnr, jobnr, nb_jobs, nb_jobs);
+    return 0;
+}
+
 av_cold void ff_sws_init_range_convert(SwsContext *c)
 {
     c->lumConvertRange = NULL;
@@ -977,7 +1057,20 @@ int attribute_align_arg sws_scale(struct SwsContext *c,
     /* reset slice direction at end of frame */
     if (srcSliceY_internal + srcSliceH == c->srcH)
         c->sliceDir = 0;
-    ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
+
+    if (c->nb_slice_ctx && !srcSliceY_internal && srcSliceH == c->srcH &&
+        !c->dstXYZ) {
+        memcpy(c->slice_src,       src2,       sizeof(c->slice_src));
+        memcpy(c->slice_srcStride, srcStride2, sizeof(c->slice_srcStride));
+        memcpy(c->slice_dst,       dst2,       sizeof(c->slice_dst));
+        memcpy(c->slice_dstStride, dstStride2, sizeof(c->slice_dstStride));
+        if (c->execute)
+            c->execute(c->execute_opaque, slice_job, c, c->nb_slice_ctx);
+        else
+            avpriv_slicethread_execute(c->slicethread, c->nb_slice_ctx, 0);
+        ret = c->dstH;
+    } else
+        ret = c->swscale(c, src2, srcStride2, srcSliceY_internal, srcSliceH, dst2, dstStride2);
 
 
     if (c->dstXYZ && !(c->srcXYZ && c->srcW==c->dstW && c->srcH==c->dstH)) {
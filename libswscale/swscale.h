@@ -162,6 +162,23 @@ int sws_init_context_xij(struct SwsContext *sws_context, SwsFilter *srcFilter, S
  */
 void sws_freeContext_xij(struct SwsContext *swsContext);
 
+/**
+ * Function that calls func(arg, jobnr, nb_jobs) once for every jobnr from
+ * 0 to nb_jobs - 1, possibly in parallel, and returns when all calls are
+ * done.
+ */
+typedef int (SwsExecuteFunc)(void *opaque,
+                             int (*func)(void *arg, int jobnr, int nb_jobs),
+                             void *arg, int nb_jobs);
+
+/**
+ * Run the bands of a slice-threaded context through execute instead of
+ * threads created by libswscale, e.g. to share the thread pool of the
+ * caller. The "threads" option still sets the number of bands.
+ * Must be called before sws_init_context_xij().
+ */
+void sws_set_execute_xij(struct SwsContext *c, SwsExecuteFunc *execute, void *opaque);
+
 /**
  * Allocate and return an SwsContext. You need it to perform
  * scaling/conversion operations using sws_scale().
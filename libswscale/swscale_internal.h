@@ -22,6 +22,7 @@
 #define SWSCALE_SWSCALE_INTERNAL_H
 
 #include "config.h"
+#include "swscale.h"
 #include "version.h"
 
 #include "libavutil/avassert.h"
@@ -31,6 +32,7 @@
 #include "libavutil/log.h"
 #include "libavutil/pixfmt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/slicethread.h"
 #include "libavutil/ppc/util_altivec.h"
 
 #define STR(s) AV_TOSTRING(s) // AV_STRINGIFY is too long
@@ -40,6 +42,10 @@
 
 #define MAX_FILTER_SIZE SWS_MAX_FILTER_SIZE
 
+/* room for aligning a scratch line like the line it stands in for and for
+ * what the SIMD output functions store past the end of a line */
+#define BAND_LINE_PADDING 256
+
 #define DITHER1XBPP
 
 #if HAVE_BIGENDIAN
@@ -321,6 +327,23 @@ typedef struct SwsContext {
     uint8_t *cascaded1_tmp[4];
     int cascaded_mainindex;
 
+    /* Slice threading: whole frames passed to sws_scale() are split into
+     * horizontal destination bands, each scaled by its own child context
+     * that reads every source line the vertical filter needs for its band.
+     */
+    int nb_threads;                     ///< Number of slice threads, 0 for auto (AVOption).
+    AVSliceThread *slicethread;
+    SwsExecuteFunc *execute;            ///< Runs the bands instead of slicethread if set.
+    void *execute_opaque;
+    struct SwsContext **slice_ctx;      ///< One scaler per slice thread.
+    int nb_slice_ctx;
+    const uint8_t *slice_src[4];        ///< Frame being scaled by the slice threads.
+    int slice_srcStride[4];
+    uint8_t *slice_dst[4];
+    int slice_dstStride[4];
+    int band_linesize[4];               ///< Bytes in one destination line of each plane.
+    uint8_t *band_line[4];              ///< Scratch lines for the last line of a band.
+
     double gamma_value;
     int gamma_flag;
     int is_internal_gamma;
@@ -383,6 +406,18 @@ typedef struct SwsContext {
     int vChrFilterSize;           ///< Vertical   filter size for chroma     pixels.
     //@}
 
+    /**
+     * Process-wide cache entries owning the filter arrays above, NULL if the
+     * arrays are owned by this context. The horizontal entries also own the
+     * MMXEXT filter code when the fast bilinear scaler is used.
+     */
+    //@{
+    struct SwsFilterCacheEntry *hLumFilterCache;
+    struct SwsFilterCacheEntry *hChrFilterCache;
+    struct SwsFilterCacheEntry *vLumFilterCache;
+    struct SwsFilterCacheEntry *vChrFilterCache;
+    //@}
+
     int lumMmxextFilterCodeSize;  ///< Runtime-generated MMXEXT horizontal fast bilinear scaler code size for luma/alpha planes.
     int chrMmxextFilterCodeSize;  ///< Runtime-generated MMXEXT horizontal fast bilinear scaler code size for chroma planes.
     uint8_t *lumMmxextFilterCode; ///< Runtime-generated MMXEXT horizontal fast bilinear scaler code for luma/alpha planes.
@@ -849,6 +884,13 @@ void ff_get_unscaled_swscale_aarch64(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+/**
+ * Slice thread callback: scale one horizontal band of the destination of the
+ * frame stored in the slice_* fields of the parent context.
+ */
+void ff_sws_slice_worker(void *priv, int jobnr, int threadnr,
+                         int nb_jobs, int nb_threads);
+
 void ff_sws_init_input_funcs(SwsContext *c);
 void ff_sws_init_output_funcs(SwsContext *c,
                               yuv2planar1_fn *yuv2plane1,
@@ -0,0 +1,164 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Check that slice threading gives the same output as a single thread,
+ * with odd sizes and destination lines that are packed without padding,
+ * both with the threads of libswscale and with a caller's executor.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/swscale.h"
+
+static const enum AVPixelFormat formats[] = {
+    AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV410P, AV_PIX_FMT_YUV422P,
+    AV_PIX_FMT_YUVA420P, AV_PIX_FMT_NV12, AV_PIX_FMT_GRAY8,
+    AV_PIX_FMT_YUV420P10LE, AV_PIX_FMT_RGB24, AV_PIX_FMT_BGRA,
+    AV_PIX_FMT_RGB565LE, AV_PIX_FMT_YUYV422, AV_PIX_FMT_GBRP,
+};
+
+static const int sizes[][2] = {
+    { 97, 61 }, { 45, 37 }, { 123, 77 }, { 17, 200 }, { 321, 13 },
+};
+
+/* allocate an image whose lines start right where the previous line ends */
+static int alloc_packed_image(uint8_t *data[4], int linesize[4],
+                              int w, int h, enum AVPixelFormat fmt)
+{
+    int size;
+
+    if (av_image_fill_linesizes(linesize, fmt, w) < 0)
+        return -1;
+    size = av_image_fill_pointers(data, fmt, h, NULL, linesize);
+    if (size < 0 || !(data[0] = av_mallocz(size)))
+        return -1;
+    av_image_fill_pointers(data, fmt, h, data[0], linesize);
+    return size;
+}
+
+/* run the bands last to first, to catch any dependency between them */
+static int execute_reverse(void *opaque, int (*func)(void *arg, int jobnr, int nb_jobs),
+                           void *arg, int nb_jobs)
+{
+    int i;
+
+    for (i = nb_jobs - 1; i >= 0; i--)
+        func(arg, i, nb_jobs);
+    return 0;
+}
+
+static int scale(enum AVPixelFormat src_fmt, int srcW, int srcH,
+                 enum AVPixelFormat dst_fmt, int dstW, int dstH,
+                 int flags, int threads, int executor, uint8_t *const src[4],
+                 const int src_stride[4], uint8_t *dst[4], int dst_stride[4])
+{
+    struct SwsContext *c = sws_alloc_context_xij();
+    int ret;
+
+    if (!c)
+        return AVERROR(ENOMEM);
+    av_opt_set_int(c, "srcw",       srcW,    0);
+    av_opt_set_int(c, "srch",       srcH,    0);
+    av_opt_set_int(c, "src_format", src_fmt, 0);
+    av_opt_set_int(c, "dstw",       dstW,    0);
+    av_opt_set_int(c, "dsth",       dstH,    0);
+    av_opt_set_int(c, "dst_format", dst_fmt, 0);
+    av_opt_set_int(c, "sws_flags",  flags,   0);
+    av_opt_set_int(c, "threads",    threads, 0);
+    if (executor)
+        sws_set_execute_xij(c, execute_reverse, NULL);
+
+    ret = sws_init_context_xij(c, NULL, NULL);
+    if (ret >= 0)
+        ret = sws_scale(c, (const uint8_t * const *)src, src_stride, 0, srcH,
+                        dst, dst_stride);
+    sws_freeContext_xij(c);
+    return ret;
+}
+
+int main(void)
+{
+    static const int flags[] = { SWS_BILINEAR, SWS_BICUBIC, SWS_POINT, SWS_LANCZOS };
+    uint8_t *src[4], *ref[4], *out[4];
+    int src_stride[4], dst_stride[4];
+    int f, d, s, i, size, ret = 0, tests = 0;
+    AVLFG lfg;
+
+    av_lfg_init(&lfg, 1);
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (f = 0; f < FF_ARRAY_ELEMS(formats); f++) {
+        for (d = 0; d < FF_ARRAY_ELEMS(formats); d++) {
+            for (s = 0; s < FF_ARRAY_ELEMS(sizes); s++) {
+                const int srcW = sizes[s][0], srcH = sizes[s][1];
+                const int dstW = sizes[(s + 1) % FF_ARRAY_ELEMS(sizes)][0];
+                const int dstH = sizes[(s + 1) % FF_ARRAY_ELEMS(sizes)][1];
+                const int flag = flags[(f + d + s) % FF_ARRAY_ELEMS(flags)];
+
+                if (av_image_alloc(src, src_stride, srcW, srcH, formats[f], 16) < 0)
+                    return 1;
+                size = alloc_packed_image(ref, dst_stride, dstW, dstH, formats[d]);
+                if (size < 0 || alloc_packed_image(out, dst_stride, dstW, dstH, formats[d]) < 0)
+                    return 1;
+
+                for (i = 0; i < 4 && src[i]; i++) {
+                    int h = i == 1 || i == 2 ?
+                            AV_CEIL_RSHIFT(srcH, av_pix_fmt_desc_get(formats[f])->log2_chroma_h) : srcH;
+                    int j;
+                    if (av_pix_fmt_desc_get(formats[f])->flags & AV_PIX_FMT_FLAG_PAL && i == 1)
+                        break;
+                    for (j = 0; j < src_stride[i] * h; j++)
+                        src[i][j] = av_lfg_get(&lfg);
+                }
+
+                if (scale(formats[f], srcW, srcH, formats[d], dstW, dstH, flag, 1, 0,
+                          src, src_stride, ref, dst_stride) < 0 ||
+                    scale(formats[f], srcW, srcH, formats[d], dstW, dstH, flag, 4, s & 1,
+                          src, src_stride, out, dst_stride) < 0) {
+                    fprintf(stderr, "failed to scale %s %dx%d -> %s %dx%d\n",
+                            av_get_pix_fmt_name(formats[f]), srcW, srcH,
+                            av_get_pix_fmt_name(formats[d]), dstW, dstH);
+                    ret = 1;
+                } else if (memcmp(ref[0], out[0], size)) {
+                    fprintf(stderr, "%s %dx%d -> %s %dx%d flags 0x%x: "
+                            "threaded output differs\n",
+                            av_get_pix_fmt_name(formats[f]), srcW, srcH,
+                            av_get_pix_fmt_name(formats[d]), dstW, dstH, flag);
+                    ret = 1;
+                }
+                tests++;
+
+                av_freep(&src[0]);
+                av_freep(&ref[0]);
+                av_freep(&out[0]);
+            }
+        }
+    }
+
+    printf("%d conversions checked\n", tests);
+    return ret;
+}
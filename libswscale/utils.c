@@ -49,6 +49,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "libavutil/aarch64/cpu.h"
 #include "libavutil/ppc/cpu.h"
 #include "libavutil/x86/asm.h"
@@ -336,8 +337,8 @@ static av_cold int initFilter(int16_t **outFilter, int32_t **filterPos,
 
     emms_c(); // FIXME should not be required but IS (even for non-MMX versions)
 
-    // NOTE: the +3 is for the MMX(+1) / SSE(+3) scaler which reads over the end
-    FF_ALLOC_ARRAY_OR_GOTO(NULL, *filterPos, (dstW + 3), sizeof(**filterPos), fail);
+    // NOTE: the +7 is for the MMX(+1) / SSE(+3) / AVX2(+7) scaler which reads over the end
+    FF_ALLOC_ARRAY_OR_GOTO(NULL, *filterPos, (dstW + 7), sizeof(**filterPos), fail);
 
     if (FFABS(xInc - 0x10000) < 10 && srcPos == dstPos) { // unscaled
         int i;
@@ -670,7 +671,7 @@ static av_cold int initFilter(int16_t **outFilter, int32_t **filterPos,
     // Note the +1 is for the MMX scaler which reads over the end
     /* align at 16 for AltiVec (needed by hScale_altivec_real) */
     FF_ALLOCZ_ARRAY_OR_GOTO(NULL, *outFilter,
-                            (dstW + 3), *outFilterSize * sizeof(int16_t), fail);
+                            (dstW + 7), *outFilterSize * sizeof(int16_t), fail);
 
     /* normalize & store in outFilter */
     for (i = 0; i < dstW; i++) {
@@ -694,15 +695,13 @@ static av_cold int initFilter(int16_t **outFilter, int32_t **filterPos,
         }
     }
 
-    (*filterPos)[dstW + 0] =
-    (*filterPos)[dstW + 1] =
-    (*filterPos)[dstW + 2] = (*filterPos)[dstW - 1]; /* the MMX/SSE scaler will
-                                                      * read over the end */
+    /* the MMX/SSE/AVX2 scaler will read over the end */
+    for (i = dstW; i < dstW + 7; i++)
+        (*filterPos)[i] = (*filterPos)[dstW - 1];
     for (i = 0; i < *outFilterSize; i++) {
-        int k = (dstW - 1) * (*outFilterSize) + i;
-        (*outFilter)[k + 1 * (*outFilterSize)] =
-        (*outFilter)[k + 2 * (*outFilterSize)] =
-        (*outFilter)[k + 3 * (*outFilterSize)] = (*outFilter)[k];
+        int j, k = (dstW - 1) * (*outFilterSize) + i;
+        for (j = 1; j <= 7; j++)
+            (*outFilter)[k + j * (*outFilterSize)] = (*outFilter)[k];
     }
 
     ret = 0;
@@ -715,6 +714,273 @@ fail:
     return ret;
 }
 
+#if HAVE_MMAP && HAVE_MPROTECT && defined(MAP_ANONYMOUS)
+#define USE_MMAP 1
+#else
+#define USE_MMAP 0
+#endif
+
+/*
+ * Filters only depend on the scalar parameters of initFilter() (or of
+ * ff_init_hscaler_mmxext() for the fast bilinear scaler), so contexts with
+ * the same geometry, flags and CPU share them read-only through a
+ * process-wide cache. Unreferenced entries are kept for reuse until the
+ * cache grows past FILTER_CACHE_SIZE entries.
+ */
+#define FILTER_CACHE_SIZE 64
+
+typedef struct SwsFilterCacheKey {
+    int mmxext;
+    int xInc;
+    int srcW, dstW;
+    int filterAlign;
+    int one;
+    int flags;
+    int cpu_flags;
+    int srcPos, dstPos;
+    double param[2];
+} SwsFilterCacheKey;
+
+typedef struct SwsFilterCacheEntry {
+    struct SwsFilterCacheEntry *next;
+    SwsFilterCacheKey key;
+    int refcount;
+
+    int16_t *filter;
+    int32_t *filterPos;
+    int filterSize;
+    uint8_t *code;              ///< MMXEXT fast bilinear scaler code, if any
+    int codeSize;
+} SwsFilterCacheEntry;
+
+static AVMutex filter_cache_mutex = AV_MUTEX_INITIALIZER;
+static SwsFilterCacheEntry *filter_cache;
+static int filter_cache_count;
+
+#if HAVE_MMXEXT_INLINE
+static av_cold void free_mmxext_code(uint8_t *code, int size)
+{
+#if USE_MMAP
+    munmap(code, size);
+#elif HAVE_VIRTUALALLOC
+    VirtualFree(code, 0, MEM_RELEASE);
+#else
+    av_free(code);
+#endif
+}
+#endif /* HAVE_MMXEXT_INLINE */
+
+static av_cold void free_filter_cache_entry(SwsFilterCacheEntry *entry)
+{
+#if HAVE_MMXEXT_INLINE
+    if (entry->code)
+        free_mmxext_code(entry->code, entry->codeSize);
+#endif
+    av_free(entry->filter);
+    av_free(entry->filterPos);
+    av_free(entry);
+}
+
+/* Look up key and take a reference to the matching entry. */
+static av_cold SwsFilterCacheEntry *filter_cache_get(const SwsFilterCacheKey *key)
+{
+    SwsFilterCacheEntry **p, *entry = NULL;
+
+    ff_mutex_lock(&filter_cache_mutex);
+    for (p = &filter_cache; *p; p = &(*p)->next) {
+        if (!memcmp(&(*p)->key, key, sizeof(*key))) {
+            entry = *p;
+            entry->refcount++;
+            /* move to the front, the tail is evicted first */
+            *p          = entry->next;
+            entry->next = filter_cache;
+            filter_cache = entry;
+            break;
+        }
+    }
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    return entry;
+}
+
+/**
+ * Insert a freshly built entry and return it with one reference taken.
+ * If another thread inserted the same key meanwhile, entry is freed and
+ * that one is returned instead.
+ */
+static av_cold SwsFilterCacheEntry *filter_cache_add(SwsFilterCacheEntry *entry)
+{
+    SwsFilterCacheEntry **p, **unused = NULL, *found = NULL;
+
+    ff_mutex_lock(&filter_cache_mutex);
+    for (p = &filter_cache; *p; p = &(*p)->next) {
+        if (!memcmp(&(*p)->key, &entry->key, sizeof(entry->key))) {
+            found = *p;
+            break;
+        }
+    }
+    if (found) {
+        found->refcount++;
+    } else {
+        entry->refcount = 1;
+        entry->next     = filter_cache;
+        filter_cache    = entry;
+        filter_cache_count++;
+
+        if (filter_cache_count > FILTER_CACHE_SIZE) {
+            for (p = &filter_cache; *p; p = &(*p)->next)
+                if (!(*p)->refcount)
+                    unused = p;
+            if (unused) {
+                SwsFilterCacheEntry *old = *unused;
+                *unused = old->next;
+                filter_cache_count--;
+                free_filter_cache_entry(old);
+            }
+        }
+    }
+    ff_mutex_unlock(&filter_cache_mutex);
+
+    if (found) {
+        free_filter_cache_entry(entry);
+        return found;
+    }
+    return entry;
+}
+
+static av_cold void filter_cache_unref(SwsFilterCacheEntry **entry)
+{
+    if (!*entry)
+        return;
+    ff_mutex_lock(&filter_cache_mutex);
+    (*entry)->refcount--;
+    ff_mutex_unlock(&filter_cache_mutex);
+    *entry = NULL;
+}
+
+/**
+ * Same as initFilter(), but the filter is taken from or added to the cache
+ * unless the user supplied filter vectors, which are not part of the key.
+ */
+static av_cold int init_cached_filter(SwsFilterCacheEntry **entry,
+                                      int16_t **outFilter, int32_t **filterPos,
+                                      int *outFilterSize, int xInc, int srcW,
+                                      int dstW, int filterAlign, int one,
+                                      int flags, int cpu_flags,
+                                      SwsVector *srcFilter, SwsVector *dstFilter,
+                                      double param[2], int srcPos, int dstPos)
+{
+    SwsFilterCacheKey key;
+    SwsFilterCacheEntry *e;
+    int ret;
+
+    if (srcFilter || dstFilter)
+        return initFilter(outFilter, filterPos, outFilterSize, xInc, srcW,
+                          dstW, filterAlign, one, flags, cpu_flags,
+                          srcFilter, dstFilter, param, srcPos, dstPos);
+
+    memset(&key, 0, sizeof(key));
+    key.xInc        = xInc;
+    key.srcW        = srcW;
+    key.dstW        = dstW;
+    key.filterAlign = filterAlign;
+    key.one         = one;
+    key.flags       = flags;
+    key.cpu_flags   = cpu_flags;
+    key.srcPos      = srcPos;
+    key.dstPos      = dstPos;
+    key.param[0]    = param[0];
+    key.param[1]    = param[1];
+
+    e = filter_cache_get(&key);
+    if (!e) {
+        e = av_mallocz(sizeof(*e));
+        if (!e)
+            return AVERROR(ENOMEM);
+        e->key = key;
+        ret = initFilter(&e->filter, &e->filterPos, &e->filterSize, xInc, srcW,
+                         dstW, filterAlign, one, flags, cpu_flags,
+                         NULL, NULL, param, srcPos, dstPos);
+        if (ret < 0) {
+            free_filter_cache_entry(e);
+            return ret;
+        }
+        e = filter_cache_add(e);
+    }
+
+    *entry         = e;
+    *outFilter     = e->filter;
+    *filterPos     = e->filterPos;
+    *outFilterSize = e->filterSize;
+    return 0;
+}
+
+#if HAVE_MMXEXT_INLINE
+/**
+ * Get the runtime generated MMXEXT fast bilinear scaler code for one plane,
+ * along with the filter and filter positions it operates on.
+ */
+static av_cold int init_cached_mmxext_filter(SwsContext *c, SwsFilterCacheEntry **entry,
+                                             int16_t **filter, int32_t **filterPos,
+                                             uint8_t **code, int *codeSize,
+                                             int dstW, int xInc, int numSplits)
+{
+    SwsFilterCacheKey key;
+    SwsFilterCacheEntry *e;
+
+    memset(&key, 0, sizeof(key));
+    key.mmxext      = 1;
+    key.xInc        = xInc;
+    key.dstW        = dstW;
+    key.filterAlign = numSplits;
+
+    e = filter_cache_get(&key);
+    if (!e) {
+        e = av_mallocz(sizeof(*e));
+        if (!e)
+            return AVERROR(ENOMEM);
+        e->key      = key;
+        e->codeSize = ff_init_hscaler_mmxext(dstW, xInc, NULL, NULL, NULL, numSplits);
+#if USE_MMAP
+        e->code = mmap(NULL, e->codeSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (e->code == MAP_FAILED)
+            e->code = NULL;
+#elif HAVE_VIRTUALALLOC
+        e->code = VirtualAlloc(NULL, e->codeSize, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#else
+        e->code = av_malloc(e->codeSize);
+#endif
+        e->filter    = av_mallocz((dstW     / numSplits + 8) * sizeof(int16_t));
+        e->filterPos = av_mallocz((dstW / 2 / numSplits + 8) * sizeof(int32_t));
+        if (!e->code || !e->filter || !e->filterPos) {
+            av_log(c, AV_LOG_ERROR, "Failed to allocate MMX2FilterCode\n");
+            free_filter_cache_entry(e);
+            return AVERROR(ENOMEM);
+        }
+
+        ff_init_hscaler_mmxext(dstW, xInc, e->code, e->filter,
+                               (uint32_t*)e->filterPos, numSplits);
+
+#if USE_MMAP
+        if (mprotect(e->code, e->codeSize, PROT_EXEC | PROT_READ) == -1) {
+            av_log(c, AV_LOG_ERROR, "mprotect failed, cannot use fast bilinear scaler\n");
+            free_filter_cache_entry(e);
+            return AVERROR(EINVAL);
+        }
+#endif
+        e = filter_cache_add(e);
+    }
+
+    *entry     = e;
+    *filter    = e->filter;
+    *filterPos = e->filterPos;
+    *code      = e->code;
+    *codeSize  = e->codeSize;
+    return 0;
+}
+#endif /* HAVE_MMXEXT_INLINE */
+
 static void fill_rgb2yuv_table(SwsContext *c, const int table[4], int dstRange)
 {
     int64_t W, V, Z, Cy, Cu, Cv;
@@ -852,6 +1118,12 @@ int sws_setColorspaceDetails_xij(struct SwsContext *c, const int inv_table[4],
     const AVPixFmtDescriptor *desc_dst;
     const AVPixFmtDescriptor *desc_src;
     int need_reinit = 0;
+    int i;
+
+    /* the slice contexts are set up on their own until c is initialized */
+    for (i = 0; c->swscale && i < c->nb_slice_ctx; i++)
+        sws_setColorspaceDetails_xij(c->slice_ctx[i], inv_table, srcRange, table,
+                                 dstRange, brightness, contrast, saturation);
 
     handle_formats(c);
     desc_dst = av_pix_fmt_desc_get(c->dstFormat);
@@ -1150,8 +1422,124 @@ static enum AVPixelFormat alphaless_fmt(enum AVPixelFormat fmt)
     }
 }
 
+static av_cold void free_slice_threads(SwsContext *c)
+{
+    int i;
+
+    avpriv_slicethread_free(&c->slicethread);
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        sws_freeContext_xij(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    c->nb_slice_ctx = 0;
+}
+
+/**
+ * Create the slice thread pool and one scaler per thread. The per-thread
+ * scalers are set up from the options as they are before c is initialized,
+ * so that they make exactly the same choices as c itself.
+ */
+static av_cold int context_init_threaded(SwsContext *c,
+                                         SwsFilter *srcFilter, SwsFilter *dstFilter)
+{
+    int i, j, ret;
+
+    if (c->execute) {
+        ret = c->nb_threads ? c->nb_threads : av_cpu_count();
+        if (ret == 1)
+            return 0;
+    } else {
+        ret = avpriv_slicethread_create(&c->slicethread, c, ff_sws_slice_worker,
+                                        NULL, c->nb_threads);
+        if (ret == AVERROR(ENOSYS))
+            return 0;
+        if (ret < 0)
+            return ret;
+        if (ret == 1) {
+            avpriv_slicethread_free(&c->slicethread);
+            return 0;
+        }
+    }
+
+    c->slice_ctx = av_mallocz_array(ret, sizeof(*c->slice_ctx));
+    if (!c->slice_ctx)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < ret; i++) {
+        SwsContext *slice;
+        int err;
+
+        slice = c->slice_ctx[i] = sws_alloc_context_xij();
+        if (!slice)
+            return AVERROR(ENOMEM);
+        c->nb_slice_ctx++;
+
+        if ((err = av_opt_copy(slice, c)) < 0)
+            return err;
+        slice->nb_threads = 1;
+        slice->src0Alpha  = c->src0Alpha;
+        slice->dst0Alpha  = c->dst0Alpha;
+
+        if (c->contrast || c->saturation || c->dstFormatBpp)
+            sws_setColorspaceDetails_xij(slice, c->srcColorspaceTable, c->srcRange,
+                                     c->dstColorspaceTable, c->dstRange,
+                                     c->brightness, c->contrast, c->saturation);
+
+        if ((err = sws_init_context_xij(slice, srcFilter, dstFilter)) < 0)
+            return err;
+
+        /* the SIMD output functions store a little past the end of a
+         * line, so the last line of a band is written to a scratch line
+         * and copied, instead of overwriting the start of the next band */
+        if ((err = av_image_fill_linesizes(slice->band_linesize, slice->dstFormat,
+                                           slice->dstW)) < 0)
+            return err;
+        for (j = 0; j < 4; j++) {
+            if (!slice->band_linesize[j])
+                continue;
+            slice->band_line[j] = av_malloc(slice->band_linesize[j] + BAND_LINE_PADDING);
+            if (!slice->band_line[j])
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    return 0;
+}
+
+static av_cold int init_single_context(SwsContext *c, SwsFilter *srcFilter,
+                                       SwsFilter *dstFilter);
+
+void sws_set_execute_xij(SwsContext *c, SwsExecuteFunc *execute, void *opaque)
+{
+    c->execute        = execute;
+    c->execute_opaque = opaque;
+}
+
 av_cold int sws_init_context_xij(SwsContext *c, SwsFilter *srcFilter,
                              SwsFilter *dstFilter)
+{
+    int ret;
+
+    if (c->nb_threads != 1) {
+        ret = context_init_threaded(c, srcFilter, dstFilter);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = init_single_context(c, srcFilter, dstFilter);
+    if (ret < 0)
+        return ret;
+
+    /* Only the generic scaler can work on destination bands, and error
+     * diffusion carries state from one line to the next. */
+    if (c->nb_slice_ctx &&
+        (!c->desc || c->cascaded_context[0] || c->dither == SWS_DITHER_ED))
+        free_slice_threads(c);
+
+    return 0;
+}
+
+static av_cold int init_single_context(SwsContext *c, SwsFilter *srcFilter,
+                                       SwsFilter *dstFilter)
 {
     int i;
     int usesVFilter, usesHFilter;
@@ -1574,72 +1962,22 @@ av_cold int sws_init_context_xij(SwsContext *c, SwsFilter *srcFilter,
         }
     }
 
-#if HAVE_MMAP && HAVE_MPROTECT && defined(MAP_ANONYMOUS)
-#define USE_MMAP 1
-#else
-#define USE_MMAP 0
-#endif
-
     /* precalculate horizontal scaler filter coefficients */
     {
 #if HAVE_MMXEXT_INLINE
 // can't downscale !!!
         if (c->canMMXEXTBeUsed && (flags & SWS_FAST_BILINEAR)) {
-            c->lumMmxextFilterCodeSize = ff_init_hscaler_mmxext(dstW, c->lumXInc, NULL,
-                                                             NULL, NULL, 8);
-            c->chrMmxextFilterCodeSize = ff_init_hscaler_mmxext(c->chrDstW, c->chrXInc,
-                                                             NULL, NULL, NULL, 4);
-
-#if USE_MMAP
-            c->lumMmxextFilterCode = mmap(NULL, c->lumMmxextFilterCodeSize,
-                                          PROT_READ | PROT_WRITE,
-                                          MAP_PRIVATE | MAP_ANONYMOUS,
-                                          -1, 0);
-            c->chrMmxextFilterCode = mmap(NULL, c->chrMmxextFilterCodeSize,
-                                          PROT_READ | PROT_WRITE,
-                                          MAP_PRIVATE | MAP_ANONYMOUS,
-                                          -1, 0);
-#elif HAVE_VIRTUALALLOC
-            c->lumMmxextFilterCode = VirtualAlloc(NULL,
-                                                  c->lumMmxextFilterCodeSize,
-                                                  MEM_COMMIT,
-                                                  PAGE_EXECUTE_READWRITE);
-            c->chrMmxextFilterCode = VirtualAlloc(NULL,
-                                                  c->chrMmxextFilterCodeSize,
-                                                  MEM_COMMIT,
-                                                  PAGE_EXECUTE_READWRITE);
-#else
-            c->lumMmxextFilterCode = av_malloc(c->lumMmxextFilterCodeSize);
-            c->chrMmxextFilterCode = av_malloc(c->chrMmxextFilterCodeSize);
-#endif
-
-#ifdef MAP_ANONYMOUS
-            if (c->lumMmxextFilterCode == MAP_FAILED || c->chrMmxextFilterCode == MAP_FAILED)
-#else
-            if (!c->lumMmxextFilterCode || !c->chrMmxextFilterCode)
-#endif
-            {
-                av_log(c, AV_LOG_ERROR, "Failed to allocate MMX2FilterCode\n");
-                return AVERROR(ENOMEM);
-            }
-
-            FF_ALLOCZ_OR_GOTO(c, c->hLumFilter,    (dstW           / 8 + 8) * sizeof(int16_t), fail);
-            FF_ALLOCZ_OR_GOTO(c, c->hChrFilter,    (c->chrDstW     / 4 + 8) * sizeof(int16_t), fail);
-            FF_ALLOCZ_OR_GOTO(c, c->hLumFilterPos, (dstW       / 2 / 8 + 8) * sizeof(int32_t), fail);
-            FF_ALLOCZ_OR_GOTO(c, c->hChrFilterPos, (c->chrDstW / 2 / 4 + 8) * sizeof(int32_t), fail);
-
-            ff_init_hscaler_mmxext(      dstW, c->lumXInc, c->lumMmxextFilterCode,
-                                c->hLumFilter, (uint32_t*)c->hLumFilterPos, 8);
-            ff_init_hscaler_mmxext(c->chrDstW, c->chrXInc, c->chrMmxextFilterCode,
-                                c->hChrFilter, (uint32_t*)c->hChrFilterPos, 4);
-
-#if USE_MMAP
-            if (   mprotect(c->lumMmxextFilterCode, c->lumMmxextFilterCodeSize, PROT_EXEC | PROT_READ) == -1
-                || mprotect(c->chrMmxextFilterCode, c->chrMmxextFilterCodeSize, PROT_EXEC | PROT_READ) == -1) {
-                av_log(c, AV_LOG_ERROR, "mprotect failed, cannot use fast bilinear scaler\n");
-                goto fail;
-            }
-#endif
+            if ((ret = init_cached_mmxext_filter(c, &c->hLumFilterCache,
+                                                 &c->hLumFilter, &c->hLumFilterPos,
+                                                 &c->lumMmxextFilterCode,
+                                                 &c->lumMmxextFilterCodeSize,
+                                                 dstW, c->lumXInc, 8)) < 0 ||
+                (ret = init_cached_mmxext_filter(c, &c->hChrFilterCache,
+                                                 &c->hChrFilter, &c->hChrFilterPos,
+                                                 &c->chrMmxextFilterCode,
+                                                 &c->chrMmxextFilterCodeSize,
+                                                 c->chrDstW, c->chrXInc, 4)) < 0)
+                return ret;
         } else
 #endif /* HAVE_MMXEXT_INLINE */
         {
@@ -1647,7 +1985,8 @@ av_cold int sws_init_context_xij(SwsContext *c, SwsFilter *srcFilter,
                                     PPC_ALTIVEC(cpu_flags) ? 8 :
                                     have_neon(cpu_flags)   ? 8 : 1;
 
-            if ((ret = initFilter(&c->hLumFilter, &c->hLumFilterPos,
+            if ((ret = init_cached_filter(&c->hLumFilterCache,
+                           &c->hLumFilter, &c->hLumFilterPos,
                            &c->hLumFilterSize, c->lumXInc,
                            srcW, dstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
@@ -1656,7 +1995,8 @@ av_cold int sws_init_context_xij(SwsContext *c, SwsFilter *srcFilter,
                            get_local_pos(c, 0, 0, 0),
                            get_local_pos(c, 0, 0, 0))) < 0)
                 goto fail;
-            if ((ret = initFilter(&c->hChrFilter, &c->hChrFilterPos,
+            if ((ret = init_cached_filter(&c->hChrFilterCache,
+                           &c->hChrFilter, &c->hChrFilterPos,
                            &c->hChrFilterSize, c->chrXInc,
                            c->chrSrcW, c->chrDstW, filterAlign, 1 << 14,
                            (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
@@ -1674,7 +2014,8 @@ av_cold int sws_init_context_xij(SwsContext *c, SwsFilter *srcFilter,
                                 PPC_ALTIVEC(cpu_flags) ? 8 :
                                 have_neon(cpu_flags)   ? 2 : 1;
 
-        if ((ret = initFilter(&c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
+        if ((ret = init_cached_filter(&c->vLumFilterCache,
+                       &c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize,
                        c->lumYInc, srcH, dstH, filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BICUBIC) : flags,
                        cpu_flags, srcFilter->lumV, dstFilter->lumV,
@@ -1682,7 +2023,8 @@ av_cold int sws_init_context_xij(SwsContext *c, SwsFilter *srcFilter,
                        get_local_pos(c, 0, 0, 1),
                        get_local_pos(c, 0, 0, 1))) < 0)
             goto fail;
-        if ((ret = initFilter(&c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
+        if ((ret = init_cached_filter(&c->vChrFilterCache,
+                       &c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize,
                        c->chrYInc, c->chrSrcH, c->chrDstH,
                        filterAlign, (1 << 12),
                        (flags & SWS_BICUBLIN) ? (flags | SWS_BILINEAR) : flags,
@@ -2287,8 +2629,36 @@ void sws_freeContext_xij(SwsContext *c)
     if (!c)
         return;
 
-    for (i = 0; i < 4; i++)
+    free_slice_threads(c);
+
+    for (i = 0; i < 4; i++) {
         av_freep(&c->dither_error[i]);
+        av_freep(&c->band_line[i]);
+    }
+
+    /* filters owned by the cache are released instead of freed */
+    if (c->hLumFilterCache) {
+        c->hLumFilter = NULL;
+        c->hLumFilterPos = NULL;
+        c->lumMmxextFilterCode = NULL;
+        filter_cache_unref(&c->hLumFilterCache);
+    }
+    if (c->hChrFilterCache) {
+        c->hChrFilter = NULL;
+        c->hChrFilterPos = NULL;
+        c->chrMmxextFilterCode = NULL;
+        filter_cache_unref(&c->hChrFilterCache);
+    }
+    if (c->vLumFilterCache) {
+        c->vLumFilter = NULL;
+        c->vLumFilterPos = NULL;
+        filter_cache_unref(&c->vLumFilterCache);
+    }
+    if (c->vChrFilterCache) {
+        c->vChrFilter = NULL;
+        c->vChrFilterPos = NULL;
+        filter_cache_unref(&c->vChrFilterCache);
+    }
 
     av_freep(&c->vLumFilter);
     av_freep(&c->vChrFilter);
@@ -2304,25 +2674,6 @@ void sws_freeContext_xij(SwsContext *c)
     av_freep(&c->hLumFilterPos);
     av_freep(&c->hChrFilterPos);
 
-#if HAVE_MMX_INLINE
-#if USE_MMAP
-    if (c->lumMmxextFilterCode)
-        munmap(c->lumMmxextFilterCode, c->lumMmxextFilterCodeSize);
-    if (c->chrMmxextFilterCode)
-        munmap(c->chrMmxextFilterCode, c->chrMmxextFilterCodeSize);
-#elif HAVE_VIRTUALALLOC
-    if (c->lumMmxextFilterCode)
-        VirtualFree(c->lumMmxextFilterCode, 0, MEM_RELEASE);
-    if (c->chrMmxextFilterCode)
-        VirtualFree(c->chrMmxextFilterCode, 0, MEM_RELEASE);
-#else
-    av_free(c->lumMmxextFilterCode);
-    av_free(c->chrMmxextFilterCode);
-#endif
-    c->lumMmxextFilterCode = NULL;
-    c->chrMmxextFilterCode = NULL;
-#endif /* HAVE_MMX_INLINE */
-
     av_freep(&c->yuvTable);
     av_freep(&c->formatConvBuffer);
 
@@ -2353,6 +2704,7 @@ struct SwsContext *sws_getCachedContext_xij(struct SwsContext *context, int srcW
                                              SWS_PARAM_DEFAULT };
     int64_t src_h_chr_pos = -513, dst_h_chr_pos = -513,
             src_v_chr_pos = -513, dst_v_chr_pos = -513;
+    int64_t threads = 1;
 
     if (!param)
         param = default_param;
@@ -2372,6 +2724,7 @@ struct SwsContext *sws_getCachedContext_xij(struct SwsContext *context, int srcW
         av_opt_get_int(context, "src_v_chr_pos", 0, &src_v_chr_pos);
         av_opt_get_int(context, "dst_h_chr_pos", 0, &dst_h_chr_pos);
         av_opt_get_int(context, "dst_v_chr_pos", 0, &dst_v_chr_pos);
+        av_opt_get_int(context, "threads", 0, &threads);
         sws_freeContext_xij(context);
         context = NULL;
     }
@@ -2393,6 +2746,7 @@ struct SwsContext *sws_getCachedContext_xij(struct SwsContext *context, int srcW
         av_opt_set_int(context, "src_v_chr_pos", src_v_chr_pos, 0);
         av_opt_set_int(context, "dst_h_chr_pos", dst_h_chr_pos, 0);
         av_opt_set_int(context, "dst_v_chr_pos", dst_v_chr_pos, 0);
+        av_opt_set_int(context, "threads", threads, 0);
 
         if (sws_init_context_xij(context, srcFilter, dstFilter) < 0) {
             sws_freeContext_xij(context);
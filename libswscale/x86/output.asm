@@ -61,8 +61,8 @@ SECTION .text
     ; 8 pixels but we can only handle 2 pixels per register, and thus 4
     ; pixels per iteration. In order to not have to keep track of where
     ; we are w.r.t. dithering, we unroll the MMX/8-bit loop x2.
-%if %1 == 8
-%assign %%repcnt 16/mmsize
+%if %1 == 8 && mmsize == 8
+%assign %%repcnt 2
 %else
 %assign %%repcnt 1
 %endif
@@ -89,18 +89,22 @@ SECTION .text
     mova            m3, [r6+r5*4]
     mova            m5, [r6+r5*4+mmsize]
 %else ; %1 == 8/9/10
-    mova            m3, [r6+r5*2]
+    movsrc          m3, [r6+r5*2]
 %endif ; %1 == 8/9/10/16
     mov             r6, [srcq+gprsize*cntr_reg-gprsize]
 %if %1 == 16
     mova            m4, [r6+r5*4]
     mova            m6, [r6+r5*4+mmsize]
 %else ; %1 == 8/9/10
-    mova            m4, [r6+r5*2]
+    movsrc          m4, [r6+r5*2]
 %endif ; %1 == 8/9/10/16
 
     ; coefficients
+%if mmsize == 32
+    vpbroadcastd    m0, [filterq+2*cntr_reg-4] ; coeff[0], coeff[1]
+%else
     movd            m0, [filterq+2*cntr_reg-4] ; coeff[0], coeff[1]
+%endif
 %if %1 == 16
     pshuflw         m7,  m0,  0          ; coeff[0]
     pshuflw         m0,  m0,  0x55       ; coeff[1]
@@ -119,7 +123,9 @@ SECTION .text
 %else ; %1 == 10/9/8
     punpcklwd       m5,  m3,  m4
     punpckhwd       m3,  m4
+%if mmsize < 32
     SPLATD          m0
+%endif
 
     pmaddwd         m5,  m0
     pmaddwd         m3,  m0
@@ -142,7 +148,12 @@ SECTION .text
 %if %1 == 8
     packssdw        m2,  m1
     packuswb        m2,  m2
+%if mmsize == 32
+    vpermq          m2,  m2, q0020
+    movu   [dstq+r5*1], xm2
+%else
     movh   [dstq+r5*1],  m2
+%endif
 %else ; %1 == 9/10/16
 %if %1 == 16
     packssdw        m2,  m1
@@ -177,6 +188,13 @@ SECTION .text
 %define movsx movsxd
 %endif
 
+; the source lines of the ymm version are only 16-byte aligned
+%if mmsize == 32
+%define movsrc movu
+%else
+%define movsrc mova
+%endif
+
 cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
 %if %1 == 8 || %1 == 9 || %1 == 10
     pxor            m6,  m6
@@ -192,7 +210,11 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
 %endif ; x86-32
 
     ; create registers holding dither
+%if mmsize == 32
+    vpbroadcastq m_dith, [ditherq]       ; dither, in both lanes
+%else
     movq        m_dith, [ditherq]        ; dither
+%endif
     test        offsetd, offsetd
     jz              .no_rot
 %if mmsize == 16
@@ -200,7 +222,7 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
 %endif ; mmsize == 16
     PALIGNR     m_dith,  m_dith,  3,  m0
 .no_rot:
-%if mmsize == 16
+%if mmsize >= 16
     punpcklbw   m_dith,  m6
 %if ARCH_X86_64
     punpcklwd       m8,  m_dith,  m6
@@ -230,7 +252,7 @@ cglobal yuv2planeX_%1, %3, 8, %2, filter, fltsize, src, dst, w, dither, offset
     mova      [rsp+ 8],  m5
     mova      [rsp+16],  m3
     mova      [rsp+24],  m_dith
-%endif ; mmsize == 8/16
+%endif ; mmsize == 8/16/32
 %endif ; %1 == 8
 
     xor             r5,  r5
@@ -283,6 +305,11 @@ yuv2planeX_fn  9,  7, 5
 yuv2planeX_fn 10,  7, 5
 %endif
 
+%if HAVE_AVX2_EXTERNAL && ARCH_X86_64
+INIT_YMM avx2
+yuv2planeX_fn  8, 10, 7
+%endif
+
 ; %1=outout-bpc, %2=alignment (u/a)
 %macro yuv2plane1_mainloop 2
 .loop_%2:
@@ -423,3 +450,103 @@ yuv2plane1_fn  9, 5, 3
 yuv2plane1_fn 10, 5, 3
 yuv2plane1_fn 16, 5, 3
 %endif
+
+;-----------------------------------------------------------------------------
+; void yuv2nv12cX_<opt>(const uint8_t *dither, const int16_t *filter,
+;                       int filterSize, const int16_t **u, const int16_t **v,
+;                       uint8_t *dst, int dstWidth)
+;
+; Scale $filterSize lines of U and V and interleave them into one line of
+; NV12 (UV) or NV21 (VU) output, 8 chroma pixels per iteration. The input is
+; 15 bits in int16_t, $filter is 12 bits. $dither holds 8 values, V uses them
+; rotated by 3.
+;-----------------------------------------------------------------------------
+%macro yuv2nv12cX_fn 1
+cglobal yuv2%1cX, 7, 10, 8, dither, filter, fltsize, u, v, dst, w, x, cntr, src
+    movsxdifnidn    wq, wd
+    movsxdifnidn fltsizeq, fltsized
+
+    ; dither: U in the low lane, V in the high lane, pixels 0-3 in m6, 4-7 in m7
+    pxor           m5, m5
+    movq          xm0, [ditherq]
+    punpcklqdq    xm0, xm0
+    palignr       xm1, xm0, xm0, 3
+    vinserti128    m0, m0, xm1, 1
+    punpcklbw      m0, m5
+    punpcklwd      m6, m0, m5
+    punpckhwd      m7, m0, m5
+    pslld          m6, 12
+    pslld          m7, 12
+
+    xor            xq, xq
+.pixelloop:
+    mova           m2, m6
+    mova           m1, m7
+    lea         cntrq, [fltsizeq-2]
+    test        cntrq, cntrq
+    jl .lastline
+.filterloop:
+    ; U and V pixels of two input lines
+    mov          srcq, [uq+cntrq*gprsize]
+    movu          xm3, [srcq+xq*2]
+    mov          srcq, [vq+cntrq*gprsize]
+    vinserti128    m3, m3, [srcq+xq*2], 1
+    mov          srcq, [uq+cntrq*gprsize+gprsize]
+    movu          xm4, [srcq+xq*2]
+    mov          srcq, [vq+cntrq*gprsize+gprsize]
+    vinserti128    m4, m4, [srcq+xq*2], 1
+
+    vpbroadcastd   m0, [filterq+cntrq*2]  ; coeff[0], coeff[1]
+    punpcklwd      m5, m3, m4
+    punpckhwd      m3, m4
+    pmaddwd        m5, m0
+    pmaddwd        m3, m0
+    paddd          m2, m5
+    paddd          m1, m3
+
+    sub         cntrq, 2
+    jge .filterloop
+.lastline:
+    ; odd filter size, line 0 is left
+    cmp         cntrq, -1
+    jne .store
+    mov          srcq, [uq]
+    movu          xm3, [srcq+xq*2]
+    mov          srcq, [vq]
+    vinserti128    m3, m3, [srcq+xq*2], 1
+    vpbroadcastw   m0, [filterq]
+    pxor           m4, m4
+    punpcklwd      m5, m3, m4
+    punpckhwd      m3, m4
+    pmaddwd        m5, m0
+    pmaddwd        m3, m0
+    paddd          m2, m5
+    paddd          m1, m3
+
+.store:
+    psrad          m2, 19
+    psrad          m1, 19
+    packssdw       m2, m1                 ; U in the low lane, V in the high lane
+    vextracti128  xm1, m2, 1
+%ifidn %1, nv12
+    punpcklwd     xm3, xm2, xm1
+    punpckhwd     xm2, xm1
+    packuswb      xm3, xm2
+%else ; nv21
+    punpcklwd     xm3, xm1, xm2
+    punpckhwd     xm1, xm2
+    packuswb      xm3, xm1
+%endif ; nv12/nv21
+    movu  [dstq+xq*2], xm3
+
+    add            xq, 8
+    cmp            xq, wq
+    jl .pixelloop
+    RET
+%endmacro
+
+%if HAVE_AVX2_EXTERNAL && ARCH_X86_64
+INIT_YMM avx2
+yuv2nv12cX_fn nv12
+yuv2nv12cX_fn nv21
+%endif
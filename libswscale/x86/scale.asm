@@ -21,9 +21,9 @@
 
 %include "libavutil/x86/x86util.asm"
 
-SECTION_RODATA
+SECTION_RODATA 32
 
-max_19bit_int: times 4 dd 0x7ffff
+max_19bit_int: times 8 dd 0x7ffff
 max_19bit_flt: times 4 dd 524287.0
 minshort:      times 8 dw 0x8000
 unicoeff:      times 4 dd 0x20000000
@@ -421,3 +421,110 @@ INIT_XMM ssse3
 SCALE_FUNCS2 6, 6, 8
 INIT_XMM sse4
 SCALE_FUNCS2 6, 6, 8
+
+;-----------------------------------------------------------------------------
+; AVX2 versions of the 8-bit 4 and 8 tap scalers. They produce 8 output
+; pixels per iteration, initFilter() pads filterPos and filter for the last
+; iteration.
+;-----------------------------------------------------------------------------
+
+; SCALE_FUNC_AVX2 intermediate_nbits, filtersize
+%macro SCALE_FUNC_AVX2 2
+cglobal hscale8to%1_%2, 7, 7, 6, pos0, dst, w, src, filter, fltpos, pos1
+    movsxd        wq, wd
+%if %1 == 19
+    mova          m2, [max_19bit_int]
+%endif ; %1 == 19
+%if %1 == 15
+    lea         dstq, [dstq+wq*2]
+%else ; %1 == 19
+    lea         dstq, [dstq+wq*4]
+%endif ; %1 == 15/19
+    lea      fltposq, [fltposq+wq*4]
+    neg           wq
+
+.loop:
+%if %2 == 4
+    ; load 8x4 source pixels, 4 output pixels per lane
+    movsxd     pos0q, dword [fltposq+wq*4+ 0]
+    movsxd     pos1q, dword [fltposq+wq*4+ 4]
+    movd         xm0, [srcq+pos0q]              ; src[filterPos[0] + {0,1,2,3}]
+    pinsrd       xm0, [srcq+pos1q], 1           ; src[filterPos[1] + {0,1,2,3}]
+    movsxd     pos0q, dword [fltposq+wq*4+ 8]
+    movsxd     pos1q, dword [fltposq+wq*4+12]
+    pinsrd       xm0, [srcq+pos0q], 2
+    pinsrd       xm0, [srcq+pos1q], 3
+    movsxd     pos0q, dword [fltposq+wq*4+16]
+    movsxd     pos1q, dword [fltposq+wq*4+20]
+    movd         xm1, [srcq+pos0q]              ; src[filterPos[4] + {0,1,2,3}]
+    pinsrd       xm1, [srcq+pos1q], 1
+    movsxd     pos0q, dword [fltposq+wq*4+24]
+    movsxd     pos1q, dword [fltposq+wq*4+28]
+    pinsrd       xm1, [srcq+pos0q], 2
+    pinsrd       xm1, [srcq+pos1q], 3
+    pmovzxbw      m0, xm0
+    pmovzxbw      m1, xm1
+
+    pmaddwd       m0, [filterq+ 0]              ; *= filter[{ 0, 1,...,14,15}]
+    pmaddwd       m1, [filterq+32]              ; *= filter[{16,17,...,30,31}]
+    phaddd        m0, m1                        ; dstpx {0,1,4,5 | 2,3,6,7}
+    vpermq        m0, m0, q3120
+%else ; %2 == 8
+    ; load 8x8 source pixels, dstpx[n] and dstpx[n+1] in the low and high lane
+    movsxd     pos0q, dword [fltposq+wq*4+ 0]
+    movsxd     pos1q, dword [fltposq+wq*4+ 4]
+    movq         xm0, [srcq+pos0q]              ; src[filterPos[0] + {0,1,...,6,7}]
+    movhps       xm0, [srcq+pos1q]              ; src[filterPos[1] + {0,1,...,6,7}]
+    movsxd     pos0q, dword [fltposq+wq*4+ 8]
+    movsxd     pos1q, dword [fltposq+wq*4+12]
+    movq         xm1, [srcq+pos0q]
+    movhps       xm1, [srcq+pos1q]
+    movsxd     pos0q, dword [fltposq+wq*4+16]
+    movsxd     pos1q, dword [fltposq+wq*4+20]
+    movq         xm4, [srcq+pos0q]
+    movhps       xm4, [srcq+pos1q]
+    movsxd     pos0q, dword [fltposq+wq*4+24]
+    movsxd     pos1q, dword [fltposq+wq*4+28]
+    movq         xm5, [srcq+pos0q]
+    movhps       xm5, [srcq+pos1q]
+    pmovzxbw      m0, xm0
+    pmovzxbw      m1, xm1
+    pmovzxbw      m4, xm4
+    pmovzxbw      m5, xm5
+
+    pmaddwd       m0, [filterq+ 0]              ; *= filter[{ 0, 1,...,14,15}]
+    pmaddwd       m1, [filterq+32]              ; *= filter[{16,17,...,30,31}]
+    pmaddwd       m4, [filterq+64]              ; *= filter[{32,33,...,46,47}]
+    pmaddwd       m5, [filterq+96]              ; *= filter[{48,49,...,62,63}]
+    phaddd        m0, m1
+    phaddd        m4, m5
+    phaddd        m0, m4                        ; dstpx {0,2,4,6 | 1,3,5,7}
+    vextracti128 xm1, m0, 1
+    punpckhdq    xm4, xm0, xm1
+    punpckldq    xm0, xm1
+    vinserti128   m0, m0, xm4, 1
+%endif ; %2 == 4/8
+
+    ; clip, store
+    psrad         m0, 14 + 8 - %1
+%if %1 == 15
+    vextracti128 xm1, m0, 1
+    packssdw     xm0, xm1
+    movu [dstq+wq*2], xm0
+%else ; %1 == 19
+    pminsd        m0, m2
+    movu [dstq+wq*4], m0
+%endif ; %1 == 15/19
+    add      filterq, 16*%2
+    add           wq, 8
+    jl .loop
+    RET
+%endmacro
+
+%if HAVE_AVX2_EXTERNAL && ARCH_X86_64
+INIT_YMM avx2
+SCALE_FUNC_AVX2 15, 4
+SCALE_FUNC_AVX2 15, 8
+SCALE_FUNC_AVX2 19, 4
+SCALE_FUNC_AVX2 19, 8
+%endif
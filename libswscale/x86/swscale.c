@@ -316,6 +316,13 @@ SCALE_FUNCS_SSE(sse2);
 SCALE_FUNCS_SSE(ssse3);
 SCALE_FUNCS_SSE(sse4);
 
+#if ARCH_X86_64
+SCALE_FUNC(4, 8, 15, avx2);
+SCALE_FUNC(8, 8, 15, avx2);
+SCALE_FUNC(4, 8, 19, avx2);
+SCALE_FUNC(8, 8, 19, avx2);
+#endif
+
 #define VSCALEX_FUNC(size, opt) \
 void ff_yuv2planeX_ ## size ## _ ## opt(const int16_t *filter, int filterSize, \
                                         const int16_t **src, uint8_t *dest, int dstW, \
@@ -332,6 +339,9 @@ VSCALEX_FUNCS(sse2);
 VSCALEX_FUNCS(sse4);
 VSCALEX_FUNC(16, sse4);
 VSCALEX_FUNCS(avx);
+#if ARCH_X86_64
+VSCALEX_FUNC(8, avx2);
+#endif
 
 #define VSCALE_FUNC(size, opt) \
 void ff_yuv2plane1_ ## size ## _ ## opt(const int16_t *src, uint8_t *dst, int dstW, \
@@ -349,6 +359,24 @@ VSCALE_FUNCS(sse2, sse2);
 VSCALE_FUNC(16, sse4);
 VSCALE_FUNCS(avx, avx);
 
+#if ARCH_X86_64
+#define YUV2NV_FUNC(fmt, opt) \
+void ff_yuv2 ## fmt ## cX_ ## opt(const uint8_t *dither, const int16_t *filter, \
+                                  int filterSize, const int16_t **u, \
+                                  const int16_t **v, uint8_t *dst, int dstWidth); \
+\
+static void yuv2 ## fmt ## cX_ ## opt(SwsContext *c, const int16_t *filter, \
+                                     int filterSize, const int16_t **u, \
+                                     const int16_t **v, uint8_t *dst, int dstWidth) \
+{ \
+    ff_yuv2 ## fmt ## cX_ ## opt(c->chrDither8, filter, filterSize, u, v, \
+                                 dst, dstWidth); \
+}
+
+YUV2NV_FUNC(nv12, avx2)
+YUV2NV_FUNC(nv21, avx2)
+#endif
+
 #define INPUT_Y_FUNC(fmt, opt) \
 void ff_ ## fmt ## ToY_  ## opt(uint8_t *dst, const uint8_t *src, \
                                 const uint8_t *unused1, const uint8_t *unused2, \
@@ -581,4 +609,35 @@ switch(c->dstBpc){ \
             break;
         }
     }
+
+#if ARCH_X86_64
+#define ASSIGN_AVX2_SCALE_FUNC(hscalefn, filtersize) \
+    switch (filtersize) { \
+    case 4: hscalefn = c->dstBpc <= 14 ? ff_hscale8to15_4_avx2 : \
+                                         ff_hscale8to19_4_avx2; break; \
+    case 8: hscalefn = c->dstBpc <= 14 ? ff_hscale8to15_8_avx2 : \
+                                         ff_hscale8to19_8_avx2; break; \
+    }
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        if (c->srcBpc == 8) {
+            ASSIGN_AVX2_SCALE_FUNC(c->hyScale, c->hLumFilterSize);
+            ASSIGN_AVX2_SCALE_FUNC(c->hcScale, c->hChrFilterSize);
+        }
+        if (c->dstBpc == 8 && !c->use_mmx_vfilter)
+            c->yuv2planeX = ff_yuv2planeX_8_avx2;
+
+        if (!c->use_mmx_vfilter) {
+            switch (c->dstFormat) {
+            case AV_PIX_FMT_NV12:
+                c->yuv2nv12cX = yuv2nv12cX_avx2;
+                break;
+            case AV_PIX_FMT_NV21:
+                c->yuv2nv12cX = yuv2nv21cX_avx2;
+                break;
+            default:
+                break;
+            }
+        }
+    }
+#endif
 }
@@ -0,0 +1,159 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Check the video parameters avformat_find_stream_info_ijk() finds against
+ * the first frame of a full decode, and the number of frames it had to
+ * decode to find them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/pixdesc.h"
+
+static int decode_first_frame(const char *filename, AVCodecContext **pctx)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    AVCodecContext *ctx = NULL;
+    AVFrame *frame = NULL;
+    AVCodec *codec;
+    AVPacket pkt;
+    int idx, ret;
+
+    av_init_packet_ijk(&pkt);
+    pkt.data = NULL;
+    pkt.size = 0;
+
+    if ((ret = avformat_open_input_ijk(&fmt_ctx, filename, NULL, NULL)) < 0)
+        return ret;
+    /* no avformat_find_stream_info_ijk(), the demuxer's parameters only */
+    idx = ret = av_find_best_stream_ijk(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (ret < 0)
+        goto end;
+
+    ctx   = avcodec_alloc_context3_ijk(codec);
+    frame = av_frame_alloc_ijk();
+    if (!ctx || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    if ((ret = avcodec_parameters_to_context_ijk(ctx, fmt_ctx->streams[idx]->codecpar)) < 0 ||
+        (ret = avcodec_open2_xij(ctx, codec, NULL)) < 0)
+        goto end;
+
+    while ((ret = av_read_frame_ijk(fmt_ctx, &pkt)) >= 0) {
+        if (pkt.stream_index == idx)
+            ret = avcodec_send_packet_xij(ctx, &pkt);
+        av_packet_unref_ijk(&pkt);
+        if (ret < 0)
+            goto end;
+        ret = avcodec_receive_frame_xij(ctx, frame);
+        if (ret != AVERROR(EAGAIN))
+            break;
+    }
+    if (ret == AVERROR_EOF) {
+        avcodec_send_packet_xij(ctx, NULL);
+        ret = avcodec_receive_frame_xij(ctx, frame);
+    }
+
+end:
+    av_frame_free_xij(&frame);
+    avformat_close_input_xij(&fmt_ctx);
+    if (ret < 0)
+        avcodec_free_context_ijk(&ctx);
+    *pctx = ctx;
+    return ret;
+}
+
+#define CHECK(field, fmt)                                                   \
+    if (par->field != ref->field) {                                         \
+        fprintf(stderr, #field " is " fmt ", decoding gives " fmt "\n",     \
+                par->field, ref->field);                                    \
+        ret = 1;                                                            \
+    }
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    AVCodecContext *ref = NULL;
+    AVCodecParameters *par;
+    AVStream *st;
+    int min_decoded, max_decoded, idx, ret;
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <input> <min decoded frames> <max decoded frames>\n",
+                argv[0]);
+        return 1;
+    }
+    min_decoded = atoi(argv[2]);
+    max_decoded = atoi(argv[3]);
+
+    if (decode_first_frame(argv[1], &ref) < 0) {
+        fprintf(stderr, "Failed to decode a frame of '%s'\n", argv[1]);
+        return 1;
+    }
+
+    if (avformat_open_input_ijk(&fmt_ctx, argv[1], NULL, NULL) < 0 ||
+        avformat_find_stream_info_ijk(fmt_ctx, NULL) < 0 ||
+        (idx = av_find_best_stream_ijk(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0)) < 0) {
+        fprintf(stderr, "Failed to probe '%s'\n", argv[1]);
+        avformat_close_input_xij(&fmt_ctx);
+        avcodec_free_context_ijk(&ref);
+        return 1;
+    }
+    st  = fmt_ctx->streams[idx];
+    par = st->codecpar;
+
+    ret = 0;
+    CHECK(width,               "%d");
+    CHECK(height,              "%d");
+    CHECK(profile,             "%d");
+    CHECK(level,               "%d");
+    CHECK(color_range,         "%d");
+    CHECK(color_primaries,     "%d");
+    CHECK(color_trc,           "%d");
+    CHECK(sample_aspect_ratio.num, "%d");
+    CHECK(sample_aspect_ratio.den, "%d");
+    if (par->color_space != ref->colorspace) {
+        fprintf(stderr, "color_space is %d, decoding gives %d\n",
+                par->color_space, ref->colorspace);
+        ret = 1;
+    }
+    if (par->chroma_location != ref->chroma_sample_location) {
+        fprintf(stderr, "chroma_location is %d, decoding gives %d\n",
+                par->chroma_location, ref->chroma_sample_location);
+        ret = 1;
+    }
+    if (par->format != ref->pix_fmt) {
+        fprintf(stderr, "format is %s, decoding gives %s\n",
+                av_get_pix_fmt_name(par->format), av_get_pix_fmt_name(ref->pix_fmt));
+        ret = 1;
+    }
+    if (st->nb_decoded_frames < min_decoded || st->nb_decoded_frames > max_decoded) {
+        fprintf(stderr, "%d frames decoded while probing, expected %d to %d\n",
+                st->nb_decoded_frames, min_decoded, max_decoded);
+        ret = 1;
+    }
+
+    avformat_close_input_xij(&fmt_ctx);
+    avcodec_free_context_ijk(&ref);
+    return ret;
+}
@@ -0,0 +1,144 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
+
+#include "libavcodec/hevcpred.h"
+
+#include "checkasm.h"
+
+#define STRIDE   48
+#define BUF_SIZE (32 * STRIDE * 2)
+
+/* top and left hold the samples -1 .. 2 * size - 1 */
+#define randomize_buffers(bit_depth)                                      \
+    do {                                                                  \
+        int j;                                                            \
+        uint32_t mask = (1 << bit_depth) - 1;                             \
+        for (j = 0; j < 2 * 65; j++) {                                    \
+            AV_WN16A(top_buf  + j * 2, rnd() & mask);                     \
+            AV_WN16A(left_buf + j * 2, rnd() & mask);                     \
+        }                                                                 \
+        if (bit_depth == 8) {                                             \
+            for (j = 0; j < 2 * 65; j++) {                                \
+                top_buf[j]  = AV_RN16A(top_buf  + j * 2);                 \
+                left_buf[j] = AV_RN16A(left_buf + j * 2);                 \
+            }                                                             \
+        }                                                                 \
+        memcpy(left_buf, top_buf, bit_depth > 8 ? 2 : 1);                 \
+        for (j = 0; j < BUF_SIZE; j += 4) {                               \
+            uint32_t r = rnd();                                           \
+            AV_WN32A(dst0 + j, r);                                        \
+            AV_WN32A(dst1 + j, r);                                        \
+        }                                                                 \
+    } while (0)
+
+static void check_pred(HEVCPredContext *h, int bit_depth)
+{
+    LOCAL_ALIGNED_32(uint8_t, top_buf,  [2 * 65 * 2]);
+    LOCAL_ALIGNED_32(uint8_t, left_buf, [2 * 65 * 2]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [BUF_SIZE]);
+    const int ps        = bit_depth > 8 ? 2 : 1;
+    const uint8_t *top  = top_buf  + ps;
+    const uint8_t *left = left_buf + ps;
+    int i, c_idx, mode;
+
+    for (i = 2; i <= 5; i++) {
+        int size = 1 << i;
+
+        {
+            declare_func(void, uint8_t *src, const uint8_t *top,
+                         const uint8_t *left, ptrdiff_t stride);
+
+            if (check_func(h->pred_planar[i - 2], "hevc_pred_planar_%dx%d_%d",
+                           size, size, bit_depth)) {
+                randomize_buffers(bit_depth);
+                call_ref(dst0, top, left, STRIDE);
+                call_new(dst1, top, left, STRIDE);
+                if (memcmp(dst0, dst1, BUF_SIZE))
+                    fail();
+                bench_new(dst1, top, left, STRIDE);
+            }
+        }
+
+        {
+            declare_func(void, uint8_t *src, const uint8_t *top,
+                         const uint8_t *left, ptrdiff_t stride,
+                         int log2_size, int c_idx);
+
+            if (check_func(h->pred_dc, "hevc_pred_dc_%dx%d_%d", size, size, bit_depth)) {
+                for (c_idx = 0; c_idx < 2; c_idx++) {
+                    randomize_buffers(bit_depth);
+                    call_ref(dst0, top, left, STRIDE, i, c_idx);
+                    call_new(dst1, top, left, STRIDE, i, c_idx);
+                    if (memcmp(dst0, dst1, BUF_SIZE))
+                        fail();
+                }
+                bench_new(dst1, top, left, STRIDE, i, 0);
+            }
+        }
+
+        {
+            static const struct {
+                const char *name;
+                int first, last, bench;
+            } dirs[] = {
+                { "horizontal",  2, 17,  6 },
+                { "vertical",   18, 34, 30 },
+            };
+            int dir;
+            declare_func(void, uint8_t *src, const uint8_t *top,
+                         const uint8_t *left, ptrdiff_t stride,
+                         int c_idx, int mode);
+
+            for (dir = 0; dir < FF_ARRAY_ELEMS(dirs); dir++) {
+                if (check_func(h->pred_angular[i - 2], "hevc_pred_angular_%s_%dx%d_%d",
+                               dirs[dir].name, size, size, bit_depth)) {
+                    for (mode = dirs[dir].first; mode <= dirs[dir].last; mode++) {
+                        for (c_idx = 0; c_idx < 2; c_idx++) {
+                            randomize_buffers(bit_depth);
+                            call_ref(dst0, top, left, STRIDE, c_idx, mode);
+                            call_new(dst1, top, left, STRIDE, c_idx, mode);
+                            if (memcmp(dst0, dst1, BUF_SIZE))
+                                fail();
+                        }
+                    }
+                    bench_new(dst1, top, left, STRIDE, 1, dirs[dir].bench);
+                }
+            }
+        }
+    }
+}
+
+void checkasm_check_hevc_pred(void)
+{
+    int bit_depth;
+
+    for (bit_depth = 8; bit_depth <= 10; bit_depth += 2) {
+        HEVCPredContext h;
+
+        ff_hevc_pred_init(&h, bit_depth);
+        check_pred(&h, bit_depth);
+    }
+    report("pred");
+}
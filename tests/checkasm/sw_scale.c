@@ -0,0 +1,241 @@
+/*
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+
+#include "libswscale/swscale.h"
+#include "libswscale/swscale_internal.h"
+
+#include "checkasm.h"
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        int j;                            \
+        for (j = 0; j < size; j += 4)     \
+            AV_WN32(buf + j, rnd());      \
+    } while (0)
+
+static const int width[] = { 1, 7, 8, 16, 24, 100, 128, 321, 512 };
+
+#define MAX_WIDTH    512
+#define MAX_FILTER   16
+#define SRC_PIXELS   (2 * MAX_WIDTH)
+/* the SIMD versions write up to a whole register past dstW */
+#define DST_PADDING  64
+
+static struct SwsContext *alloc_context(enum AVPixelFormat dst_format,
+                                        int flags)
+{
+    struct SwsContext *c = sws_alloc_context_xij();
+
+    if (!c)
+        return NULL;
+    av_opt_set_int(c, "srcw", SRC_PIXELS, 0);
+    av_opt_set_int(c, "srch", 16, 0);
+    av_opt_set_int(c, "src_format", AV_PIX_FMT_YUV420P, 0);
+    av_opt_set_int(c, "dstw", MAX_WIDTH, 0);
+    av_opt_set_int(c, "dsth", 16, 0);
+    av_opt_set_int(c, "dst_format", dst_format, 0);
+    av_opt_set_int(c, "sws_flags", flags, 0);
+    if (sws_init_context_xij(c, NULL, NULL) < 0)
+        sws_freeContext_xij(c), c = NULL;
+    return c;
+}
+
+/* coefficients small enough that no implementation has to saturate */
+static void randomize_filter(int16_t *filter, int size, int bits)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+        filter[i] = (int)(rnd() & ((1 << bits) - 1)) - (1 << (bits - 1));
+}
+
+static void check_hscale(void)
+{
+    static const int filter_sizes[] = { 4, 8 };
+    static const enum AVPixelFormat dst_formats[] = {
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P16LE,
+    };
+    LOCAL_ALIGNED_32(uint8_t, src, [SRC_PIXELS + MAX_FILTER]);
+    LOCAL_ALIGNED_32(int32_t, dst0, [MAX_WIDTH + DST_PADDING]);
+    LOCAL_ALIGNED_32(int32_t, dst1, [MAX_WIDTH + DST_PADDING]);
+    LOCAL_ALIGNED_32(int16_t, filter, [(MAX_WIDTH + 7) * 8]);
+    LOCAL_ALIGNED_32(int32_t, filter_pos, [MAX_WIDTH + 7]);
+    int i, j, k, w;
+
+    declare_func(void, SwsContext *c, int16_t *dst, int dstW,
+                 const uint8_t *src, const int16_t *filter,
+                 const int32_t *filterPos, int filterSize);
+
+    randomize_buffers(src, SRC_PIXELS + MAX_FILTER);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(dst_formats); i++) {
+        for (j = 0; j < FF_ARRAY_ELEMS(filter_sizes); j++) {
+            const int filter_size = filter_sizes[j];
+            struct SwsContext *c = alloc_context(dst_formats[i], SWS_BILINEAR);
+            int bits;
+
+            if (!c) {
+                fail();
+                continue;
+            }
+            bits = c->dstBpc <= 14 ? 15 : 19;
+            c->hLumFilterSize = filter_size;
+            ff_getSwsFunc(c);
+
+            if (check_func(c->hyScale, "hscale_8_to_%d_%d", bits, filter_size)) {
+                for (k = 0; k < FF_ARRAY_ELEMS(width); k++) {
+                    const int dst_w = width[k];
+
+                    /* padded like initFilter() does */
+                    for (w = 0; w < dst_w + 7; w++) {
+                        filter_pos[w] = w < dst_w ? rnd() % (SRC_PIXELS - filter_size)
+                                                  : filter_pos[dst_w - 1];
+                        randomize_filter(filter + w * filter_size, filter_size, 12);
+                    }
+                    memset(dst0, 0, (MAX_WIDTH + DST_PADDING) * sizeof(*dst0));
+                    memset(dst1, 0, (MAX_WIDTH + DST_PADDING) * sizeof(*dst1));
+
+                    call_ref(c, (int16_t *)dst0, dst_w, src, filter, filter_pos, filter_size);
+                    call_new(c, (int16_t *)dst1, dst_w, src, filter, filter_pos, filter_size);
+                    if (memcmp(dst0, dst1, dst_w * (bits == 15 ? 2 : 4)))
+                        fail();
+                }
+                bench_new(c, (int16_t *)dst1, MAX_WIDTH, src, filter, filter_pos, filter_size);
+            }
+            sws_freeContext_xij(c);
+        }
+    }
+}
+
+static void check_yuv2planeX(void)
+{
+    static const int filter_sizes[] = { 2, 4, 8, 16 };
+    static const uint8_t dither[8] = { 64, 0, 48, 16, 60, 4, 52, 20 };
+    LOCAL_ALIGNED_32(int16_t, src_pixels, [MAX_FILTER * (MAX_WIDTH + DST_PADDING)]);
+    LOCAL_ALIGNED_32(int16_t, filter, [MAX_FILTER]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [MAX_WIDTH + DST_PADDING]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [MAX_WIDTH + DST_PADDING]);
+    const int16_t *src[MAX_FILTER];
+    struct SwsContext *c;
+    int i, j, k;
+
+    declare_func_emms(AV_CPU_FLAG_MMX, void, const int16_t *filter, int filterSize,
+                      const int16_t **src, uint8_t *dest, int dstW,
+                      const uint8_t *dither, int offset);
+
+    c = alloc_context(AV_PIX_FMT_YUV420P, SWS_BILINEAR | SWS_ACCURATE_RND);
+    if (!c) {
+        fail();
+        return;
+    }
+
+    for (i = 0; i < MAX_FILTER * (MAX_WIDTH + DST_PADDING); i++)
+        src_pixels[i] = rnd() & 0x7fff;
+    for (i = 0; i < MAX_FILTER; i++)
+        src[i] = src_pixels + i * (MAX_WIDTH + DST_PADDING);
+
+    if (check_func(c->yuv2planeX, "yuv2planeX_8")) {
+        for (i = 0; i < FF_ARRAY_ELEMS(filter_sizes); i++) {
+            randomize_filter(filter, filter_sizes[i], 12);
+            for (j = 0; j < FF_ARRAY_ELEMS(width); j++) {
+                for (k = 0; k <= 3; k += 3) {
+                    memset(dst0, 0, MAX_WIDTH + DST_PADDING);
+                    memset(dst1, 0, MAX_WIDTH + DST_PADDING);
+                    call_ref(filter, filter_sizes[i], src, dst0, width[j], dither, k);
+                    call_new(filter, filter_sizes[i], src, dst1, width[j], dither, k);
+                    if (memcmp(dst0, dst1, width[j]))
+                        fail();
+                }
+            }
+        }
+        bench_new(filter, 8, src, dst1, MAX_WIDTH, dither, 0);
+    }
+    sws_freeContext_xij(c);
+}
+
+static void check_yuv2nv12cX(void)
+{
+    static const enum AVPixelFormat dst_formats[] = {
+        AV_PIX_FMT_NV12, AV_PIX_FMT_NV21,
+    };
+    static const uint8_t dither[8] = { 64, 0, 48, 16, 60, 4, 52, 20 };
+    LOCAL_ALIGNED_32(int16_t, src_pixels, [2 * MAX_FILTER * (MAX_WIDTH + DST_PADDING)]);
+    LOCAL_ALIGNED_32(int16_t, filter, [MAX_FILTER]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [2 * (MAX_WIDTH + DST_PADDING)]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [2 * (MAX_WIDTH + DST_PADDING)]);
+    const int16_t *src_u[MAX_FILTER], *src_v[MAX_FILTER];
+    int i, j, k;
+
+    declare_func(void, SwsContext *c, const int16_t *chrFilter, int chrFilterSize,
+                 const int16_t **chrUSrc, const int16_t **chrVSrc,
+                 uint8_t *dest, int dstW);
+
+    for (i = 0; i < 2 * MAX_FILTER * (MAX_WIDTH + DST_PADDING); i++)
+        src_pixels[i] = rnd() & 0x7fff;
+    for (i = 0; i < MAX_FILTER; i++) {
+        src_u[i] = src_pixels + (2 * i    ) * (MAX_WIDTH + DST_PADDING);
+        src_v[i] = src_pixels + (2 * i + 1) * (MAX_WIDTH + DST_PADDING);
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(dst_formats); i++) {
+        struct SwsContext *c = alloc_context(dst_formats[i], SWS_BILINEAR);
+
+        if (!c) {
+            fail();
+            continue;
+        }
+        c->chrDither8 = dither;
+
+        if (check_func(c->yuv2nv12cX, "yuv2%scX",
+                       dst_formats[i] == AV_PIX_FMT_NV12 ? "nv12" : "nv21")) {
+            for (j = 1; j <= MAX_FILTER; j++) {
+                randomize_filter(filter, j, 12);
+                for (k = 0; k < FF_ARRAY_ELEMS(width); k++) {
+                    memset(dst0, 0, 2 * (MAX_WIDTH + DST_PADDING));
+                    memset(dst1, 0, 2 * (MAX_WIDTH + DST_PADDING));
+                    call_ref(c, filter, j, src_u, src_v, dst0, width[k]);
+                    call_new(c, filter, j, src_u, src_v, dst1, width[k]);
+                    if (memcmp(dst0, dst1, 2 * width[k]))
+                        fail();
+                }
+            }
+            bench_new(c, filter, 4, src_u, src_v, dst1, MAX_WIDTH);
+        }
+        sws_freeContext_xij(c);
+    }
+}
+
+void checkasm_check_sw_scale(void)
+{
+    check_hscale();
+    report("hscale");
+
+    check_yuv2planeX();
+    report("yuv2planeX");
+
+    check_yuv2nv12cX();
+    report("yuv2nv12cX");
+}
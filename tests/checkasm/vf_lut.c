@@ -0,0 +1,88 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/lut.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+
+#define WIDTH 256
+#define WIDTH_PADDED (256 + 32)
+
+static const int widths[] = { 1, 15, 16, 17, 31, 32, 33, 100, WIDTH };
+
+static void check_lut_row8(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,     [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst_init, [WIDTH_PADDED]);
+    LUTTable8 tab;
+    LUTDSPContext dsp, dsp_c;
+    int cpu_flags = av_get_cpu_flags();
+    int i;
+
+    declare_func(int, uint8_t *dst, const uint8_t *src, const LUTTable8 *tab, int w);
+
+    ff_lut_init(&dsp);
+    /* the C version, which vf_lut runs on the samples the SIMD versions
+     * leave over */
+    av_force_cpu_flags(0);
+    ff_lut_init(&dsp_c);
+    av_force_cpu_flags(cpu_flags);
+
+    for (i = 0; i < 256; i++)
+        tab.val[i] = rnd();
+    ff_lut_init_table8(&tab);
+    /* every value at least once, including the 0x7f/0x80 boundary */
+    for (i = 0; i < WIDTH_PADDED; i++)
+        src[i] = i < 256 ? i * 97 : rnd();
+    memset(dst_init, 0xaa, WIDTH_PADDED);
+
+    if (check_func(dsp.lut_row8, "lut_row8")) {
+        for (i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            const int w = widths[i];
+            int n;
+
+            memcpy(dst_ref, dst_init, WIDTH_PADDED);
+            memcpy(dst_new, dst_init, WIDTH_PADDED);
+            /* a lookup is exact, so the row looked up the way vf_lut does,
+             * with the C version finishing the samples the tested one
+             * returned untouched, must match the C version alone and the
+             * tail must still hold the 0xaa filler */
+            dsp_c.lut_row8(dst_ref, src, &tab, w);
+            n = call_new(dst_new, src, &tab, w);
+            if (n < 0 || n > w ||
+                memcmp(dst_init + n, dst_new + n, WIDTH_PADDED - n)) {
+                fail();
+                continue;
+            }
+            dsp_c.lut_row8(dst_new + n, src + n, &tab, w - n);
+            if (memcmp(dst_ref, dst_new, WIDTH_PADDED))
+                fail();
+        }
+        bench_new(dst_new, src, &tab, WIDTH);
+    }
+}
+
+void checkasm_check_vf_lut(void)
+{
+    check_lut_row8();
+    report("lut_row8");
+}
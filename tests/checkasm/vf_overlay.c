@@ -0,0 +1,118 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/vf_overlay.h"
+#include "libavutil/cpu.h"
+#include "libavutil/intreadwrite.h"
+
+#define WIDTH 256
+#define WIDTH_PADDED 256 + 32
+#define ALPHA_LINESIZE (2 * WIDTH_PADDED)
+
+#define randomize_buffers(buf, size)     \
+    do {                                 \
+       int j;                            \
+       uint8_t *tmp_buf = (uint8_t *)buf;\
+       for (j = 0; j < size; j++)        \
+           tmp_buf[j] = rnd() & 0xFF;    \
+    } while (0)
+
+/* around the 8 and 16 pixel blocks of the SSE4 and AVX2 versions */
+static const int widths[] = { 1, 7, 8, 15, 16, 17, 24, 33, 100, WIDTH };
+
+static void check_overlay(enum AVPixelFormat pix_fmt, int alpha_format)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,     [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, alpha,   [2 * ALPHA_LINESIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst,     [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [WIDTH_PADDED]);
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+    OverlayContext s, s_c;
+    int cpu_flags = av_get_cpu_flags();
+    int i, p;
+
+    declare_func(int, uint8_t *d, const uint8_t *s, const uint8_t *a,
+                 int w, ptrdiff_t alinesize);
+
+    memset(&s, 0, sizeof(s));
+    s.main_desc    = desc;
+    s.hsub         = desc->log2_chroma_w;
+    s.vsub         = desc->log2_chroma_h;
+    s.alpha_format = alpha_format;
+    ff_overlay_init(&s);
+    /* the C versions, which stand in for the generic code of vf_overlay
+     * that blends the pixels the SIMD versions leave over */
+    s_c = s;
+    av_force_cpu_flags(0);
+    ff_overlay_init(&s_c);
+    av_force_cpu_flags(cpu_flags);
+
+    randomize_buffers(src,   WIDTH_PADDED);
+    randomize_buffers(alpha, 2 * ALPHA_LINESIZE);
+    randomize_buffers(dst,   WIDTH_PADDED);
+    /* make sure fully transparent and fully opaque pixels occur */
+    for (i = 0; i < 2 * ALPHA_LINESIZE; i += 7)
+        alpha[i] = i & 8 ? 255 : 0;
+
+    for (p = 0; p < 2; p++) {
+        if (check_func(s.blend_row[p], "overlay_%s_%s_%s", desc->name,
+                       alpha_format ? "premultiplied" : "straight",
+                       p ? "chroma" : "luma")) {
+            for (i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+                const int w = widths[i];
+                int n;
+
+                memcpy(dst_ref, dst, WIDTH_PADDED);
+                memcpy(dst_new, dst, WIDTH_PADDED);
+                /* blend the row the way vf_overlay does, finishing the pixels
+                 * the tested version returned unblended in C, and compare
+                 * with the C version alone */
+                s_c.blend_row[p](dst_ref, src, alpha, w, ALPHA_LINESIZE);
+                n = call_new(dst_new, src, alpha, w, ALPHA_LINESIZE);
+                if (n < 0 || n > w ||
+                    memcmp(dst + n, dst_new + n, WIDTH_PADDED - n)) {
+                    fail();
+                    continue;
+                }
+                s_c.blend_row[p](dst_new + n, src + n, alpha + (n << (p ? s.hsub : 0)),
+                                 w - n, ALPHA_LINESIZE);
+                if (memcmp(dst_ref, dst_new, WIDTH_PADDED))
+                    fail();
+            }
+            bench_new(dst_new, src, alpha, WIDTH, ALPHA_LINESIZE);
+        }
+    }
+}
+
+void checkasm_check_vf_overlay(void)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV422P,
+        AV_PIX_FMT_YUV444P, AV_PIX_FMT_GBRP,
+    };
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(pix_fmts); i++) {
+        check_overlay(pix_fmts[i], 0);
+        check_overlay(pix_fmts[i], 1);
+    }
+    report("overlay_row");
+}
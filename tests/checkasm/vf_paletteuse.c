@@ -0,0 +1,71 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "checkasm.h"
+#include "libavfilter/paletteuse.h"
+#include "libavutil/common.h"
+
+#define NB_COLORS 256
+
+static const int nb_colors[] = { 1, 7, 8, 16, 33, 100, 255, NB_COLORS };
+
+static void check_nearest_color(void)
+{
+    LOCAL_ALIGNED_32(uint32_t, pal_rg, [NB_COLORS]);
+    LOCAL_ALIGNED_32(uint32_t, pal_b,  [NB_COLORS]);
+    PaletteUseDSPContext dsp;
+    int i, j, k;
+
+    declare_func(int, const uint32_t *pal_rg, const uint32_t *pal_b,
+                 int nb, uint32_t rg, uint32_t b);
+
+    ff_paletteuse_init(&dsp);
+
+    if (check_func(dsp.nearest_color, "nearest_color")) {
+        for (i = 0; i < FF_ARRAY_ELEMS(nb_colors); i++) {
+            const int nb = FFALIGN(nb_colors[i], PALETTEUSE_PAL_ALIGN);
+
+            /* a small range of values makes equally near entries likely */
+            for (j = 0; j < nb_colors[i]; j++) {
+                const int mask = i & 1 ? 0x0f : 0xff;
+                pal_rg[j] = (rnd() & mask) | (rnd() & mask) << 16;
+                pal_b[j]  =  rnd() & mask;
+            }
+            for (; j < nb; j++) {
+                pal_rg[j] = PALETTEUSE_PAL_PAD | PALETTEUSE_PAL_PAD << 16;
+                pal_b[j]  = PALETTEUSE_PAL_PAD;
+            }
+            for (k = 0; k < 64; k++) {
+                const uint32_t rg = k ? (rnd() & 0xff) | (rnd() & 0xff) << 16 : 0xff00ff;
+                const uint32_t b  = k ? rnd() & 0xff : 0xff;
+                const int ref = call_ref(pal_rg, pal_b, nb, rg, b);
+                const int new = call_new(pal_rg, pal_b, nb, rg, b);
+
+                if (ref != new)
+                    fail();
+            }
+        }
+        bench_new(pal_rg, pal_b, NB_COLORS, 0x800080, 0x80);
+    }
+}
+
+void checkasm_check_vf_paletteuse(void)
+{
+    check_nearest_color();
+    report("nearest_color");
+}
@@ -0,0 +1,131 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/tonemap.h"
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+
+#define WIDTH 256
+#define WIDTH_PADDED (256 + 32)
+
+/* one vector of 4 or 8 floats and the pixels left over after it */
+static const int widths[] = { 1, 3, 4, 5, 7, 8, 9, 37, WIDTH };
+
+/* the C version, which vf_tonemap runs on the pixels the SIMD versions
+ * leave over */
+static void init_c(TonemapDSPContext *dsp)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    av_force_cpu_flags(0);
+    ff_tonemap_init(dsp);
+    av_force_cpu_flags(cpu_flags);
+}
+
+static void randomize_samples(float *buf, int size)
+{
+    int i;
+
+    for (i = 0; i < size; i++) {
+        float v = (rnd() & 0xffff) / 65535.0f;
+
+        switch (rnd() & 15) {
+        case 0:  buf[i] = 0;         break;
+        case 1:  buf[i] = -v;        break;
+        case 2:  buf[i] = v * 10000; break;
+        default: buf[i] = v * v * 20; break;
+        }
+    }
+}
+
+static void check_tonemap_row(float desat)
+{
+    LOCAL_ALIGNED_32(float, src,      [3 * WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(float, dst_ref,  [3 * WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(float, dst_new,  [3 * WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(float, dst_init, [WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(float, lut,      [TONEMAP_LUT_SIZE + 2]);
+    const float *const src_p[3] = { src, src + WIDTH_PADDED, src + 2 * WIDTH_PADDED };
+    float *const ref_p[3] = { dst_ref, dst_ref + WIDTH_PADDED, dst_ref + 2 * WIDTH_PADDED };
+    float *const new_p[3] = { dst_new, dst_new + WIDTH_PADDED, dst_new + 2 * WIDTH_PADDED };
+    TonemapRowParams params = {
+        .coeffs = { 0.2627f, 0.0593f, 0.6780f },
+        .desat  = desat,
+        .peak   = 10.0f,
+    };
+    TonemapDSPContext dsp, dsp_c;
+    int i, p;
+
+    declare_func(int, float *const dst[3], const float *const src[3],
+                 const float *lut, const TonemapRowParams *params, int w);
+
+    ff_tonemap_init(&dsp);
+    init_c(&dsp_c);
+
+    for (i = 0; i < TONEMAP_LUT_SIZE + 2; i++)
+        lut[i] = (rnd() & 0xffff) / 32768.0f;
+    randomize_samples(src, 3 * WIDTH_PADDED);
+    for (i = 0; i < WIDTH_PADDED; i++)
+        dst_init[i] = -1.0f;
+
+    if (check_func(dsp.tonemap_row, "tonemap_row%s", desat > 0 ? "_desat" : "")) {
+        for (i = 0; i < FF_ARRAY_ELEMS(widths); i++) {
+            const int w = widths[i];
+            const float *src_tail[3];
+            float *new_tail[3];
+            int n;
+
+            for (p = 0; p < 3; p++) {
+                memcpy(ref_p[p], dst_init, WIDTH_PADDED * sizeof(float));
+                memcpy(new_p[p], dst_init, WIDTH_PADDED * sizeof(float));
+            }
+            /* convert the row the way vf_tonemap does, with the C version
+             * finishing the pixels the tested one returned unconverted, and
+             * compare with the C version alone; the C compiler may contract
+             * the luma and desaturation multiply-adds, so allow 1 ulp */
+            dsp_c.tonemap_row(ref_p, src_p, lut, &params, w);
+            n = call_new(new_p, src_p, lut, &params, w);
+            if (n < 0 || n > w) {
+                fail();
+                continue;
+            }
+            for (p = 0; p < 3; p++) {
+                if (memcmp(dst_init + n, new_p[p] + n, (WIDTH_PADDED - n) * sizeof(float)))
+                    fail();
+                src_tail[p] = src_p[p] + n;
+                new_tail[p] = new_p[p] + n;
+            }
+            dsp_c.tonemap_row(new_tail, src_tail, lut, &params, w - n);
+            for (p = 0; p < 3; p++) {
+                if (!float_near_ulp_array(ref_p[p], new_p[p], 1, w) ||
+                    memcmp(dst_init + w, new_p[p] + w, (WIDTH_PADDED - w) * sizeof(float)))
+                    fail();
+            }
+        }
+        bench_new(new_p, src_p, lut, &params, WIDTH);
+    }
+}
+
+void checkasm_check_vf_tonemap(void)
+{
+    check_tonemap_row(0);
+    check_tonemap_row(2.0f);
+    report("tonemap_row");
+}
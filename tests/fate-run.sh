@@ -134,6 +134,15 @@ framecrc(){
     ffmpeg "$@" -bitexact -f framecrc -
 }
 
+# framecrc with the given decoder thread count and type instead of the
+# ones of the run, for comparing with the single-threaded reference
+threads_framecrc(){
+    threads=$1
+    thread_type=$2
+    shift 2
+    framecrc "$@"
+}
+
 ffmetadata(){
     ffmpeg "$@" -bitexact -f ffmetadata -
 }
@@ -25,6 +25,23 @@ FATE_API_SAMPLES_LIBAVFORMAT-$(call DEMDEC, IMAGE2, MJPEG) += fate-api-mjpeg-cod
 fate-api-mjpeg-codec-param: $(APITESTSDIR)/api-codec-param-test$(EXESUF)
 fate-api-mjpeg-codec-param: CMD = run $(APITESTSDIR)/api-codec-param-test $(TARGET_SAMPLES)/exif/image_small.jpg
 
+# The H.264 sample does not signal its reorder depth, so probing decodes
+# frames after parsing the headers; HEVC and VP9 need no decoding at all.
+FATE_API_SAMPLES_LIBAVFORMAT-$(call DEMDEC, H264, H264) += fate-api-probe-h264
+fate-api-probe-h264: $(APITESTSDIR)/api-probe-test$(EXESUF)
+fate-api-probe-h264: CMD = run $(APITESTSDIR)/api-probe-test $(TARGET_SAMPLES)/h264-conformance/SVA_NL2_E.264 1 20
+fate-api-probe-h264: CMP = null
+
+FATE_API_SAMPLES_LIBAVFORMAT-$(call DEMDEC, HEVC, HEVC) += fate-api-probe-hevc
+fate-api-probe-hevc: $(APITESTSDIR)/api-probe-test$(EXESUF)
+fate-api-probe-hevc: CMD = run $(APITESTSDIR)/api-probe-test $(TARGET_SAMPLES)/hevc-conformance/AMP_A_Samsung_4.bit 0 0
+fate-api-probe-hevc: CMP = null
+
+FATE_API_SAMPLES_LIBAVFORMAT-$(call DEMDEC, MATROSKA, VP9) += fate-api-probe-vp9
+fate-api-probe-vp9: $(APITESTSDIR)/api-probe-test$(EXESUF)
+fate-api-probe-vp9: CMD = run $(APITESTSDIR)/api-probe-test $(TARGET_SAMPLES)/vp9-test-vectors/vp90-2-00-quantizer-00.webm 0 0
+fate-api-probe-vp9: CMP = null
+
 FATE_API-$(HAVE_THREADS) += fate-api-threadmessage
 fate-api-threadmessage: $(APITESTSDIR)/api-threadmessage-test$(EXESUF)
 fate-api-threadmessage: CMD = run $(APITESTSDIR)/api-threadmessage-test 3 10 30 50 2 20 40
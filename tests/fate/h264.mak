@@ -219,6 +219,10 @@ FATE_H264-$(call DEMDEC,  MOV, H264) += fate-h264-unescaped-extradata
 # this sample contains field-coded frames, with both fields in a single packet
 FATE_H264-$(call DEMDEC,  MOV, H264) += fate-h264-twofields-packet
 
+# this sample has several slices per picture, frame and slice threads together
+# must give the same output as a single thread
+FATE_H264-$(call DEMDEC, H264, H264) += fate-h264-frame-slice-threads
+
 FATE_H264-$(call ALLYES, MOV_DEMUXER H264_MP4TOANNEXB_BSF H264_MUXER) += fate-h264-bsf-mp4toannexb
 FATE_H264-$(call DEMDEC, MATROSKA, H264) += fate-h264-direct-bff
 FATE_H264-$(call DEMDEC, FLV, H264) += fate-h264-brokensps-2580
@@ -440,6 +444,8 @@ fate-h264-twofields-packet:                       CMD = framecrc -i $(TARGET_SAM
 fate-h264-unescaped-extradata:                    CMD = framecrc -i $(TARGET_SAMPLES)/h264/unescaped_extradata.mp4 -an -frames 10
 fate-h264-3386:                                   CMD = framecrc -i $(TARGET_SAMPLES)/h264/bbc2.sample.h264
 fate-h264-missing-frame:                          CMD = framecrc -i $(TARGET_SAMPLES)/h264/nondeterministic_cut.h264
+fate-h264-frame-slice-threads:                    CMD = threads_framecrc 4 frame+slice -frame_threads 2 -framerate 19 -i $(TARGET_SAMPLES)/h264-conformance/BA1_FT_C.264
+fate-h264-frame-slice-threads:                    REF = $(SRC_PATH)/tests/ref/fate/h264-conformance-ba1_ft_c
 
 fate-h264-reinit-%:                               CMD = framecrc -i $(TARGET_SAMPLES)/h264/$(@:fate-h264-%=%).h264 -vf format=yuv444p10le,scale=w=352:h=288
 
@@ -243,6 +243,12 @@ fate-hevc-bsf-mp4toannexb: REF = 1873662a3af1848c37e4eb25722c8df9
 fate-hevc-skiploopfilter: CMD = framemd5 -skip_loop_filter nokey -i $(TARGET_SAMPLES)/hevc-conformance/SAO_D_Samsung_5.bit -sws_flags bitexact
 FATE_HEVC += fate-hevc-skiploopfilter
 
+# decode a WPP stream with frame and slice threads together, the output must
+# match the single-threaded reference
+fate-hevc-frame-slice-threads: CMD = threads_framecrc 4 frame+slice -frame_threads 2 -flags unaligned -vsync drop -i $(TARGET_SAMPLES)/hevc-conformance/WPP_B_ericsson_MAIN_2.bit -pix_fmt yuv420p
+fate-hevc-frame-slice-threads: REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-WPP_B_ericsson_MAIN_2
+FATE_HEVC += fate-hevc-frame-slice-threads
+
 FATE_HEVC-$(call DEMDEC, HEVC, HEVC) += $(FATE_HEVC)
 
 # this sample has two stsd entries and needs to reload extradata
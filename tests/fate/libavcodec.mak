@@ -18,6 +18,11 @@ fate-codec_desc: libavcodec/tests/codec_desc$(EXESUF)
 fate-codec_desc: CMD = run libavcodec/tests/codec_desc
 fate-codec_desc: CMP = null
 
+FATE_LIBAVCODEC-yes += fate-framepool
+fate-framepool: libavcodec/tests/framepool$(EXESUF)
+fate-framepool: CMD = run libavcodec/tests/framepool
+fate-framepool: CMP = null
+
 FATE_LIBAVCODEC-$(CONFIG_GOLOMB) += fate-golomb
 fate-golomb: libavcodec/tests/golomb$(EXESUF)
 fate-golomb: CMD = run libavcodec/tests/golomb